@@ -0,0 +1,134 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef ARRAY_STORAGE_HEADER
+#define ARRAY_STORAGE_HEADER
+
+//Local
+#include "CCCoreLib.h"
+
+//system
+#include <stddef.h>
+#include <string>
+
+//! Raw memory block holding the content of a GenericChunkedArray (64 bits version)
+/** Two backends are available:
+	- HEAP_MEMORY: standard (anonymous) memory
+	- MAPPED_FILE: memory mapped on a temporary 'scratch' file (deleted automatically).
+	Pages are loaded on demand by the system, and can be written back to the disk
+	when memory is scarce, so that the arrays may exceed the physical memory.
+	When MAPPED_FILE is the default backend, the arrays are only mapped once they
+	exceed a given size (see SetMappingThreshold): small arrays (reference clouds
+	indexes, temporary arrays, etc.) stay in memory and don't use a file handle.
+	In both cases, the block grows without copying its content whenever the system
+	allows it, and sizes are handled with 64 bits integers.
+**/
+class CC_CORE_LIB_API ArrayStorage
+{
+public:
+
+	//! Storage backends
+	enum Backend { HEAP_MEMORY = 0, MAPPED_FILE = 1 };
+
+	//! Sets the backend used by default by the new arrays
+	static void SetDefaultBackend(Backend backend);
+	//! Returns the backend used by default by the new arrays
+	static Backend GetDefaultBackend();
+
+	//! Sets the minimal size above which the arrays created with the MAPPED_FILE default backend are actually mapped
+	/** \param byteCount threshold (in bytes)
+	**/
+	static void SetMappingThreshold(size_t byteCount);
+	//! Returns the minimal size above which the arrays created with the MAPPED_FILE default backend are actually mapped
+	static size_t GetMappingThreshold();
+
+	//! Sets the directory where the scratch files (MAPPED_FILE backend) are created
+	/** By default, the system temporary directory is used.
+	**/
+	static void SetScratchDirectory(const std::string& path);
+	//! Returns the directory where the scratch files (MAPPED_FILE backend) are created
+	static std::string GetScratchDirectory();
+
+	//! Default constructor (uses the default backend)
+	/** With the MAPPED_FILE default backend, the block is only mapped once it
+		exceeds the mapping threshold.
+	**/
+	ArrayStorage();
+
+	//! Destructor
+	~ArrayStorage();
+
+	//! Returns the current backend
+	inline Backend backend() const { return m_backend; }
+
+	//! Changes the backend
+	/** The current content is preserved. The backend is applied immediately,
+		whatever the size of the block.
+		\return success
+	**/
+	bool setBackend(Backend backend);
+
+	//! Resizes the block
+	/** The current content is preserved. New bytes are set to 0.
+		\param byteCount new size (in bytes)
+		\return success
+	**/
+	bool resize(size_t byteCount);
+
+	//! Releases the memory
+	void clear();
+
+	//! Returns the size of the block (in bytes)
+	inline size_t size() const { return m_size; }
+
+	//! Returns a pointer on the beginning of the block
+	inline void* data() { return m_data; }
+	//! Returns a pointer on the beginning of the block (const version)
+	inline const void* data() const { return m_data; }
+
+protected:
+
+	//! Resizes the block (HEAP_MEMORY backend)
+	bool resizeHeap(size_t byteCount);
+	//! Resizes the block (MAPPED_FILE backend)
+	bool resizeMapped(size_t byteCount);
+
+	//! Data
+	void* m_data;
+	//! Size (in bytes)
+	size_t m_size;
+	//! Current backend
+	Backend m_backend;
+	//! Whether the block should switch to the MAPPED_FILE backend once it exceeds the mapping threshold
+	bool m_mapWhenBig;
+
+	//! Scratch file handle (MAPPED_FILE backend)
+#ifdef _WIN32
+	void* m_fileHandle;
+#else
+	int m_fileHandle;
+#endif
+
+private:
+
+	//forbidden (use GenericChunkedArray::copy instead)
+	ArrayStorage(const ArrayStorage&);
+	ArrayStorage& operator = (const ArrayStorage&);
+};
+
+#endif //ARRAY_STORAGE_HEADER
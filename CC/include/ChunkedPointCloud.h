@@ -210,6 +210,13 @@ public:
 		//! Returns cloud capacity (i.e. reserved size)
 		inline virtual unsigned capacity() const { return m_points->capacity(); }
 
+		//! Sets the coordinates of a given point
+		/** WARNING: index must be valid
+			\param index point index
+			\param P new point coordinates
+		**/
+		inline void setPoint(unsigned index, const CCVector3& P) { *point(index) = P; }
+
 protected:
 
 		//! Swaps two points (and their associated scalar values!)
@@ -163,21 +163,25 @@ public:
 	//! Statistical Outliers Removal (SOR) filter
 	/** This filter removes points based on their mean distance to their distance (by comparing it to the average distance of all points to their neighbors).
 		It is equivalent to PCL StatisticalOutlierRemoval filter (see http://pointclouds.org/documentation/tutorials/statistical_outlier.php)
+		\warning Use NeighbourStatsCache directly to apply the filter several times on the same cloud.
 		\param cloud the point cloud to resample
 		\param knn number of neighbors
 		\param nSigma number of sigmas under which the points should be kept
 		\param octree associated octree if available
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param maxThreadCount max number of threads (0 = all)
 		\return a reference cloud corresponding to the filtered cloud
 	**/
 	static ReferenceCloud* sorFilter(	GenericIndexedCloudPersist* cloud,
 										int knn = 6,
 										double nSigma = 1.0,
 										DgmOctree* octree = 0,
-										GenericProgressCallback* progressCb = 0);
+										GenericProgressCallback* progressCb = 0,
+										int maxThreadCount = 0);
 
 	//! Noise filter based on the distance to the approximate local surface
 	/** This filter removes points based on their distance relatively to the best fit plane computed on their neighbors.
+		\warning Use NeighbourStatsCache directly to apply the filter several times on the same cloud.
 		\param cloud the point cloud to resample
 		\param kernelRadius neighborhood radius
 		\param nSigma number of sigmas under which the points should be kept
@@ -188,6 +192,7 @@ public:
 		\param absoluteError absolute error (if useAbsoluteError is true)
 		\param octree associated octree if available
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param maxThreadCount max number of threads (0 = all)
 		\return a reference cloud corresponding to the filtered cloud
 	**/
 	static ReferenceCloud* noiseFilter(	GenericIndexedCloudPersist* cloud,
@@ -199,7 +204,8 @@ public:
 										bool useAbsoluteError = true,
 										double absoluteError = 0.0,
 										DgmOctree* octree = 0,
-										GenericProgressCallback* progressCb = 0);
+										GenericProgressCallback* progressCb = 0,
+										int maxThreadCount = 0);
 
 protected:
 
@@ -232,28 +238,6 @@ protected:
 	static bool subsampleCellAtLevel(	const DgmOctree::octreeCell& cell,
 										void** additionalParameters,
 										NormalizedProgress* nProgress = 0);
-
-	//! "Cellular" function to apply the noise filter inside an octree cell
-	/** This function is meant to be applied to all cells of the octree
-		(it is of the form DgmOctree::localFunctionPtr).
-		\param cell structure describing the cell on which processing is applied
-		\param additionalParameters see method description
-		\param nProgress optional (normalized) progress notification (per-point)
-	**/
-	static bool applyNoiseFilterAtLevel(const DgmOctree::octreeCell& cell,
-										void** additionalParameters,
-										NormalizedProgress* nProgress = 0);
-
-	//! "Cellular" function to apply the SOR filter inside an octree cell
-	/** This function is meant to be applied to all cells of the octree
-		(it is of the form DgmOctree::localFunctionPtr).
-		\param cell structure describing the cell on which processing is applied
-		\param additionalParameters see method description
-		\param nProgress optional (normalized) progress notification (per-point)
-	**/
-	static bool applySORFilterAtLevel(	const DgmOctree::octreeCell& cell,
-										void** additionalParameters,
-										NormalizedProgress* nProgress = 0);
 };
 
 }
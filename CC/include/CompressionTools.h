@@ -0,0 +1,81 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_COMPRESSION_TOOLS_HEADER
+#define CC_COMPRESSION_TOOLS_HEADER
+
+//Local
+#include "CCToolbox.h"
+
+//system
+#include <stddef.h>
+
+namespace CCLib
+{
+	//! Fast lossless compression of memory blocks
+	/** Blocks are compressed with a LZ77 byte-oriented scheme (LZ4 block format:
+		literal runs and matches of at least 4 bytes, 64 KB window) favoring
+		speed over compression ratio.
+		Numerical arrays compress much better once 'shuffled' (i.e. once the
+		bytes of same significance of all the values are stored contiguously).
+		Each block is independent from the others (so that several blocks can
+		be compressed or decompressed concurrently).
+	**/
+	class CC_CORE_LIB_API CompressionTools : public CCToolbox
+	{
+	public:
+
+		//! Returns the maximum compressed size of a block (worst case)
+		static size_t CompressBound(size_t sourceSize);
+
+		//! Compresses a block
+		/** \param source input data
+			\param sourceSize input data size (in bytes)
+			\param dest output buffer
+			\param destCapacity output buffer capacity (in bytes)
+			\return compressed size (or 0 if the output buffer is too small, e.g. if the data is incompressible)
+		**/
+		static size_t Compress(const void* source, size_t sourceSize, void* dest, size_t destCapacity);
+
+		//! Decompresses a block
+		/** The input data is fully checked (corrupted data can't cause out-of-bounds accesses).
+			\param source compressed data
+			\param sourceSize compressed data size (in bytes)
+			\param dest output buffer
+			\param destSize decompressed data size (in bytes)
+			\return false if the compressed data is corrupted (or if its decompressed size is not 'destSize')
+		**/
+		static bool Decompress(const void* source, size_t sourceSize, void* dest, size_t destSize);
+
+		//! Shuffles the bytes of an array of values (before compression)
+		/** The i-th byte of all the values are stored contiguously, for each i.
+			Trailing bytes (if the size is not a multiple of the value size) are copied as is.
+			\param source input values
+			\param dest output buffer (must not overlap with the input)
+			\param byteCount input size (in bytes)
+			\param typeSize size of each value (in bytes)
+		**/
+		static void Shuffle(const void* source, void* dest, size_t byteCount, size_t typeSize);
+
+		//! Restores the original order of shuffled bytes (see CompressionTools::Shuffle)
+		static void Unshuffle(const void* source, void* dest, size_t byteCount, size_t typeSize);
+	};
+
+} //namespace CCLib
+
+#endif //CC_COMPRESSION_TOOLS_HEADER
@@ -43,6 +43,7 @@ class ReferenceCloud;
 class GenericIndexedCloudPersist;
 class GenericProgressCallback;
 class NormalizedProgress;
+class ParallelCancelToken;
 
 //! The octree structure used throughout the library
 /** Implements the GenericOctree interface.
@@ -232,6 +233,69 @@ public:
 		**/
 		cellIndexesContainer minimalCellsSetToVisit;
 
+		//! Coordinates of the points of the already visited cells (stored as a structure of arrays)
+		/** This field is updated by the "unique nearest point" search algorithm, along with
+			minimalCellsSetToVisit. Points coordinates are gathered only once per cell so that
+			the distances can be computed with vectorized instructions.
+		**/
+		struct VisitedCellsPoints
+		{
+			//! Visited cell
+			struct Cell
+			{
+				//! Index of the cell (see NearestNeighboursSearchStruct::minimalCellsSetToVisit)
+				unsigned cellIndex;
+				//! Index of the first point of the cell (in the arrays below)
+				unsigned firstPoint;
+				//! Number of points in the cell
+				unsigned pointCount;
+				//! Min corner of the bounding-box of the cell points
+				CCVector3 bbMin;
+				//! Max corner of the bounding-box of the cell points
+				CCVector3 bbMax;
+			};
+
+			//! Points X coordinates
+			std::vector<PointCoordinateType> x;
+			//! Points Y coordinates
+			std::vector<PointCoordinateType> y;
+			//! Points Z coordinates
+			std::vector<PointCoordinateType> z;
+			//! Points global indexes (in the associated cloud)
+			std::vector<unsigned> indexes;
+			//! Visited cells
+			std::vector<Cell> cells;
+
+			//! Octree from which the points have been gathered (key)
+			const DgmOctree* octree;
+			//! Level of subdivision at which the cells have been gathered (key)
+			unsigned char level;
+			//! Position of the cell including the query point (key)
+			Tuple3i cellPos;
+
+			//! Default constructor
+			VisitedCellsPoints() : octree(0), level(0), cellPos(0,0,0) {}
+
+			//! Clears the structure (without releasing memory)
+			inline void clear() { x.clear(); y.clear(); z.clear(); indexes.clear(); cells.clear(); }
+
+			//! Clears the structure and sets its new key
+			inline void reset(const DgmOctree* o, unsigned char l, const Tuple3i& pos) { clear(); octree = o; level = l; cellPos = pos; }
+
+			//! Returns whether the gathered cells are the first ones of a given set of cells to visit
+			inline bool isValidFor(const DgmOctree* o, unsigned char l, const Tuple3i& pos, const cellIndexesContainer& cellsToVisit) const
+			{
+				return	octree == o
+					&&	level == l
+					&&	cellPos.x == pos.x && cellPos.y == pos.y && cellPos.z == pos.z
+					&&	cells.size() <= cellsToVisit.size()
+					&&	(cells.empty() || cells.back().cellIndex == cellsToVisit[cells.size()-1]);
+			}
+		};
+
+		//! Points of the already visited cells
+		VisitedCellsPoints visitedCellsPoints;
+
 		//! All the points that belong to the cubical neighbourhood of the current cell
 		/** This structure is only used by the "multiple nearest neighbours" search algorithms.
 			The nearest points (relatively to the query point) are stored at the beginning of
@@ -344,6 +408,9 @@ public:
 		{
 		}
 
+		//! Copy assignment operator
+		IndexAndCode& operator = (const IndexAndCode& ic) = default;
+
 		//! Code-based 'less than' comparison operator
 		inline bool operator < (const IndexAndCode& iac) const
 		{
@@ -461,6 +528,23 @@ public:
 				const CCVector3* pointsMaxFilter = 0,
 				GenericProgressCallback* progressCb = 0);
 
+	//! Inserts new points in the octree (incremental update)
+	/** The points must have already been added to the associated cloud, and they must
+		lie inside the current octree 'points' bounding-box (otherwise the octree should
+		be rebuilt). Cost: O(n + k.log(k)) instead of a full rebuild.
+		\param pointIndexes indexes of the new points in the associated cloud
+		\return false if one of the points lies outside the octree or if there's not enough memory (the octree is left unchanged)
+	**/
+	virtual bool insertPoints(const std::vector<unsigned>& pointIndexes);
+
+	//! Removes points from the octree (incremental update)
+	/** Cost: O(n).
+		\param pointIndexes indexes of the points to remove
+		\param shiftIndexes whether to update the remaining indexes as if the removed points had been erased from the cloud (the order of the other points being preserved)
+		\return false if there's not enough memory (the octree is left unchanged)
+	**/
+	virtual bool removePoints(const std::vector<unsigned>& pointIndexes, bool shiftIndexes);
+
 	/**** GETTERS ****/
 
 	//! Returns the number of points projected into the octree
@@ -522,7 +606,7 @@ public:
 
 	//! Returns distance from cell center to cell neighbourhood INSIDE filled octree
 	/** WARNING: if cell neighbourhood is totally outside filled octree,
-		the method returns false and cellDists is invalid.
+		the corresponding limits define an empty range (i.e. -min > max).
 		\param cellPos center cell position
 		\param level level at which octree grid is considered
 		\param neighbourhoodLength cell neighbourhood "radius"
@@ -640,6 +724,70 @@ public:
 												double radius,
 												bool sortValues = true) const;
 
+	//! Output of the batched neighbours search methods
+	/** Neighbours are stored in compressed rows: the neighbours of the i-th query point
+		are stored in 'indexes' and 'squareDistances' between offsets[i] (included)
+		and offsets[i+1] (excluded), sorted by increasing distance.
+	**/
+	struct BatchNeighbours
+	{
+		//! Offsets of each query point's neighbours (size = number of query points + 1)
+		std::vector<unsigned> offsets;
+		//! Neighbours indexes (in the octree associated cloud)
+		std::vector<unsigned> indexes;
+		//! Neighbours square distances to their query point
+		std::vector<ScalarType> squareDistances;
+
+		//! Returns the number of neighbours of a given query point
+		inline unsigned neighbourCount(unsigned queryIndex) const { return offsets[queryIndex + 1] - offsets[queryIndex]; }
+		//! Returns the number of query points
+		inline unsigned queryCount() const { return offsets.empty() ? 0 : static_cast<unsigned>(offsets.size()) - 1; }
+		//! Clears the structure
+		inline void clear() { offsets.clear(); indexes.clear(); squareDistances.clear(); }
+	};
+
+	//! Batched form of the nearest neighbours search algorithm (k nearest neighbours)
+	/** Query points are grouped by octree cell so that the neighbourhood of a
+		cell is gathered only once for all the query points it contains. Groups
+		are processed in parallel.
+		\param queryPoints query points (may not belong to the associated cloud)
+		\param queryCount number of query points
+		\param k number of neighbours to find (per query point)
+		\param[out] result neighbours of each query point
+		\param level subdivision level at which to start the search (0 = automatic)
+		\param maxSearchDist the maximum search distance (ignored if <= 0)
+		\param maxThreadCount maximum number of threads to use (0 = all)
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool findNearestNeighborsBatch(	const CCVector3* queryPoints,
+									unsigned queryCount,
+									unsigned k,
+									BatchNeighbours& result,
+									unsigned char level = 0,
+									double maxSearchDist = 0,
+									int maxThreadCount = 0,
+									GenericProgressCallback* progressCb = 0) const;
+
+	//! Batched form of the nearest neighbours search algorithm (in a sphere)
+	/** See DgmOctree::findNearestNeighborsBatch.
+		\param queryPoints query points (may not belong to the associated cloud)
+		\param queryCount number of query points
+		\param radius the sphere radius
+		\param[out] result neighbours of each query point
+		\param level subdivision level at which to apply the search (0 = automatic)
+		\param maxThreadCount maximum number of threads to use (0 = all)
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool findNeighborsInASphereBatch(	const CCVector3* queryPoints,
+										unsigned queryCount,
+										PointCoordinateType radius,
+										BatchNeighbours& result,
+										unsigned char level = 0,
+										int maxThreadCount = 0,
+										GenericProgressCallback* progressCb = 0) const;
+
 public: //extraction of points inside geometrical volumes (sphere, cylinder, box, etc.)
 
 	//deprecated
@@ -828,7 +976,12 @@ public:	/***** CELLS POSITION HANDLING *****/
 	{
 		assert(level <= MAX_OCTREE_LEVEL);
 
-		getTheCellPosWhichIncludesThePoint(thePoint, cellPos);
+		//DGM: the point may lie 'below' the octree bounding-box, in which case the 'floor' operator is mandatory
+		//(otherwise the positions in ]-1;0[ would be truncated to 0 and the point would be considered as inside)
+		const PointCoordinateType& cs = getCellSize(MAX_OCTREE_LEVEL);
+		cellPos.x = static_cast<int>(floor((thePoint->x - m_dimMin.x)/cs));
+		cellPos.y = static_cast<int>(floor((thePoint->y - m_dimMin.y)/cs));
+		cellPos.z = static_cast<int>(floor((thePoint->z - m_dimMin.z)/cs));
 
 		inBounds =	(	cellPos.x >= 0 && cellPos.x < MAX_OCTREE_LENGTH
 					 && cellPos.y >= 0 && cellPos.y < MAX_OCTREE_LENGTH
@@ -1058,7 +1211,7 @@ public:	/***** CELLS POSITION HANDLING *****/
 		number of points, avoiding great loss of performances. The only limitation is when the
 		level of subdivision is deepest level. In this case no more splitting is possible.
 
-		Parallel processing is based on QtConcurrent::map system.
+		Parallel processing is based on ParallelTools::ForEach (each call uses its own thread pool).
 
 		\param startingLevel the initial level of subdivision
 		\param func the function to apply
@@ -1085,7 +1238,7 @@ public:	/***** CELLS POSITION HANDLING *****/
 	/** The function to apply should be of the form DgmOctree::octreeCellFunc. In this case
 		the octree cells are scanned one by one at the same level of subdivision.
 
-		Parallel processing is based on QtConcurrent::map system.
+		Parallel processing is based on ParallelTools::ForEach (each call uses its own thread pool).
 
 		\param level the level of subdivision
 		\param func the function to apply
@@ -1197,6 +1350,37 @@ protected:
 	**/
 	int genericBuild(GenericProgressCallback* progressCb = 0);
 
+	//! Block of consecutive points projected in the octree (see genericBuild)
+	struct ProjectedBlock
+	{
+		//! First point index
+		unsigned firstIndex;
+		//! Last point index (excluded)
+		unsigned lastIndex;
+		//! Number of points actually projected (stored from 'firstIndex' in m_thePointsAndTheirCellCodes)
+		unsigned projectedCount;
+		//! Bitwise OR of all the generated cell codes
+		CellCode usedCodeBits;
+		//! Min fill indexes (at the highest level)
+		Tuple3i minFillIndexes;
+		//! Max fill indexes (at the highest level)
+		Tuple3i maxFillIndexes;
+
+		//! Default constructor
+		ProjectedBlock() : firstIndex(0), lastIndex(0), projectedCount(0), usedCodeBits(0) {}
+	};
+
+	//! Computes the cell codes of a block of points (thread-safe for disjoint blocks)
+	void projectPoints(ProjectedBlock& block, NormalizedProgress& nprogress, ParallelCancelToken& cancelToken);
+
+	//! Computes the position of the (max level) cell including a given point
+	/** \return false if the point lies outside the 'points' bounding-box
+	**/
+	bool projectPoint(const CCVector3* P, Tuple3i& cellPos) const;
+
+	//! Deduces the 'fill indexes' of all levels from the highest level ones
+	void updateFillIndexesFromMaxLevel();
+
 	//! Updates the tables containing octree limits and boundaries
 	void updateMinAndMaxTables();
 
@@ -1240,6 +1424,21 @@ protected:
 												int maxNeighbourhoodLength) const;
 #endif
 
+	//! Common implementation of the batched neighbours search methods
+	/** See DgmOctree::findNearestNeighborsBatch and DgmOctree::findNeighborsInASphereBatch.
+		\param k number of neighbours to find (if > 0) - otherwise the neighbours are searched inside a sphere
+		\param radius the sphere radius (ignored if k > 0)
+	**/
+	bool findNeighborsBatch(const CCVector3* queryPoints,
+							unsigned queryCount,
+							unsigned k,
+							PointCoordinateType radius,
+							BatchNeighbours& result,
+							unsigned char level,
+							double maxSearchDist,
+							int maxThreadCount,
+							GenericProgressCallback* progressCb) const;
+
 	//! Returns the index of a given cell represented by its code
 	/** The index is found thanks to a binary search. The index of an existing cell
 		is between 0 and the number of points projected in the octree minus 1. If
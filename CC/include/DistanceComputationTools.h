@@ -176,12 +176,20 @@ public: //distance to clouds or meshes
 		//! Whether triangle normals should be computed in the 'direct' order (true) or 'indirect' (false)
 		bool flipNormals;
 
-		//! Whether to use multi-thread or single thread mode (if maxSearchDist > 0, single thread mode is forced)
+		//! Whether to use multi-thread or single thread mode (if maxSearchDist > 0, single thread mode is forced, except with useTriangleBVH)
 		bool multiThread;
 
 		//! Maximum number of threads to use (0 = max)
 		int maxThreadCount;
 
+		//! Whether to use a Bounding Volume Hierarchy of the mesh triangles instead of the octree
+		/** The mesh is not rasterized in the octree grid (octreeLevel is ignored) and each point
+			is processed independently (in parallel, even if maxSearchDist > 0). Much less memory
+			is needed for big meshes.
+			\warning Incompatible with useDistanceMap (which is ignored in this case).
+		**/
+		bool useTriangleBVH;
+
 		//! Cloud to store the Closest Point Set
 		/** The cloud should be initialized but empty on input. It will have the same size as the compared cloud on output.
 			\warning Not compatible with maxSearchDist > 0.
@@ -197,6 +205,7 @@ public: //distance to clouds or meshes
 			, flipNormals(false)
 			, multiThread(true)
 			, maxThreadCount(0)
+			, useTriangleBVH(false)
 			, CPSet(0)
 		{}
 	};
@@ -406,6 +415,19 @@ protected:
 													Cloud2MeshDistanceComputationParams& params,
 													GenericProgressCallback* progressCb = 0);
 
+	//! Computes the distances between a point cloud and a mesh with a Bounding Volume Hierarchy of its triangles
+	/** This method is used by computeCloud2MeshDistance if params.useTriangleBVH is true.
+		\param pointCloud the compared cloud (its scalar field must be already enabled)
+		\param mesh the reference mesh
+		\param params parameters
+		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return -1 if an error occurred (e.g. not enough memory), -2 if the process has been cancelled and 0 otherwise
+	**/
+	static int computeCloud2MeshDistanceWithBVH(GenericIndexedCloudPersist* pointCloud,
+												GenericIndexedMesh* mesh,
+												const Cloud2MeshDistanceComputationParams& params,
+												GenericProgressCallback* progressCb = 0);
+
 	//! Computes the "nearest neighbour distance" without local modeling for all points of an octree cell
 	/** This method has the generic syntax of a "cellular function" (see DgmOctree::localFunctionPtr).
 		Specific parameters are transmitted via the "additionalParameters" structure.
@@ -144,6 +144,7 @@ protected:
 		Cell()
 			: state(FAR_CELL)
 			, T(T_INF())
+			, trialPos(0)
 		{}
 
 		//! Virtual destructor
@@ -154,6 +155,8 @@ protected:
 
 		//! Front arrival time
 		float T;
+		//! Position in the TRIAL cells heap (only valid for TRIAL cells)
+		unsigned trialPos;
 	};
 
 	//! Intializes the grid as a snapshot of an octree structure at a given subdivision level
@@ -221,10 +224,19 @@ protected:
 	}
 
 	//! Add a cell to the TRIAL cells list
-	/** \param index index of the cell
+	/** The cell front arrival time (T) must be set before calling this method.
+		\param index index of the cell
 	**/
 	virtual void addTrialCell(unsigned index);
 
+	//! Updates the front arrival time of a TRIAL cell
+	/** The TRIAL cells are stored in a min-heap: their front arrival
+		time should only be modified through this method.
+		\param index index of the cell
+		\param T new front arrival time
+	**/
+	void updateTrialCell(unsigned index, float T);
+
 	//! Add a cell to the ACTIVE cells list
 	/** \param index index of the cell
 	**/
@@ -236,10 +248,16 @@ protected:
 	virtual void addIgnoredCell(unsigned index);
 
 	//! Returns the TRIAL cell with the smallest front arrival time
-	/** \return the index of the "earliest" TRIAL cell (or 0 in case of error)
+	/** The cell is removed from the TRIAL cells list. Complexity: O(log(n)).
+		\return the index of the "earliest" TRIAL cell (or 0 in case of error)
 	**/
 	virtual unsigned getNearestTrialCell();
 
+	//! Moves a TRIAL cell up in the heap (after its arrival time has decreased)
+	void trialCellsSiftUp(unsigned pos);
+	//! Moves a TRIAL cell down in the heap (after its arrival time has increased)
+	void trialCellsSiftDown(unsigned pos);
+
 	//! Resets the state of cells in a given list
 	/** Warning: the list will be cleared!
 	**/
@@ -247,7 +265,7 @@ protected:
 
 	//! ACTIVE cells list
 	std::vector<unsigned> m_activeCells;
-	//! TRIAL cells list
+	//! TRIAL cells list (binary min-heap on the cells front arrival time)
 	std::vector<unsigned> m_trialCells;
 	//! IGNORED cells lits
 	std::vector<unsigned> m_ignoredCells;
@@ -0,0 +1,116 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+#ifndef FLAT_KD_TREE_HEADER
+#define FLAT_KD_TREE_HEADER
+
+//Local
+#include "CCGeom.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedCloud;
+class GenericProgressCallback;
+
+//! Static Kd-tree stored in flat arrays
+/** Contrary to KDTree, the nodes are stored in a single array (children are
+	contiguous) and the points are copied in leaf order, so that a query only
+	touches contiguous memory. The structure can't be updated: it is meant to
+	be built once on a cloud that won't move, then queried many times (and
+	concurrently by several threads).
+**/
+class CC_CORE_LIB_API FlatKDTree
+{
+public:
+
+	//! Default constructor
+	FlatKDTree();
+
+	//! Destructor
+	virtual ~FlatKDTree();
+
+	//! Builds the tree
+	/** \param cloud the point cloud from which to build the tree
+		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool buildFromCloud(GenericIndexedCloud* cloud, GenericProgressCallback* progressCb = 0);
+
+	//! Clears the structure
+	void clear();
+
+	//! Returns the cloud from which the tree has been built
+	GenericIndexedCloud* getAssociatedCloud() const { return m_associatedCloud; }
+
+	//! Returns the number of nodes
+	unsigned nodeCount() const { return static_cast<unsigned>(m_nodes.size()); }
+
+	//! Returns the (approximate) memory used by the structure (in bytes)
+	size_t memoryUsage() const;
+
+	//! Nearest point search
+	/** \param P query point
+		\param pointIndex [out] index of the nearest point (in the associated cloud)
+		\param squareDist [out] squared distance between the query point and the nearest point
+		\param maxSquareDist (squared) distance above which points are ignored (ignored if <= 0)
+		\return false if no point lies below 'maxSquareDist' (or if the structure is empty)
+	**/
+	bool findNearestNeighbour(	const CCVector3& P,
+								unsigned& pointIndex,
+								ScalarType& squareDist,
+								ScalarType maxSquareDist = 0) const;
+
+protected:
+
+	//! Tree node
+	struct Node
+	{
+		//! Bounding-box min corner
+		CCVector3 bbMin;													//12 bytes
+		//! Bounding-box max corner
+		CCVector3 bbMax;													//12 bytes
+		//! Leaf: index of the first point (in m_points) / Inner node: index of the first child (the second one follows it)
+		unsigned first;														//4 bytes
+		//! Number of points (0 for inner nodes)
+		unsigned count;														//4 bytes
+
+		//Total																//32 bytes
+	};
+
+	//! Splits a node (if worth it)
+	/** \param nodeIndex node index
+		\return whether the node has been split or not
+	**/
+	bool splitNode(unsigned nodeIndex);
+
+	//! Nodes (the first one is the root)
+	std::vector<Node> m_nodes;
+	//! Points (sorted by leaf)
+	std::vector<CCVector3> m_points;
+	//! Points indexes in the associated cloud (same order as m_points)
+	std::vector<unsigned> m_indexes;
+	//! Associated cloud
+	GenericIndexedCloud* m_associatedCloud;
+};
+
+} //namespace CCLib
+
+#endif //FLAT_KD_TREE_HEADER
@@ -0,0 +1,91 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef GAUSSIAN_ELIMINATION_HEADER
+#define GAUSSIAN_ELIMINATION_HEADER
+
+//Local
+#include "MathTools.h"
+
+//system
+#include <algorithm>
+#include <cmath>
+
+namespace CCLib
+{
+
+//! Direct solver for small dense linear systems (Gaussian elimination with partial pivoting)
+/** Template parameter 'N' is the dimension of the linear system.
+	Typically used to solve the (6x6) normal equations of the least squares problems.
+**/
+template <int N, class Scalar> class GaussianElimination : MathTools
+{
+public:
+
+	//! Solves A.X = b
+	/** A and b are modified in place (upper triangular form).
+		\param A the matrix (N*N)
+		\param b the right-hand side vector (size N)
+		\param X the solution (size N)
+		\param pivotTolerance the system is considered as degenerate if a pivot is (in absolute value) below this threshold
+		\return false if the system is degenerate
+	**/
+	static bool Solve(Scalar A[N][N], Scalar b[N], Scalar X[N], Scalar pivotTolerance)
+	{
+		//forward elimination
+		for (int col = 0; col < N; ++col)
+		{
+			//partial pivoting
+			int pivot = col;
+			for (int r = col + 1; r < N; ++r)
+				if (std::abs(A[r][col]) > std::abs(A[pivot][col]))
+					pivot = r;
+			if (std::abs(A[pivot][col]) <= pivotTolerance)
+				return false;
+			if (pivot != col)
+			{
+				for (int c = col; c < N; ++c)
+					std::swap(A[col][c], A[pivot][c]);
+				std::swap(b[col], b[pivot]);
+			}
+
+			for (int r = col + 1; r < N; ++r)
+			{
+				Scalar f = A[r][col] / A[col][col];
+				for (int c = col; c < N; ++c)
+					A[r][c] -= f * A[col][c];
+				b[r] -= f * b[col];
+			}
+		}
+
+		//back substitution
+		for (int r = N - 1; r >= 0; --r)
+		{
+			Scalar sum = b[r];
+			for (int c = r + 1; c < N; ++c)
+				sum -= A[r][c] * X[c];
+			X[r] = sum / A[r][r];
+		}
+
+		return true;
+	}
+};
+
+}
+
+#endif //GAUSSIAN_ELIMINATION_HEADER
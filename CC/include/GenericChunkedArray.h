@@ -39,6 +39,9 @@ static const unsigned ELEMENT_INDEX_BIT_MASK = MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-
 #endif
 
 #include "CCShareable.h"
+#ifdef CC_ENV_64
+#include "ArrayStorage.h"
+#endif
 
 //system
 #include <stdlib.h>
@@ -123,6 +126,17 @@ public:
 				+ static_cast<size_t>(N) * static_cast<size_t>(capacity()) * sizeof(ElementType);
 	}
 
+#ifdef CC_ENV_64
+	//! Returns the storage backend of this array
+	inline ArrayStorage::Backend storageBackend() const { return m_storage.backend(); }
+
+	//! Sets the storage backend of this array
+	/** The current content is preserved (see ArrayStorage).
+		\return success
+	**/
+	inline bool setStorageBackend(ArrayStorage::Backend backend) { return m_storage.setBackend(backend); }
+#endif
+
 	//! Clears the array
 	/** \param releaseMemory whether memory should be released or not (for quicker "refill")
 	**/
@@ -131,7 +145,7 @@ public:
 		if (releaseMemory)
 		{
 #ifdef CC_ENV_64
-			m_data.clear();
+			m_storage.clear();
 #else
 			while (!m_theChunks.empty())
 			{
@@ -164,8 +178,7 @@ public:
 		{
 			//default fill value = 0
 #ifdef CC_ENV_64
-			ElementType zero = 0;
-			std::fill(m_data.begin(), m_data.end(), zero);
+			memset(m_storage.data(), 0, m_storage.size());
 #else
 			for (size_t i = 0; i < m_theChunks.size(); ++i)
 				memset(m_theChunks[i], 0, m_perChunkCount[i]*sizeof(ElementType)*N);
@@ -176,7 +189,7 @@ public:
 			//we initialize the first chunk properly
 			//with a recursive copy of N*2^k bytes (k=0,1,2,...)
 #ifdef CC_ENV_64
-			ElementType* _cDest = &(m_data.front());
+			ElementType* _cDest = data();
 #else
 			ElementType* _cDest = m_theChunks.front();
 #endif
@@ -233,7 +246,8 @@ public:
 		{
 			if (m_capacity < capacity)
 			{
-				m_data.resize(capacity * N);
+				if (!m_storage.resize(static_cast<size_t>(capacity) * N * sizeof(ElementType)))
+					return false;
 				m_capacity = capacity;
 			}
 		}
@@ -317,11 +331,7 @@ public:
 		else //last case: we have to reduce the array size
 		{
 #ifdef CC_ENV_64
-			try
-			{
-				m_data.resize(count * N); //shouldn't fail, smaller
-			}
-			catch (const std::bad_alloc&)
+			if (!m_storage.resize(static_cast<size_t>(count) * N * sizeof(ElementType))) //shouldn't fail, smaller
 			{
 				//not enough memory
 				return false;
@@ -437,7 +447,7 @@ public:
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return &(m_data[index * N]);
+		return data() + static_cast<size_t>(index) * N;
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC]+((index & ELEMENT_INDEX_BIT_MASK)*N);
 #endif
@@ -451,7 +461,7 @@ public:
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return &(m_data[index * N]);
+		return data() + static_cast<size_t>(index) * N;
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC]+((index & ELEMENT_INDEX_BIT_MASK)*N);
 #endif
@@ -604,10 +614,10 @@ public:
 
 #ifdef CC_ENV_64
 	//! Returns a pointer on the (contiguous) data array
-	inline ElementType* data() { return &(m_data.front()); }
+	inline ElementType* data() { return static_cast<ElementType*>(m_storage.data()); }
 
 	//! Returns a pointer on the (contiguous) data array (const version)
-	inline const ElementType* data() const { return &(m_data.front()); }
+	inline const ElementType* data() const { return static_cast<const ElementType*>(m_storage.data()); }
 #endif //!CC_ENV_64
 	
 	//! Returns the number of chunks
@@ -637,7 +647,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N;
 #else
 		return m_theChunks[index];
 #endif
@@ -648,7 +658,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N;
 #else
 		return m_theChunks[index];
 #endif
@@ -669,7 +679,8 @@ public:
 		
 		//copy content		
 #ifdef CC_ENV_64
-		std::copy(m_data.begin(), m_data.end(), dest.m_data.begin());
+		if (count != 0)
+			memcpy(dest.data(), data(), static_cast<size_t>(count) * N * sizeof(ElementType));
 #else
 		unsigned copyCount = 0;
 		assert(dest.m_theChunks.size() <= m_theChunks.size());
@@ -707,8 +718,8 @@ protected:
 	ElementType m_maxVal[N];
 
 #ifdef CC_ENV_64
-	//! Data
-	std::vector<ElementType> m_data;
+	//! Data storage
+	ArrayStorage m_storage;
 #else
 	//! Arrays 'chunks'
 	std::vector<ElementType*> m_theChunks;
@@ -796,6 +807,17 @@ public:
 #endif
 				+ static_cast<size_t>(capacity()) * sizeof(ElementType);
 	}
+#ifdef CC_ENV_64
+	//! Returns the storage backend of this array
+	inline ArrayStorage::Backend storageBackend() const { return m_storage.backend(); }
+
+	//! Sets the storage backend of this array
+	/** The current content is preserved (see ArrayStorage).
+		\return success
+	**/
+	inline bool setStorageBackend(ArrayStorage::Backend backend) { return m_storage.setBackend(backend); }
+#endif
+
 	//! Clears the array
 	/** \param releaseMemory whether memory should be released or not (for quicker "refill")
 	**/
@@ -804,7 +826,7 @@ public:
 		if (releaseMemory)
 		{
 #ifdef CC_ENV_64
-			m_data.clear();
+			m_storage.clear();
 #else
 			while (!m_theChunks.empty())
 			{
@@ -833,7 +855,7 @@ public:
 		}
 
 #ifdef CC_ENV_64
-		std::fill(m_data.begin(), m_data.end(), fillValue);
+		std::fill(data(), data() + m_capacity, fillValue);
 #else
 		if (fillValue == 0)
 		{
@@ -893,7 +915,8 @@ public:
 		{
 			if (m_capacity < capacity)
 			{
-				m_data.resize(capacity);
+				if (!m_storage.resize(static_cast<size_t>(capacity) * sizeof(ElementType)))
+					return false;
 				m_capacity = capacity;
 			}
 		}
@@ -980,11 +1003,7 @@ public:
 		else //last case: we have to reduce the array size
 		{
 #ifdef CC_ENV_64
-			try
-			{
-				m_data.resize(count); //shouldn't fail, smaller
-			}
-			catch (const std::bad_alloc&)
+			if (!m_storage.resize(static_cast<size_t>(count) * sizeof(ElementType))) //shouldn't fail, smaller
 			{
 				//not enough memory
 				return false;
@@ -1108,7 +1127,7 @@ public:
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return m_data[index];
+		return data()[index];
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC][index & ELEMENT_INDEX_BIT_MASK];
 #endif
@@ -1122,7 +1141,7 @@ public:
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return m_data[index];
+		return data()[index];
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC][index & ELEMENT_INDEX_BIT_MASK];
 #endif
@@ -1210,10 +1229,10 @@ public:
 
 #ifdef CC_ENV_64
 	//! Returns a pointer on the (contiguous) data array
-	inline ElementType* data() { return &(m_data.front()); }
+	inline ElementType* data() { return static_cast<ElementType*>(m_storage.data()); }
 
 	//! Returns a pointer on the (contiguous) data array (const version)
-	inline const ElementType* data() const { return &(m_data.front()); }
+	inline const ElementType* data() const { return static_cast<const ElementType*>(m_storage.data()); }
 #endif //!CC_ENV_64
 
 	//! Returns the number of chunks
@@ -1243,7 +1262,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
 #else
 		return m_theChunks[index];
 #endif
@@ -1254,7 +1273,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
 #else
 		return m_theChunks[index];
 #endif
@@ -1275,7 +1294,8 @@ public:
 		
 		//copy content		
 #ifdef CC_ENV_64
-		std::copy(m_data.begin(), m_data.end(), dest.m_data.begin());
+		if (count != 0)
+			memcpy(dest.data(), data(), static_cast<size_t>(count) * sizeof(ElementType));
 #else
 		unsigned copyCount = 0;
 		assert(dest.m_theChunks.size() <= m_theChunks.size());
@@ -1313,8 +1333,8 @@ protected:
 	ElementType m_maxVal;
 
 #ifdef CC_ENV_64
-	//! Data
-	std::vector<ElementType> m_data;
+	//! Data storage
+	ArrayStorage m_storage;
 #else
 	//! Arrays 'chunks'
 	std::vector<ElementType*> m_theChunks;
@@ -0,0 +1,179 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+#ifndef NEIGHBOUR_STATS_CACHE_HEADER
+#define NEIGHBOUR_STATS_CACHE_HEADER
+
+//Local
+#include "DgmOctree.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedCloudPersist;
+class GenericProgressCallback;
+class ReferenceCloud;
+
+//! Per-point neighbourhood statistics for the SOR and noise filters
+/** The expensive part of both filters (the neighbourhood extraction) is done
+	once, in parallel. The filters can then be applied with different thresholds
+	(and, for the SOR filter, a different number of neighbours) in O(n).
+	The cache is bound to a cloud: it is considered as obsolete if the cloud
+	size or bounding-box changes. It must be cleared by the caller if the points
+	are modified in another way.
+**/
+class CC_CORE_LIB_API NeighbourStatsCache
+{
+public:
+
+	//! Default constructor
+	NeighbourStatsCache();
+
+	//! Destructor
+	virtual ~NeighbourStatsCache();
+
+	//! Clears the cache
+	void clear();
+
+	//! Returns whether the cache has been computed on a given cloud (and is still valid)
+	bool isValidFor(GenericIndexedCloudPersist* cloud) const;
+
+	/*** SOR filter ***/
+
+	//! Computes the mean distance of each point to its neighbours, for a range of neighbours count
+	/** See CloudSamplingTools::sorFilter. The k nearest neighbours are only extracted once (for maxKnn).
+		\param cloud the point cloud
+		\param minKnn min. number of neighbors
+		\param maxKnn max. number of neighbors
+		\param octree associated octree if available
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param maxThreadCount max number of threads (0 = all)
+		\return success
+	**/
+	bool computeKnnMeanDistances(	GenericIndexedCloudPersist* cloud,
+									int minKnn,
+									int maxKnn,
+									DgmOctree* octree = 0,
+									GenericProgressCallback* progressCb = 0,
+									int maxThreadCount = 0);
+
+	//! Returns whether the mean distances are available for a given cloud and number of neighbours
+	bool hasKnnMeanDistances(GenericIndexedCloudPersist* cloud, int knn) const;
+
+	//! Applies the SOR filter (with the cached mean distances)
+	/** \param knn number of neighbors (must be in the computed range)
+		\param nSigma number of sigmas under which the points should be kept
+		\return a reference cloud corresponding to the filtered cloud
+	**/
+	ReferenceCloud* sorFilter(int knn, double nSigma) const;
+
+	/*** Noise filter ***/
+
+	//! Computes the distance of each point to the plane fitted on its neighbours
+	/** See CloudSamplingTools::noiseFilter.
+		\param cloud the point cloud
+		\param kernelRadius neighborhood radius
+		\param useKnn whether to use a constant number of neighbors instead of a radius
+		\param knn number of neighbors (if useKnn is true)
+		\param octree associated octree if available
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param maxThreadCount max number of threads (0 = all)
+		\return success
+	**/
+	bool computePlaneDistances(	GenericIndexedCloudPersist* cloud,
+								PointCoordinateType kernelRadius,
+								bool useKnn,
+								int knn,
+								DgmOctree* octree = 0,
+								GenericProgressCallback* progressCb = 0,
+								int maxThreadCount = 0);
+
+	//! Returns whether the distances to the local planes are available for a given cloud and neighbourhood
+	bool hasPlaneDistances(GenericIndexedCloudPersist* cloud, PointCoordinateType kernelRadius, bool useKnn, int knn) const;
+
+	//! Applies the noise filter (with the cached distances)
+	/** \param nSigma number of sigmas under which the points should be kept
+		\param removeIsolatedPoints whether to remove isolated points (i.e. with 3 points or less in the neighborhood)
+		\param useAbsoluteError whether to use an absolute error instead of 'n' sigmas
+		\param absoluteError absolute error (if useAbsoluteError is true)
+		\return a reference cloud corresponding to the filtered cloud
+	**/
+	ReferenceCloud* noiseFilter(double nSigma,
+								bool removeIsolatedPoints,
+								bool useAbsoluteError,
+								double absoluteError) const;
+
+protected:
+
+	//! Binds the cache to a cloud
+	/** The cached values are cleared if the cloud differs from the current one.
+	**/
+	void bindToCloud(GenericIndexedCloudPersist* cloud);
+
+	//! "Cellular" function to compute the mean distances to the k nearest neighbours
+	static bool computeKnnMeanDistancesAtLevel(	const DgmOctree::octreeCell& cell,
+												void** additionalParameters,
+												NormalizedProgress* nProgress = 0);
+
+	//! "Cellular" function to compute the distances to the local planes
+	static bool computePlaneDistancesAtLevel(	const DgmOctree::octreeCell& cell,
+												void** additionalParameters,
+												NormalizedProgress* nProgress = 0);
+
+	//! Associated cloud
+	GenericIndexedCloudPersist* m_cloud;
+	//! Number of points of the cloud when the cache was computed
+	unsigned m_pointCount;
+	//! Bounding-box of the cloud when the cache was computed
+	CCVector3 m_bbMin, m_bbMax;
+
+	//! Min number of neighbours for which the mean distances have been computed
+	int m_minKnn;
+	//! Max number of neighbours for which the mean distances have been computed
+	int m_maxKnn;
+	//! Mean distances (one vector per number of neighbours, from m_minKnn to m_maxKnn)
+	std::vector< std::vector<PointCoordinateType> > m_knnMeanDistances;
+	//! Average of the mean distances (per number of neighbours)
+	std::vector<double> m_knnAvgDist;
+	//! Std. dev. of the mean distances (per number of neighbours)
+	std::vector<double> m_knnStdDev;
+
+	//! Point status regarding the noise filter
+	enum PlaneStatus { ISOLATED_POINT = 0, NO_PLANE = 1, VALID_PLANE = 2 };
+
+	//! Whether the distances to the local planes have been computed
+	bool m_hasPlaneDistances;
+	//! Neighbourhood radius used to compute the distances to the local planes
+	PointCoordinateType m_kernelRadius;
+	//! Whether a constant number of neighbours has been used to compute the distances to the local planes
+	bool m_useKnn;
+	//! Number of neighbours used to compute the distances to the local planes
+	int m_planeKnn;
+	//! Point status (see PlaneStatus)
+	std::vector<unsigned char> m_planeStatus;
+	//! Distance of each point to its local plane
+	std::vector<double> m_planeDistances;
+	//! Std. dev. of the distances of the neighbours to the local plane
+	std::vector<double> m_planeStdDevs;
+};
+
+}
+
+#endif //NEIGHBOUR_STATS_CACHE_HEADER
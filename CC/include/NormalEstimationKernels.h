@@ -0,0 +1,101 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef NORMAL_ESTIMATION_KERNELS_HEADER
+#define NORMAL_ESTIMATION_KERNELS_HEADER
+
+//Local
+#include "DgmOctree.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+//! Fast kernels for normal estimation on small neighbourhoods
+/** Contrary to the Neighbourhood class, these kernels work on points gathered
+	in a structure of arrays (no virtual access to the points), accumulate the
+	covariance matrix with SIMD instructions (when available) and rely on a
+	closed-form 3x3 symmetric eigen-solver.
+
+	All the methods return false if the configuration is degenerate (in which
+	case the caller can fall back to the generic Neighbourhood methods).
+**/
+class CC_CORE_LIB_API NormalEstimationKernels
+{
+public:
+
+	//! Neighbourhood points stored as a structure of arrays
+	/** Coordinates are expressed relatively to a reference point (generally
+		the query point) so as to preserve the precision of the accumulations.
+	**/
+	struct Points
+	{
+		//! X coordinates (relative to 'origin')
+		std::vector<float> x;
+		//! Y coordinates (relative to 'origin')
+		std::vector<float> y;
+		//! Z coordinates (relative to 'origin')
+		std::vector<float> z;
+		//! Reference point
+		CCVector3 origin;
+		//! Number of points
+		unsigned size;
+
+		//! Default constructor
+		Points() : origin(0,0,0), size(0) {}
+
+		//! Gathers the first 'count' points of a neighbours set
+		/** Memory is only reallocated if the buffers are too small.
+			\return false if there's not enough memory
+		**/
+		bool gather(const DgmOctree::NeighboursSet& neighbours, unsigned count, const CCVector3& origin);
+	};
+
+	//! Computes the gravity center and the covariance matrix of a set of points
+	/** \param points input points
+		\param G gravity center (absolute coordinates)
+		\param cov covariance matrix coefficients (XX, YY, ZZ, XY, XZ, YZ)
+		\return success
+	**/
+	static bool ComputeCovariance(const Points& points, CCVector3d& G, double cov[6]);
+
+	//! Returns the eigen vector associated to the smallest eigen value of a 3x3 symmetric matrix
+	/** \param cov symmetric matrix coefficients (XX, YY, ZZ, XY, XZ, YZ)
+		\param eigVector unit eigen vector
+		\return false if the smallest eigen value is not unique (i.e. if the eigen vector is not defined)
+	**/
+	static bool SmallestEigenVector(const double cov[6], CCVector3d& eigVector);
+
+	//! Computes the normal of the least squares best fitting plane
+	static bool ComputeLSNormal(const Points& points, CCVector3& N);
+
+	//! Computes the normal of the 2.5D quadric (height function) that best fits the points, at a given position
+	/** Same model as Neighbourhood::getQuadric, but the linear system is solved directly.
+		\param points input points
+		\param P position (absolute coordinates) at which the normal is computed
+		\param N output normal
+		\return success
+	**/
+	static bool ComputeQuadricNormal(const Points& points, const CCVector3& P, CCVector3& N);
+};
+
+} //namespace CCLib
+
+#endif //NORMAL_ESTIMATION_KERNELS_HEADER
@@ -0,0 +1,98 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_PARALLEL_TOOLS_HEADER
+#define CC_PARALLEL_TOOLS_HEADER
+
+//Local
+#include "CCToolbox.h"
+
+//system
+#include <atomic>
+#include <functional>
+
+namespace CCLib
+{
+	//! Cancellation token shared by all the tasks of a parallel job
+	/** Any task (or any other thread) may cancel the job. Remaining tasks
+		will then be skipped as soon as possible.
+	**/
+	class CC_CORE_LIB_API ParallelCancelToken
+	{
+	public:
+		//! Default constructor
+		ParallelCancelToken() : m_canceled(false) {}
+
+		//! Requests the cancellation of the job
+		inline void cancel() { m_canceled.store(true); }
+		//! Returns whether the job has been canceled
+		inline bool isCanceled() const { return m_canceled.load(); }
+
+	protected:
+		//! Cancellation flag
+		std::atomic<bool> m_canceled;
+	};
+
+	//! Parallel processing helpers
+	/** Each parallel job is executed by its own private thread pool, so that
+		its thread limit never interferes with the global Qt thread pool (used by
+		the GUI and the plugins) nor with the other jobs running concurrently.
+		Without Qt support, jobs are simply processed sequentially.
+	**/
+	class CC_CORE_LIB_API ParallelTools : public CCToolbox
+	{
+	public:
+
+		//! Per-element task
+		typedef std::function<void(unsigned)> IndexedTask;
+
+		//! Returns the ideal number of threads for the current machine
+		static int IdealThreadCount();
+
+		//! Sets the default maximum number of threads of a parallel job
+		/** Applies to the jobs that don't specify their own limit (e.g. to share
+			the cores between several files processed concurrently).
+			\param maxThreadCount default maximum number of threads (0 = IdealThreadCount())
+		**/
+		static void SetDefaultMaxThreadCount(int maxThreadCount);
+
+		//! Returns the default maximum number of threads of a parallel job
+		static int DefaultMaxThreadCount();
+
+		//! Processes elements [0 ; count[ in parallel
+		/** Elements are dispatched by contiguous chunks: each thread grabs the next
+			available chunk as soon as it has finished the previous one (so that
+			the load is balanced between threads while memory accesses stay local).
+			The calling thread takes part in the processing.
+			\param count number of elements
+			\param task function called once per element index
+			\param maxThreadCount maximum number of threads for this job (0 = DefaultMaxThreadCount())
+			\param cancelToken optional cancellation token (the task may also use it to abort the job)
+			\param chunkSize number of consecutive elements processed by a thread at once (0 = auto)
+			\return false if the job has been canceled
+		**/
+		static bool ForEach(unsigned count,
+							const IndexedTask& task,
+							int maxThreadCount = 0,
+							ParallelCancelToken* cancelToken = 0,
+							unsigned chunkSize = 0);
+	};
+
+} //namespace CCLib
+
+#endif //CC_PARALLEL_TOOLS_HEADER
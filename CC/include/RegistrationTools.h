@@ -22,6 +22,8 @@
 //Local
 #include "PointProjectionTools.h"
 
+//system
+#include <vector>
 
 namespace CCLib
 {
@@ -31,6 +33,7 @@ class GenericCloud;
 class GenericIndexedMesh;
 class GenericIndexedCloud;
 class KDTree;
+class ReferenceCloud;
 class ScalarField;
 
 //! Common point cloud registration algorithms
@@ -94,6 +97,27 @@ protected:
 										ScalarField* coupleWeights = 0,
 										PointCoordinateType aPrioriScale = 1.0f);
 
+	//! Point-to-plane registration procedure (one step)
+	/** Determines the (linearized) rigid transformation that minimizes the sum
+		of the squared distances between the points of P and the planes defined by
+		the points of X and their normals (Chen and Medioni, 1991).
+
+		Warning: P and X must have the same size, and must be in the same
+		order (i.e. P[i] is the point equivalent to X[i] for all 'i').
+
+		\param P the cloud to register (data)
+		\param X the reference points (model)
+		\param normals the reference normals (indexed by the global indexes of X)
+		\param trans the resulting transformation
+		\param coupleWeights weights for each (Pi,Xi) couple (optional)
+		\return success
+	**/
+	static bool PointToPlaneRegistrationProcedure(	GenericIndexedCloud* P,
+													ReferenceCloud* X,
+													const std::vector<CCVector3>& normals,
+													ScaledTransformation& trans,
+													ScalarField* coupleWeights = 0);
+
 };
 
 //! Horn point cloud registration algorithm
@@ -172,6 +196,9 @@ public:
 			, dataWeights(0)
 			, transformationFilters(SKIP_NONE)
 			, maxThreadCount(0)
+			, useStaticModelIndex(false)
+			, pointToPlane(false)
+			, modelNormals(0)
 		{}
 
 		//! Convergence type
@@ -206,6 +233,22 @@ public:
 
 		//! Maximum number of threads to use (0 = max)
 		int maxThreadCount;
+
+		//! Whether to index the model entity once for all iterations
+		/** A static Kd-tree (model cloud) or triangles hierarchy (model mesh) is built
+			once, and only the data points are queried at each iteration (instead of
+			computing the octree(s) of both entities again at each iteration).
+		**/
+		bool useStaticModelIndex;
+
+		//! Whether to minimize the point-to-plane distances instead of the point-to-point distances
+		/** Only works with a model cloud and requires its normals (see 'modelNormals').
+			The scale can't be adjusted in this mode ('adjustScale' is ignored).
+		**/
+		bool pointToPlane;
+
+		//! Model cloud normals (one per point, in the same order) - only used by the point-to-plane variant
+		const std::vector<CCVector3>* modelNormals;
 	};
 
 	//! Registers two clouds or a cloud and a mesh
@@ -0,0 +1,128 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef TRIANGLE_BVH_HEADER
+#define TRIANGLE_BVH_HEADER
+
+//Local
+#include "CCGeom.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedMesh;
+class GenericProgressCallback;
+
+//! Bounding Volume Hierarchy of the triangles of a mesh
+/** The hierarchy is built with the Surface Area Heuristic (SAH) on binned
+	triangle centroids. It only stores the triangle indexes and the nodes
+	bounding-boxes (the triangles vertices are queried on the mesh).
+	Once built, the structure can be queried concurrently by several threads.
+**/
+class CC_CORE_LIB_API TriangleBVH
+{
+public:
+
+	//! Default constructor
+	TriangleBVH();
+
+	//! Destructor
+	virtual ~TriangleBVH();
+
+	//! Builds the hierarchy
+	/** \warning The mesh must not be modified (nor deleted) as long as the hierarchy is used.
+		\param mesh the mesh from which to build the hierarchy
+		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool buildFromMesh(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb = 0);
+
+	//! Clears the structure
+	void clear();
+
+	//! Returns the mesh from which the hierarchy has been built
+	GenericIndexedMesh* getAssociatedMesh() const { return m_associatedMesh; }
+
+	//! Returns the number of nodes
+	unsigned nodeCount() const { return static_cast<unsigned>(m_nodes.size()); }
+
+	//! Returns the (approximate) memory used by the structure (in bytes)
+	size_t memoryUsage() const;
+
+	//! Closest triangle search
+	/** \param P query point
+		\param triangleIndex [out] index of the closest triangle
+		\param squareDist [out] squared distance between the query point and the closest triangle
+		\param maxSquareDist (squared) distance above which triangles are ignored (ignored if <= 0)
+		\param nearestPoint [out] optional: nearest point on the closest triangle
+		\return false if no triangle lies below 'maxSquareDist' (or if the structure is empty)
+	**/
+	bool findClosestTriangle(	const CCVector3& P,
+								unsigned& triangleIndex,
+								ScalarType& squareDist,
+								ScalarType maxSquareDist = 0,
+								CCVector3* nearestPoint = 0) const;
+
+protected:
+
+	//! Hierarchy node
+	struct Node
+	{
+		//! Bounding-box min corner
+		CCVector3 bbMin;													//12 bytes
+		//! Bounding-box max corner
+		CCVector3 bbMax;													//12 bytes
+		//! Leaf: index of the first triangle (in m_triIndexes) / Inner node: index of the first child (the second one follows it)
+		unsigned first;														//4 bytes
+		//! Number of triangles (0 for inner nodes)
+		unsigned count;														//4 bytes
+
+		//Total																//32 bytes
+	};
+
+	//! Triangle bounding-box (used during the build process only)
+	struct TriangleBox
+	{
+		CCVector3 bbMin;
+		CCVector3 bbMax;
+	};
+
+	//! Computes the bounding-box of a set of triangles
+	void computeBoundingBox(const std::vector<TriangleBox>& boxes, unsigned first, unsigned count, CCVector3& bbMin, CCVector3& bbMax) const;
+
+	//! Splits a node (if worth it)
+	/** \param nodeIndex node index
+		\param boxes triangles bounding-boxes
+		\return whether the node has been split or not
+	**/
+	bool splitNode(unsigned nodeIndex, const std::vector<TriangleBox>& boxes);
+
+	//! Nodes (the first one is the root)
+	std::vector<Node> m_nodes;
+	//! Triangle indexes (sorted by leaf)
+	std::vector<unsigned> m_triIndexes;
+	//! Associated mesh
+	GenericIndexedMesh* m_associatedMesh;
+};
+
+} //namespace CCLib
+
+#endif //TRIANGLE_BVH_HEADER
@@ -0,0 +1,345 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ArrayStorage.h"
+
+//system
+#include <algorithm>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//! Default backend for the new arrays
+static ArrayStorage::Backend s_defaultBackend = ArrayStorage::HEAP_MEMORY;
+//! Minimal size of the mapped arrays (64 MB by default)
+static size_t s_mappingThreshold = (static_cast<size_t>(1) << 26);
+//! Scratch files directory
+static std::string s_scratchDirectory;
+
+void ArrayStorage::SetDefaultBackend(Backend backend)
+{
+	s_defaultBackend = backend;
+}
+
+ArrayStorage::Backend ArrayStorage::GetDefaultBackend()
+{
+	return s_defaultBackend;
+}
+
+void ArrayStorage::SetMappingThreshold(size_t byteCount)
+{
+	s_mappingThreshold = byteCount;
+}
+
+size_t ArrayStorage::GetMappingThreshold()
+{
+	return s_mappingThreshold;
+}
+
+void ArrayStorage::SetScratchDirectory(const std::string& path)
+{
+	s_scratchDirectory = path;
+}
+
+std::string ArrayStorage::GetScratchDirectory()
+{
+	if (!s_scratchDirectory.empty())
+	{
+		return s_scratchDirectory;
+	}
+
+	//system temporary directory
+#ifdef _WIN32
+	char buffer[MAX_PATH+1];
+	DWORD length = GetTempPathA(MAX_PATH+1, buffer);
+	return (length != 0 && length <= MAX_PATH ? std::string(buffer, length) : std::string("."));
+#else
+	const char* tmpDir = getenv("TMPDIR");
+	return (tmpDir && tmpDir[0] != 0 ? std::string(tmpDir) : std::string("/tmp"));
+#endif
+}
+
+ArrayStorage::ArrayStorage()
+	: m_data(0)
+	, m_size(0)
+	, m_backend(HEAP_MEMORY) //small arrays are never mapped (see resize)
+	, m_mapWhenBig(s_defaultBackend == MAPPED_FILE)
+#ifdef _WIN32
+	, m_fileHandle(INVALID_HANDLE_VALUE)
+#else
+	, m_fileHandle(-1)
+#endif
+{
+}
+
+ArrayStorage::~ArrayStorage()
+{
+	clear();
+}
+
+void ArrayStorage::clear()
+{
+	if (m_backend == HEAP_MEMORY)
+	{
+		free(m_data);
+	}
+	else
+	{
+#ifdef _WIN32
+		if (m_data)
+			UnmapViewOfFile(m_data);
+		if (m_fileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(m_fileHandle); //the file is automatically deleted (FILE_FLAG_DELETE_ON_CLOSE)
+		m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+		if (m_data)
+			munmap(m_data, m_size);
+		if (m_fileHandle >= 0)
+			close(m_fileHandle); //the file has already been unlinked
+		m_fileHandle = -1;
+#endif
+	}
+
+	m_data = 0;
+	m_size = 0;
+}
+
+bool ArrayStorage::setBackend(Backend backend)
+{
+	//explicit choice
+	m_mapWhenBig = false;
+
+	if (backend == m_backend)
+	{
+		return true;
+	}
+
+	if (m_size == 0)
+	{
+		clear();
+		m_backend = backend;
+		return true;
+	}
+
+	//we have to transfer the current content
+	ArrayStorage other;
+	other.m_backend = backend;
+	other.m_mapWhenBig = false;
+	if (!other.resize(m_size))
+	{
+		return false;
+	}
+	memcpy(other.m_data, m_data, m_size);
+
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_backend, other.m_backend);
+	std::swap(m_fileHandle, other.m_fileHandle);
+
+	return true; //the old content is released by 'other'
+}
+
+bool ArrayStorage::resize(size_t byteCount)
+{
+	if (byteCount == m_size)
+	{
+		return true;
+	}
+
+	if (byteCount == 0)
+	{
+		clear();
+		return true;
+	}
+
+	if (m_mapWhenBig && m_backend == HEAP_MEMORY && byteCount >= s_mappingThreshold)
+	{
+		//the array is now big enough to be mapped on a scratch file
+		if (!setBackend(MAPPED_FILE))
+		{
+			//we simply keep it in memory (and we'll try again next time)
+			m_mapWhenBig = true;
+		}
+	}
+
+	return (m_backend == HEAP_MEMORY ? resizeHeap(byteCount) : resizeMapped(byteCount));
+}
+
+bool ArrayStorage::resizeHeap(size_t byteCount)
+{
+	//big blocks are generally moved (not copied) by the system when they grow
+	void* newData = realloc(m_data, byteCount);
+	if (!newData)
+	{
+		//not enough memory
+		return false;
+	}
+
+	if (byteCount > m_size)
+	{
+		memset(static_cast<char*>(newData) + m_size, 0, byteCount - m_size);
+	}
+
+	m_data = newData;
+	m_size = byteCount;
+
+	return true;
+}
+
+#ifdef _WIN32
+
+bool ArrayStorage::resizeMapped(size_t byteCount)
+{
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		//create the (temporary) scratch file
+		char filename[MAX_PATH+1];
+		if (GetTempFileNameA(GetScratchDirectory().c_str(), "cca", 0, filename) == 0)
+		{
+			return false;
+		}
+		m_fileHandle = CreateFileA(	filename,
+									GENERIC_READ | GENERIC_WRITE,
+									0,
+									0,
+									CREATE_ALWAYS,
+									FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+									0);
+		if (m_fileHandle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+	}
+
+	//the view must be released before the file size can change
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = 0;
+	}
+
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = static_cast<LONGLONG>(byteCount);
+	bool success = (SetFilePointerEx(m_fileHandle, fileSize, 0, FILE_BEGIN) && SetEndOfFile(m_fileHandle)); //new bytes are set to 0
+	if (!success)
+	{
+		//restore the previous size (if possible)
+		fileSize.QuadPart = static_cast<LONGLONG>(m_size);
+		SetFilePointerEx(m_fileHandle, fileSize, 0, FILE_BEGIN);
+		SetEndOfFile(m_fileHandle);
+		byteCount = m_size;
+	}
+
+	if (byteCount != 0)
+	{
+		HANDLE mapping = CreateFileMappingA(m_fileHandle, 0, PAGE_READWRITE, 0, 0, 0);
+		if (mapping)
+		{
+			m_data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, byteCount);
+			CloseHandle(mapping); //the view keeps a reference on the mapping
+		}
+		if (!m_data)
+		{
+			clear();
+			return false;
+		}
+	}
+	m_size = byteCount;
+
+	return success;
+}
+
+#else
+
+bool ArrayStorage::resizeMapped(size_t byteCount)
+{
+	if (m_fileHandle < 0)
+	{
+		//create the (temporary) scratch file
+		std::string pattern = GetScratchDirectory() + "/ccArrayXXXXXX";
+		std::vector<char> filename(pattern.begin(), pattern.end());
+		filename.push_back(0);
+		m_fileHandle = mkstemp(&filename.front());
+		if (m_fileHandle < 0)
+		{
+			return false;
+		}
+		//the file will be deleted as soon as it is closed
+		unlink(&filename.front());
+	}
+
+	//new bytes are set to 0
+	if (ftruncate(m_fileHandle, static_cast<off_t>(byteCount)) != 0)
+	{
+		//not enough disk space?
+		return false;
+	}
+
+	void* newData = 0;
+	if (m_data)
+	{
+#ifdef __linux__
+		//the pages are simply remapped (no copy)
+		newData = mremap(m_data, m_size, byteCount, MREMAP_MAYMOVE);
+#else
+		//the content is in the file: we can simply map it again
+		munmap(m_data, m_size);
+		m_data = 0;
+		newData = mmap(0, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileHandle, 0);
+#endif
+	}
+	else
+	{
+		newData = mmap(0, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileHandle, 0);
+	}
+
+	if (newData == MAP_FAILED)
+	{
+		//restore the previous state
+		if (m_size != 0 && ftruncate(m_fileHandle, static_cast<off_t>(m_size)) == 0)
+		{
+			if (!m_data)
+			{
+				newData = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileHandle, 0);
+				m_data = (newData != MAP_FAILED ? newData : 0);
+			}
+		}
+		if (!m_data)
+		{
+			clear();
+		}
+		return false;
+	}
+
+	m_data = newData;
+	m_size = byteCount;
+
+	return true;
+}
+
+#endif
@@ -28,6 +28,7 @@
 #include "DistanceComputationTools.h"
 #include "ScalarField.h"
 #include "ScalarFieldTools.h"
+#include "NeighbourStatsCache.h"
 
 //system
 #include <random>
@@ -472,7 +473,8 @@ ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* input
 												int knn/*=6*/,
 												double nSigma/*=1.0*/,
 												DgmOctree* inputOctree/*=0*/,
-												GenericProgressCallback* progressCb/*=0*/)
+												GenericProgressCallback* progressCb/*=0*/,
+												int maxThreadCount/*=0*/)
 {
 	if (!inputCloud || knn <= 0 || inputCloud->size() <= static_cast<unsigned>(knn))
 	{
@@ -481,102 +483,16 @@ ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* input
 		return 0;
 	}
 
-	DgmOctree* octree = inputOctree;
-	if (!octree)
-	{
-		//compute the octree if necessary
-		octree = new DgmOctree(inputCloud);
-		if (octree->build(progressCb) < 1)
-		{
-			delete octree;
-			return 0;
-		}
-	}
-
-	//output
-	ReferenceCloud* filteredCloud = 0;
-
-	for (unsigned step = 0; step < 1; ++step) //fake loop for easy break
-	{
-		unsigned pointCount = inputCloud->size();
-
-		std::vector<PointCoordinateType> meanDistances;
-		try
-		{
-			meanDistances.resize(pointCount, 0);
-		}
-		catch (const std::bad_alloc&)
-		{
-			//not enough memory
-			break;
-		}
-		double avgDist = 0, stdDev = 0;
-
-		//1st step: compute the average distance to the neighbors
-		{
-			//additional parameters
-			void* additionalParameters[] = {reinterpret_cast<void*>(&knn),
-											reinterpret_cast<void*>(&meanDistances)
-			};
-
-			unsigned char octreeLevel = octree->findBestLevelForAGivenPopulationPerCell(knn);
-
-			if (octree->executeFunctionForAllCellsAtLevel(	octreeLevel,
-															&applySORFilterAtLevel,
-															additionalParameters,
-															true,
-															progressCb,
-															"SOR filter") == 0)
-			{
-				//something went wrong
-				break;
-			}
-
-			//deduce the average distance and std. dev.
-			double sumDist = 0;
-			double sumSquareDist = 0;
-			for (unsigned i = 0; i < pointCount; ++i)
-			{
-				sumDist += meanDistances[i];
-				sumSquareDist += meanDistances[i] * meanDistances[i];
-			}
-			avgDist = sumDist / pointCount;
-			stdDev = sqrt(fabs(sumSquareDist / pointCount - avgDist*avgDist));
-		}
-
-		//2nd step: remove the farthest points 
-		{
-			//deduce the max distance
-			double maxDist = avgDist + nSigma * stdDev;
-
-			filteredCloud = new ReferenceCloud(inputCloud);
-			if (!filteredCloud->reserve(pointCount))
-			{
-				//not enough memory
-				delete filteredCloud;
-				filteredCloud = 0;
-				break;
-			}
-
-			for (unsigned i = 0; i < pointCount; ++i)
-			{
-				if (meanDistances[i] <= maxDist)
-				{
-					filteredCloud->addPointIndex(i);
-				}
-			}
-
-			filteredCloud->resize(filteredCloud->size());
-		}
-	}
-
-	if (!inputOctree)
+	//1st step: compute the average distance to the neighbors
+	NeighbourStatsCache cache;
+	if (!cache.computeKnnMeanDistances(inputCloud, knn, knn, inputOctree, progressCb, maxThreadCount))
 	{
-		delete octree;
-		octree = 0;
+		//not enough memory or process canceled
+		return 0;
 	}
 
-	return filteredCloud;
+	//2nd step: remove the farthest points
+	return cache.sorFilter(knn, nSigma);
 }
 
 ReferenceCloud* CloudSamplingTools::noiseFilter(GenericIndexedCloudPersist* inputCloud,
@@ -588,7 +504,8 @@ ReferenceCloud* CloudSamplingTools::noiseFilter(GenericIndexedCloudPersist* inpu
 												bool useAbsoluteError/*=true*/,
 												double absoluteError/*=0.0*/,
 												DgmOctree* inputOctree/*=0*/,
-												GenericProgressCallback* progressCb/*=0*/)
+												GenericProgressCallback* progressCb/*=0*/,
+												int maxThreadCount/*=0*/)
 {
 	if (!inputCloud || inputCloud->size() < 2 || (useKnn && knn <= 0) || (!useKnn && kernelRadius <= 0))
 	{
@@ -597,70 +514,14 @@ ReferenceCloud* CloudSamplingTools::noiseFilter(GenericIndexedCloudPersist* inpu
 		return 0;
 	}
 
-	DgmOctree* octree = inputOctree;
-	if (!octree)
-	{
-		octree = new DgmOctree(inputCloud);
-		if (octree->build(progressCb) < 1)
-		{
-			delete octree;
-			return 0;
-		}
-	}
-
-	ReferenceCloud* filteredCloud = new ReferenceCloud(inputCloud);
-
-	unsigned pointCount = inputCloud->size();
-	if (!filteredCloud->reserve(pointCount))
+	NeighbourStatsCache cache;
+	if (!cache.computePlaneDistances(inputCloud, kernelRadius, useKnn, knn, inputOctree, progressCb, maxThreadCount))
 	{
-		//not enough memory
-		if (!inputOctree)
-			delete octree;
-		delete filteredCloud;
+		//not enough memory or process canceled
 		return 0;
 	}
 
-	//additional parameters
-	void* additionalParameters[] = {reinterpret_cast<void*>(filteredCloud),
-									reinterpret_cast<void*>(&kernelRadius),
-									reinterpret_cast<void*>(&nSigma),
-									reinterpret_cast<void*>(&removeIsolatedPoints),
-									reinterpret_cast<void*>(&useKnn),
-									reinterpret_cast<void*>(&knn),
-									reinterpret_cast<void*>(&useAbsoluteError),
-									reinterpret_cast<void*>(&absoluteError)
-	};
-
-	unsigned char octreeLevel = 0;
-	if (useKnn)
-		octreeLevel = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(kernelRadius);
-	else
-		octreeLevel = octree->findBestLevelForAGivenPopulationPerCell(knn);
-
-	if (octree->executeFunctionForAllCellsAtLevel(	octreeLevel,
-													&applyNoiseFilterAtLevel,
-													additionalParameters,
-													true,
-													progressCb,
-													"Noise filter" ) == 0)
-	{
-		//something went wrong
-		delete filteredCloud;
-		filteredCloud = 0;
-	}
-
-	if (!inputOctree)
-	{
-		delete octree;
-		octree = 0;
-	}
-
-	if (filteredCloud)
-	{
-		filteredCloud->resize(filteredCloud->size());
-	}
-
-	return filteredCloud;
+	return cache.noiseFilter(nSigma, removeIsolatedPoints, useAbsoluteError, absoluteError);
 }
 
 bool CloudSamplingTools::resampleCellAtLevel(	const DgmOctree::octreeCell& cell,
@@ -736,167 +597,3 @@ bool CloudSamplingTools::subsampleCellAtLevel(	const DgmOctree::octreeCell& cell
 
 	return cloud->addPointIndex(cell.points->getPointGlobalIndex(selectedPointIndex));
 }
-
-bool CloudSamplingTools::applyNoiseFilterAtLevel(	const DgmOctree::octreeCell& cell,
-													void** additionalParameters,
-													NormalizedProgress* nProgress/*=0*/)
-{
-	ReferenceCloud* cloud				=  static_cast<ReferenceCloud*>(additionalParameters[0]);
-	PointCoordinateType kernelRadius	= *static_cast<PointCoordinateType*>(additionalParameters[1]);
-	double nSigma						= *static_cast<double*>(additionalParameters[2]);
-	bool removeIsolatedPoints			= *static_cast<bool*>(additionalParameters[3]);
-	bool useKnn							= *static_cast<bool*>(additionalParameters[4]);
-	int knn								= *static_cast<int*>(additionalParameters[5]);
-	bool useAbsoluteError				= *static_cast<bool*>(additionalParameters[6]);
-	double absoluteError				= *static_cast<double*>(additionalParameters[7]);
-
-	//structure for nearest neighbors search
-	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
-	nNSS.level = cell.level;
-	nNSS.prepare(kernelRadius, cell.parentOctree->getCellSize(nNSS.level));
-	if (useKnn)
-	{
-		nNSS.minNumberOfNeighbors = knn;
-	}
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-
-	unsigned n = cell.points->size(); //number of points in the current cell
-
-	//for each point in the cell
-	for (unsigned i = 0; i < n; ++i)
-	{
-		cell.points->getPoint(i, nNSS.queryPoint);
-
-		//look for neighbors (either inside a sphere or the k nearest ones)
-		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
-		unsigned neighborCount = 0;
-
-		if (useKnn)
-			neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
-		else
-			neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, kernelRadius, false);
-
-		if (neighborCount > 3) //we want 3 points or more (other than the point itself!)
-		{
-			//find the query point in the nearest neighbors set and place it at the end
-			const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
-			unsigned localIndex = 0;
-			while (localIndex < neighborCount && nNSS.pointsInNeighbourhood[localIndex].pointIndex != globalIndex)
-				++localIndex;
-			//the query point should be in the nearest neighbors set!
-			assert(localIndex < neighborCount);
-			if (localIndex + 1 < neighborCount) //no need to swap with another point if it's already at the end!
-			{
-				std::swap(nNSS.pointsInNeighbourhood[localIndex], nNSS.pointsInNeighbourhood[neighborCount - 1]);
-			}
-
-			unsigned realNeighborCount = neighborCount - 1;
-			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood, realNeighborCount); //we don't take the query point into account!
-			Neighbourhood Z(&neighboursCloud);
-
-			const PointCoordinateType* lsPlane = Z.getLSPlane();
-			if (lsPlane)
-			{
-				double maxD = absoluteError;
-				if (!useAbsoluteError)
-				{
-					//compute the std. dev. to this plane
-					double sum_d = 0;
-					double sum_d2 = 0;
-					for (unsigned j = 0; j < realNeighborCount; ++j)
-					{
-						const CCVector3* P = neighboursCloud.getPoint(j);
-						double d = CCLib::DistanceComputationTools::computePoint2PlaneDistance(P, lsPlane);
-						sum_d += d;
-						sum_d2 += d*d;
-					}
-
-					double stddev = sqrt(fabs(sum_d2*realNeighborCount - sum_d*sum_d)) / realNeighborCount;
-					maxD = stddev * nSigma;
-				}
-
-				//distance from the query point to the plane
-				double d = fabs(CCLib::DistanceComputationTools::computePoint2PlaneDistance(&nNSS.queryPoint, lsPlane));
-
-				if (d <= maxD)
-					cloud->addPointIndex(globalIndex);
-			}
-			else
-			{
-				//TODO: ???
-			}
-		}
-		else
-		{
-			//not enough points to fit a plane AND compute distances to it
-			if (!removeIsolatedPoints)
-			{
-				//we keep the point
-				unsigned globalIndex = cell.points->getPointGlobalIndex(i);
-				cloud->addPointIndex(globalIndex);
-			}
-		}
-
-		if (nProgress && !nProgress->oneStep())
-		{
-			return false;
-		}
-	}
-
-	return true;
-}
-
-bool CloudSamplingTools::applySORFilterAtLevel(	const DgmOctree::octreeCell& cell,
-												void** additionalParameters,
-												NormalizedProgress* nProgress/*=0*/)
-{
-	int knn											= *static_cast<int*>(additionalParameters[0]);
-	std::vector<PointCoordinateType>& meanDistances = *static_cast<std::vector<PointCoordinateType>*>(additionalParameters[1]);
-
-	//structure for nearest neighbors search
-	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
-	nNSS.level = cell.level;
-	nNSS.minNumberOfNeighbors = knn; //DGM: I woud have put knn+1 (as the point itself will be ignored) but in this case we won't get the same result as PCL!
-	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
-	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
-
-	unsigned n = cell.points->size(); //number of points in the current cell
-
-	//for each point in the cell
-	for (unsigned i = 0; i < n; ++i)
-	{
-		cell.points->getPoint(i, nNSS.queryPoint);
-		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
-
-		//look for the k nearest neighbors
-		cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
-		double sumDist = 0;
-		unsigned count = 0;
-		for (int j = 0; j < knn; ++j)
-		{
-			if (nNSS.pointsInNeighbourhood[j].pointIndex != globalIndex)
-			{
-				sumDist += sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-				++count;
-			}
-		}
-
-		if (count)
-		{
-			meanDistances[globalIndex] = static_cast<PointCoordinateType>(sumDist / count);
-		}
-		else
-		{
-			//shouldn't happen
-			assert(false);
-		}
-
-		if (nProgress && !nProgress->oneStep())
-		{
-			return false;
-		}
-	}
-
-	return true;
-}
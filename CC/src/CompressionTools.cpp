@@ -0,0 +1,338 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "CompressionTools.h"
+
+//system
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+using namespace CCLib;
+
+//! Log2 of the size of the match finder hash table
+static const unsigned HASH_LOG = 14;
+//! Minimum match length
+static const size_t MIN_MATCH = 4;
+//! The last bytes of a block are always stored as literals
+static const size_t LAST_LITERALS = 5;
+//! A match can't start after this limit (from the end of the block)
+static const size_t MF_LIMIT = 12;
+//! Maximum match distance
+static const size_t MAX_DISTANCE = 65535;
+//! The search step is increased after each (1 << SKIP_TRIGGER) unsuccessful attempts
+static const unsigned SKIP_TRIGGER = 6;
+
+static inline unsigned Read32(const unsigned char* p)
+{
+	unsigned value;
+	memcpy(&value, p, sizeof(unsigned));
+	return value;
+}
+
+static inline unsigned long long Read64(const unsigned char* p)
+{
+	unsigned long long value;
+	memcpy(&value, p, sizeof(unsigned long long));
+	return value;
+}
+
+static inline unsigned Hash(unsigned sequence)
+{
+	return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+//! Writes a length in the LZ4 'extended length' format (255 + 255 + ... + remainder)
+static inline unsigned char* WriteLength(unsigned char* op, size_t length)
+{
+	while (length >= 255)
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = static_cast<unsigned char>(length);
+	return op;
+}
+
+size_t CompressionTools::CompressBound(size_t sourceSize)
+{
+	return sourceSize + sourceSize / 255 + 16;
+}
+
+size_t CompressionTools::Compress(const void* source, size_t sourceSize, void* dest, size_t destCapacity)
+{
+	const unsigned char* const src = static_cast<const unsigned char*>(source);
+	unsigned char* const dst = static_cast<unsigned char*>(dest);
+	unsigned char* const dstEnd = dst + destCapacity;
+
+	const unsigned char* ip = src;
+	const unsigned char* anchor = src; //start of the pending literals
+	const unsigned char* const iend = src + sourceSize;
+	unsigned char* op = dst;
+
+	if (sourceSize >= MF_LIMIT + 1)
+	{
+		//positions (relative to 'src') of the last occurrence of each hashed 4-bytes sequence
+		std::vector<unsigned> hashTable;
+		try
+		{
+			hashTable.resize(static_cast<size_t>(1) << HASH_LOG, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return 0;
+		}
+
+		const unsigned char* const mflimit = iend - MF_LIMIT;
+		const unsigned char* const matchlimit = iend - LAST_LITERALS;
+
+		++ip; //the first byte can't be matched
+		while (ip < mflimit)
+		{
+			//look for a match
+			const unsigned char* match = 0;
+			{
+				unsigned attempts = (1 << SKIP_TRIGGER);
+				while (ip < mflimit)
+				{
+					unsigned h = Hash(Read32(ip));
+					const unsigned char* candidate = src + hashTable[h];
+					hashTable[h] = static_cast<unsigned>(ip - src);
+					if (candidate < ip && static_cast<size_t>(ip - candidate) <= MAX_DISTANCE && Read32(candidate) == Read32(ip))
+					{
+						match = candidate;
+						break;
+					}
+					//incompressible data is skipped faster and faster
+					ip += (attempts++ >> SKIP_TRIGGER);
+				}
+				if (!match)
+					break;
+			}
+
+			//extend the match backward
+			while (ip > anchor && match > src && ip[-1] == match[-1])
+			{
+				--ip;
+				--match;
+			}
+
+			//extend the match forward (8 bytes at a time first)
+			size_t matchLength = MIN_MATCH;
+			while (ip + matchLength + 8 <= matchlimit && Read64(ip + matchLength) == Read64(match + matchLength))
+				matchLength += 8;
+			while (ip + matchLength < matchlimit && ip[matchLength] == match[matchLength])
+				++matchLength;
+
+			//write the sequence
+			size_t literalCount = static_cast<size_t>(ip - anchor);
+			//worst case: token + literal length + literals + offset + match length
+			if (static_cast<size_t>(dstEnd - op) < 1 + literalCount / 255 + 1 + literalCount + 2 + (matchLength - MIN_MATCH) / 255 + 1)
+				return 0;
+
+			unsigned char* token = op++;
+			if (literalCount >= 15)
+			{
+				*token = (15 << 4);
+				op = WriteLength(op, literalCount - 15);
+			}
+			else
+			{
+				*token = static_cast<unsigned char>(literalCount << 4);
+			}
+			memcpy(op, anchor, literalCount);
+			op += literalCount;
+
+			size_t offset = static_cast<size_t>(ip - match);
+			*op++ = static_cast<unsigned char>(offset & 255);
+			*op++ = static_cast<unsigned char>(offset >> 8);
+
+			size_t matchCode = matchLength - MIN_MATCH;
+			if (matchCode >= 15)
+			{
+				*token |= 15;
+				op = WriteLength(op, matchCode - 15);
+			}
+			else
+			{
+				*token |= static_cast<unsigned char>(matchCode);
+			}
+
+			ip += matchLength;
+			anchor = ip;
+
+			//update the table with a position inside the match
+			if (ip - 2 > src)
+				hashTable[Hash(Read32(ip - 2))] = static_cast<unsigned>(ip - 2 - src);
+		}
+	}
+
+	//last literals
+	{
+		size_t literalCount = static_cast<size_t>(iend - anchor);
+		if (static_cast<size_t>(dstEnd - op) < 1 + literalCount / 255 + 1 + literalCount)
+			return 0;
+
+		if (literalCount >= 15)
+		{
+			*op++ = (15 << 4);
+			op = WriteLength(op, literalCount - 15);
+		}
+		else
+		{
+			*op++ = static_cast<unsigned char>(literalCount << 4);
+		}
+		memcpy(op, anchor, literalCount);
+		op += literalCount;
+	}
+
+	return static_cast<size_t>(op - dst);
+}
+
+//! Reads a length in the LZ4 'extended length' format
+/** \return false if the input is truncated
+**/
+static inline bool ReadLength(const unsigned char*& ip, const unsigned char* iend, size_t& length)
+{
+	unsigned char s = 255;
+	while (s == 255)
+	{
+		if (ip >= iend)
+			return false;
+		s = *ip++;
+		length += s;
+	}
+	return true;
+}
+
+bool CompressionTools::Decompress(const void* source, size_t sourceSize, void* dest, size_t destSize)
+{
+	const unsigned char* ip = static_cast<const unsigned char*>(source);
+	const unsigned char* const iend = ip + sourceSize;
+	unsigned char* const dst = static_cast<unsigned char*>(dest);
+	unsigned char* op = dst;
+	unsigned char* const oend = dst + destSize;
+
+	while (ip < iend)
+	{
+		unsigned token = *ip++;
+
+		//literals
+		size_t literalCount = (token >> 4);
+		if (literalCount == 15 && !ReadLength(ip, iend, literalCount))
+			return false;
+		if (literalCount > static_cast<size_t>(iend - ip) || literalCount > static_cast<size_t>(oend - op))
+			return false;
+		memcpy(op, ip, literalCount);
+		ip += literalCount;
+		op += literalCount;
+
+		//the last sequence has no match
+		if (ip == iend)
+			break;
+
+		//match
+		if (iend - ip < 2)
+			return false;
+		size_t offset = static_cast<size_t>(ip[0]) | (static_cast<size_t>(ip[1]) << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<size_t>(op - dst))
+			return false;
+
+		size_t matchLength = (token & 15);
+		if (matchLength == 15 && !ReadLength(ip, iend, matchLength))
+			return false;
+		matchLength += MIN_MATCH;
+		if (matchLength > static_cast<size_t>(oend - op))
+			return false;
+
+		const unsigned char* match = op - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else
+		{
+			//overlapping copy (repeated pattern): the copied pattern doubles at each step
+			unsigned char* const stop = op + matchLength;
+			while (op < stop)
+			{
+				size_t n = std::min(static_cast<size_t>(op - match), static_cast<size_t>(stop - op));
+				memcpy(op, match, n);
+				op += n;
+			}
+		}
+	}
+
+	return op == oend;
+}
+
+void CompressionTools::Shuffle(const void* source, void* dest, size_t byteCount, size_t typeSize)
+{
+	const unsigned char* src = static_cast<const unsigned char*>(source);
+	unsigned char* dst = static_cast<unsigned char*>(dest);
+
+	size_t count = (typeSize != 0 ? byteCount / typeSize : 0);
+	if (typeSize > 1)
+	{
+		for (size_t j = 0; j < typeSize; ++j)
+		{
+			const unsigned char* in = src + j;
+			unsigned char* out = dst + j * count;
+			for (size_t i = 0; i < count; ++i, in += typeSize)
+				out[i] = *in;
+		}
+	}
+	else
+	{
+		count = 0;
+		typeSize = 0;
+	}
+
+	//remaining bytes
+	size_t processed = count * typeSize;
+	memcpy(dst + processed, src + processed, byteCount - processed);
+}
+
+void CompressionTools::Unshuffle(const void* source, void* dest, size_t byteCount, size_t typeSize)
+{
+	const unsigned char* src = static_cast<const unsigned char*>(source);
+	unsigned char* dst = static_cast<unsigned char*>(dest);
+
+	size_t count = (typeSize != 0 ? byteCount / typeSize : 0);
+	if (typeSize > 1)
+	{
+		for (size_t j = 0; j < typeSize; ++j)
+		{
+			const unsigned char* in = src + j * count;
+			unsigned char* out = dst + j;
+			for (size_t i = 0; i < count; ++i, out += typeSize)
+				*out = in[i];
+		}
+	}
+	else
+	{
+		count = 0;
+		typeSize = 0;
+	}
+
+	//remaining bytes
+	size_t processed = count * typeSize;
+	memcpy(dst + processed, src + processed, byteCount - processed);
+}
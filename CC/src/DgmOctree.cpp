@@ -22,12 +22,16 @@
 #include "ReferenceCloud.h"
 #include "GenericProgressCallback.h"
 #include "CCMiscTools.h"
+#include "ParallelTools.h"
 #include "ScalarField.h"
 #include "RayAndBox.h"
 #include "SortAlgo.h"
+#include "NearestPointKernels.h"
 
 //system
 #include <stdio.h>
+#include <float.h>
+#include <algorithm>
 #include <set>
 
 //DGM: tests in progress
@@ -238,6 +242,196 @@ int DgmOctree::build(	const CCVector3& octreeMin,
 	return genericBuild(progressCb);
 }
 
+//! Min. number of points per block for parallel octree construction
+static const unsigned MIN_POINTS_PER_BLOCK = (1 << 16);
+
+//! Number of bits per radix sort digit
+static const unsigned RADIX_BITS = 8;
+//! Number of buckets per radix sort digit
+static const unsigned RADIX_SIZE = (1 << RADIX_BITS);
+
+//! Stable LSD radix sort of octree elements by cell code (parallel)
+/** Only the digits containing bits set in 'usedCodeBits' are processed.
+	Requires a temporary buffer as large as the input container.
+	\return false if there's not enough memory
+**/
+static bool ParallelRadixSortByCode(DgmOctree::cellsContainer& elements, DgmOctree::CellCode usedCodeBits)
+{
+	const unsigned count = static_cast<unsigned>(elements.size());
+	const unsigned blockCount = std::max(1u, std::min(static_cast<unsigned>(ParallelTools::DefaultMaxThreadCount()), count / MIN_POINTS_PER_BLOCK));
+	const unsigned blockSize = (count + blockCount - 1) / blockCount;
+
+	DgmOctree::cellsContainer buffer;
+	std::vector<unsigned> offsets; //per block and per digit
+	try
+	{
+		buffer.resize(count);
+		offsets.resize(static_cast<size_t>(blockCount) * RADIX_SIZE);
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		return false;
+	}
+
+	DgmOctree::IndexAndCode* src = &(elements[0]);
+	DgmOctree::IndexAndCode* dst = &(buffer[0]);
+
+	for (unsigned shift = 0; shift < sizeof(DgmOctree::CellCode) * 8; shift += RADIX_BITS)
+	{
+		if (((usedCodeBits >> shift) & (RADIX_SIZE - 1)) == 0)
+		{
+			//this digit is always null
+			continue;
+		}
+
+		//per-block histograms
+		ParallelTools::ForEach(blockCount, [&](unsigned b)
+		{
+			unsigned* histogram = &(offsets[static_cast<size_t>(b) * RADIX_SIZE]);
+			std::fill(histogram, histogram + RADIX_SIZE, 0);
+			unsigned stop = std::min((b + 1) * blockSize, count);
+			for (unsigned i = b * blockSize; i < stop; ++i)
+			{
+				++histogram[(src[i].theCode >> shift) & (RADIX_SIZE - 1)];
+			}
+		}, 0, 0, 1);
+
+		//convert them to (global) output offsets
+		bool singleBucket = false;
+		unsigned sum = 0;
+		for (unsigned d = 0; d < RADIX_SIZE; ++d)
+		{
+			unsigned digitStart = sum;
+			for (unsigned b = 0; b < blockCount; ++b)
+			{
+				unsigned& offset = offsets[static_cast<size_t>(b) * RADIX_SIZE + d];
+				unsigned population = offset;
+				offset = sum;
+				sum += population;
+			}
+			if (sum - digitStart == count)
+			{
+				singleBucket = true;
+				break;
+			}
+		}
+		if (singleBucket)
+		{
+			//all the elements share the same digit: nothing to do
+			continue;
+		}
+
+		//scatter
+		ParallelTools::ForEach(blockCount, [&](unsigned b)
+		{
+			unsigned* blockOffsets = &(offsets[static_cast<size_t>(b) * RADIX_SIZE]);
+			unsigned stop = std::min((b + 1) * blockSize, count);
+			for (unsigned i = b * blockSize; i < stop; ++i)
+			{
+				dst[blockOffsets[(src[i].theCode >> shift) & (RADIX_SIZE - 1)]++] = src[i];
+			}
+		}, 0, 0, 1);
+
+		std::swap(src, dst);
+	}
+
+	if (src != &(elements[0]))
+	{
+		elements.swap(buffer);
+	}
+
+	return true;
+}
+
+bool DgmOctree::projectPoint(const CCVector3* P, Tuple3i& cellPos) const
+{
+	//does the point falls in the 'accepted points' box?
+	//(potentially different from the octree box - see DgmOctree::build)
+	if (	(P->x < m_pointsMin[0]) || (P->x > m_pointsMax[0])
+		||	(P->y < m_pointsMin[1]) || (P->y > m_pointsMax[1])
+		||	(P->z < m_pointsMin[2]) || (P->z > m_pointsMax[2]) )
+	{
+		return false;
+	}
+
+	//compute the position of the cell that includes this point
+	getTheCellPosWhichIncludesThePoint(P, cellPos);
+
+	//clipping X
+	if (cellPos.x < 0)
+		cellPos.x = 0;
+	else if (cellPos.x >= MAX_OCTREE_LENGTH)
+		cellPos.x = MAX_OCTREE_LENGTH-1;
+	//clipping Y
+	if (cellPos.y < 0)
+		cellPos.y = 0;
+	else if (cellPos.y >= MAX_OCTREE_LENGTH)
+		cellPos.y = MAX_OCTREE_LENGTH-1;
+	//clipping Z
+	if (cellPos.z < 0)
+		cellPos.z = 0;
+	else if (cellPos.z >= MAX_OCTREE_LENGTH)
+		cellPos.z = MAX_OCTREE_LENGTH-1;
+
+	return true;
+}
+
+void DgmOctree::projectPoints(ProjectedBlock& block, NormalizedProgress& nprogress, ParallelCancelToken& cancelToken)
+{
+	block.projectedCount = 0;
+	block.usedCodeBits = 0;
+
+	//the projected points are stored at the beginning of the block's own range
+	cellsContainer::iterator it = m_thePointsAndTheirCellCodes.begin() + block.firstIndex;
+	for (unsigned i = block.firstIndex; i < block.lastIndex; i++)
+	{
+		const CCVector3* P = m_theAssociatedCloud->getPoint(i);
+
+		//compute the position of the cell that includes this point
+		Tuple3i cellPos;
+		if (projectPoint(P, cellPos))
+		{
+			it->theIndex = i;
+			it->theCode = GenerateTruncatedCellCode(cellPos, MAX_OCTREE_LEVEL);
+			block.usedCodeBits |= it->theCode;
+
+			if (block.projectedCount)
+			{
+				if (block.minFillIndexes.x > cellPos.x)
+					block.minFillIndexes.x = cellPos.x;
+				else if (block.maxFillIndexes.x < cellPos.x)
+					block.maxFillIndexes.x = cellPos.x;
+
+				if (block.minFillIndexes.y > cellPos.y)
+					block.minFillIndexes.y = cellPos.y;
+				else if (block.maxFillIndexes.y < cellPos.y)
+					block.maxFillIndexes.y = cellPos.y;
+
+				if (block.minFillIndexes.z > cellPos.z)
+					block.minFillIndexes.z = cellPos.z;
+				else if (block.maxFillIndexes.z < cellPos.z)
+					block.maxFillIndexes.z = cellPos.z;
+			}
+			else
+			{
+				block.minFillIndexes = block.maxFillIndexes = cellPos;
+			}
+
+			++it;
+			++block.projectedCount;
+		}
+
+		if (!nprogress.oneStep())
+		{
+			cancelToken.cancel();
+		}
+		if (cancelToken.isCanceled())
+		{
+			return;
+		}
+	}
+}
+
 int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 {
 	unsigned pointCount = (m_theAssociatedCloud ? m_theAssociatedCloud->size() : 0);
@@ -276,96 +470,88 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 	}
 	NormalizedProgress nprogress(progressCb, pointCount, 90); //first phase: 90% (we keep 10% for sort)
 
-	//fill indexes table (we'll fill the max. level, then deduce the others from this one)
-	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL * 6);
-
-	//for all points
-	cellsContainer::iterator it = m_thePointsAndTheirCellCodes.begin();
-	for (unsigned i=0; i<pointCount; i++)
+	//the points are projected in parallel, by contiguous blocks
+	std::vector<ProjectedBlock> blocks;
 	{
-		const CCVector3* P = m_theAssociatedCloud->getPoint(i);
-
-		//does the point falls in the 'accepted points' box?
-		//(potentially different from the octree box - see DgmOctree::build)
-		if (	(P->x >= m_pointsMin[0]) && (P->x <= m_pointsMax[0])
-			&&	(P->y >= m_pointsMin[1]) && (P->y <= m_pointsMax[1])
-			&&	(P->z >= m_pointsMin[2]) && (P->z <= m_pointsMax[2]) )
+		unsigned blockCount = std::max(1u, std::min(static_cast<unsigned>(ParallelTools::DefaultMaxThreadCount()) * 4, pointCount / MIN_POINTS_PER_BLOCK));
+		unsigned blockSize = (pointCount + blockCount - 1) / blockCount;
+		try
 		{
-			//compute the position of the cell that includes this point
-			Tuple3i cellPos;
-			getTheCellPosWhichIncludesThePoint(P, cellPos);
-
-			//clipping X
-			if (cellPos.x < 0)
-				cellPos.x = 0;
-			else if (cellPos.x >= MAX_OCTREE_LENGTH)
-				cellPos.x = MAX_OCTREE_LENGTH-1;
-			//clipping Y
-			if (cellPos.y < 0)
-				cellPos.y = 0;
-			else if (cellPos.y >= MAX_OCTREE_LENGTH)
-				cellPos.y = MAX_OCTREE_LENGTH-1;
-			//clipping Z
-			if (cellPos.z < 0)
-				cellPos.z = 0;
-			else if (cellPos.z >= MAX_OCTREE_LENGTH)
-				cellPos.z = MAX_OCTREE_LENGTH-1;
+			blocks.resize(blockCount);
+		}
+		catch (const std::bad_alloc&) //out of memory
+		{
+			m_thePointsAndTheirCellCodes.clear();
+			return -1;
+		}
+		for (unsigned b = 0; b < blockCount; ++b)
+		{
+			blocks[b].firstIndex = std::min(b * blockSize, pointCount);
+			blocks[b].lastIndex = std::min(blocks[b].firstIndex + blockSize, pointCount);
+		}
+	}
 
-			it->theIndex = i;
-			it->theCode = GenerateTruncatedCellCode(cellPos, MAX_OCTREE_LEVEL);
+	ParallelCancelToken cancelToken;
+	ParallelTools::ForEach(	static_cast<unsigned>(blocks.size()),
+							[&](unsigned b) { projectPoints(blocks[b], nprogress, cancelToken); },
+							0,
+							&cancelToken,
+							1);
 
-			if (m_numberOfProjectedPoints)
-			{
-				if (fillIndexesAtMaxLevel[0] > cellPos.x)
-					fillIndexesAtMaxLevel[0] = cellPos.x;
-				else if (fillIndexesAtMaxLevel[3] < cellPos.x)
-					fillIndexesAtMaxLevel[3] = cellPos.x;
-
-				if (fillIndexesAtMaxLevel[1] > cellPos.y)
-					fillIndexesAtMaxLevel[1] = cellPos.y;
-				else if (fillIndexesAtMaxLevel[4] < cellPos.y)
-					fillIndexesAtMaxLevel[4] = cellPos.y;
-
-				if (fillIndexesAtMaxLevel[2] > cellPos.z)
-					fillIndexesAtMaxLevel[2] = cellPos.z;
-				else if (fillIndexesAtMaxLevel[5] < cellPos.z)
-					fillIndexesAtMaxLevel[5] = cellPos.z;
-			}
-			else
-			{
-				fillIndexesAtMaxLevel[0] = fillIndexesAtMaxLevel[3] = cellPos.x;
-				fillIndexesAtMaxLevel[1] = fillIndexesAtMaxLevel[4] = cellPos.y;
-				fillIndexesAtMaxLevel[2] = fillIndexesAtMaxLevel[5] = cellPos.z;
-			}
+	if (cancelToken.isCanceled())
+	{
+		m_thePointsAndTheirCellCodes.clear();
+		m_numberOfProjectedPoints = 0;
+		if (progressCb)
+		{
+			progressCb->stop();
+		}
+		return 0;
+	}
 
-			++it;
-			++m_numberOfProjectedPoints;
+	//we gather the blocks (in order) and merge their 'fill indexes' at the highest level
+	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL * 6);
+	CellCode usedCodeBits = 0;
+	for (size_t b = 0; b < blocks.size(); ++b)
+	{
+		const ProjectedBlock& block = blocks[b];
+		if (block.projectedCount == 0)
+		{
+			continue;
 		}
 
-		if (!nprogress.oneStep())
+		if (m_numberOfProjectedPoints != block.firstIndex)
 		{
-			m_thePointsAndTheirCellCodes.clear();
-			m_numberOfProjectedPoints = 0;
-			if (progressCb)
+			assert(m_numberOfProjectedPoints < block.firstIndex);
+			std::copy(	m_thePointsAndTheirCellCodes.begin() + block.firstIndex,
+						m_thePointsAndTheirCellCodes.begin() + (block.firstIndex + block.projectedCount),
+						m_thePointsAndTheirCellCodes.begin() + m_numberOfProjectedPoints);
+		}
+
+		if (m_numberOfProjectedPoints)
+		{
+			for (unsigned char k = 0; k < 3; ++k)
 			{
-				progressCb->stop();
+				fillIndexesAtMaxLevel[k] = std::min(fillIndexesAtMaxLevel[k], block.minFillIndexes.u[k]);
+				fillIndexesAtMaxLevel[k+3] = std::max(fillIndexesAtMaxLevel[k+3], block.maxFillIndexes.u[k]);
 			}
-			return 0;
 		}
-	}
-
-	//we deduce the lower levels 'fill indexes' from the highest level
-	{
-		for (int k = MAX_OCTREE_LEVEL - 1; k >= 0; k--)
+		else
 		{
-			int* fillIndexes = m_fillIndexes + (k*6);
-			for (int dim=0; dim<6; ++dim)
+			for (unsigned char k = 0; k < 3; ++k)
 			{
-				fillIndexes[dim] = (fillIndexes[dim+6] >> 1);
+				fillIndexesAtMaxLevel[k] = block.minFillIndexes.u[k];
+				fillIndexesAtMaxLevel[k+3] = block.maxFillIndexes.u[k];
 			}
 		}
+
+		usedCodeBits |= block.usedCodeBits;
+		m_numberOfProjectedPoints += block.projectedCount;
 	}
 
+	//we deduce the lower levels 'fill indexes' from the highest level
+	updateFillIndexesFromMaxLevel();
+
 	if (m_numberOfProjectedPoints < pointCount)
 		m_thePointsAndTheirCellCodes.resize(m_numberOfProjectedPoints); //smaller --> should always be ok
 
@@ -375,7 +561,12 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 	}
 
 	//we sort the 'cells' by ascending code order
-	SortAlgo(m_thePointsAndTheirCellCodes.begin(), m_thePointsAndTheirCellCodes.end(), IndexAndCode::codeComp);
+	if (	m_numberOfProjectedPoints < MIN_POINTS_PER_BLOCK
+		||	!ParallelRadixSortByCode(m_thePointsAndTheirCellCodes, usedCodeBits))
+	{
+		//small cloud or not enough memory for the radix sort buffer
+		SortAlgo(m_thePointsAndTheirCellCodes.begin(), m_thePointsAndTheirCellCodes.end(), IndexAndCode::codeComp);
+	}
 
 	//update the pre-computed 'number of cells per level of subdivision' array
 	updateCellCountTable();
@@ -408,6 +599,190 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 	return static_cast<int>(m_numberOfProjectedPoints);
 }
 
+void DgmOctree::updateFillIndexesFromMaxLevel()
+{
+	for (int k = MAX_OCTREE_LEVEL - 1; k >= 0; k--)
+	{
+		int* fillIndexes = m_fillIndexes + (k*6);
+		for (int dim=0; dim<6; ++dim)
+		{
+			fillIndexes[dim] = (fillIndexes[dim+6] >> 1);
+		}
+	}
+}
+
+bool DgmOctree::insertPoints(const std::vector<unsigned>& pointIndexes)
+{
+	if (pointIndexes.empty())
+	{
+		return true;
+	}
+	if (m_thePointsAndTheirCellCodes.empty())
+	{
+		//the octree must be built first
+		return false;
+	}
+
+	//compute the codes of the new points
+	cellsContainer delta;
+	try
+	{
+		delta.resize(pointIndexes.size());
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		return false;
+	}
+
+	Tuple3i minFillIndexes(m_fillIndexes + MAX_OCTREE_LEVEL*6);
+	Tuple3i maxFillIndexes(m_fillIndexes + MAX_OCTREE_LEVEL*6 + 3);
+	for (size_t i = 0; i < pointIndexes.size(); ++i)
+	{
+		Tuple3i cellPos;
+		if (!projectPoint(m_theAssociatedCloud->getPoint(pointIndexes[i]), cellPos))
+		{
+			//the point is outside the octree 'points' box: it must be rebuilt
+			return false;
+		}
+
+		delta[i].theIndex = pointIndexes[i];
+		delta[i].theCode = GenerateTruncatedCellCode(cellPos, MAX_OCTREE_LEVEL);
+
+		for (unsigned char k = 0; k < 3; ++k)
+		{
+			minFillIndexes.u[k] = std::min(minFillIndexes.u[k], cellPos.u[k]);
+			maxFillIndexes.u[k] = std::max(maxFillIndexes.u[k], cellPos.u[k]);
+		}
+	}
+
+	//sort them (k.log(k))
+	SortAlgo(delta.begin(), delta.end(), IndexAndCode::codeComp);
+
+	//and merge them with the current (sorted) ones (n+k)
+	cellsContainer merged;
+	try
+	{
+		merged.resize(m_thePointsAndTheirCellCodes.size() + delta.size());
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		return false;
+	}
+	std::merge(	m_thePointsAndTheirCellCodes.begin(), m_thePointsAndTheirCellCodes.end(),
+				delta.begin(), delta.end(),
+				merged.begin(),
+				IndexAndCode::codeComp);
+	m_thePointsAndTheirCellCodes.swap(merged);
+	m_numberOfProjectedPoints = static_cast<unsigned>(m_thePointsAndTheirCellCodes.size());
+
+	//update the 'fill indexes'
+	for (unsigned char k = 0; k < 3; ++k)
+	{
+		m_fillIndexes[MAX_OCTREE_LEVEL*6 + k] = minFillIndexes.u[k];
+		m_fillIndexes[MAX_OCTREE_LEVEL*6 + 3 + k] = maxFillIndexes.u[k];
+	}
+	updateFillIndexesFromMaxLevel();
+
+	//update the pre-computed 'number of cells per level of subdivision' array
+	updateCellCountTable();
+
+	return true;
+}
+
+bool DgmOctree::removePoints(const std::vector<unsigned>& pointIndexes, bool shiftIndexes)
+{
+	if (pointIndexes.empty() || m_thePointsAndTheirCellCodes.empty())
+	{
+		return true;
+	}
+
+	//new index of each point (or -1 if it is removed)
+	static const unsigned REMOVED = static_cast<unsigned>(-1);
+	std::vector<unsigned> newIndexes;
+	try
+	{
+		unsigned maxIndex = m_theAssociatedCloud->size();
+		for (size_t i = 0; i < pointIndexes.size(); ++i)
+		{
+			maxIndex = std::max(maxIndex, pointIndexes[i] + 1);
+		}
+		newIndexes.resize(maxIndex, 0);
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < pointIndexes.size(); ++i)
+	{
+		newIndexes[pointIndexes[i]] = REMOVED;
+	}
+	unsigned newIndex = 0;
+	for (size_t i = 0; i < newIndexes.size(); ++i)
+	{
+		if (newIndexes[i] != REMOVED)
+		{
+			newIndexes[i] = (shiftIndexes ? newIndex++ : static_cast<unsigned>(i));
+		}
+	}
+
+	//remove the points (the remaining ones stay sorted) and update the 'fill indexes'
+	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL * 6);
+	size_t remainingCount = 0;
+	CellCode lastCode = 0;
+	for (size_t i = 0; i < m_thePointsAndTheirCellCodes.size(); ++i)
+	{
+		IndexAndCode element = m_thePointsAndTheirCellCodes[i];
+		assert(element.theIndex < newIndexes.size());
+		if (newIndexes[element.theIndex] == REMOVED)
+		{
+			continue;
+		}
+
+		if (remainingCount == 0 || element.theCode != lastCode)
+		{
+			Tuple3i cellPos;
+			getCellPos(element.theCode, MAX_OCTREE_LEVEL, cellPos, true);
+			if (remainingCount)
+			{
+				for (unsigned char k = 0; k < 3; ++k)
+				{
+					fillIndexesAtMaxLevel[k] = std::min(fillIndexesAtMaxLevel[k], cellPos.u[k]);
+					fillIndexesAtMaxLevel[k+3] = std::max(fillIndexesAtMaxLevel[k+3], cellPos.u[k]);
+				}
+			}
+			else
+			{
+				for (unsigned char k = 0; k < 3; ++k)
+				{
+					fillIndexesAtMaxLevel[k] = fillIndexesAtMaxLevel[k+3] = cellPos.u[k];
+				}
+			}
+			lastCode = element.theCode;
+		}
+
+		element.theIndex = newIndexes[element.theIndex];
+		m_thePointsAndTheirCellCodes[remainingCount++] = element;
+	}
+
+	m_thePointsAndTheirCellCodes.resize(remainingCount); //smaller --> should always be ok
+	m_numberOfProjectedPoints = static_cast<unsigned>(remainingCount);
+
+	if (remainingCount == 0)
+	{
+		memset(m_fillIndexes, 0, sizeof(int)*(MAX_OCTREE_LEVEL + 1) * 6);
+	}
+	else
+	{
+		updateFillIndexesFromMaxLevel();
+	}
+
+	//update the pre-computed 'number of cells per level of subdivision' array
+	updateCellCountTable();
+
+	return true;
+}
+
 void DgmOctree::updateMinAndMaxTables()
 {
 	if (!m_theAssociatedCloud)
@@ -818,11 +1193,15 @@ void DgmOctree::getCellDistanceFromBorders(	const Tuple3i& cellPos,
 	int* _limits = limits;
 	for (int dim=0; dim<3; ++dim)
 	{
+		//DGM: if the neighbourhood is totally outside the filled octree (the cell itself is outside
+		//of it), the limits must define an empty range (i.e. -min > max) so that no (invalid) cell
+		//position is generated
+
 		//min dim.
 		{
 			int a = cellPos.u[dim] - fillIndexes[dim];
 			if (a < -neighbourhoodLength)
-				a = -neighbourhoodLength;
+				a = -neighbourhoodLength-1;
 			else if (a > neighbourhoodLength)
 				a = neighbourhoodLength;
 			*_limits++ = a;
@@ -832,7 +1211,7 @@ void DgmOctree::getCellDistanceFromBorders(	const Tuple3i& cellPos,
 		{
 			int b = fillIndexes[3+dim] - cellPos.u[dim];
 			if (b < -neighbourhoodLength)
-				b = -neighbourhoodLength;
+				b = -neighbourhoodLength-1;
 			else if (b > neighbourhoodLength)
 				b = neighbourhoodLength;
 			*_limits++ = b;
@@ -1349,6 +1728,7 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 		//'visitedCellDistance == 0' means that no cell has ever been processed!
 		//No cell should be inside 'minimalCellsSetToVisit'
 		assert(nNSS.minimalCellsSetToVisit.empty());
+		nNSS.visitedCellsPoints.reset(this, nNSS.level, nNSS.cellPos);
 
 		//check for existence of an 'including' cell
 		CellCode truncatedCellCode = GenerateTruncatedCellCode(nNSS.cellPos, nNSS.level);
@@ -1421,6 +1801,10 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 
 	//Min (squared) distance of neighbours
 	double minSquareDist = -1.0;
+	//same value in single precision (used by the vectorized kernels)
+	PointCoordinateType minSquareDistf = FLT_MAX;
+	//query point coordinates
+	const PointCoordinateType Q[3] = { nNSS.queryPoint.x, nNSS.queryPoint.y, nNSS.queryPoint.z };
 
 	while (true)
 	{
@@ -1439,31 +1823,77 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 			++nNSS.alreadyVisitedNeighbourhoodSize;
 		}
 
-		//we compute distances for the new points
-		DgmOctree::cellIndexesContainer::const_iterator q;
-		for (q = nNSS.minimalCellsSetToVisit.begin()+alreadyProcessedCells; q != nNSS.minimalCellsSetToVisit.end(); ++q)
+		//we gather the coordinates of the points of the new cells (once and for all)
+		NearestNeighboursSearchStruct::VisitedCellsPoints& soa = nNSS.visitedCellsPoints;
+		if (!soa.isValidFor(this, nNSS.level, nNSS.cellPos, nNSS.minimalCellsSetToVisit))
+		{
+			//the query cell or the set of visited cells has been changed by the caller
+			soa.reset(this, nNSS.level, nNSS.cellPos);
+		}
+		for (size_t c = soa.cells.size(); c < nNSS.minimalCellsSetToVisit.size(); ++c)
 		{
 			//current cell index (== index of its first point)
-			unsigned m = *q;
+			unsigned m = nNSS.minimalCellsSetToVisit[c];
+
+			NearestNeighboursSearchStruct::VisitedCellsPoints::Cell cellDesc;
+			cellDesc.cellIndex = m;
+			cellDesc.firstPoint = static_cast<unsigned>(soa.indexes.size());
 
-			//we scan the whole cell to see if it contains a closer point
 			cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+m;
 			CellCode code = (p->theCode >> bitDec);
+			cellDesc.bbMin = cellDesc.bbMax = *m_theAssociatedCloud->getPointPersistentPtr(p->theIndex);
 			while (m < m_numberOfProjectedPoints && (p->theCode >> bitDec) == code)
 			{
-				//square distance to query point
-				double dist2 = (*m_theAssociatedCloud->getPointPersistentPtr(p->theIndex) - nNSS.queryPoint).norm2d();
-				//we keep track of the closest one
-				if (dist2 < minSquareDist || minSquareDist < 0)
+				const CCVector3* P = m_theAssociatedCloud->getPointPersistentPtr(p->theIndex);
+				soa.x.push_back(P->x);
+				soa.y.push_back(P->y);
+				soa.z.push_back(P->z);
+				soa.indexes.push_back(p->theIndex);
+				for (unsigned char d = 0; d < 3; ++d)
 				{
-					nNSS.theNearestPointIndex = p->theIndex;
-					minSquareDist = dist2;
-					if (dist2 == 0) //no need to process any further
-						break;
+					if (P->u[d] < cellDesc.bbMin.u[d])
+						cellDesc.bbMin.u[d] = P->u[d];
+					else if (P->u[d] > cellDesc.bbMax.u[d])
+						cellDesc.bbMax.u[d] = P->u[d];
 				}
 				++m;
 				++p;
 			}
+
+			cellDesc.pointCount = static_cast<unsigned>(soa.indexes.size()) - cellDesc.firstPoint;
+			soa.cells.push_back(cellDesc);
+		}
+
+		//we compute distances for the new points
+		for (size_t c = alreadyProcessedCells; c < soa.cells.size() && minSquareDistf != 0; ++c)
+		{
+			const NearestNeighboursSearchStruct::VisitedCellsPoints::Cell& cellDesc = soa.cells[c];
+
+			//early rejection: the cell bounding-box is farther than the current nearest point
+			if (minSquareDist >= 0)
+			{
+				PointCoordinateType boxDist2 = 0;
+				for (unsigned char d = 0; d < 3; ++d)
+				{
+					PointCoordinateType delta = 0;
+					if (Q[d] < cellDesc.bbMin.u[d])
+						delta = cellDesc.bbMin.u[d] - Q[d];
+					else if (Q[d] > cellDesc.bbMax.u[d])
+						delta = Q[d] - cellDesc.bbMax.u[d];
+					boxDist2 += delta*delta;
+				}
+				if (boxDist2 > minSquareDistf)
+					continue;
+			}
+
+			unsigned first = cellDesc.firstPoint;
+			unsigned closest = NearestPointKernels::FindClosest(&soa.x[first], &soa.y[first], &soa.z[first], cellDesc.pointCount, Q, minSquareDistf);
+			if (closest < cellDesc.pointCount)
+			{
+				//we keep track of the closest one (its distance is recomputed in double precision)
+				nNSS.theNearestPointIndex = soa.indexes[first + closest];
+				minSquareDist = (*m_theAssociatedCloud->getPointPersistentPtr(nNSS.theNearestPointIndex) - nNSS.queryPoint).norm2d();
+			}
 		}
 		alreadyProcessedCells = static_cast<unsigned>(nNSS.minimalCellsSetToVisit.size());
 
@@ -2386,6 +2816,301 @@ int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSpherical
 	return numberOfEligiblePoints;
 }
 
+bool DgmOctree::findNearestNeighborsBatch(	const CCVector3* queryPoints,
+											unsigned queryCount,
+											unsigned k,
+											BatchNeighbours& result,
+											unsigned char level/*=0*/,
+											double maxSearchDist/*=0*/,
+											int maxThreadCount/*=0*/,
+											GenericProgressCallback* progressCb/*=0*/) const
+{
+	if (k == 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	if (level == 0)
+	{
+		level = findBestLevelForAGivenPopulationPerCell(std::max(k, 3u));
+	}
+
+	return findNeighborsBatch(queryPoints, queryCount, k, 0, result, level, maxSearchDist, maxThreadCount, progressCb);
+}
+
+bool DgmOctree::findNeighborsInASphereBatch(const CCVector3* queryPoints,
+											unsigned queryCount,
+											PointCoordinateType radius,
+											BatchNeighbours& result,
+											unsigned char level/*=0*/,
+											int maxThreadCount/*=0*/,
+											GenericProgressCallback* progressCb/*=0*/) const
+{
+	if (radius <= 0)
+	{
+		assert(false);
+		return false;
+	}
+
+	if (level == 0)
+	{
+		level = findBestLevelForAGivenNeighbourhoodSizeExtraction(radius);
+	}
+
+	return findNeighborsBatch(queryPoints, queryCount, 0, radius, result, level, 0, maxThreadCount, progressCb);
+}
+
+//! Query point reference (for the batched neighbours search)
+struct BatchQuery
+{
+	//! Truncated code of the cell including the query point (or INVALID_CELL_CODE if it's outside the octree)
+	DgmOctree::CellCode cellCode;
+	//! Query point index
+	unsigned index;
+
+	//! Sorting operator (by cell, then by index)
+	inline bool operator < (const BatchQuery& other) const
+	{
+		return cellCode < other.cellCode || (cellCode == other.cellCode && index < other.index);
+	}
+};
+
+//! Neighbours found for a group of query points (lying in the same cell)
+struct BatchGroupOutput
+{
+	//! Index of the first query of the group (in the sorted queries array)
+	unsigned firstQuery;
+	//! Number of queries in the group
+	unsigned queryCount;
+	//! Neighbours indexes (for all the queries of the group, in the sorted order)
+	std::vector<unsigned> indexes;
+	//! Neighbours square distances
+	std::vector<ScalarType> squareDistances;
+};
+
+bool DgmOctree::findNeighborsBatch(	const CCVector3* queryPoints,
+									unsigned queryCount,
+									unsigned k,
+									PointCoordinateType radius,
+									BatchNeighbours& result,
+									unsigned char level,
+									double maxSearchDist,
+									int maxThreadCount,
+									GenericProgressCallback* progressCb) const
+{
+	result.clear();
+
+	if (!queryPoints && queryCount != 0)
+	{
+		assert(false);
+		return false;
+	}
+	if (level == 0 || level > MAX_OCTREE_LEVEL || m_numberOfProjectedPoints == 0)
+	{
+		return false;
+	}
+
+	//we group the query points by cell
+	std::vector<BatchQuery> queries;
+	std::vector<BatchGroupOutput> groups;
+	try
+	{
+		result.offsets.resize(static_cast<size_t>(queryCount) + 1, 0);
+		queries.resize(queryCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	ParallelTools::ForEach(	queryCount,
+							[&](unsigned i)
+							{
+								Tuple3i cellPos;
+								bool inBounds = false;
+								getTheCellPosWhichIncludesThePoint(queryPoints + i, cellPos, level, inBounds);
+								queries[i].cellCode = (inBounds ? GenerateTruncatedCellCode(cellPos, level) : INVALID_CELL_CODE);
+								queries[i].index = i;
+							},
+							maxThreadCount);
+
+	SortAlgo(queries.begin(), queries.end());
+
+	try
+	{
+		for (unsigned i = 0; i < queryCount; )
+		{
+			BatchGroupOutput group;
+			group.firstQuery = i;
+			group.queryCount = 1;
+			//points outside of the octree are processed one by one
+			if (queries[i].cellCode != INVALID_CELL_CODE)
+			{
+				while (i + group.queryCount < queryCount && queries[i + group.queryCount].cellCode == queries[i].cellCode)
+					++group.queryCount;
+			}
+			i += group.queryCount;
+			groups.push_back(group);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	//progress notification (optional)
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Neighbours search");
+			char infosBuffer[256];
+			sprintf(infosBuffer, "Query points: %u\nCells: %u\nLevel: %i", queryCount, static_cast<unsigned>(groups.size()), static_cast<int>(level));
+			progressCb->setInfo(infosBuffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+	NormalizedProgress nprogress(progressCb, queryCount);
+
+	double maxSearchSquareDist = (maxSearchDist > 0 ? maxSearchDist * maxSearchDist : 0);
+	PointCoordinateType cellSize = getCellSize(level);
+	ParallelCancelToken cancelToken;
+
+	//each group is processed independently
+	ParallelTools::ForEach(	static_cast<unsigned>(groups.size()),
+							[&](unsigned g)
+							{
+								BatchGroupOutput& group = groups[g];
+
+								//the search structure (and the neighbour cells points) is shared by all the queries of the group
+								NearestNeighboursSphericalSearchStruct nNSS;
+								nNSS.level = level;
+								nNSS.minNumberOfNeighbors = k;
+								nNSS.maxSearchSquareDistd = maxSearchSquareDist;
+								if (k == 0)
+								{
+									nNSS.prepare(radius, cellSize);
+								}
+								bool inBounds = false;
+								getTheCellPosWhichIncludesThePoint(queryPoints + queries[group.firstQuery].index, nNSS.cellPos, level, inBounds);
+								computeCellCenter(nNSS.cellPos, level, nNSS.cellCenter);
+								nNSS.alreadyVisitedNeighbourhoodSize = (inBounds ? 0 : 1);
+
+								try
+								{
+									if (k != 0)
+									{
+										group.indexes.reserve(static_cast<size_t>(group.queryCount) * k);
+										group.squareDistances.reserve(static_cast<size_t>(group.queryCount) * k);
+									}
+
+									for (unsigned j = 0; j < group.queryCount; ++j)
+									{
+										const BatchQuery& query = queries[group.firstQuery + j];
+										nNSS.queryPoint = queryPoints[query.index];
+
+										unsigned neighbourCount = 0;
+										if (k != 0)
+										{
+											neighbourCount = std::min(findNearestNeighborsStartingFromCell(nNSS), k);
+											//the farthest neighbours may be beyond the search limit
+											if (maxSearchSquareDist > 0)
+											{
+												while (neighbourCount != 0 && nNSS.pointsInNeighbourhood[neighbourCount - 1].squareDistd > maxSearchSquareDist)
+													--neighbourCount;
+											}
+										}
+										else
+										{
+											neighbourCount = static_cast<unsigned>(findNeighborsInASphereStartingFromCell(nNSS, radius, true));
+										}
+
+										for (unsigned n = 0; n < neighbourCount; ++n)
+										{
+											const PointDescriptor& P = nNSS.pointsInNeighbourhood[n];
+											group.indexes.push_back(P.pointIndex);
+											group.squareDistances.push_back(static_cast<ScalarType>(P.squareDistd));
+										}
+										result.offsets[query.index + 1] = neighbourCount;
+
+										if (!nprogress.oneStep())
+										{
+											//process cancelled by the user
+											cancelToken.cancel();
+											return;
+										}
+									}
+								}
+								catch (const std::bad_alloc&)
+								{
+									//not enough memory
+									cancelToken.cancel();
+								}
+							},
+							maxThreadCount,
+							&cancelToken,
+							1);
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	if (cancelToken.isCanceled())
+	{
+		result.clear();
+		return false;
+	}
+
+	//offsets (prefix sum of the neighbours counts)
+	for (unsigned i = 0; i < queryCount; ++i)
+	{
+		result.offsets[i + 1] += result.offsets[i];
+	}
+
+	try
+	{
+		result.indexes.resize(result.offsets.back());
+		result.squareDistances.resize(result.offsets.back());
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		result.clear();
+		return false;
+	}
+
+	//we copy the neighbours of each group at their final position
+	ParallelTools::ForEach(	static_cast<unsigned>(groups.size()),
+							[&](unsigned g)
+							{
+								BatchGroupOutput& group = groups[g];
+								size_t pos = 0;
+								for (unsigned j = 0; j < group.queryCount; ++j)
+								{
+									unsigned queryIndex = queries[group.firstQuery + j].index;
+									unsigned first = result.offsets[queryIndex];
+									unsigned count = result.offsets[queryIndex + 1] - first;
+									if (count != 0)
+									{
+										std::copy(group.indexes.begin() + pos, group.indexes.begin() + pos + count, result.indexes.begin() + first);
+										std::copy(group.squareDistances.begin() + pos, group.squareDistances.begin() + pos + count, result.squareDistances.begin() + first);
+										pos += count;
+									}
+								}
+								//release memory asap
+								std::vector<unsigned>().swap(group.indexes);
+								std::vector<ScalarType>().swap(group.squareDistances);
+							},
+							maxThreadCount);
+
+	return true;
+}
+
 unsigned char DgmOctree::findBestLevelForAGivenNeighbourhoodSizeExtraction(PointCoordinateType radius) const
 {
 	static const PointCoordinateType c_neighbourhoodSizeExtractionFactor = static_cast<PointCoordinateType>(2.5);
@@ -3220,10 +3945,6 @@ DgmOctree::octreeCell::~octreeCell()
 
 #ifdef ENABLE_MT_OCTREE
 
-#include <QtCore>
-#include <QApplication>
-#include <QtConcurrentMap>
-#include <QThreadPool>
 
 /*** FOR THE MULTI THREADING WRAPPER ***/
 struct octreeCellDesc
@@ -3233,63 +3954,78 @@ struct octreeCellDesc
 	unsigned char level;
 };
 
-static DgmOctree* s_octree_MT = 0;
-static DgmOctree::octreeCellFunc s_func_MT = 0;
-static void** s_userParams_MT = 0;
-static GenericProgressCallback* s_progressCb_MT = 0;
-static NormalizedProgress* s_normProgressCb_MT = 0;
-static bool s_cellFunc_MT_success = true;
-
-void LaunchOctreeCellFunc_MT(const octreeCellDesc& desc)
+//! Per-job state of a multi-threaded octree traversal
+/** Each call to executeFunctionForAllCellsAtLevel or executeFunctionForAllCellsStartingAtLevel
+	owns its own instance, so that several traversals (on the same octree or not) can run
+	concurrently from different threads.
+**/
+struct MultiThreadingWrapper
 {
-	//skip cell if process is aborted/has failed
-	if (!s_cellFunc_MT_success)
+	DgmOctree* octree;
+	DgmOctree::octreeCellFunc cellFunc;
+	void** userParams;
+	GenericProgressCallback* progressCb;
+	NormalizedProgress* normProgressCb;
+	ParallelCancelToken cancelToken;
+
+	MultiThreadingWrapper(DgmOctree* _octree, DgmOctree::octreeCellFunc _cellFunc, void** _userParams)
+		: octree(_octree)
+		, cellFunc(_cellFunc)
+		, userParams(_userParams)
+		, progressCb(0)
+		, normProgressCb(0)
+	{}
+
+	~MultiThreadingWrapper()
 	{
-		return;
+		if (normProgressCb)
+			delete normProgressCb;
 	}
 
-	const DgmOctree::cellsContainer& pointsAndCodes = s_octree_MT->pointsAndTheirCellCodes();
+	inline bool success() const { return !cancelToken.isCanceled(); }
 
-	//cell descriptor
-	DgmOctree::octreeCell cell(s_octree_MT);
-	cell.level = desc.level;
-	cell.index = desc.i1;
-	cell.truncatedCode = desc.truncatedCode;
-	if (cell.points->reserve(desc.i2 - desc.i1 + 1))
+	void launchOctreeCellFunc(const octreeCellDesc& desc)
 	{
-		for (unsigned i = desc.i1; i <= desc.i2; ++i)
+		//skip cell if process is aborted/has failed
+		if (!success())
 		{
-			cell.points->addPointIndex(pointsAndCodes[i].theIndex);
+			return;
 		}
 
-		s_cellFunc_MT_success &= (*s_func_MT)(cell, s_userParams_MT, s_normProgressCb_MT);
-	}
-	else
-	{
-		s_cellFunc_MT_success = false;
-	}
+		const DgmOctree::cellsContainer& pointsAndCodes = octree->pointsAndTheirCellCodes();
 
-	if (!s_cellFunc_MT_success)
-	{
-		//TODO: display a message to make clear that the cancel order has been acknowledged!
-		if (s_progressCb_MT)
+		//cell descriptor
+		DgmOctree::octreeCell cell(octree);
+		cell.level = desc.level;
+		cell.index = desc.i1;
+		cell.truncatedCode = desc.truncatedCode;
+
+		bool result = false;
+		if (cell.points->reserve(desc.i2 - desc.i1 + 1))
 		{
-			if (s_progressCb_MT->textCanBeEdited())
+			for (unsigned i = desc.i1; i <= desc.i2; ++i)
 			{
-				s_progressCb_MT->setInfo("Cancelling...");
+				cell.points->addPointIndex(pointsAndCodes[i].theIndex);
 			}
+
+			result = (*cellFunc)(cell, userParams, normProgressCb);
 		}
 
-		//if (s_normProgressCb_MT)
-		//{
-		//	if (!s_normProgressCb_MT->oneStep())
-		//	{
-		//		s_cellFunc_MT_success = false;
-		//		return;
-		//	}
-		//}
+		if (!result)
+		{
+			//only the first failing cell notifies the user
+			if (success())
+			{
+				cancelToken.cancel();
+				//TODO: display a message to make clear that the cancel order has been acknowledged!
+				if (progressCb && progressCb->textCanBeEdited())
+				{
+					progressCb->setInfo("Cancelling...");
+				}
+			}
+		}
 	}
-}
+};
 
 #endif
 
@@ -3306,7 +4042,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 
 #ifdef ENABLE_MT_OCTREE
 
-	//cells that will be processed by QtConcurrent::map
+	//cells that will be processed by ParallelTools::ForEach
 	const unsigned cellsNumber = getCellNumber(level);
 	std::vector<octreeCellDesc> cells;
 
@@ -3465,17 +4201,9 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 		//don't forget the last cell!
 		cells.push_back(cellDesc);
 
-		//static wrap
-		s_octree_MT = this;
-		s_func_MT = func;
-		s_userParams_MT = additionalParameters;
-		s_cellFunc_MT_success = true;
-		s_progressCb_MT = progressCb;
-		if (s_normProgressCb_MT)
-		{
-			delete s_normProgressCb_MT;
-			s_normProgressCb_MT = 0;
-		}
+		//per-job wrapper (no static state: several jobs may run concurrently)
+		MultiThreadingWrapper job(this, func, additionalParameters);
+		job.progressCb = progressCb;
 
 		//progress notification
 		if (progressCb)
@@ -3491,7 +4219,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 				progressCb->setInfo(buffer);
 			}
 			progressCb->update(0);
-			s_normProgressCb_MT = new NormalizedProgress(progressCb,m_theAssociatedCloud->size());
+			job.normProgressCb = new NormalizedProgress(progressCb, m_theAssociatedCloud->size());
 			progressCb->start();
 		}
 
@@ -3502,12 +4230,12 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 		s_binarySearchCount = 0.0;
 #endif
 
-		if (maxThreadCount == 0)
-		{
-			maxThreadCount = QThread::idealThreadCount();
-		}
-		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-		QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+		//each job has its own thread pool (and thread limit)
+		ParallelTools::ForEach(	static_cast<unsigned>(cells.size()),
+								[&job, &cells](unsigned i) { job.launchOctreeCellFunc(cells[i]); },
+								maxThreadCount,
+								&job.cancelToken,
+								1);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 		FILE* fp = fopen("octree_log.txt", "at");
@@ -3524,21 +4252,13 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 		}
 #endif
 
-		s_octree_MT = 0;
-		s_func_MT = 0;
-		s_userParams_MT = 0;
-
 		if (progressCb)
 		{
 			progressCb->stop();
-			if (s_normProgressCb_MT)
-				delete s_normProgressCb_MT;
-			s_normProgressCb_MT = 0;
-			s_progressCb_MT = 0;
 		}
 
 		//if something went wrong, we clear everything and return 0!
-		if (!s_cellFunc_MT_success)
+		if (!job.success())
 			cells.clear();
 
 		return static_cast<unsigned>(cells.size());
@@ -3567,7 +4287,7 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 
 #ifdef ENABLE_MT_OCTREE
 
-	//cells that will be processed by QtConcurrent::map
+	//cells that will be processed by ParallelTools::ForEach
 	std::vector<octreeCellDesc> cells;
 	if (multiThread)
 	{
@@ -4014,14 +4734,9 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 		double mean = static_cast<double>(popSum) / cells.size();
 		double stddev = sqrt(static_cast<double>(popSum2 - popSum*popSum)) / cells.size();
 
-		//static wrap
-		s_octree_MT = this;
-		s_func_MT = func;
-		s_userParams_MT = additionalParameters;
-		s_cellFunc_MT_success = true;
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = 0;
+		//per-job wrapper (no static state: several jobs may run concurrently)
+		MultiThreadingWrapper job(this, func, additionalParameters);
+		job.progressCb = progressCb;
 
 		//progress notification
 		if (progressCb)
@@ -4036,11 +4751,7 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 				sprintf(buffer, "Octree levels %i - %i\nCells: %i\nAverage population: %3.2f (+/-%3.2f)\nMax population: %llu", startingLevel, MAX_OCTREE_LEVEL, static_cast<int>(cells.size()), mean, stddev, maxPop);
 				progressCb->setInfo(buffer);
 			}
-			if (s_normProgressCb_MT)
-			{
-				delete s_normProgressCb_MT;
-			}
-			s_normProgressCb_MT = new NormalizedProgress(progressCb,static_cast<unsigned>(cells.size()));
+			job.normProgressCb = new NormalizedProgress(progressCb, static_cast<unsigned>(cells.size()));
 			progressCb->update(0);
 			progressCb->start();
 		}
@@ -4052,12 +4763,12 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 		s_binarySearchCount = 0.0;
 #endif
 
-		if (maxThreadCount == 0)
-		{
-			maxThreadCount = QThread::idealThreadCount();
-		}
-		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-		QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+		//each job has its own thread pool (and thread limit)
+		ParallelTools::ForEach(	static_cast<unsigned>(cells.size()),
+								[&job, &cells](unsigned i) { job.launchOctreeCellFunc(cells[i]); },
+								maxThreadCount,
+								&job.cancelToken,
+								1);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 		FILE* fp=fopen("octree_log.txt","at");
@@ -4074,20 +4785,13 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 		}
 #endif
 
-		s_octree_MT = 0;
-		s_func_MT = 0;
-		s_userParams_MT = 0;
-
 		if (progressCb)
 		{
 			progressCb->stop();
-			if (s_normProgressCb_MT)
-				delete s_normProgressCb_MT;
-			s_normProgressCb_MT = 0;
 		}
 
 		//if something went wrong, we clear everything and return 0!
-		if (!s_cellFunc_MT_success)
+		if (!job.success())
 			cells.clear();
 
 		return static_cast<unsigned>(cells.size());
@@ -4129,14 +4833,6 @@ bool DgmOctree::rayCast(const CCVector3& rayAxis,
 	//no need to go too deep
 	const unsigned char maxLevel = findBestLevelForAGivenPopulationPerCell(10);
 
-	//starting level of subdivision
-	unsigned char level = 1;
-	//binary shift for cell code truncation at current level
-	unsigned char currentBitDec = GET_BIT_SHIFT(level);
-	//current cell code
-	CellCode currentCode = INVALID_CELL_CODE;
-	//whether the current cell should be skipped or not
-	bool skipThisCell = false;
 	//smallest FOV (i.e. nearest point)
 	double smallestOrderDist = -1.0;
 
@@ -4147,74 +4843,73 @@ bool DgmOctree::rayCast(const CCVector3& rayAxis,
 	//ray with origin expressed in the local coordinate system!
 	Ray<PointCoordinateType> rayLocal(rayAxis, rayOrigin - m_dimMin);
 
-	//let's sweep through the octree
-	for (cellsContainer::const_iterator it = m_thePointsAndTheirCellCodes.begin(); it != m_thePointsAndTheirCellCodes.end(); ++it)
+	//let's sweep through the octree (only the cells intersecting the ray are visited)
+	cellsContainer::const_iterator it = m_thePointsAndTheirCellCodes.begin();
+	CellCode previousCode = INVALID_CELL_CODE;
+	while (it != m_thePointsAndTheirCellCodes.end())
 	{
-		CellCode truncatedCode = (it->theCode >> currentBitDec);
-		
-		//new cell?
-		if (truncatedCode != (currentCode >> currentBitDec))
+		//the (accepted) parent cells shared with the previous cell don't need to be tested again
+		unsigned char level = 1;
+		if (previousCode != INVALID_CELL_CODE)
 		{
-			//look for the biggest 'parent' cell that englobes this cell and the previous one (if any)
-			while (level > 1)
-			{
-				unsigned char bitDec = GET_BIT_SHIFT(level-1);
-				if ((it->theCode >> bitDec) == (currentCode >> bitDec))
-				{
-					//same parent cell, we can stop here
-					break;
-				}
-				--level;
-			}
+			while (level < maxLevel && (it->theCode >> GET_BIT_SHIFT(level)) == (previousCode >> GET_BIT_SHIFT(level)))
+				++level;
+		}
+		previousCode = it->theCode;
 
-			currentCode = it->theCode;
+		//now try to go deeper with the new cell
+		bool skipThisCell = false;
+		for (; level < maxLevel; ++level)
+		{
+			Tuple3i cellPos;
+			getCellPos(it->theCode, level, cellPos, false);
 
-			//now try to go deeper with the new cell
-			while (level < maxLevel)
-			{
-				Tuple3i cellPos;
-				getCellPos(it->theCode, level, cellPos, false);
+			//first test with the total bounding box
+			const PointCoordinateType& halfCellSize = getCellSize(level) / 2;
+			CCVector3 cellCenter(	(2* cellPos.x + 1) * halfCellSize,
+									(2* cellPos.y + 1) * halfCellSize,
+									(2* cellPos.z + 1) * halfCellSize);
 
-				//first test with the total bounding box
-				const PointCoordinateType& halfCellSize = getCellSize(level) / 2;
-				CCVector3 cellCenter(	(2* cellPos.x + 1) * halfCellSize,
-										(2* cellPos.y + 1) * halfCellSize,
-										(2* cellPos.z + 1) * halfCellSize);
+			CCVector3 halfCell = CCVector3(halfCellSize, halfCellSize, halfCellSize);
 
-				CCVector3 halfCell = CCVector3(halfCellSize, halfCellSize, halfCellSize);
+			if (isFOV)
+			{
+				double radialSqDist, sqDistToOrigin;
+				rayLocal.squareDistances(cellCenter, radialSqDist, sqDistToOrigin);
 
-				if (isFOV)
-				{
-					double radialSqDist, sqDistToOrigin;
-					rayLocal.squareDistances(cellCenter, radialSqDist, sqDistToOrigin);
+				double dx = sqrt(sqDistToOrigin);
+				double dy = std::max<double>(0, sqrt(radialSqDist) - SQRT_3 * halfCellSize);
+				double fov_rad = atan2(dy, dx);
 
-					double dx = sqrt(sqDistToOrigin);
-					double dy = std::max<double>(0, sqrt(radialSqDist) - SQRT_3 * halfCellSize);
-					double fov_rad = atan2(dy, dx);
+				skipThisCell = (fov_rad > maxRadiusOrFov);
+			}
+			else
+			{
+				skipThisCell = !AABB<PointCoordinateType>(	cellCenter - halfCell - margin,
+															cellCenter + halfCell + margin).intersects(rayLocal);
+			}
 
-					skipThisCell = (fov_rad > maxRadiusOrFov);
-				}
-				else
-				{
-					skipThisCell = !AABB<PointCoordinateType>(	cellCenter - halfCell - margin,
-																cellCenter + halfCell + margin).intersects(rayLocal);
-				}
+			if (skipThisCell)
+				break;
+		}
 
-				if (skipThisCell)
-					break;
-				else
-					++level;
-			}
-			currentBitDec = GET_BIT_SHIFT(level);
+		//we jump to the first point after this cell (at the current level)
+		unsigned char bitDec = GET_BIT_SHIFT(level);
+		IndexAndCode nextCell(0, ((it->theCode >> bitDec) + 1) << bitDec);
+		cellsContainer::const_iterator cellEnd = std::lower_bound(it, m_thePointsAndTheirCellCodes.end(), nextCell, IndexAndCode::codeComp);
+
+		if (skipThisCell)
+		{
+			it = cellEnd;
+			continue;
 		}
 
+		//test the points of the cell
+		for (; it != cellEnd; ++it)
+		{
 #ifdef QT_DEBUG
-		m_theAssociatedCloud->setPointScalarValue(it->theIndex, level);
+			m_theAssociatedCloud->setPointScalarValue(it->theIndex, level);
 #endif
-
-		if (!skipThisCell)
-		{
-			//test the point
 			const CCVector3* P = m_theAssociatedCloud->getPoint(it->theIndex);
 
 			double radialSqDist = ray.radialSquareDistance(*P);
@@ -4227,17 +4922,10 @@ bool DgmOctree::rayCast(const CCVector3& rayAxis,
 				double fov_rad = atan2(sqrt(radialSqDist), sqrt(sqDist));
 				isElligible = (fov_rad <= maxRadiusOrFov);
 				orderDist = fov_rad;
-#ifdef QT_DEBUG
-				//m_theAssociatedCloud->setPointScalarValue(it->theIndex, fov_rad);
-				//m_theAssociatedCloud->setPointScalarValue(it->theIndex, sqrt(sqDist));
-#endif
 			}
 			else
 			{
 				isElligible = (radialSqDist <= maxSqRadius);
-#ifdef QT_DEBUG
-				//m_theAssociatedCloud->setPointScalarValue(it->theIndex, sqrt(radialSqDist));
-#endif
 			}
 
 			if (isElligible)
@@ -26,8 +26,10 @@
 #include "FastMarchingForPropagation.h"
 #include "ScalarFieldTools.h"
 #include "LocalModel.h"
+#include "ParallelTools.h"
 #include "SimpleTriangle.h"
 #include "ScalarField.h"
+#include "TriangleBVH.h"
 
 //system
 #include <assert.h>
@@ -1078,40 +1080,57 @@ int ComputeMaxNeighborhoodLength(ScalarType maxSearchDist, PointCoordinateType c
 
 #ifdef ENABLE_CLOUD2MESH_DIST_MT
 
-#include <QtCore>
-#include <QApplication>
-#include <QtConcurrentMap>
+#include <QMutex>
 
-/*** MULTI THREADING WRAPPER ***/
+//system
+#include <atomic>
 
-static DgmOctree* s_octree_MT = 0;
-static NormalizedProgress* s_normProgressCb_MT = 0;
-static OctreeAndMeshIntersection* s_intersection_MT = 0;
-static bool s_cellFunc_MT_success = true;
-static CCLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams s_params_MT;
+/*** MULTI THREADING WRAPPER ***/
 
 //'processTriangles' mechanism (based on bit mask)
 #include <QtCore/QBitArray>
-static std::vector<QBitArray*> s_bitArrayPool_MT;
-static bool s_useBitArrays_MT = true;
-static QMutex s_currentBitMaskMutex;
 
-void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
+//! Shared state of a multi-threaded cloud-to-mesh distances computation
+/** One instance per call (so that several computations can run at the same time).
+**/
+struct Cloud2MeshDistContext_MT
 {
-	if (!s_cellFunc_MT_success)
+	Cloud2MeshDistContext_MT()
+		: octree(0)
+		, normProgressCb(0)
+		, intersection(0)
+		, success(true)
+		, useBitArrays(true)
+	{}
+
+	DgmOctree* octree;
+	NormalizedProgress* normProgressCb;
+	OctreeAndMeshIntersection* intersection;
+	std::atomic<bool> success;
+	CCLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams params;
+
+	//'processTriangles' mechanism (based on bit mask)
+	std::vector<QBitArray*> bitArrayPool;
+	bool useBitArrays;
+	QMutex bitMaskMutex;
+};
+
+void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc, Cloud2MeshDistContext_MT& context)
+{
+	if (!context.success)
 	{
 		//skip this cell if the process is aborted / has failed
 		return;
 	}
 
-	if (s_normProgressCb_MT && !s_normProgressCb_MT->oneStep())
+	if (context.normProgressCb && !context.normProgressCb->oneStep())
 	{
-		s_cellFunc_MT_success = false;
+		context.success = false;
 		return;
 	}
 
-	ReferenceCloud Yk(s_octree_MT->associatedCloud());
-	s_octree_MT->getPointsInCellByCellIndex(&Yk, desc.theIndex, s_params_MT.octreeLevel);
+	ReferenceCloud Yk(context.octree->associatedCloud());
+	context.octree->getPointsInCellByCellIndex(&Yk, desc.theIndex, context.params.octreeLevel);
 
 	//min distance array
 	unsigned remainingPoints = Yk.size();
@@ -1124,18 +1143,18 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 	catch (const std::bad_alloc&)
 	{
 		//not enough memory
-		s_cellFunc_MT_success = false;
+		context.success = false;
 		return;
 	}
 
 	//get cell pos
 	Tuple3i startPos;
-	s_octree_MT->getCellPos(desc.theCode, s_params_MT.octreeLevel, startPos, true);
+	context.octree->getCellPos(desc.theCode, context.params.octreeLevel, startPos, true);
 
 	//get the distance to the nearest and farthest boundaries
 	int maxDistToBoundaries = 0;
-	Tuple3i distToLowerBorder = startPos - s_intersection_MT->minFillIndexes;
-	Tuple3i distToUpperBorder = s_intersection_MT->maxFillIndexes - startPos;
+	Tuple3i distToLowerBorder = startPos - context.intersection->minFillIndexes;
+	Tuple3i distToUpperBorder = context.intersection->maxFillIndexes - startPos;
 	for (unsigned k = 0; k<3; ++k)
 	{
 		maxDistToBoundaries = std::max(maxDistToBoundaries, distToLowerBorder.u[k]);
@@ -1143,18 +1162,18 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 	}
 	int maxIntDist = maxDistToBoundaries;
 
-	if (s_params_MT.maxSearchDist > 0)
+	if (context.params.maxSearchDist > 0)
 	{
 		//no need to look farther than 'maxNeighbourhoodLength'
-		int maxNeighbourhoodLength = ComputeMaxNeighborhoodLength(s_params_MT.maxSearchDist, s_octree_MT->getCellSize(s_params_MT.octreeLevel));
+		int maxNeighbourhoodLength = ComputeMaxNeighborhoodLength(context.params.maxSearchDist, context.octree->getCellSize(context.params.octreeLevel));
 		if (maxNeighbourhoodLength < maxIntDist)
 			maxIntDist = maxNeighbourhoodLength;
 
-		ScalarType maxDistance = s_params_MT.maxSearchDist;
-		if (!s_params_MT.signedDistances)
+		ScalarType maxDistance = context.params.maxSearchDist;
+		if (!context.params.signedDistances)
 		{
 			//we compute squared distances when not in 'signed' mode!
-			maxDistance = s_params_MT.maxSearchDist*s_params_MT.maxSearchDist;
+			maxDistance = context.params.maxSearchDist*context.params.maxSearchDist;
 		}
 
 		for (unsigned j = 0; j < remainingPoints; ++j)
@@ -1163,13 +1182,13 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 
 	//determine the cell center
 	CCVector3 cellCenter;
-	s_octree_MT->computeCellCenter(startPos, s_params_MT.octreeLevel, cellCenter);
+	context.octree->computeCellCenter(startPos, context.params.octreeLevel, cellCenter);
 
 	//express 'startPos' relatively to the grid borders
-	startPos -= s_intersection_MT->minFillIndexes;
+	startPos -= context.intersection->minFillIndexes;
 
 	//octree cell size
-	const PointCoordinateType& cellLength = s_octree_MT->getCellSize(s_params_MT.octreeLevel);
+	const PointCoordinateType& cellLength = context.octree->getCellSize(context.params.octreeLevel);
 
 	//useful variables
 	std::vector<unsigned> trianglesToTest;
@@ -1178,21 +1197,21 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 
 	//bit mask for efficient comparisons
 	QBitArray* bitArray = 0;
-	if (s_useBitArrays_MT)
+	if (context.useBitArrays)
 	{
-		s_currentBitMaskMutex.lock();
-		if (s_bitArrayPool_MT.empty())
+		context.bitMaskMutex.lock();
+		if (context.bitArrayPool.empty())
 		{
 			bitArray = new QBitArray();
-			bitArray->resize(s_intersection_MT->mesh->size());
-			//s_bitArrayPool_MT.push_back(bitArray);
+			bitArray->resize(context.intersection->mesh->size());
+			//context.bitArrayPool.push_back(bitArray);
 		}
 		else
 		{
-			bitArray = s_bitArrayPool_MT.back();
-			s_bitArrayPool_MT.pop_back();
+			bitArray = context.bitArrayPool.back();
+			context.bitArrayPool.pop_back();
 		}
-		s_currentBitMaskMutex.unlock();
+		context.bitMaskMutex.unlock();
 		bitArray->fill(0);
 	}
 
@@ -1239,7 +1258,7 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 					{
 						//are there any triangles near this cell?
 						cellPos.z = startPos.z+k;
-						TriangleList* triList = s_intersection_MT->perCellTriangleList.getValue(cellPos);
+						TriangleList* triList = context.intersection->perCellTriangleList.getValue(cellPos);
 						if (triList)
 						{
 							if (trianglesToTestCount + triList->indexes.size() > trianglesToTestCapacity)
@@ -1274,7 +1293,7 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 					{
 						//are there any triangles near this cell?
 						cellPos.z = startPos.z - e;
-						TriangleList* triList = s_intersection_MT->perCellTriangleList.getValue(cellPos);
+						TriangleList* triList = context.intersection->perCellTriangleList.getValue(cellPos);
 						if (triList)
 						{
 							if (trianglesToTestCount + triList->indexes.size() > trianglesToTestCapacity)
@@ -1307,7 +1326,7 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 					{
 						//are there any triangles near this cell?
 						cellPos.z = startPos.z + f;
-						TriangleList* triList = s_intersection_MT->perCellTriangleList.getValue(cellPos);
+						TriangleList* triList = context.intersection->perCellTriangleList.getValue(cellPos);
 						if (triList)
 						{
 							if (trianglesToTestCount + triList->indexes.size() > trianglesToTestCapacity)
@@ -1339,15 +1358,15 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 			}
 		}
 
-		ComparePointsAndTriangles(Yk, remainingPoints, s_intersection_MT->mesh, trianglesToTest, trianglesToTestCount, minDists, maxRadius, s_params_MT);
+		ComparePointsAndTriangles(Yk, remainingPoints, context.intersection->mesh, trianglesToTest, trianglesToTestCount, minDists, maxRadius, context.params);
 	}
 
 	//release bit mask
 	if (bitArray)
 	{
-		s_currentBitMaskMutex.lock();
-		s_bitArrayPool_MT.push_back(bitArray);
-		s_currentBitMaskMutex.unlock();
+		context.bitMaskMutex.lock();
+		context.bitArrayPool.push_back(bitArray);
+		context.bitMaskMutex.unlock();
 	}
 }
 
@@ -1723,40 +1742,139 @@ int DistanceComputationTools::computeCloud2MeshDistanceWithOctree(	OctreeAndMesh
 			progressCb->start();
 		}
 
-		s_octree_MT = octree;
-		s_normProgressCb_MT = &nProgress;
-		s_cellFunc_MT_success = true;
-		s_params_MT = params;
-		s_intersection_MT = intersection;
+		Cloud2MeshDistContext_MT context;
+		context.octree = octree;
+		context.normProgressCb = &nProgress;
+		context.params = params;
+		context.intersection = intersection;
 		//acceleration structure
-		s_useBitArrays_MT = true;
+		context.useBitArrays = true;
 
 		//Single thread emulation
 		//for (unsigned i=0; i<numberOfCells; ++i)
-		//	cloudMeshDistCellFunc_MT(cellsDescs[i]);
+		//	cloudMeshDistCellFunc_MT(cellsDescs[i], context);
+
+		//the job uses its own thread pool (see ParallelTools)
+		ParallelTools::ForEach(	numberOfCells,
+								[&cellsDescs, &context](unsigned i) { cloudMeshDistCellFunc_MT(cellsDescs[i], context); },
+								params.maxThreadCount,
+								0,
+								1);
 
-		int maxThreadCount = params.maxThreadCount;
-		if (maxThreadCount == 0)
+		//clean acceleration structure
+		while (!context.bitArrayPool.empty())
 		{
-			maxThreadCount = QThread::idealThreadCount();
+			delete context.bitArrayPool.back();
+			context.bitArrayPool.pop_back();
 		}
-		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-		QtConcurrent::blockingMap(cellsDescs, cloudMeshDistCellFunc_MT);
 
-		s_octree_MT = 0;
-		s_normProgressCb_MT = 0;
-		s_intersection_MT = 0;
+		return (context.success ? 0 : -2);
+	}
+#endif
+}
 
-		//clean acceleration structure
-		while (!s_bitArrayPool_MT.empty())
+int DistanceComputationTools::computeCloud2MeshDistanceWithBVH(	GenericIndexedCloudPersist* pointCloud,
+																GenericIndexedMesh* mesh,
+																const Cloud2MeshDistanceComputationParams& params,
+																GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(pointCloud && mesh);
+	assert(!params.CPSet || params.maxSearchDist <= 0);
+
+	//build the triangles hierarchy
+	TriangleBVH bvh;
+	if (!bvh.buildFromMesh(mesh, progressCb))
+	{
+		//not enough memory (or process cancelled by the user)
+		return -1;
+	}
+
+	unsigned pointCount = pointCloud->size();
+
+	//Closest Point Set
+	if (params.CPSet)
+	{
+		//reserve memory for the Closest Point Set
+		if (!params.CPSet->resize(pointCount))
+		{
+			//not enough memory
+			return -1;
+		}
+	}
+
+	//Progress callback
+	NormalizedProgress nProgress(progressCb, pointCount);
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
 		{
-			delete s_bitArrayPool_MT.back();
-			s_bitArrayPool_MT.pop_back();
+			char buffer[256];
+			sprintf(buffer, "Points: %u", pointCount);
+			progressCb->setInfo(buffer);
+			progressCb->setMethodTitle(params.signedDistances ? "Compute signed distances" : "Compute distances");
 		}
+		progressCb->update(0);
+		progressCb->start();
+	}
 
-		return (s_cellFunc_MT_success ? 0 : -2);
+	ScalarType maxSquareDist = (params.maxSearchDist > 0 ? params.maxSearchDist * params.maxSearchDist : 0);
+
+	//each point is processed independently (so the job can be parallelized even if maxSearchDist > 0)
+	ParallelCancelToken cancelToken;
+	ParallelTools::ForEach(	pointCount,
+							[&](unsigned i)
+							{
+								CCVector3 P;
+								pointCloud->getPoint(i, P);
+
+								unsigned triIndex = 0;
+								ScalarType squareDist = 0;
+								CCVector3 nearestPoint;
+								if (bvh.findClosestTriangle(P, triIndex, squareDist, maxSquareDist, params.CPSet ? &nearestPoint : 0))
+								{
+									ScalarType dist = 0;
+									if (params.signedDistances)
+									{
+										//the sign is given by the closest triangle normal
+										SimpleTriangle tri;
+										mesh->getTriangleVertices(triIndex, tri.A, tri.B, tri.C);
+										dist = computePoint2TriangleDistance(&P, &tri, true);
+										if (params.flipNormals)
+											dist = -dist;
+									}
+									else
+									{
+										dist = sqrt(squareDist);
+									}
+									pointCloud->setPointScalarValue(i, dist);
+
+									if (params.CPSet)
+									{
+										//Closest Point Set: save the nearest point as well
+										params.CPSet->setPoint(i, nearestPoint);
+									}
+								}
+								else if (maxSquareDist > 0)
+								{
+									//the point is farther than 'maxSearchDist'
+									pointCloud->setPointScalarValue(i, params.maxSearchDist);
+								}
+
+								if (!nProgress.oneStep())
+								{
+									//process cancelled by the user
+									cancelToken.cancel();
+								}
+							},
+							params.multiThread ? params.maxThreadCount : 1,
+							&cancelToken);
+
+	if (progressCb)
+	{
+		progressCb->stop();
 	}
-#endif
+
+	return (cancelToken.isCanceled() ? -2 : 0);
 }
 
 //convert all 'distances' (squared in fact) to their square root
@@ -1791,6 +1909,24 @@ int DistanceComputationTools::computeCloud2MeshDistance(	GenericIndexedCloudPers
 		params.maxSearchDist = 0;
 	}
 
+	if (params.useTriangleBVH)
+	{
+		//no need for the octree (nor the distance map) in this case
+		//(we work on a local copy so as to leave the caller's parameters untouched)
+		Cloud2MeshDistanceComputationParams bvhParams = params;
+		bvhParams.useDistanceMap = false;
+
+		//reset the output distances
+		pointCloud->enableScalarField();
+		pointCloud->forEach(ScalarFieldTools::SetScalarValueToNaN);
+
+		if (computeCloud2MeshDistanceWithBVH(pointCloud, mesh, bvhParams, progressCb) < 0)
+		{
+			return -7;
+		}
+		return 0;
+	}
+
 	//compute the (cubical) bounding box that contains both the cloud and the mehs BBs
 	CCVector3 cloudMinBB,cloudMaxBB;
 	CCVector3 meshMinBB,meshMaxBB;
@@ -213,8 +213,88 @@ void FastMarching::initTrialCells()
 
 void FastMarching::addTrialCell(unsigned index)
 {
-	m_theGrid[index]->state = Cell::TRIAL_CELL;
+	Cell* cell = m_theGrid[index];
+	cell->state = Cell::TRIAL_CELL;
+	cell->trialPos = static_cast<unsigned>(m_trialCells.size());
 	m_trialCells.push_back(index);
+	trialCellsSiftUp(cell->trialPos);
+}
+
+void FastMarching::updateTrialCell(unsigned index, float T)
+{
+	Cell* cell = m_theGrid[index];
+	assert(cell && cell->state == Cell::TRIAL_CELL);
+	assert(m_trialCells[cell->trialPos] == index);
+
+	if (T < cell->T)
+	{
+		cell->T = T;
+		trialCellsSiftUp(cell->trialPos);
+	}
+	else
+	{
+		cell->T = T;
+		trialCellsSiftDown(cell->trialPos);
+	}
+}
+
+void FastMarching::trialCellsSiftUp(unsigned pos)
+{
+	unsigned index = m_trialCells[pos];
+	Cell* cell = m_theGrid[index];
+
+	while (pos != 0)
+	{
+		unsigned parentPos = (pos - 1) / 2;
+		unsigned parentIndex = m_trialCells[parentPos];
+		Cell* parentCell = m_theGrid[parentIndex];
+		if (parentCell->T <= cell->T)
+			break;
+
+		//move the parent down
+		m_trialCells[pos] = parentIndex;
+		parentCell->trialPos = pos;
+		pos = parentPos;
+	}
+
+	m_trialCells[pos] = index;
+	cell->trialPos = pos;
+}
+
+void FastMarching::trialCellsSiftDown(unsigned pos)
+{
+	const unsigned count = static_cast<unsigned>(m_trialCells.size());
+	unsigned index = m_trialCells[pos];
+	Cell* cell = m_theGrid[index];
+
+	while (true)
+	{
+		unsigned childPos = 2 * pos + 1;
+		if (childPos >= count)
+			break;
+
+		//smallest child
+		Cell* childCell = m_theGrid[m_trialCells[childPos]];
+		if (childPos + 1 < count)
+		{
+			Cell* rightCell = m_theGrid[m_trialCells[childPos + 1]];
+			if (rightCell->T < childCell->T)
+			{
+				++childPos;
+				childCell = rightCell;
+			}
+		}
+		if (cell->T <= childCell->T)
+			break;
+
+		//move the child up
+		m_trialCells[pos] = m_trialCells[childPos];
+		childCell->trialPos = pos;
+		pos = childPos;
+	}
+
+	m_trialCells[pos] = index;
+	cell->trialPos = pos;
 }
 
 void FastMarching::addActiveCell(unsigned index)
@@ -234,29 +314,17 @@ unsigned FastMarching::getNearestTrialCell()
 	if (m_trialCells.empty())
 		return 0; //0 = error
 
-	//we look for the "TRIAL" cell with the minimum time (T)
-	size_t minTCellIndexPos = 0;
-	unsigned minTCellIndex = m_trialCells[minTCellIndexPos];
-	CCLib::FastMarching::Cell* minTCell = m_theGrid[minTCellIndex];
-	assert(minTCell != 0);
-
-	for (size_t i=1; i<m_trialCells.size(); ++i)
-	{
-		unsigned cellIndex = m_trialCells[i];
-		CCLib::FastMarching::Cell* cell = m_theGrid[cellIndex];
-		assert(cell != 0);
-		
-		if (cell->T < minTCell->T)
-		{
-			minTCellIndexPos = i;
-			minTCellIndex = cellIndex;
-			minTCell = cell;
-		}
-	}
+	//the "TRIAL" cell with the minimum time (T) is at the top of the heap
+	unsigned minTCellIndex = m_trialCells.front();
+	assert(m_theGrid[minTCellIndex] != 0);
 
 	//we remove this cell from the TRIAL set
-	m_trialCells[minTCellIndexPos] = m_trialCells.back();
+	m_trialCells.front() = m_trialCells.back();
 	m_trialCells.pop_back();
+	if (!m_trialCells.empty())
+	{
+		trialCellsSiftDown(0);
+	}
 
 	return minTCellIndex;
 }
@@ -134,7 +134,7 @@ int FastMarchingForPropagation::step()
 					float t_new = computeT(nIndex);
 
 					if (t_new < t_old)
-						nCell->T = t_new;
+						updateTrialCell(nIndex, t_new);
 				}
 			}
 		}
@@ -0,0 +1,328 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+#include "FlatKDTree.h"
+
+//local
+#include "GenericIndexedCloud.h"
+#include "GenericProgressCallback.h"
+
+//system
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <stdio.h>
+
+using namespace CCLib;
+
+//! Max number of points per leaf
+static const unsigned KD_MAX_LEAF_SIZE = 16;
+//! Max depth of the tree (nodes at this depth are leaves whatever their size)
+static const unsigned KD_MAX_DEPTH = 64;
+
+//! Returns the squared distance between a point and a box (0 if the point is inside)
+static inline PointCoordinateType SquareDistToBox(const CCVector3& P, const CCVector3& bbMin, const CCVector3& bbMax)
+{
+	PointCoordinateType d2 = 0;
+	for (unsigned char k = 0; k < 3; ++k)
+	{
+		PointCoordinateType delta = 0;
+		if (P.u[k] < bbMin.u[k])
+			delta = bbMin.u[k] - P.u[k];
+		else if (P.u[k] > bbMax.u[k])
+			delta = P.u[k] - bbMax.u[k];
+		d2 += delta*delta;
+	}
+	return d2;
+}
+
+FlatKDTree::FlatKDTree()
+	: m_associatedCloud(0)
+{
+}
+
+FlatKDTree::~FlatKDTree()
+{
+}
+
+void FlatKDTree::clear()
+{
+	m_nodes.clear();
+	m_points.clear();
+	m_indexes.clear();
+	m_associatedCloud = 0;
+}
+
+size_t FlatKDTree::memoryUsage() const
+{
+	return m_nodes.capacity() * sizeof(Node) + m_points.capacity() * sizeof(CCVector3) + m_indexes.capacity() * sizeof(unsigned);
+}
+
+bool FlatKDTree::splitNode(unsigned nodeIndex)
+{
+	//warning: the nodes vector will grow
+	const unsigned first = m_nodes[nodeIndex].first;
+	const unsigned count = m_nodes[nodeIndex].count;
+	if (count <= KD_MAX_LEAF_SIZE)
+	{
+		return false;
+	}
+
+	//we cut the largest dimension at the median point
+	unsigned char dim = 0;
+	{
+		CCVector3 d = m_nodes[nodeIndex].bbMax - m_nodes[nodeIndex].bbMin;
+		if (d.y > d.u[dim])
+			dim = 1;
+		if (d.z > d.u[dim])
+			dim = 2;
+	}
+	unsigned leftCount = count / 2;
+	{
+		std::vector<unsigned>::iterator begin = m_indexes.begin() + first;
+		std::nth_element(	begin,
+							begin + leftCount,
+							begin + count,
+							[&](unsigned a, unsigned b) { return m_points[a].u[dim] < m_points[b].u[dim]; });
+	}
+
+	Node children[2];
+	children[0].first = first;
+	children[0].count = leftCount;
+	children[1].first = first + leftCount;
+	children[1].count = count - leftCount;
+	for (unsigned c = 0; c < 2; ++c)
+	{
+		Node& child = children[c];
+		child.bbMin = child.bbMax = m_points[m_indexes[child.first]];
+		for (unsigned i = child.first + 1; i < child.first + child.count; ++i)
+		{
+			const CCVector3& P = m_points[m_indexes[i]];
+			for (unsigned char k = 0; k < 3; ++k)
+			{
+				if (P.u[k] < child.bbMin.u[k])
+					child.bbMin.u[k] = P.u[k];
+				else if (P.u[k] > child.bbMax.u[k])
+					child.bbMax.u[k] = P.u[k];
+			}
+		}
+	}
+
+	m_nodes[nodeIndex].first = static_cast<unsigned>(m_nodes.size());
+	m_nodes[nodeIndex].count = 0;
+	m_nodes.push_back(children[0]);
+	m_nodes.push_back(children[1]);
+
+	return true;
+}
+
+bool FlatKDTree::buildFromCloud(GenericIndexedCloud* cloud, GenericProgressCallback* progressCb/*=0*/)
+{
+	clear();
+
+	if (!cloud || cloud->size() == 0)
+	{
+		return false;
+	}
+
+	unsigned pointCount = cloud->size();
+
+	try
+	{
+		m_points.resize(pointCount);
+		m_indexes.resize(pointCount);
+		//a binary tree with leaves of ~KD_MAX_LEAF_SIZE/2 points
+		m_nodes.reserve(2 * (pointCount / (KD_MAX_LEAF_SIZE / 2) + 1));
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		clear();
+		return false;
+	}
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			char buffer[64];
+			sprintf(buffer, "Points: %u", pointCount);
+			progressCb->setInfo(buffer);
+			progressCb->setMethodTitle("Build Kd-tree");
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+	NormalizedProgress nProgress(progressCb, pointCount);
+
+	//root node
+	Node root;
+	root.first = 0;
+	root.count = pointCount;
+	for (unsigned i = 0; i < pointCount; ++i)
+	{
+		cloud->getPoint(i, m_points[i]);
+		m_indexes[i] = i;
+		const CCVector3& P = m_points[i];
+		if (i == 0)
+		{
+			root.bbMin = root.bbMax = P;
+			continue;
+		}
+		for (unsigned char k = 0; k < 3; ++k)
+		{
+			if (P.u[k] < root.bbMin.u[k])
+				root.bbMin.u[k] = P.u[k];
+			else if (P.u[k] > root.bbMax.u[k])
+				root.bbMax.u[k] = P.u[k];
+		}
+	}
+	m_nodes.push_back(root);
+
+	//nodes to process (index and depth)
+	std::vector< std::pair<unsigned, unsigned> > nodesToSplit;
+	nodesToSplit.push_back(std::pair<unsigned, unsigned>(0, 0));
+
+	bool success = true;
+	try
+	{
+		while (!nodesToSplit.empty())
+		{
+			unsigned nodeIndex = nodesToSplit.back().first;
+			unsigned depth = nodesToSplit.back().second;
+			nodesToSplit.pop_back();
+
+			if (depth + 1 < KD_MAX_DEPTH && splitNode(nodeIndex))
+			{
+				unsigned firstChild = m_nodes[nodeIndex].first;
+				nodesToSplit.push_back(std::pair<unsigned, unsigned>(firstChild + 1, depth + 1));
+				nodesToSplit.push_back(std::pair<unsigned, unsigned>(firstChild, depth + 1));
+			}
+			else if (!nProgress.steps(m_nodes[nodeIndex].count))
+			{
+				//process cancelled by user
+				success = false;
+				break;
+			}
+		}
+
+		if (success)
+		{
+			//we copy the points in leaf order (so that each leaf is contiguous in memory)
+			std::vector<CCVector3> sortedPoints(pointCount);
+			for (unsigned i = 0; i < pointCount; ++i)
+			{
+				sortedPoints[i] = m_points[m_indexes[i]];
+			}
+			m_points.swap(sortedPoints);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		success = false;
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	if (!success)
+	{
+		clear();
+		return false;
+	}
+
+	m_associatedCloud = cloud;
+
+	return true;
+}
+
+bool FlatKDTree::findNearestNeighbour(	const CCVector3& P,
+										unsigned& pointIndex,
+										ScalarType& squareDist,
+										ScalarType maxSquareDist/*=0*/) const
+{
+	if (m_nodes.empty() || !m_associatedCloud)
+	{
+		return false;
+	}
+
+	bool found = false;
+	ScalarType bestSquareDist = (maxSquareDist > 0 ? maxSquareDist : FLT_MAX);
+	unsigned bestIndex = 0;
+
+	//nodes to visit (the depth of the tree is bounded)
+	unsigned stack[KD_MAX_DEPTH + 2];
+	unsigned stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize != 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (SquareDistToBox(P, node.bbMin, node.bbMax) > bestSquareDist)
+		{
+			continue;
+		}
+
+		if (node.count != 0)
+		{
+			//leaf: the points are contiguous
+			const CCVector3* points = &m_points[node.first];
+			for (unsigned i = 0; i < node.count; ++i)
+			{
+				ScalarType d2 = static_cast<ScalarType>((points[i] - P).norm2());
+				if (d2 <= bestSquareDist)
+				{
+					bestSquareDist = d2;
+					bestIndex = node.first + i;
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			//we visit the nearest child first (i.e. we push it last)
+			unsigned c = node.first;
+			PointCoordinateType d0 = SquareDistToBox(P, m_nodes[c].bbMin, m_nodes[c].bbMax);
+			PointCoordinateType d1 = SquareDistToBox(P, m_nodes[c + 1].bbMin, m_nodes[c + 1].bbMax);
+			if (d0 <= d1)
+			{
+				if (d1 <= bestSquareDist)
+					stack[stackSize++] = c + 1;
+				if (d0 <= bestSquareDist)
+					stack[stackSize++] = c;
+			}
+			else
+			{
+				if (d0 <= bestSquareDist)
+					stack[stackSize++] = c;
+				if (d1 <= bestSquareDist)
+					stack[stackSize++] = c + 1;
+			}
+		}
+	}
+
+	if (found)
+	{
+		pointIndex = m_indexes[bestIndex];
+		squareDist = bestSquareDist;
+	}
+
+	return found;
+}
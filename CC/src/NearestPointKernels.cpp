@@ -0,0 +1,251 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "NearestPointKernels.h"
+
+//system
+#include <float.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CC_NN_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+using namespace CCLib;
+
+typedef unsigned (*FindClosestFunc)(const float*, const float*, const float*, unsigned, const float*, float&);
+
+static unsigned FindClosestScalar(	const float* x,
+									const float* y,
+									const float* z,
+									unsigned count,
+									const float* Q,
+									float& minSquareDist)
+{
+	unsigned closest = count;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		float dx = x[i] - Q[0];
+		float dy = y[i] - Q[1];
+		float dz = z[i] - Q[2];
+		float d2 = dx*dx + dy*dy + dz*dz;
+		if (d2 < minSquareDist)
+		{
+			minSquareDist = d2;
+			closest = i;
+		}
+	}
+	return closest;
+}
+
+#ifdef CC_NN_KERNELS_X86
+
+//! Returns the lane with the smallest distance (and the smallest index in case of equality)
+static inline void ReduceLanes(const float* dist, const int* index, unsigned laneCount, unsigned& closest, float& minSquareDist)
+{
+	for (unsigned k = 0; k < laneCount; ++k)
+	{
+		if (index[k] >= 0 && (dist[k] < minSquareDist || (dist[k] == minSquareDist && static_cast<unsigned>(index[k]) < closest)))
+		{
+			minSquareDist = dist[k];
+			closest = static_cast<unsigned>(index[k]);
+		}
+	}
+}
+
+static unsigned FindClosestSSE2(const float* x,
+								const float* y,
+								const float* z,
+								unsigned count,
+								const float* Q,
+								float& minSquareDist)
+{
+	const __m128 qx = _mm_set1_ps(Q[0]);
+	const __m128 qy = _mm_set1_ps(Q[1]);
+	const __m128 qz = _mm_set1_ps(Q[2]);
+
+	__m128 best = _mm_set1_ps(minSquareDist);
+	__m128i bestIndex = _mm_set1_epi32(-1);
+	__m128i index = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i step = _mm_set1_epi32(4);
+
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), qx);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), qy);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), qz);
+		__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		//early rejection: only the (strictly) closer points are kept
+		__m128 closer = _mm_cmplt_ps(d2, best);
+		best = _mm_or_ps(_mm_and_ps(closer, d2), _mm_andnot_ps(closer, best));
+		__m128i closerI = _mm_castps_si128(closer);
+		bestIndex = _mm_or_si128(_mm_and_si128(closerI, index), _mm_andnot_si128(closerI, bestIndex));
+		index = _mm_add_epi32(index, step);
+	}
+
+	float laneDist[4];
+	int laneIndex[4];
+	_mm_storeu_ps(laneDist, best);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(laneIndex), bestIndex);
+
+	unsigned closest = count;
+	ReduceLanes(laneDist, laneIndex, 4, closest, minSquareDist);
+
+	//remaining points
+	unsigned tailClosest = FindClosestScalar(x + i, y + i, z + i, count - i, Q, minSquareDist);
+	if (tailClosest < count - i)
+	{
+		closest = i + tailClosest;
+	}
+
+	return closest;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CC_NN_KERNELS_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define CC_NN_KERNELS_AVX2_TARGET
+#endif
+
+CC_NN_KERNELS_AVX2_TARGET
+static unsigned FindClosestAVX2(const float* x,
+								const float* y,
+								const float* z,
+								unsigned count,
+								const float* Q,
+								float& minSquareDist)
+{
+	const __m256 qx = _mm256_set1_ps(Q[0]);
+	const __m256 qy = _mm256_set1_ps(Q[1]);
+	const __m256 qz = _mm256_set1_ps(Q[2]);
+
+	__m256 best = _mm256_set1_ps(minSquareDist);
+	__m256i bestIndex = _mm256_set1_epi32(-1);
+	__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i step = _mm256_set1_epi32(8);
+
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), qx);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), qy);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), qz);
+		__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+		//early rejection: only the (strictly) closer points are kept
+		__m256 closer = _mm256_cmp_ps(d2, best, _CMP_LT_OQ);
+		best = _mm256_blendv_ps(best, d2, closer);
+		bestIndex = _mm256_blendv_epi8(bestIndex, index, _mm256_castps_si256(closer));
+		index = _mm256_add_epi32(index, step);
+	}
+
+	float laneDist[8];
+	int laneIndex[8];
+	_mm256_storeu_ps(laneDist, best);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(laneIndex), bestIndex);
+
+	unsigned closest = count;
+	ReduceLanes(laneDist, laneIndex, 8, closest, minSquareDist);
+
+	//remaining points
+	unsigned tailClosest = FindClosestScalar(x + i, y + i, z + i, count - i, Q, minSquareDist);
+	if (tailClosest < count - i)
+	{
+		closest = i + tailClosest;
+	}
+
+	return closest;
+}
+
+static bool CPUSupportsAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	//OSXSAVE and AVX
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+		return false;
+	//the OS must save the YMM registers
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+}
+
+#endif //CC_NN_KERNELS_X86
+
+//! Selected implementation
+struct SelectedKernel
+{
+	FindClosestFunc func;
+	const char* name;
+
+	SelectedKernel()
+		: func(FindClosestScalar)
+		, name("scalar")
+	{
+#ifdef CC_NN_KERNELS_X86
+		if (CPUSupportsAVX2())
+		{
+			func = FindClosestAVX2;
+			name = "AVX2";
+		}
+		else
+		{
+			//SSE2 is part of the x86-64 baseline (and of any reasonably recent x86 CPU)
+			func = FindClosestSSE2;
+			name = "SSE2";
+		}
+#endif
+	}
+};
+
+static const SelectedKernel& GetKernel()
+{
+	static const SelectedKernel s_kernel; //thread-safe initialization
+	return s_kernel;
+}
+
+unsigned NearestPointKernels::FindClosest(	const float* x,
+											const float* y,
+											const float* z,
+											unsigned count,
+											const float Q[3],
+											float& minSquareDist)
+{
+	return GetKernel().func(x, y, z, count, Q, minSquareDist);
+}
+
+const char* NearestPointKernels::ImplementationName()
+{
+	return GetKernel().name;
+}
@@ -0,0 +1,56 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef NEAREST_POINT_KERNELS_HEADER
+#define NEAREST_POINT_KERNELS_HEADER
+
+namespace CCLib
+{
+
+//! Nearest point search kernels on points stored as a structure of arrays
+/** The best implementation (AVX2, SSE2 or plain scalar code) is chosen
+	at runtime depending on the instructions supported by the CPU.
+**/
+class NearestPointKernels
+{
+public:
+
+	//! Looks for the point closest to a query point
+	/** Only points strictly closer than 'minSquareDist' are considered.
+		\param x points X coordinates
+		\param y points Y coordinates
+		\param z points Z coordinates
+		\param count number of points
+		\param Q query point
+		\param minSquareDist input: current min (squared) distance / output: updated min (squared) distance
+		\return the position of the closest point or 'count' if no point is closer than the input 'minSquareDist'
+	**/
+	static unsigned FindClosest(const float* x,
+								const float* y,
+								const float* z,
+								unsigned count,
+								const float Q[3],
+								float& minSquareDist);
+
+	//! Returns the name of the implementation used at runtime ("AVX2", "SSE2" or "scalar")
+	static const char* ImplementationName();
+};
+
+} //namespace CCLib
+
+#endif //NEAREST_POINT_KERNELS_HEADER
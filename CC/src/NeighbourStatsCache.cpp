@@ -0,0 +1,534 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "NeighbourStatsCache.h"
+
+//local
+#include "GenericIndexedCloudPersist.h"
+#include "GenericProgressCallback.h"
+#include "ReferenceCloud.h"
+#include "Neighbourhood.h"
+#include "DgmOctreeReferenceCloud.h"
+#include "DistanceComputationTools.h"
+#include "ParallelTools.h"
+
+//system
+#include <cmath>
+
+using namespace CCLib;
+
+NeighbourStatsCache::NeighbourStatsCache()
+	: m_cloud(0)
+	, m_pointCount(0)
+	, m_bbMin(0, 0, 0)
+	, m_bbMax(0, 0, 0)
+	, m_minKnn(0)
+	, m_maxKnn(0)
+	, m_hasPlaneDistances(false)
+	, m_kernelRadius(0)
+	, m_useKnn(false)
+	, m_planeKnn(0)
+{
+}
+
+NeighbourStatsCache::~NeighbourStatsCache()
+{
+	clear();
+}
+
+void NeighbourStatsCache::clear()
+{
+	m_cloud = 0;
+	m_pointCount = 0;
+	m_bbMin = m_bbMax = CCVector3(0, 0, 0);
+
+	m_minKnn = m_maxKnn = 0;
+	m_knnMeanDistances.clear();
+	m_knnAvgDist.clear();
+	m_knnStdDev.clear();
+
+	m_hasPlaneDistances = false;
+	m_planeStatus.clear();
+	m_planeDistances.clear();
+	m_planeStdDevs.clear();
+}
+
+bool NeighbourStatsCache::isValidFor(GenericIndexedCloudPersist* cloud) const
+{
+	if (!cloud || cloud != m_cloud || cloud->size() != m_pointCount)
+		return false;
+
+	CCVector3 bbMin, bbMax;
+	cloud->getBoundingBox(bbMin, bbMax);
+	return (bbMin - m_bbMin).norm2() == 0 && (bbMax - m_bbMax).norm2() == 0;
+}
+
+void NeighbourStatsCache::bindToCloud(GenericIndexedCloudPersist* cloud)
+{
+	if (!isValidFor(cloud))
+	{
+		clear();
+		m_cloud = cloud;
+		m_pointCount = cloud->size();
+		cloud->getBoundingBox(m_bbMin, m_bbMax);
+	}
+}
+
+bool NeighbourStatsCache::computeKnnMeanDistances(	GenericIndexedCloudPersist* cloud,
+													int minKnn,
+													int maxKnn,
+													DgmOctree* inputOctree/*=0*/,
+													GenericProgressCallback* progressCb/*=0*/,
+													int maxThreadCount/*=0*/)
+{
+	if (!cloud || minKnn <= 0 || maxKnn < minKnn || cloud->size() <= static_cast<unsigned>(maxKnn))
+	{
+		//invalid input
+		assert(false);
+		return false;
+	}
+
+	bindToCloud(cloud);
+	m_knnMeanDistances.clear();
+	m_knnAvgDist.clear();
+	m_knnStdDev.clear();
+	m_minKnn = m_maxKnn = 0;
+
+	unsigned pointCount = cloud->size();
+	size_t knnCount = static_cast<size_t>(maxKnn - minKnn + 1);
+	try
+	{
+		m_knnMeanDistances.resize(knnCount);
+		for (std::vector<PointCoordinateType>& meanDistances : m_knnMeanDistances)
+		{
+			meanDistances.resize(pointCount, 0);
+		}
+		m_knnAvgDist.resize(knnCount, 0);
+		m_knnStdDev.resize(knnCount, 0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		m_knnMeanDistances.clear();
+		m_knnAvgDist.clear();
+		m_knnStdDev.clear();
+		return false;
+	}
+
+	DgmOctree* octree = inputOctree;
+	if (!octree)
+	{
+		//compute the octree if necessary
+		octree = new DgmOctree(cloud);
+		if (octree->build(progressCb) < 1)
+		{
+			delete octree;
+			return false;
+		}
+	}
+
+	//additional parameters
+	void* additionalParameters[] = {reinterpret_cast<void*>(&minKnn),
+									reinterpret_cast<void*>(&maxKnn),
+									reinterpret_cast<void*>(&m_knnMeanDistances)
+	};
+
+	unsigned char octreeLevel = octree->findBestLevelForAGivenPopulationPerCell(maxKnn);
+
+	bool success = (octree->executeFunctionForAllCellsAtLevel(	octreeLevel,
+																&computeKnnMeanDistancesAtLevel,
+																additionalParameters,
+																true,
+																progressCb,
+																"SOR filter",
+																maxThreadCount) != 0);
+
+	if (!inputOctree)
+	{
+		delete octree;
+		octree = 0;
+	}
+
+	if (!success)
+	{
+		m_knnMeanDistances.clear();
+		m_knnAvgDist.clear();
+		m_knnStdDev.clear();
+		return false;
+	}
+
+	//deduce the average distance and std. dev. (for each number of neighbours)
+	ParallelTools::ForEach(	static_cast<unsigned>(knnCount),
+							[&](unsigned k)
+							{
+								const std::vector<PointCoordinateType>& meanDistances = m_knnMeanDistances[k];
+								double sumDist = 0;
+								double sumSquareDist = 0;
+								for (unsigned i = 0; i < pointCount; ++i)
+								{
+									sumDist += meanDistances[i];
+									sumSquareDist += meanDistances[i] * meanDistances[i];
+								}
+								m_knnAvgDist[k] = sumDist / pointCount;
+								m_knnStdDev[k] = sqrt(fabs(sumSquareDist / pointCount - m_knnAvgDist[k] * m_knnAvgDist[k]));
+							},
+							maxThreadCount);
+
+	m_minKnn = minKnn;
+	m_maxKnn = maxKnn;
+
+	return true;
+}
+
+bool NeighbourStatsCache::hasKnnMeanDistances(GenericIndexedCloudPersist* cloud, int knn) const
+{
+	return (knn >= m_minKnn && knn <= m_maxKnn && m_maxKnn != 0 && isValidFor(cloud));
+}
+
+ReferenceCloud* NeighbourStatsCache::sorFilter(int knn, double nSigma) const
+{
+	if (!m_cloud || knn < m_minKnn || knn > m_maxKnn || m_maxKnn == 0)
+	{
+		//mean distances not computed for this number of neighbours
+		assert(false);
+		return 0;
+	}
+
+	size_t k = static_cast<size_t>(knn - m_minKnn);
+	const std::vector<PointCoordinateType>& meanDistances = m_knnMeanDistances[k];
+
+	//deduce the max distance
+	double maxDist = m_knnAvgDist[k] + nSigma * m_knnStdDev[k];
+
+	ReferenceCloud* filteredCloud = new ReferenceCloud(m_cloud);
+	if (!filteredCloud->reserve(m_pointCount))
+	{
+		//not enough memory
+		delete filteredCloud;
+		return 0;
+	}
+
+	//remove the farthest points
+	for (unsigned i = 0; i < m_pointCount; ++i)
+	{
+		if (meanDistances[i] <= maxDist)
+		{
+			filteredCloud->addPointIndex(i);
+		}
+	}
+
+	filteredCloud->resize(filteredCloud->size());
+
+	return filteredCloud;
+}
+
+bool NeighbourStatsCache::computePlaneDistances(GenericIndexedCloudPersist* cloud,
+												PointCoordinateType kernelRadius,
+												bool useKnn,
+												int knn,
+												DgmOctree* inputOctree/*=0*/,
+												GenericProgressCallback* progressCb/*=0*/,
+												int maxThreadCount/*=0*/)
+{
+	if (!cloud || cloud->size() < 2 || (useKnn && knn <= 0) || (!useKnn && kernelRadius <= 0))
+	{
+		//invalid input
+		assert(false);
+		return false;
+	}
+
+	bindToCloud(cloud);
+	m_hasPlaneDistances = false;
+
+	unsigned pointCount = cloud->size();
+	try
+	{
+		m_planeStatus.resize(pointCount);
+		m_planeDistances.resize(pointCount);
+		m_planeStdDevs.resize(pointCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		m_planeStatus.clear();
+		m_planeDistances.clear();
+		m_planeStdDevs.clear();
+		return false;
+	}
+
+	DgmOctree* octree = inputOctree;
+	if (!octree)
+	{
+		octree = new DgmOctree(cloud);
+		if (octree->build(progressCb) < 1)
+		{
+			delete octree;
+			return false;
+		}
+	}
+
+	//additional parameters
+	void* additionalParameters[] = {reinterpret_cast<void*>(&kernelRadius),
+									reinterpret_cast<void*>(&useKnn),
+									reinterpret_cast<void*>(&knn),
+									reinterpret_cast<void*>(&m_planeStatus),
+									reinterpret_cast<void*>(&m_planeDistances),
+									reinterpret_cast<void*>(&m_planeStdDevs)
+	};
+
+	//DGM: in 'knn' mode, all the eligible neighbors are used (i.e. at least knn, depending on the level)
+	unsigned char octreeLevel = 0;
+	if (useKnn)
+		octreeLevel = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(kernelRadius);
+	else
+		octreeLevel = octree->findBestLevelForAGivenPopulationPerCell(knn);
+
+	bool success = (octree->executeFunctionForAllCellsAtLevel(	octreeLevel,
+																&computePlaneDistancesAtLevel,
+																additionalParameters,
+																true,
+																progressCb,
+																"Noise filter",
+																maxThreadCount) != 0);
+
+	if (!inputOctree)
+	{
+		delete octree;
+		octree = 0;
+	}
+
+	if (!success)
+	{
+		m_planeStatus.clear();
+		m_planeDistances.clear();
+		m_planeStdDevs.clear();
+		return false;
+	}
+
+	m_hasPlaneDistances = true;
+	m_kernelRadius = kernelRadius;
+	m_useKnn = useKnn;
+	m_planeKnn = knn;
+
+	return true;
+}
+
+bool NeighbourStatsCache::hasPlaneDistances(GenericIndexedCloudPersist* cloud, PointCoordinateType kernelRadius, bool useKnn, int knn) const
+{
+	if (!m_hasPlaneDistances || useKnn != m_useKnn || !isValidFor(cloud))
+		return false;
+
+	return useKnn ? (knn == m_planeKnn) : (kernelRadius == m_kernelRadius);
+}
+
+ReferenceCloud* NeighbourStatsCache::noiseFilter(	double nSigma,
+													bool removeIsolatedPoints,
+													bool useAbsoluteError,
+													double absoluteError) const
+{
+	if (!m_cloud || !m_hasPlaneDistances)
+	{
+		//distances not computed
+		assert(false);
+		return 0;
+	}
+
+	ReferenceCloud* filteredCloud = new ReferenceCloud(m_cloud);
+	if (!filteredCloud->reserve(m_pointCount))
+	{
+		//not enough memory
+		delete filteredCloud;
+		return 0;
+	}
+
+	for (unsigned i = 0; i < m_pointCount; ++i)
+	{
+		bool keep = false;
+		switch (m_planeStatus[i])
+		{
+		case VALID_PLANE:
+			{
+				double maxD = (useAbsoluteError ? absoluteError : m_planeStdDevs[i] * nSigma);
+				keep = (m_planeDistances[i] <= maxD);
+			}
+			break;
+		case ISOLATED_POINT:
+			//not enough points to fit a plane AND compute distances to it
+			keep = !removeIsolatedPoints;
+			break;
+		default:
+			//no plane could be fitted
+			break;
+		}
+
+		if (keep)
+		{
+			filteredCloud->addPointIndex(i);
+		}
+	}
+
+	filteredCloud->resize(filteredCloud->size());
+
+	return filteredCloud;
+}
+
+bool NeighbourStatsCache::computeKnnMeanDistancesAtLevel(	const DgmOctree::octreeCell& cell,
+															void** additionalParameters,
+															NormalizedProgress* nProgress/*=0*/)
+{
+	int minKnn													= *static_cast<int*>(additionalParameters[0]);
+	int maxKnn													= *static_cast<int*>(additionalParameters[1]);
+	std::vector< std::vector<PointCoordinateType> >& knnMeanDistances	= *static_cast<std::vector< std::vector<PointCoordinateType> >*>(additionalParameters[2]);
+
+	//structure for nearest neighbors search
+	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+	nNSS.level = cell.level;
+	nNSS.minNumberOfNeighbors = maxKnn; //DGM: I woud have put knn+1 (as the point itself will be ignored) but in this case we won't get the same result as PCL!
+	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	//for each point in the cell
+	for (unsigned i = 0; i < n; ++i)
+	{
+		cell.points->getPoint(i, nNSS.queryPoint);
+		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+
+		//look for the k nearest neighbors (only once for all the requested values of k)
+		cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
+		double sumDist = 0;
+		unsigned count = 0;
+		for (int j = 0; j < maxKnn; ++j)
+		{
+			if (nNSS.pointsInNeighbourhood[j].pointIndex != globalIndex)
+			{
+				sumDist += sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
+				++count;
+			}
+
+			//mean distance to the (j+1) nearest neighbors
+			int knn = j + 1;
+			if (knn >= minKnn && count != 0)
+			{
+				knnMeanDistances[knn - minKnn][globalIndex] = static_cast<PointCoordinateType>(sumDist / count);
+			}
+		}
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool NeighbourStatsCache::computePlaneDistancesAtLevel(	const DgmOctree::octreeCell& cell,
+														void** additionalParameters,
+														NormalizedProgress* nProgress/*=0*/)
+{
+	PointCoordinateType kernelRadius		= *static_cast<PointCoordinateType*>(additionalParameters[0]);
+	bool useKnn								= *static_cast<bool*>(additionalParameters[1]);
+	int knn									= *static_cast<int*>(additionalParameters[2]);
+	std::vector<unsigned char>& planeStatus	= *static_cast<std::vector<unsigned char>*>(additionalParameters[3]);
+	std::vector<double>& planeDistances		= *static_cast<std::vector<double>*>(additionalParameters[4]);
+	std::vector<double>& planeStdDevs		= *static_cast<std::vector<double>*>(additionalParameters[5]);
+
+	//structure for nearest neighbors search
+	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+	nNSS.level = cell.level;
+	nNSS.prepare(kernelRadius, cell.parentOctree->getCellSize(nNSS.level));
+	if (useKnn)
+	{
+		nNSS.minNumberOfNeighbors = knn;
+	}
+	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	//for each point in the cell
+	for (unsigned i = 0; i < n; ++i)
+	{
+		cell.points->getPoint(i, nNSS.queryPoint);
+		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+
+		//look for neighbors (either inside a sphere or the k nearest ones)
+		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
+		unsigned neighborCount = 0;
+
+		if (useKnn)
+			neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
+		else
+			neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, kernelRadius, false);
+
+		planeStatus[globalIndex] = ISOLATED_POINT;
+		planeDistances[globalIndex] = 0;
+		planeStdDevs[globalIndex] = 0;
+
+		if (neighborCount > 3) //we want 3 points or more (other than the point itself!)
+		{
+			//find the query point in the nearest neighbors set and place it at the end
+			unsigned localIndex = 0;
+			while (localIndex < neighborCount && nNSS.pointsInNeighbourhood[localIndex].pointIndex != globalIndex)
+				++localIndex;
+			//the query point should be in the nearest neighbors set!
+			assert(localIndex < neighborCount);
+			if (localIndex + 1 < neighborCount) //no need to swap with another point if it's already at the end!
+			{
+				std::swap(nNSS.pointsInNeighbourhood[localIndex], nNSS.pointsInNeighbourhood[neighborCount - 1]);
+			}
+
+			unsigned realNeighborCount = neighborCount - 1;
+			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood, realNeighborCount); //we don't take the query point into account!
+			Neighbourhood Z(&neighboursCloud);
+
+			const PointCoordinateType* lsPlane = Z.getLSPlane();
+			if (lsPlane)
+			{
+				//compute the std. dev. to this plane
+				double sum_d = 0;
+				double sum_d2 = 0;
+				for (unsigned j = 0; j < realNeighborCount; ++j)
+				{
+					const CCVector3* P = neighboursCloud.getPoint(j);
+					double d = DistanceComputationTools::computePoint2PlaneDistance(P, lsPlane);
+					sum_d += d;
+					sum_d2 += d*d;
+				}
+
+				planeStatus[globalIndex] = VALID_PLANE;
+				planeStdDevs[globalIndex] = sqrt(fabs(sum_d2*realNeighborCount - sum_d*sum_d)) / realNeighborCount;
+				//distance from the query point to the plane
+				planeDistances[globalIndex] = fabs(DistanceComputationTools::computePoint2PlaneDistance(&nNSS.queryPoint, lsPlane));
+			}
+			else
+			{
+				planeStatus[globalIndex] = NO_PLANE;
+			}
+		}
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,317 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "NormalEstimationKernels.h"
+
+//local
+#include "CCConst.h"
+#include "GaussianElimination.h"
+
+//system
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CC_NORMAL_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace CCLib;
+
+//! Max number of points accumulated in single precision before flushing the sums in double precision
+static const unsigned c_floatAccumulationBlock = 1024;
+
+bool NormalEstimationKernels::Points::gather(const DgmOctree::NeighboursSet& neighbours, unsigned count, const CCVector3& _origin)
+{
+	assert(count <= neighbours.size());
+	if (x.size() < count)
+	{
+		try
+		{
+			//some margin to avoid too many reallocations when the neighbourhoods grow
+			size_t newSize = std::max<size_t>(count, x.size() * 3 / 2);
+			x.resize(newSize);
+			y.resize(newSize);
+			z.resize(newSize);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			size = 0;
+			return false;
+		}
+	}
+
+	origin = _origin;
+	size = count;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const CCVector3* P = neighbours[i].point;
+		x[i] = P->x - origin.x;
+		y[i] = P->y - origin.y;
+		z[i] = P->z - origin.z;
+	}
+
+	return true;
+}
+
+//! Accumulates the first and second order moments of a block of points
+/** \param sums output sums (X, Y, Z, XX, YY, ZZ, XY, XZ, YZ)
+**/
+static void AccumulateMoments(const float* x, const float* y, const float* z, unsigned count, double sums[9])
+{
+	unsigned i = 0;
+
+#ifdef CC_NORMAL_KERNELS_SSE2
+	if (count >= 4)
+	{
+		__m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(), sz = _mm_setzero_ps();
+		__m128 sxx = _mm_setzero_ps(), syy = _mm_setzero_ps(), szz = _mm_setzero_ps();
+		__m128 sxy = _mm_setzero_ps(), sxz = _mm_setzero_ps(), syz = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i);
+			__m128 vy = _mm_loadu_ps(y + i);
+			__m128 vz = _mm_loadu_ps(z + i);
+			sx = _mm_add_ps(sx, vx);
+			sy = _mm_add_ps(sy, vy);
+			sz = _mm_add_ps(sz, vz);
+			sxx = _mm_add_ps(sxx, _mm_mul_ps(vx, vx));
+			syy = _mm_add_ps(syy, _mm_mul_ps(vy, vy));
+			szz = _mm_add_ps(szz, _mm_mul_ps(vz, vz));
+			sxy = _mm_add_ps(sxy, _mm_mul_ps(vx, vy));
+			sxz = _mm_add_ps(sxz, _mm_mul_ps(vx, vz));
+			syz = _mm_add_ps(syz, _mm_mul_ps(vy, vz));
+		}
+
+		__m128 lanes[9] = { sx, sy, sz, sxx, syy, szz, sxy, sxz, syz };
+		for (unsigned j = 0; j < 9; ++j)
+		{
+			float v[4];
+			_mm_storeu_ps(v, lanes[j]);
+			sums[j] += (static_cast<double>(v[0]) + v[1]) + (static_cast<double>(v[2]) + v[3]);
+		}
+	}
+#endif
+
+	//remaining points
+	for (; i < count; ++i)
+	{
+		double px = x[i], py = y[i], pz = z[i];
+		sums[0] += px;
+		sums[1] += py;
+		sums[2] += pz;
+		sums[3] += px*px;
+		sums[4] += py*py;
+		sums[5] += pz*pz;
+		sums[6] += px*py;
+		sums[7] += px*pz;
+		sums[8] += py*pz;
+	}
+}
+
+bool NormalEstimationKernels::ComputeCovariance(const Points& points, CCVector3d& G, double cov[6])
+{
+	unsigned count = points.size;
+	if (count < 3)
+		return false;
+
+	double sums[9] = { 0 };
+	for (unsigned first = 0; first < count; first += c_floatAccumulationBlock)
+	{
+		unsigned blockSize = std::min(c_floatAccumulationBlock, count - first);
+		AccumulateMoments(&points.x[first], &points.y[first], &points.z[first], blockSize, sums);
+	}
+
+	//mean (relative to the origin)
+	double mx = sums[0] / count;
+	double my = sums[1] / count;
+	double mz = sums[2] / count;
+	G = CCVector3d(mx + points.origin.x, my + points.origin.y, mz + points.origin.z);
+
+	cov[0] = std::max(0.0, sums[3] / count - mx*mx);
+	cov[1] = std::max(0.0, sums[4] / count - my*my);
+	cov[2] = std::max(0.0, sums[5] / count - mz*mz);
+	cov[3] = sums[6] / count - mx*my;
+	cov[4] = sums[7] / count - mx*mz;
+	cov[5] = sums[8] / count - my*mz;
+
+	return true;
+}
+
+bool NormalEstimationKernels::SmallestEigenVector(const double cov[6], CCVector3d& eigVector)
+{
+	const double& a00 = cov[0];
+	const double& a11 = cov[1];
+	const double& a22 = cov[2];
+	const double& a01 = cov[3];
+	const double& a02 = cov[4];
+	const double& a12 = cov[5];
+
+	//closed-form eigen values (trigonometric solution of the characteristic equation)
+	double q = (a00 + a11 + a22) / 3;
+	double p1 = a01*a01 + a02*a02 + a12*a12;
+	double p2 = (a00 - q)*(a00 - q) + (a11 - q)*(a11 - q) + (a22 - q)*(a22 - q) + 2 * p1;
+	if (p2 <= 0)
+	{
+		//3 equal eigen values (isotropic or null matrix)
+		return false;
+	}
+	double p = sqrt(p2 / 6);
+
+	//B = (A - q.I) / p
+	double b00 = (a00 - q) / p, b11 = (a11 - q) / p, b22 = (a22 - q) / p;
+	double b01 = a01 / p, b02 = a02 / p, b12 = a12 / p;
+	double r = (b00 * (b11*b22 - b12*b12) - b01 * (b01*b22 - b12*b02) + b02 * (b01*b12 - b11*b02)) / 2;
+	r = std::max(-1.0, std::min(1.0, r));
+	double phi = acos(r) / 3;
+
+	//smallest eigen value
+	static const double c_twoPiOver3 = 2.0943951023931954923;
+	double lambda = q + 2 * p * cos(phi + c_twoPiOver3);
+
+	//the eigen vector is orthogonal to the rows of (A - lambda.I)
+	CCVector3d r0(a00 - lambda, a01, a02);
+	CCVector3d r1(a01, a11 - lambda, a12);
+	CCVector3d r2(a02, a12, a22 - lambda);
+
+	CCVector3d c01 = r0.cross(r1);
+	CCVector3d c02 = r0.cross(r2);
+	CCVector3d c12 = r1.cross(r2);
+	double n01 = c01.norm2();
+	double n02 = c02.norm2();
+	double n12 = c12.norm2();
+
+	double nMax = n01;
+	eigVector = c01;
+	if (n02 > nMax)
+	{
+		nMax = n02;
+		eigVector = c02;
+	}
+	if (n12 > nMax)
+	{
+		nMax = n12;
+		eigVector = c12;
+	}
+
+	//if all the cross products are (relatively) too small, the smallest eigen value is not unique
+	double scale = p * p;
+	if (nMax <= 1.0e-12 * scale * scale)
+	{
+		return false;
+	}
+
+	eigVector /= sqrt(nMax);
+	return true;
+}
+
+bool NormalEstimationKernels::ComputeLSNormal(const Points& points, CCVector3& N)
+{
+	CCVector3d G;
+	double cov[6];
+	if (!ComputeCovariance(points, G, cov))
+		return false;
+
+	CCVector3d n;
+	if (!SmallestEigenVector(cov, n))
+		return false;
+
+	N = CCVector3::fromArray(n.u);
+	return true;
+}
+
+bool NormalEstimationKernels::ComputeQuadricNormal(const Points& points, const CCVector3& P, CCVector3& N)
+{
+	unsigned count = points.size;
+	if (count < CC_LOCAL_MODEL_MIN_SIZE[QUADRIC])
+		return false;
+
+	//LS plane (to determine the best projection axes)
+	CCVector3d G;
+	double cov[6];
+	CCVector3d n;
+	if (!ComputeCovariance(points, G, cov) || !SmallestEigenVector(cov, n))
+		return false;
+
+	//same convention as Neighbourhood::computeQuadric
+	unsigned char iX = 0, iY = 1, iZ = 2;
+	double nxx = n.x*n.x, nyy = n.y*n.y, nzz = n.z*n.z;
+	if (nxx > nyy)
+	{
+		if (nxx > nzz)
+		{
+			iX = 1; iY = 2; iZ = 0;
+		}
+	}
+	else
+	{
+		if (nyy > nzz)
+		{
+			iX = 2; iY = 0; iZ = 1;
+		}
+	}
+
+	//gravity center relatively to the points origin
+	CCVector3d g(G.x - points.origin.x, G.y - points.origin.y, G.z - points.origin.z);
+	const float* coords[3] = { &points.x[0], &points.y[0], &points.z[0] };
+	const float* _X = coords[iX];
+	const float* _Y = coords[iY];
+	const float* _Z = coords[iZ];
+
+	//normal equations tA.A.X = tA.b with A = [1 X Y X^2 XY Y^2] and b = Z
+	double tAA[6][6] = { { 0 } };
+	double tAb[6] = { 0 };
+	for (unsigned i = 0; i < count; ++i)
+	{
+		double lX = _X[i] - g.u[iX];
+		double lY = _Y[i] - g.u[iY];
+		double lZ = _Z[i] - g.u[iZ];
+		double a[6] = { 1.0, lX, lY, lX*lX, lX*lY, lY*lY };
+		for (unsigned r = 0; r < 6; ++r)
+		{
+			for (unsigned c = r; c < 6; ++c)
+				tAA[r][c] += a[r] * a[c];
+			tAb[r] += a[r] * lZ;
+		}
+	}
+	for (unsigned r = 1; r < 6; ++r)
+		for (unsigned c = 0; c < r; ++c)
+			tAA[r][c] = tAA[c][r];
+
+	//the system is considered as degenerate if a pivot is negligible relatively to the diagonal
+	double maxDiag = 0;
+	for (unsigned r = 0; r < 6; ++r)
+		maxDiag = std::max(maxDiag, fabs(tAA[r][r]));
+
+	double h[6];
+	if (!GaussianElimination<6, double>::Solve(tAA, tAb, h, maxDiag * 1.0e-12))
+		return false;
+
+	double lX = P.u[iX] - G.u[iX];
+	double lY = P.u[iY] - G.u[iY];
+
+	CCVector3d Nd;
+	Nd.u[iX] = h[1] + (2 * h[3] * lX) + (h[4] * lY);
+	Nd.u[iY] = h[2] + (2 * h[5] * lY) + (h[4] * lX);
+	Nd.u[iZ] = -1;
+	Nd.normalize();
+
+	N = CCVector3::fromArray(Nd.u);
+	return true;
+}
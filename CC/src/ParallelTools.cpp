@@ -0,0 +1,162 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ParallelTools.h"
+
+//system
+#include <algorithm>
+#include <assert.h>
+
+#ifdef USE_QT
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#endif
+
+using namespace CCLib;
+
+//! Shared state of a parallel job: dispatches contiguous chunks of elements to the workers
+class ChunkDispatcher
+{
+public:
+
+	ChunkDispatcher(unsigned count,
+					unsigned chunkSize,
+					const ParallelTools::IndexedTask& task,
+					ParallelCancelToken* cancelToken)
+		: m_count(count)
+		, m_chunkSize(chunkSize)
+		, m_task(task)
+		, m_cancelToken(cancelToken)
+		, m_next(0)
+	{
+		assert(m_chunkSize != 0);
+	}
+
+	//! Processes chunks until there is none left (or the job is canceled)
+	void run()
+	{
+		while (!m_cancelToken || !m_cancelToken->isCanceled())
+		{
+			unsigned long long start = m_next.fetch_add(m_chunkSize);
+			if (start >= m_count)
+			{
+				break;
+			}
+			unsigned stop = static_cast<unsigned>(std::min<unsigned long long>(start + m_chunkSize, m_count));
+			for (unsigned i = static_cast<unsigned>(start); i < stop; ++i)
+			{
+				m_task(i);
+			}
+		}
+	}
+
+protected:
+
+	const unsigned m_count;
+	const unsigned m_chunkSize;
+	const ParallelTools::IndexedTask& m_task;
+	ParallelCancelToken* m_cancelToken;
+	std::atomic<unsigned long long> m_next;
+};
+
+#ifdef USE_QT
+
+//! Worker thread of a parallel job
+class ChunkWorker : public QRunnable
+{
+public:
+	explicit ChunkWorker(ChunkDispatcher& dispatcher) : m_dispatcher(dispatcher) {}
+	virtual void run() { m_dispatcher.run(); }
+
+protected:
+	ChunkDispatcher& m_dispatcher;
+};
+
+#endif
+
+int ParallelTools::IdealThreadCount()
+{
+#ifdef USE_QT
+	return std::max(1, QThread::idealThreadCount());
+#else
+	return 1;
+#endif
+}
+
+//! Default maximum number of threads of a parallel job (0 = ideal thread count)
+static std::atomic<int> s_defaultMaxThreadCount(0);
+
+void ParallelTools::SetDefaultMaxThreadCount(int maxThreadCount)
+{
+	s_defaultMaxThreadCount.store(std::max(0, maxThreadCount));
+}
+
+int ParallelTools::DefaultMaxThreadCount()
+{
+	int maxThreadCount = s_defaultMaxThreadCount.load();
+	return (maxThreadCount > 0 ? maxThreadCount : IdealThreadCount());
+}
+
+bool ParallelTools::ForEach(unsigned count,
+							const IndexedTask& task,
+							int maxThreadCount/*=0*/,
+							ParallelCancelToken* cancelToken/*=0*/,
+							unsigned chunkSize/*=0*/)
+{
+	if (count == 0)
+	{
+		return true;
+	}
+
+	if (maxThreadCount <= 0)
+	{
+		maxThreadCount = DefaultMaxThreadCount();
+	}
+	unsigned threadCount = std::min(static_cast<unsigned>(maxThreadCount), count);
+
+	if (chunkSize == 0)
+	{
+		//a few chunks per thread, so that threads that finish early can help the others
+		chunkSize = std::max(1u, count / (threadCount * 8));
+	}
+
+	ChunkDispatcher dispatcher(count, chunkSize, task, cancelToken);
+
+#ifdef USE_QT
+	if (threadCount > 1)
+	{
+		//private pool: the global pool settings are left untouched
+		QThreadPool pool;
+		pool.setMaxThreadCount(static_cast<int>(threadCount) - 1);
+		for (unsigned i = 1; i < threadCount; ++i)
+		{
+			pool.start(new ChunkWorker(dispatcher)); //auto-deleted by the pool
+		}
+		//the calling thread works as well
+		dispatcher.run();
+		pool.waitForDone();
+	}
+	else
+#endif
+	{
+		dispatcher.run();
+	}
+
+	return (!cancelToken || !cancelToken->isCanceled());
+}
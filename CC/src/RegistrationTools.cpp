@@ -28,9 +28,13 @@
 #include "ManualSegmentationTools.h"
 #include "GeometricalAnalysisTools.h"
 #include "KdTree.h"
+#include "FlatKDTree.h"
+#include "TriangleBVH.h"
+#include "ParallelTools.h"
 #include "SimpleCloud.h"
 #include "ChunkedPointCloud.h"
 #include "Garbage.h"
+#include "GaussianElimination.h"
 #include "Jacobi.h"
 #include "SortAlgo.h"
 
@@ -146,6 +150,95 @@ struct DataCloud
 	ChunkedPointCloud* CPSetPlain;
 };
 
+//! Computes the distances between the data points and the model entity with a static index
+/** See ICPRegistrationTools::Parameters::useStaticModelIndex.
+	The data points scalar values and the Closest Point Set are updated.
+	\return success
+**/
+static bool ComputeDistancesWithStaticIndex(DataCloud& data,
+											const FlatKDTree* modelTree,
+											const TriangleBVH* modelBVH,
+											int maxThreadCount,
+											GenericProgressCallback* progressCb = 0)
+{
+	assert(modelTree || modelBVH);
+	unsigned pointCount = data.cloud->size();
+
+	//the data cloud may have been replaced by its rotated version (without scalar field)
+	if (!data.cloud->enableScalarField())
+		return false;
+
+	//Closest Point Set
+	if (data.CPSetRef)
+	{
+		if (!data.CPSetRef->resize(pointCount))
+			return false;
+	}
+	else if (data.CPSetPlain)
+	{
+		if (!data.CPSetPlain->resize(pointCount))
+			return false;
+	}
+	else
+	{
+		assert(false);
+		return false;
+	}
+
+	NormalizedProgress nProgress(progressCb, pointCount);
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			char buffer[64];
+			sprintf(buffer, "Points: %u", pointCount);
+			progressCb->setInfo(buffer);
+			progressCb->setMethodTitle("Compute distances");
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	ParallelCancelToken cancelToken;
+	ParallelTools::ForEach(	pointCount,
+							[&](unsigned i)
+							{
+								CCVector3 P;
+								data.cloud->getPoint(i, P);
+
+								ScalarType squareDist = NAN_VALUE;
+								if (modelTree)
+								{
+									unsigned nearestIndex = 0;
+									if (modelTree->findNearestNeighbour(P, nearestIndex, squareDist))
+										data.CPSetRef->setPointIndex(i, nearestIndex);
+								}
+								else
+								{
+									unsigned triIndex = 0;
+									CCVector3 nearestPoint;
+									if (modelBVH->findClosestTriangle(P, triIndex, squareDist, 0, &nearestPoint))
+										*const_cast<CCVector3*>(data.CPSetPlain->getPoint(i)) = nearestPoint;
+								}
+								data.cloud->setPointScalarValue(i, sqrt(squareDist));
+
+								if (!nProgress.oneStep())
+								{
+									//process cancelled by the user
+									cancelToken.cancel();
+								}
+							},
+							maxThreadCount,
+							&cancelToken);
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	return !cancelToken.isCanceled();
+}
+
 ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexedCloudPersist* inputModelCloud,
 																	GenericIndexedMesh* inputModelMesh,
 																	GenericIndexedCloudPersist* inputDataCloud,
@@ -161,6 +254,12 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		return ICP_ERROR_INVALID_INPUT;
 	}
 
+	//the point-to-plane variant requires the model cloud normals
+	if (params.pointToPlane && (inputModelMesh || !params.modelNormals || params.modelNormals->size() != inputModelCloud->size()))
+	{
+		return ICP_ERROR_INVALID_INPUT;
+	}
+
 
 	//hopefully the user will understand it's not possible ;)
 	finalRMS = -1.0;
@@ -296,6 +395,58 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		assert(model.cloud);
 	}
 
+	//model normals (point-to-plane variant)
+	std::vector<CCVector3> sampledModelNormals;
+	const std::vector<CCVector3>* modelNormals = 0;
+	if (params.pointToPlane)
+	{
+		if (model.cloud == inputModelCloud)
+		{
+			modelNormals = params.modelNormals;
+		}
+		else
+		{
+			//we must resample the normals as well
+			ReferenceCloud* subModelCloud = static_cast<ReferenceCloud*>(model.cloud);
+			unsigned destCount = subModelCloud->size();
+			try
+			{
+				sampledModelNormals.resize(destCount);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+				return ICP_ERROR_NOT_ENOUGH_MEMORY;
+			}
+			for (unsigned i = 0; i < destCount; ++i)
+			{
+				sampledModelNormals[i] = params.modelNormals->at(subModelCloud->getPointGlobalIndex(i));
+			}
+			modelNormals = &sampledModelNormals;
+		}
+	}
+
+	//static index of the model entity (built once for all iterations)
+	FlatKDTree modelTree;
+	TriangleBVH modelBVH;
+	const FlatKDTree* modelTreePtr = 0;
+	const TriangleBVH* modelBVHPtr = 0;
+	if (params.useStaticModelIndex)
+	{
+		if (inputModelMesh)
+		{
+			if (!modelBVH.buildFromMesh(inputModelMesh, progressCb))
+				return ICP_ERROR_NOT_ENOUGH_MEMORY;
+			modelBVHPtr = &modelBVH;
+		}
+		else
+		{
+			if (!modelTree.buildFromCloud(model.cloud, progressCb))
+				return ICP_ERROR_NOT_ENOUGH_MEMORY;
+			modelTreePtr = &modelTree;
+		}
+	}
+
 	//for partial overlap
 	unsigned maxOverlapCount = 0;
 	std::vector<ScalarType> overlapDistances;
@@ -337,7 +488,15 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 
 	//we compute the initial distance between the two clouds (and the CPSet by the way)
 	//data.cloud->forEach(ScalarFieldTools::SetScalarValueToNaN); //DGM: done automatically in computeCloud2CloudDistance now
-	if (inputModelMesh)
+	if (params.useStaticModelIndex)
+	{
+		if (!ComputeDistancesWithStaticIndex(data, modelTreePtr, modelBVHPtr, params.maxThreadCount, progressCb))
+		{
+			//an error occurred during distances computation...
+			return ICP_ERROR_DIST_COMPUTATION;
+		}
+	}
+	else if (inputModelMesh)
 	{
 		assert(data.CPSetPlain);
 		DistanceComputationTools::Cloud2MeshDistanceComputationParams c2mDistParams;
@@ -702,11 +861,25 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 
 		//single iteration of the registration procedure
 		currentTrans = ScaledTransformation();
-		if (!RegistrationTools::RegistrationProcedure(	data.cloud,
-														data.CPSetRef ? static_cast<CCLib::GenericCloud*>(data.CPSetRef) : static_cast<CCLib::GenericCloud*>(data.CPSetPlain),
-														currentTrans,
-														params.adjustScale,
-														coupleWeights))
+		bool stepSuccess = false;
+		if (params.pointToPlane)
+		{
+			assert(data.CPSetRef && modelNormals);
+			stepSuccess = RegistrationTools::PointToPlaneRegistrationProcedure(	data.cloud,
+																				data.CPSetRef,
+																				*modelNormals,
+																				currentTrans,
+																				coupleWeights);
+		}
+		else
+		{
+			stepSuccess = RegistrationTools::RegistrationProcedure(	data.cloud,
+																	data.CPSetRef ? static_cast<CCLib::GenericCloud*>(data.CPSetRef) : static_cast<CCLib::GenericCloud*>(data.CPSetPlain),
+																	currentTrans,
+																	params.adjustScale,
+																	coupleWeights);
+		}
+		if (!stepSuccess)
 		{
 			result = ICP_ERROR_REGISTRATION_STEP;
 			break;
@@ -768,7 +941,17 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		}
 
 		//compute (new) distances to model
-		if (inputModelMesh)
+		if (params.useStaticModelIndex)
+		{
+			//only the (transformed) data points have to be queried
+			if (!ComputeDistancesWithStaticIndex(data, modelTreePtr, modelBVHPtr, params.maxThreadCount))
+			{
+				//an error occurred during distances computation...
+				result = ICP_ERROR_REGISTRATION_STEP;
+				break;
+			}
+		}
+		else if (inputModelMesh)
 		{
 			DistanceComputationTools::Cloud2MeshDistanceComputationParams c2mDistParams;
 			c2mDistParams.octreeLevel = meshDistOctreeLevel;
@@ -815,6 +998,98 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 	return result;
 }
 
+bool RegistrationTools::PointToPlaneRegistrationProcedure(	GenericIndexedCloud* P, //data
+															ReferenceCloud* X, //model
+															const std::vector<CCVector3>& normals,
+															ScaledTransformation& trans,
+															ScalarField* coupleWeights/*=0*/)
+{
+	//resulting transformation (R is invalid on initialization, T is (0,0,0) and s==1)
+	trans.R.invalidate();
+	trans.T = CCVector3(0,0,0);
+	trans.s = PC_ONE;
+
+	if (P == 0 || X == 0 || P->size() != X->size() || P->size() < 6)
+		return false;
+
+	unsigned count = P->size();
+
+	//we work relatively to the data gravity center (for a better conditioning)
+	CCVector3d G = CCVector3d::fromArray(GeometricalAnalysisTools::computeGravityCenter(P).u);
+
+	//normal equations of the linearized problem
+	//unknowns: (alpha, beta, gamma) = rotation angles about X, Y and Z, then (tx, ty, tz)
+	double AtA[6][6] = { { 0 } };
+	double Atb[6] = { 0 };
+	unsigned validCount = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		double w = 1.0;
+		if (coupleWeights)
+		{
+			ScalarType sw = coupleWeights->getValue(i);
+			if (!ScalarField::ValidValue(sw))
+				continue;
+			w = fabs(sw);
+		}
+
+		const CCVector3& N = normals[X->getPointGlobalIndex(i)];
+		CCVector3d n = CCVector3d::fromArray(N.u);
+		if (n.norm2() < ZERO_TOLERANCE)
+			continue; //invalid normal
+
+		CCVector3d p = CCVector3d::fromArray(P->getPoint(i)->u) - G;
+		CCVector3d q = CCVector3d::fromArray(X->getPoint(i)->u) - G;
+
+		CCVector3d c = p.cross(n);
+		double a[6] = { c.x, c.y, c.z, n.x, n.y, n.z };
+		double b = (q - p).dot(n);
+
+		for (unsigned r = 0; r < 6; ++r)
+		{
+			for (unsigned k = r; k < 6; ++k)
+				AtA[r][k] += w * a[r] * a[k];
+			Atb[r] += w * a[r] * b;
+		}
+		++validCount;
+	}
+	if (validCount < 6)
+		return false;
+
+	//symmetric matrix
+	for (unsigned r = 1; r < 6; ++r)
+		for (unsigned k = 0; k < r; ++k)
+			AtA[r][k] = AtA[k][r];
+
+	//Gaussian elimination (with partial pivoting)
+	double x[6];
+	if (!GaussianElimination<6, double>::Solve(AtA, Atb, x, ZERO_TOLERANCE))
+		return false; //degenerate configuration
+
+	//rotation matrix: R = Rz(gamma).Ry(beta).Rx(alpha)
+	double ca = cos(x[0]), sa = sin(x[0]);
+	double cb = cos(x[1]), sb = sin(x[1]);
+	double cg = cos(x[2]), sg = sin(x[2]);
+	SquareMatrixd R(3);
+	R.m_values[0][0] = cg*cb;	R.m_values[0][1] = cg*sb*sa - sg*ca;	R.m_values[0][2] = cg*sb*ca + sg*sa;
+	R.m_values[1][0] = sg*cb;	R.m_values[1][1] = sg*sb*sa + cg*ca;	R.m_values[1][2] = sg*sb*ca - cg*sa;
+	R.m_values[2][0] = -sb;		R.m_values[2][1] = cb*sa;				R.m_values[2][2] = cb*ca;
+
+	trans.R = SquareMatrix(3);
+	for (unsigned r = 0; r < 3; ++r)
+		for (unsigned k = 0; k < 3; ++k)
+			trans.R.m_values[r][k] = static_cast<PointCoordinateType>(R.m_values[r][k]);
+
+	//the rotation is centered on G: T = G - R.G + t
+	CCVector3d t(x[3], x[4], x[5]);
+	CCVector3d RG(	R.m_values[0][0]*G.x + R.m_values[0][1]*G.y + R.m_values[0][2]*G.z,
+					R.m_values[1][0]*G.x + R.m_values[1][1]*G.y + R.m_values[1][2]*G.z,
+					R.m_values[2][0]*G.x + R.m_values[2][1]*G.y + R.m_values[2][2]*G.z);
+	trans.T = CCVector3::fromArray((G - RG + t).u);
+
+	return true;
+}
+
 bool HornRegistrationTools::FindAbsoluteOrientation(GenericCloud* lCloud,
 													GenericCloud* rCloud,
 													ScaledTransformation& trans,
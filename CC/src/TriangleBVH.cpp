@@ -0,0 +1,448 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "TriangleBVH.h"
+
+//local
+#include "DistanceComputationTools.h"
+#include "GenericIndexedMesh.h"
+#include "GenericProgressCallback.h"
+#include "ParallelTools.h"
+#include "SimpleTriangle.h"
+
+//system
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <stdio.h>
+
+using namespace CCLib;
+
+//! Number of bins used to evaluate the SAH cost
+static const unsigned BVH_BIN_COUNT = 16;
+//! Max number of triangles per leaf (unless the triangles can't be separated)
+static const unsigned BVH_MAX_LEAF_SIZE = 8;
+//! Max depth of the hierarchy (nodes at this depth are leaves whatever their size)
+static const unsigned BVH_MAX_DEPTH = 64;
+//! Cost of a node traversal (relatively to a point-to-triangle distance computation)
+static const PointCoordinateType BVH_TRAVERSAL_COST = static_cast<PointCoordinateType>(1.0);
+
+//! Returns the half surface area of a box
+static inline PointCoordinateType HalfArea(const CCVector3& bbMin, const CCVector3& bbMax)
+{
+	CCVector3 d = bbMax - bbMin;
+	return d.x*d.y + d.y*d.z + d.z*d.x;
+}
+
+//! Returns the squared distance between a point and a box (0 if the point is inside)
+static inline PointCoordinateType SquareDistToBox(const CCVector3& P, const CCVector3& bbMin, const CCVector3& bbMax)
+{
+	PointCoordinateType d2 = 0;
+	for (unsigned char k = 0; k < 3; ++k)
+	{
+		PointCoordinateType delta = 0;
+		if (P.u[k] < bbMin.u[k])
+			delta = bbMin.u[k] - P.u[k];
+		else if (P.u[k] > bbMax.u[k])
+			delta = P.u[k] - bbMax.u[k];
+		d2 += delta*delta;
+	}
+	return d2;
+}
+
+TriangleBVH::TriangleBVH()
+	: m_associatedMesh(0)
+{
+}
+
+TriangleBVH::~TriangleBVH()
+{
+}
+
+void TriangleBVH::clear()
+{
+	m_nodes.clear();
+	m_triIndexes.clear();
+	m_associatedMesh = 0;
+}
+
+size_t TriangleBVH::memoryUsage() const
+{
+	return m_nodes.capacity() * sizeof(Node) + m_triIndexes.capacity() * sizeof(unsigned);
+}
+
+void TriangleBVH::computeBoundingBox(const std::vector<TriangleBox>& boxes, unsigned first, unsigned count, CCVector3& bbMin, CCVector3& bbMax) const
+{
+	assert(count != 0);
+	const TriangleBox& firstBox = boxes[m_triIndexes[first]];
+	bbMin = firstBox.bbMin;
+	bbMax = firstBox.bbMax;
+	for (unsigned i = first + 1; i < first + count; ++i)
+	{
+		const TriangleBox& box = boxes[m_triIndexes[i]];
+		for (unsigned char k = 0; k < 3; ++k)
+		{
+			bbMin.u[k] = std::min(bbMin.u[k], box.bbMin.u[k]);
+			bbMax.u[k] = std::max(bbMax.u[k], box.bbMax.u[k]);
+		}
+	}
+}
+
+bool TriangleBVH::splitNode(unsigned nodeIndex, const std::vector<TriangleBox>& boxes)
+{
+	//warning: the nodes vector will grow
+	const unsigned first = m_nodes[nodeIndex].first;
+	const unsigned count = m_nodes[nodeIndex].count;
+	if (count <= 2)
+	{
+		return false;
+	}
+
+	//bounding-box of the triangles centers (we use 'min+max' = twice the center)
+	CCVector3 cMin, cMax;
+	{
+		const TriangleBox& firstBox = boxes[m_triIndexes[first]];
+		cMin = cMax = firstBox.bbMin + firstBox.bbMax;
+		for (unsigned i = first + 1; i < first + count; ++i)
+		{
+			const TriangleBox& box = boxes[m_triIndexes[i]];
+			CCVector3 c = box.bbMin + box.bbMax;
+			for (unsigned char k = 0; k < 3; ++k)
+			{
+				if (c.u[k] < cMin.u[k])
+					cMin.u[k] = c.u[k];
+				else if (c.u[k] > cMax.u[k])
+					cMax.u[k] = c.u[k];
+			}
+		}
+	}
+
+	//look for the best split (SAH)
+	int bestDim = -1;
+	unsigned bestBin = 0;
+	PointCoordinateType bestCost = FLT_MAX;
+	for (unsigned char dim = 0; dim < 3; ++dim)
+	{
+		PointCoordinateType extent = cMax.u[dim] - cMin.u[dim];
+		if (extent <= 0)
+			continue;
+		PointCoordinateType scale = static_cast<PointCoordinateType>(BVH_BIN_COUNT) / extent;
+
+		//fill the bins
+		unsigned binCount[BVH_BIN_COUNT];
+		CCVector3 binMin[BVH_BIN_COUNT], binMax[BVH_BIN_COUNT];
+		for (unsigned b = 0; b < BVH_BIN_COUNT; ++b)
+		{
+			binCount[b] = 0;
+			binMin[b] = CCVector3(FLT_MAX, FLT_MAX, FLT_MAX);
+			binMax[b] = CCVector3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+		for (unsigned i = first; i < first + count; ++i)
+		{
+			const TriangleBox& box = boxes[m_triIndexes[i]];
+			unsigned b = std::min(static_cast<unsigned>((box.bbMin.u[dim] + box.bbMax.u[dim] - cMin.u[dim]) * scale), BVH_BIN_COUNT - 1);
+			++binCount[b];
+			for (unsigned char k = 0; k < 3; ++k)
+			{
+				binMin[b].u[k] = std::min(binMin[b].u[k], box.bbMin.u[k]);
+				binMax[b].u[k] = std::max(binMax[b].u[k], box.bbMax.u[k]);
+			}
+		}
+
+		//sweep from the right to compute the right sides costs
+		PointCoordinateType rightCost[BVH_BIN_COUNT];
+		{
+			CCVector3 rMin(FLT_MAX, FLT_MAX, FLT_MAX), rMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			unsigned rCount = 0;
+			for (unsigned b = BVH_BIN_COUNT - 1; b > 0; --b)
+			{
+				rCount += binCount[b];
+				for (unsigned char k = 0; k < 3; ++k)
+				{
+					rMin.u[k] = std::min(rMin.u[k], binMin[b].u[k]);
+					rMax.u[k] = std::max(rMax.u[k], binMax[b].u[k]);
+				}
+				rightCost[b - 1] = (rCount ? HalfArea(rMin, rMax) * rCount : 0);
+			}
+		}
+
+		//then from the left (split 'b' means: bins [0;b] on the left side)
+		{
+			CCVector3 lMin(FLT_MAX, FLT_MAX, FLT_MAX), lMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			unsigned lCount = 0;
+			for (unsigned b = 0; b + 1 < BVH_BIN_COUNT; ++b)
+			{
+				lCount += binCount[b];
+				for (unsigned char k = 0; k < 3; ++k)
+				{
+					lMin.u[k] = std::min(lMin.u[k], binMin[b].u[k]);
+					lMax.u[k] = std::max(lMax.u[k], binMax[b].u[k]);
+				}
+				if (lCount == 0 || lCount == count)
+					continue;
+				PointCoordinateType cost = HalfArea(lMin, lMax) * lCount + rightCost[b];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestDim = dim;
+					bestBin = b;
+				}
+			}
+		}
+	}
+
+	Node& node = m_nodes[nodeIndex];
+	PointCoordinateType nodeArea = HalfArea(node.bbMin, node.bbMax);
+
+	unsigned leftCount = 0;
+	if (bestDim >= 0)
+	{
+		//is the split worth it?
+		if (count <= BVH_MAX_LEAF_SIZE && BVH_TRAVERSAL_COST * nodeArea + bestCost >= nodeArea * count)
+		{
+			return false;
+		}
+
+		PointCoordinateType scale = static_cast<PointCoordinateType>(BVH_BIN_COUNT) / (cMax.u[bestDim] - cMin.u[bestDim]);
+		PointCoordinateType minC = cMin.u[bestDim];
+		std::vector<unsigned>::iterator middle = std::partition(m_triIndexes.begin() + first,
+																m_triIndexes.begin() + (first + count),
+																[&](unsigned t)
+																{
+																	const TriangleBox& box = boxes[t];
+																	unsigned b = std::min(static_cast<unsigned>((box.bbMin.u[bestDim] + box.bbMax.u[bestDim] - minC) * scale), BVH_BIN_COUNT - 1);
+																	return b <= bestBin;
+																});
+		leftCount = static_cast<unsigned>(middle - (m_triIndexes.begin() + first));
+	}
+
+	if (leftCount == 0 || leftCount == count)
+	{
+		//the triangles can't be separated (same centers)
+		if (count <= BVH_MAX_LEAF_SIZE)
+		{
+			return false;
+		}
+		//we split them arbitrarily (so as to keep small leaves)
+		leftCount = count / 2;
+	}
+
+	Node children[2];
+	children[0].first = first;
+	children[0].count = leftCount;
+	children[1].first = first + leftCount;
+	children[1].count = count - leftCount;
+	for (unsigned c = 0; c < 2; ++c)
+	{
+		computeBoundingBox(boxes, children[c].first, children[c].count, children[c].bbMin, children[c].bbMax);
+	}
+
+	node.first = static_cast<unsigned>(m_nodes.size());
+	node.count = 0;
+	m_nodes.push_back(children[0]); //warning: 'node' is invalid from now on
+	m_nodes.push_back(children[1]);
+
+	return true;
+}
+
+bool TriangleBVH::buildFromMesh(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb/*=0*/)
+{
+	clear();
+
+	if (!mesh || mesh->size() == 0)
+	{
+		return false;
+	}
+
+	unsigned triCount = mesh->size();
+
+	std::vector<TriangleBox> boxes;
+	try
+	{
+		boxes.resize(triCount);
+		m_triIndexes.resize(triCount);
+		//a binary tree with leaves of ~BVH_MAX_LEAF_SIZE/2 triangles
+		m_nodes.reserve(2 * (triCount / (BVH_MAX_LEAF_SIZE / 2) + 1));
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		clear();
+		return false;
+	}
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			char buffer[64];
+			sprintf(buffer, "Triangles: %u", triCount);
+			progressCb->setInfo(buffer);
+			progressCb->setMethodTitle("Build triangles hierarchy");
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+	NormalizedProgress nProgress(progressCb, triCount);
+
+	//compute the triangles bounding-boxes
+	ParallelTools::ForEach(	triCount,
+							[&](unsigned i)
+							{
+								CCVector3 A, B, C;
+								mesh->getTriangleVertices(i, A, B, C);
+								TriangleBox& box = boxes[i];
+								for (unsigned char k = 0; k < 3; ++k)
+								{
+									box.bbMin.u[k] = std::min(A.u[k], std::min(B.u[k], C.u[k]));
+									box.bbMax.u[k] = std::max(A.u[k], std::max(B.u[k], C.u[k]));
+								}
+								m_triIndexes[i] = i;
+							});
+
+	//root node
+	Node root;
+	root.first = 0;
+	root.count = triCount;
+	computeBoundingBox(boxes, 0, triCount, root.bbMin, root.bbMax);
+	m_nodes.push_back(root);
+
+	//nodes to process (index and depth)
+	std::vector< std::pair<unsigned, unsigned> > nodesToSplit;
+	nodesToSplit.push_back(std::pair<unsigned, unsigned>(0, 0));
+
+	bool success = true;
+	try
+	{
+		while (!nodesToSplit.empty())
+		{
+			unsigned nodeIndex = nodesToSplit.back().first;
+			unsigned depth = nodesToSplit.back().second;
+			nodesToSplit.pop_back();
+
+			if (depth + 1 < BVH_MAX_DEPTH && splitNode(nodeIndex, boxes))
+			{
+				unsigned firstChild = m_nodes[nodeIndex].first;
+				nodesToSplit.push_back(std::pair<unsigned, unsigned>(firstChild + 1, depth + 1));
+				nodesToSplit.push_back(std::pair<unsigned, unsigned>(firstChild, depth + 1));
+			}
+			else if (!nProgress.steps(m_nodes[nodeIndex].count))
+			{
+				//process cancelled by user
+				success = false;
+				break;
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		success = false;
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	if (!success)
+	{
+		clear();
+		return false;
+	}
+
+	m_associatedMesh = mesh;
+
+	return true;
+}
+
+bool TriangleBVH::findClosestTriangle(	const CCVector3& P,
+										unsigned& triangleIndex,
+										ScalarType& squareDist,
+										ScalarType maxSquareDist/*=0*/,
+										CCVector3* nearestPoint/*=0*/) const
+{
+	if (m_nodes.empty() || !m_associatedMesh)
+	{
+		return false;
+	}
+
+	bool found = false;
+	ScalarType bestSquareDist = (maxSquareDist > 0 ? maxSquareDist : FLT_MAX);
+
+	CCVector3 candidatePoint;
+	CCVector3* _candidatePoint = nearestPoint ? &candidatePoint : 0;
+
+	//nodes to visit (the depth of the hierarchy is bounded)
+	unsigned stack[BVH_MAX_DEPTH + 2];
+	unsigned stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize != 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (SquareDistToBox(P, node.bbMin, node.bbMax) > bestSquareDist)
+		{
+			continue;
+		}
+
+		if (node.count != 0)
+		{
+			//leaf: test the triangles
+			for (unsigned i = node.first; i < node.first + node.count; ++i)
+			{
+				unsigned t = m_triIndexes[i];
+				SimpleTriangle tri;
+				m_associatedMesh->getTriangleVertices(t, tri.A, tri.B, tri.C);
+				ScalarType d2 = DistanceComputationTools::computePoint2TriangleDistance(&P, &tri, false, _candidatePoint);
+				if (d2 < bestSquareDist || (!found && d2 <= bestSquareDist))
+				{
+					bestSquareDist = d2;
+					triangleIndex = t;
+					found = true;
+					if (nearestPoint)
+						*nearestPoint = candidatePoint;
+				}
+			}
+		}
+		else
+		{
+			//inner node: we visit the closest child first
+			unsigned c0 = node.first;
+			unsigned c1 = node.first + 1;
+			PointCoordinateType d0 = SquareDistToBox(P, m_nodes[c0].bbMin, m_nodes[c0].bbMax);
+			PointCoordinateType d1 = SquareDistToBox(P, m_nodes[c1].bbMin, m_nodes[c1].bbMax);
+			if (d0 > d1)
+			{
+				std::swap(c0, c1);
+				std::swap(d0, d1);
+			}
+			if (d1 <= bestSquareDist)
+				stack[stackSize++] = c1;
+			if (d0 <= bestSquareDist)
+				stack[stackSize++] = c0;
+		}
+	}
+
+	if (found)
+	{
+		squareDist = bestSquareDist;
+	}
+
+	return found;
+}
@@ -17,6 +17,38 @@
 
 #include "ccAdvancedTypes.h"
 
+//! Normal codes format (dataVersion >= 50)
+enum NormalCodesFormat
+{
+	STANDARD_NORMAL_CODES = 0,
+	PRECISE_NORMAL_CODES = 1,
+};
+
+bool NormsIndexesTableType::hasPreciseCodes() const
+{
+	for (unsigned c = 0; c < chunksCount(); ++c)
+	{
+		const CompressedNormType* codes = chunkStartPtr(c);
+		unsigned chunkSize = this->chunkSize(c);
+		for (unsigned i = 0; i < chunkSize; ++i)
+		{
+			if (codes[i] != ccNormalCompressor::GetStandardCode(codes[i]))
+				return true;
+		}
+	}
+	return false;
+}
+
+bool NormsIndexesTableType::toFile_MeOnly(QFile& out) const
+{
+	//codes format (dataVersion >= 50)
+	uint8_t format = static_cast<uint8_t>(hasPreciseCodes() ? PRECISE_NORMAL_CODES : STANDARD_NORMAL_CODES);
+	if (out.write((const char*)&format, 1) < 0)
+		return WriteError();
+
+	return ccSerializationHelper::GenericArrayToFile(*this, out);
+}
+
 bool NormsIndexesTableType::fromFile_MeOnly(QFile& in, short dataVersion, int flags)
 {
 	if (dataVersion < 41)
@@ -57,6 +89,34 @@ bool NormsIndexesTableType::fromFile_MeOnly(QFile& in, short dataVersion, int fl
 	}
 	else
 	{
-		return ccSerializationHelper::GenericArrayFromFile(*this, in, dataVersion);
+		//codes format (dataVersion >= 50)
+		uint8_t format = STANDARD_NORMAL_CODES;
+		if (dataVersion >= 50)
+		{
+			if (in.read((char*)&format, 1) < 0)
+				return ReadError();
+			if (format != STANDARD_NORMAL_CODES && format != PRECISE_NORMAL_CODES)
+				return CorruptError();
+		}
+
+		if (!ccSerializationHelper::GenericArrayFromFile(*this, in, dataVersion))
+			return false;
+
+		//check the codes
+		for (unsigned c = 0; c < chunksCount(); ++c)
+		{
+			const CompressedNormType* codes = chunkStartPtr(c);
+			unsigned chunkSize = this->chunkSize(c);
+			for (unsigned i = 0; i < chunkSize; ++i)
+			{
+				if (	ccNormalCompressor::GetStandardCode(codes[i]) > ccNormalCompressor::NULL_NORM_CODE
+					||	(format == STANDARD_NORMAL_CODES && codes[i] > ccNormalCompressor::NULL_NORM_CODE))
+				{
+					return CorruptError();
+				}
+			}
+		}
+
+		return true;
 	}
 }
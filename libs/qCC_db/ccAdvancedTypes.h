@@ -50,7 +50,11 @@ public:
 		return cloneArray;
 	}
 
+	//! Returns whether the array contains 'precise' normal codes (see ccNormalVectors::GetPreciseNormIndex)
+	bool hasPreciseCodes() const;
+
 	//inherited from ccHObject/ccChunkedArray
+	virtual bool toFile_MeOnly(QFile& out) const override;
 	virtual bool fromFile_MeOnly(QFile& in, short dataVersion, int flags) override;
 };
 
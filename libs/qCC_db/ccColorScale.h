@@ -248,9 +248,7 @@ public:
 		assert(m_updated);
 		if (relativePos >= 0.0 && relativePos <= 1.0)
 		{
-			//quantized (16 bits) version --> much faster than floor!
-			unsigned index = (static_cast<unsigned>((relativePos*steps)*65535.0))>>16;
-			return getColorByIndex((index*(MAX_STEPS-1)) / steps).rgba;
+			return getColorByIndex(GetColorIndex(relativePos, steps)).rgba;
 		}
 		else
 		{
@@ -258,6 +256,19 @@ public:
 		}
 	}
 
+	//! Returns the color index corresponding to a relative position with a given 'resolution'
+	/** See getColorByRelativePos.
+		\param relativePos relative position (must be between 0 and 1!)
+		\param steps desired resolution (must be greater than 1 and smaller than MAX_STEPS)
+		\return color index (see getColorByIndex)
+	**/
+	static inline unsigned GetColorIndex(double relativePos, unsigned steps)
+	{
+		//quantized (16 bits) version --> much faster than floor!
+		unsigned index = (static_cast<unsigned>((relativePos*steps)*65535.0))>>16;
+		return (index*(MAX_STEPS-1)) / steps;
+	}
+
 	//! Returns color by index
 	/** \param index color index in m_rgbaScale array (must be below MAX_STEPS)
 		\return corresponding color
@@ -245,7 +245,7 @@ int ccFastMarchingForNormsDirection::step()
 					float t_new = computeT(nIndex);
 
 					if (t_new < t_old)
-						nCell->T = t_new;
+						updateTrialCell(nIndex, t_new);
 				}
 			}
 		}
@@ -306,7 +306,7 @@ unsigned ccFastMarchingForNormsDirection::updateResolvedTable(	ccGenericPointClo
 			resolved.setValue(index,1);
 
 			const CompressedNormType& norm = theNorms->getValue(index);
-			const CCVector3& N = ccNormalVectors::GetNormal(norm);
+			CCVector3 N = ccNormalVectors::GetPreciseNormal(norm);
 
 			//inverse point normal if necessary
 			if (N.dot(aCell->N) < 0)
@@ -351,10 +351,10 @@ void ccFastMarchingForNormsDirection::initTrialCells()
 			if (nCell/* && nCell->state == DirectionCell::FAR_CELL*/)
 			{
 				assert(nCell->state == DirectionCell::FAR_CELL);
-				addTrialCell(nIndex);
-
 				//compute its approximate arrival time
 				nCell->T = seedCell->T + m_neighboursDistance[i] * computeTCoefApprox(seedCell,nCell);
+
+				addTrialCell(nIndex);
 			}
 		}
 	}
@@ -498,6 +498,9 @@ bool ccGenericPointCloud::pointPicking(	const CCVector2d& clickPos,
 					&&	fabs(Q2D.y - clickPos.y) <= pickHeight)
 				{
 					double squareDist = CCVector3d(X.x - P->x, X.y - P->y, X.z - P->z).norm2d();
+#if defined(_OPENMP)
+#pragma omp critical(ccGenericPointCloudPointPicking)
+#endif
 					if (nearestPointIndex < 0 || squareDist < nearestSquareDist)
 					{
 						nearestSquareDist = squareDist;
@@ -152,7 +152,7 @@ public:
 	//! Returns normal corresponding to a given point
 	/** WARNING: normals array must be enabled! (see ccDrawableObject::hasNormals)
 	**/
-	virtual const CCVector3& getPointNormal(unsigned pointIndex) const = 0;
+	virtual CCVector3 getPointNormal(unsigned pointIndex) const = 0;
 
 
 	/***************************************************
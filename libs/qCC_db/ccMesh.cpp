@@ -534,7 +534,7 @@ void ccMesh::transformTriNormals(const ccGLMatrix& trans)
             for (unsigned i=0; i<numTriNormals; i++)
             {
                 CompressedNormType* _theNormIndex = m_triNormals->getCurrentValuePtr();
-                CCVector3 new_n(ccNormalVectors::GetNormal(*_theNormIndex));
+                CCVector3 new_n(ccNormalVectors::GetPreciseNormal(*_theNormIndex));
                 trans.applyRotation(new_n);
                 *_theNormIndex = ccNormalVectors::GetNormIndex(new_n.u);
                 m_triNormals->forwardIterator();
@@ -22,40 +22,74 @@
 
 //System
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
-void ccNormalCompressor::InvertNormal(CompressedNormType &code)
+static_assert(ccNormalCompressor::STANDARD_CODE_BITS + 2 * ccNormalCompressor::PRECISE_OFFSET_BITS == 8 * sizeof(CompressedNormType), "Invalid precise normal codes layout");
+
+unsigned ccNormalCompressor::MakePreciseCode(unsigned standardCode, int du, int dv)
 {
-	if (code != NULL_NORM_CODE)
+	assert(standardCode <= NULL_NORM_CODE);
+	assert(std::abs(du) <= MAX_PRECISE_OFFSET && std::abs(dv) <= MAX_PRECISE_OFFSET);
+	if (standardCode == NULL_NORM_CODE)
 	{
-		//see 'Decompress' for a better understanding
-		code ^= (static_cast<CompressedNormType>(7) << 2 * QUANTIZE_LEVEL);
+		return NULL_NORM_CODE;
 	}
+
+	//offsets are stored in two's complement (so that null offsets give the standard code)
+	static const unsigned offsetMask = (1 << PRECISE_OFFSET_BITS) - 1;
+	return	standardCode
+		|	((static_cast<unsigned>(du) & offsetMask) << STANDARD_CODE_BITS)
+		|	((static_cast<unsigned>(dv) & offsetMask) << (STANDARD_CODE_BITS + PRECISE_OFFSET_BITS));
 }
 
-unsigned ccNormalCompressor::Compress(const PointCoordinateType n[3])
+void ccNormalCompressor::GetPreciseOffsets(unsigned code, int& du, int& dv)
 {
-	assert(QUANTIZE_LEVEL != 0);
+	static const unsigned offsetMask = (1 << PRECISE_OFFSET_BITS) - 1;
+	static const int signBit = (1 << (PRECISE_OFFSET_BITS - 1));
 
-	/// compute in which sector lie the elements
-	unsigned res = 0;
-	PointCoordinateType x, y, z;
-	if (n[0] >= 0) { x = n[0]; } else { res |= 4; x = -n[0]; }
-	if (n[1] >= 0) { y = n[1]; } else { res |= 2; y = -n[1]; }
-	if (n[2] >= 0) { z = n[2]; } else { res |= 1; z = -n[2]; }
+	du = static_cast<int>((code >> STANDARD_CODE_BITS) & offsetMask);
+	dv = static_cast<int>((code >> (STANDARD_CODE_BITS + PRECISE_OFFSET_BITS)) & offsetMask);
+	if (du & signBit)
+		du -= (1 << PRECISE_OFFSET_BITS);
+	if (dv & signBit)
+		dv -= (1 << PRECISE_OFFSET_BITS);
+}
 
-	/// scale the sectored vector - early return for null vector
-	PointCoordinateType psnorm = x + y + z;
-	if (psnorm == 0)
+void ccNormalCompressor::InvertNormal(CompressedNormType &code)
+{
+	if (GetStandardCode(code) != NULL_NORM_CODE)
 	{
-		return NULL_NORM_CODE;
+		//see 'Decompress' for a better understanding
+		code ^= (static_cast<CompressedNormType>(7) << 2 * QUANTIZE_LEVEL);
+
+		//the second axis of the offsets frame is not inverted with the normal
+		//(see ccNormalVectors::GetPreciseNormal)
+		int du = 0, dv = 0;
+		GetPreciseOffsets(code, du, dv);
+		if (dv != 0)
+		{
+			code = static_cast<CompressedNormType>(MakePreciseCode(GetStandardCode(code), du, -dv));
+		}
 	}
-	x /= psnorm; y /= psnorm; z /= psnorm;
+}
 
+//! Quantizes a normalized vector lying in the first octant (i.e. x, y, z >= 0 and x + y + z = 1)
+/** \param res octant bits
+	\param x first coordinate
+	\param y second coordinate
+	\param z third coordinate
+	\return the complete normal code
+**/
+static unsigned CompressInOctant(unsigned res, PointCoordinateType x, PointCoordinateType y, PointCoordinateType z)
+{
 	/// compute the box
 	PointCoordinateType box[6] = { 0, 0, 0, 1, 1, 1 };
+	PointCoordinateType psnorm = 0;
 	/// then for each required level, quantize...
 	bool flip = false;
-	for (unsigned char level = QUANTIZE_LEVEL; level != 0; )
+	for (unsigned char level = ccNormalCompressor::QUANTIZE_LEVEL; level != 0; )
 	{
 		//next level
 		res <<= 2;
@@ -122,6 +156,175 @@ unsigned ccNormalCompressor::Compress(const PointCoordinateType n[3])
 	return res;
 }
 
+//! Number of subdivisions of each octant edge at the finest quantization level
+static const unsigned LUT_RESOLUTION = (1 << ccNormalCompressor::QUANTIZE_LEVEL);
+
+//! Lookup table of the (octant-relative) codes
+/** The recursive subdivision of an octant face (x + y + z = 1) is a regular triangular
+	lattice with LUT_RESOLUTION subdivisions per edge. Each elementary triangle is
+	either 'upward' (floor(R.x) + floor(R.y) + floor(R.z) = R - 1) or 'downward' (= R - 2),
+	and is indexed by (floor(R.x), floor(R.y), downward).
+	The table is built once, by quantizing the center of each triangle with the recursive
+	algorithm, so that both methods give exactly the same codes.
+**/
+static std::vector<unsigned> BuildCompressionLUT()
+{
+	std::vector<unsigned> lut(2 * LUT_RESOLUTION * LUT_RESOLUTION, 0);
+
+	const PointCoordinateType R = static_cast<PointCoordinateType>(LUT_RESOLUTION);
+	const unsigned octantMask = (1 << (2 * ccNormalCompressor::QUANTIZE_LEVEL)) - 1;
+	for (unsigned i = 0; i < LUT_RESOLUTION; ++i)
+	{
+		for (unsigned j = 0; i + j < LUT_RESOLUTION; ++j)
+		{
+			//upward triangle (i + j + k = R - 1)
+			{
+				unsigned k = LUT_RESOLUTION - 1 - i - j;
+				PointCoordinateType x = (i + static_cast<PointCoordinateType>(1.0 / 3.0)) / R;
+				PointCoordinateType y = (j + static_cast<PointCoordinateType>(1.0 / 3.0)) / R;
+				PointCoordinateType z = (k + static_cast<PointCoordinateType>(1.0 / 3.0)) / R;
+				lut[2 * (i * LUT_RESOLUTION + j)] = (CompressInOctant(0, x, y, z) & octantMask);
+			}
+			//downward triangle (i + j + k = R - 2)
+			if (i + j + 2 <= LUT_RESOLUTION)
+			{
+				unsigned k = LUT_RESOLUTION - 2 - i - j;
+				PointCoordinateType x = (i + static_cast<PointCoordinateType>(2.0 / 3.0)) / R;
+				PointCoordinateType y = (j + static_cast<PointCoordinateType>(2.0 / 3.0)) / R;
+				PointCoordinateType z = (k + static_cast<PointCoordinateType>(2.0 / 3.0)) / R;
+				lut[2 * (i * LUT_RESOLUTION + j) + 1] = (CompressInOctant(0, x, y, z) & octantMask);
+			}
+		}
+	}
+
+	return lut;
+}
+
+//! Returns the (unique) compression lookup table
+static const std::vector<unsigned>& GetCompressionLUT()
+{
+	//thread-safe initialization (the table is built on first use)
+	static const std::vector<unsigned> s_lut = BuildCompressionLUT();
+	return s_lut;
+}
+
+//! Quantizes a normalized vector lying in the first octant with the lookup table
+/** Falls back to the recursive algorithm for the (rare) points lying exactly on
+	the edges of the elementary triangles, as well as when rounding errors make the
+	lattice coordinates inconsistent.
+**/
+static inline unsigned CompressInOctantWithLUT(	const std::vector<unsigned>& lut,
+												unsigned res,
+												PointCoordinateType x,
+												PointCoordinateType y,
+												PointCoordinateType z)
+{
+	const PointCoordinateType R = static_cast<PointCoordinateType>(LUT_RESOLUTION);
+	PointCoordinateType a = x * R;
+	PointCoordinateType b = y * R;
+	PointCoordinateType c = z * R;
+	unsigned i = static_cast<unsigned>(a);
+	unsigned j = static_cast<unsigned>(b);
+	unsigned k = static_cast<unsigned>(c);
+
+	unsigned sum = i + j + k;
+	if (	(sum + 1 == LUT_RESOLUTION || sum + 2 == LUT_RESOLUTION)
+		&&	a != static_cast<PointCoordinateType>(i)
+		&&	b != static_cast<PointCoordinateType>(j)
+		&&	c != static_cast<PointCoordinateType>(k) )
+	{
+		unsigned downward = (sum + 2 == LUT_RESOLUTION ? 1 : 0);
+		return (res << (2 * ccNormalCompressor::QUANTIZE_LEVEL)) | lut[2 * (i * LUT_RESOLUTION + j) + downward];
+	}
+
+	return CompressInOctant(res, x, y, z);
+}
+
+unsigned ccNormalCompressor::CompressHierarchical(const PointCoordinateType n[3])
+{
+	assert(QUANTIZE_LEVEL != 0);
+
+	/// compute in which sector lie the elements
+	unsigned res = 0;
+	PointCoordinateType x, y, z;
+	if (n[0] >= 0) { x = n[0]; } else { res |= 4; x = -n[0]; }
+	if (n[1] >= 0) { y = n[1]; } else { res |= 2; y = -n[1]; }
+	if (n[2] >= 0) { z = n[2]; } else { res |= 1; z = -n[2]; }
+
+	/// scale the sectored vector - early return for null vector
+	PointCoordinateType psnorm = x + y + z;
+	if (psnorm == 0)
+	{
+		return NULL_NORM_CODE;
+	}
+	x /= psnorm; y /= psnorm; z /= psnorm;
+
+	return CompressInOctant(res, x, y, z);
+}
+
+unsigned ccNormalCompressor::Compress(const PointCoordinateType n[3])
+{
+	static const std::vector<unsigned>& lut = GetCompressionLUT();
+
+	/// compute in which sector lie the elements
+	unsigned res = 0;
+	PointCoordinateType x, y, z;
+	if (n[0] >= 0) { x = n[0]; } else { res |= 4; x = -n[0]; }
+	if (n[1] >= 0) { y = n[1]; } else { res |= 2; y = -n[1]; }
+	if (n[2] >= 0) { z = n[2]; } else { res |= 1; z = -n[2]; }
+
+	/// scale the sectored vector - early return for null vector
+	PointCoordinateType psnorm = x + y + z;
+	if (psnorm == 0)
+	{
+		return NULL_NORM_CODE;
+	}
+	x /= psnorm; y /= psnorm; z /= psnorm;
+
+	return CompressInOctantWithLUT(lut, res, x, y, z);
+}
+
+void ccNormalCompressor::Compress(const PointCoordinateType* N, unsigned count, CompressedNormType* codes)
+{
+	static const std::vector<unsigned>& lut = GetCompressionLUT();
+
+	//we process the normals by blocks: the first (branchless) pass can be vectorized by the compiler
+	static const unsigned BLOCK_SIZE = 256;
+	PointCoordinateType x[BLOCK_SIZE], y[BLOCK_SIZE], z[BLOCK_SIZE];
+	unsigned octant[BLOCK_SIZE];
+
+	for (unsigned blockStart = 0; blockStart < count; blockStart += BLOCK_SIZE)
+	{
+		unsigned blockSize = std::min(BLOCK_SIZE, count - blockStart);
+		const PointCoordinateType* n = N + 3 * static_cast<size_t>(blockStart);
+
+		for (unsigned i = 0; i < blockSize; ++i)
+		{
+			PointCoordinateType nx = n[3 * i];
+			PointCoordinateType ny = n[3 * i + 1];
+			PointCoordinateType nz = n[3 * i + 2];
+			octant[i] = (nx < 0 ? 4 : 0) | (ny < 0 ? 2 : 0) | (nz < 0 ? 1 : 0);
+			x[i] = std::abs(nx);
+			y[i] = std::abs(ny);
+			z[i] = std::abs(nz);
+		}
+
+		CompressedNormType* _codes = codes + blockStart;
+		for (unsigned i = 0; i < blockSize; ++i)
+		{
+			PointCoordinateType psnorm = x[i] + y[i] + z[i];
+			if (psnorm == 0)
+			{
+				_codes[i] = static_cast<CompressedNormType>(NULL_NORM_CODE);
+			}
+			else
+			{
+				_codes[i] = static_cast<CompressedNormType>(CompressInOctantWithLUT(lut, octant[i], x[i] / psnorm, y[i] / psnorm, z[i] / psnorm));
+			}
+		}
+	}
+}
+
 void ccNormalCompressor::Decompress(unsigned index, PointCoordinateType n[3], unsigned char level/*=QUANTIZE_LEVEL*/)
 {
 	assert(level != 0);
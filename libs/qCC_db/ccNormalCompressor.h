@@ -36,9 +36,47 @@ public:
 	//! Null normal code
 	static const unsigned NULL_NORM_CODE = MAX_VALID_NORM_CODE + 1;
 
+	//! Number of bits used by the standard codes (including the null code)
+	static const unsigned char STANDARD_CODE_BITS = QUANTIZE_LEVEL * 2 + 4;
+	//! Mask of the standard part of a normal code
+	static const unsigned STANDARD_NORM_CODE_MASK = (1 << STANDARD_CODE_BITS) - 1;
+
+	//! Number of bits of each offset of a 'precise' code
+	/** A precise code is a standard code (lower bits) followed by two offsets (upper bits)
+		relatively to the corresponding standard normal (see ccNormalVectors::GetPreciseNormIndex).
+		A standard code is a precise code with null offsets.
+	**/
+	static const unsigned char PRECISE_OFFSET_BITS = 5;
+	//! Max (absolute) value of the offsets of a 'precise' code
+	static const int MAX_PRECISE_OFFSET = (1 << (PRECISE_OFFSET_BITS - 1)) - 1;
+
+	//! Returns the standard part of a (standard or precise) normal code
+	static inline unsigned GetStandardCode(unsigned code) { return code & STANDARD_NORM_CODE_MASK; }
+
+	//! Builds a precise code from a standard code and two offsets (in [-MAX_PRECISE_OFFSET ; MAX_PRECISE_OFFSET])
+	static unsigned MakePreciseCode(unsigned standardCode, int du, int dv);
+
+	//! Returns the offsets of a precise code (both are null for a standard code)
+	static void GetPreciseOffsets(unsigned code, int& du, int& dv);
+
 	//! Compression algorithm
+	/** Constant time: relies on a precomputed lookup table (see CompressHierarchical
+		for the equivalent - and slower - recursive algorithm).
+	**/
 	static unsigned Compress(const PointCoordinateType N[3]);
 
+	//! Compresses an array of normals
+	/** \param N normals (3 contiguous coordinates per normal)
+		\param count number of normals
+		\param codes output codes (must be already allocated with at least 'count' elements)
+	**/
+	static void Compress(const PointCoordinateType* N, unsigned count, CompressedNormType* codes);
+
+	//! Original (recursive) compression algorithm
+	/** Gives exactly the same codes as Compress, but iterates over all the quantization levels.
+	**/
+	static unsigned CompressHierarchical(const PointCoordinateType N[3]);
+
 	//! Decompression algorithm
 	static void Decompress(unsigned index, PointCoordinateType N[3], unsigned char level = QUANTIZE_LEVEL);
 
@@ -27,9 +27,11 @@
 #include <GenericIndexedMesh.h>
 #include <GenericProgressCallback.h>
 #include <Neighbourhood.h>
+#include <NormalEstimationKernels.h>
 
 //System
 #include <assert.h>
+#include <atomic>
 #include <random>
 
 //unique instance
@@ -66,13 +68,143 @@ ccNormalVectors::~ccNormalVectors()
 		delete[] m_theNormalHSVColors;
 }
 
+//Whether the higher precision normal codes are enabled or not
+static std::atomic<bool> s_preciseNormals(false);
+
+//! Quantization step of the 'precise' codes offsets
+/** The angle between a normal and the corresponding standard normal is always below
+	0.00287 rad (0.164 degree), hence the range of the offsets.
+**/
+static const PointCoordinateType PRECISE_OFFSET_STEP = static_cast<PointCoordinateType>(0.003 / ccNormalCompressor::MAX_PRECISE_OFFSET);
+
+//! Returns the frame in which the offsets of the 'precise' codes are expressed
+/** The first axis is orthogonal to C and to the axis the least aligned with C,
+	so that it is inverted with C (the second axis is not).
+**/
+static void GetPreciseOffsetsFrame(const CCVector3& C, CCVector3& T1, CCVector3& T2)
+{
+	PointCoordinateType ax = std::abs(C.x);
+	PointCoordinateType ay = std::abs(C.y);
+	PointCoordinateType az = std::abs(C.z);
+	unsigned char dim = (ax <= ay ? (ax <= az ? 0 : 2) : (ay <= az ? 1 : 2));
+
+	CCVector3 axis(0, 0, 0);
+	axis.u[dim] = PC_ONE;
+	T1 = axis.cross(C);
+	T1.normalize();
+	T2 = C.cross(T1);
+}
+
+//! Completes a standard code with the offsets of the input normal (see GetPreciseNormIndex)
+static CompressedNormType ToPreciseCode(const CCVector3* table, const PointCoordinateType N[], unsigned code)
+{
+	if (code == ccNormalCompressor::NULL_NORM_CODE)
+	{
+		return static_cast<CompressedNormType>(code);
+	}
+
+	const CCVector3& C = table[code];
+	CCVector3 T1, T2;
+	GetPreciseOffsetsFrame(C, T1, T2);
+
+	//we project the normal on the plane tangent to the sphere at C
+	CCVector3 P(N);
+	PointCoordinateType dot = P.dot(C);
+	if (dot <= 0)
+	{
+		assert(false);
+		return static_cast<CompressedNormType>(code);
+	}
+	P /= dot;
+
+	int du = static_cast<int>(floor(P.dot(T1) / PRECISE_OFFSET_STEP + 0.5));
+	int dv = static_cast<int>(floor(P.dot(T2) / PRECISE_OFFSET_STEP + 0.5));
+	du = std::max(-ccNormalCompressor::MAX_PRECISE_OFFSET, std::min(du, ccNormalCompressor::MAX_PRECISE_OFFSET));
+	dv = std::max(-ccNormalCompressor::MAX_PRECISE_OFFSET, std::min(dv, ccNormalCompressor::MAX_PRECISE_OFFSET));
+
+	return static_cast<CompressedNormType>(ccNormalCompressor::MakePreciseCode(code, du, dv));
+}
+
+//! Decodes a (standard or precise) code
+static inline CCVector3 FromPreciseCode(const CCVector3* table, CompressedNormType code)
+{
+	const CCVector3& C = table[ccNormalCompressor::GetStandardCode(code)];
+
+	int du = 0, dv = 0;
+	ccNormalCompressor::GetPreciseOffsets(code, du, dv);
+	if (du == 0 && dv == 0)
+	{
+		return C;
+	}
+
+	CCVector3 T1, T2;
+	GetPreciseOffsetsFrame(C, T1, T2);
+	CCVector3 N = C + T1 * (du * PRECISE_OFFSET_STEP) + T2 * (dv * PRECISE_OFFSET_STEP);
+	N.normalize();
+	return N;
+}
+
+void ccNormalVectors::EnablePreciseNormals(bool state)
+{
+	s_preciseNormals = state;
+}
+
+bool ccNormalVectors::PreciseNormalsEnabled()
+{
+	return s_preciseNormals;
+}
+
 CompressedNormType ccNormalVectors::GetNormIndex(const PointCoordinateType N[])
 {
+	if (s_preciseNormals)
+	{
+		return GetPreciseNormIndex(N);
+	}
+
 	unsigned index = ccNormalCompressor::Compress(N);
 
 	return static_cast<CompressedNormType>(index);
 }
 
+CompressedNormType ccNormalVectors::GetPreciseNormIndex(const PointCoordinateType N[])
+{
+	unsigned index = ccNormalCompressor::Compress(N);
+
+	return ToPreciseCode(GetUniqueInstance()->m_theNormalVectors.data(), N, index);
+}
+
+void ccNormalVectors::GetNormIndexes(const PointCoordinateType* N, unsigned count, CompressedNormType* codes)
+{
+	ccNormalCompressor::Compress(N, count, codes);
+
+	if (s_preciseNormals)
+	{
+		const CCVector3* table = GetUniqueInstance()->m_theNormalVectors.data();
+		for (unsigned i = 0; i < count; ++i)
+		{
+			codes[i] = ToPreciseCode(table, N + 3 * static_cast<size_t>(i), codes[i]);
+		}
+	}
+}
+
+CCVector3 ccNormalVectors::GetPreciseNormal(CompressedNormType code)
+{
+	return FromPreciseCode(GetUniqueInstance()->m_theNormalVectors.data(), code);
+}
+
+void ccNormalVectors::getNormals(const CompressedNormType* codes, unsigned count, PointCoordinateType* N) const
+{
+	assert(codes && N);
+	const CCVector3* table = m_theNormalVectors.data();
+	for (unsigned i = 0; i < count; ++i, N += 3)
+	{
+		CCVector3 n = FromPreciseCode(table, codes[i]);
+		N[0] = n.x;
+		N[1] = n.y;
+		N[2] = n.z;
+	}
+}
+
 bool ccNormalVectors::enableNormalHSVColorsArray()
 {
 	if (m_theNormalHSVColors)
@@ -106,6 +238,7 @@ bool ccNormalVectors::enableNormalHSVColorsArray()
 const ColorCompType* ccNormalVectors::getNormalHSVColor(unsigned index) const
 {
 	assert(m_theNormalHSVColors);
+	index = ccNormalCompressor::GetStandardCode(index);
 	assert(index < m_theNormalVectors.size());
 	return m_theNormalHSVColors+3*index;
 }
@@ -204,7 +337,7 @@ bool ccNormalVectors::UpdateNormalOrientations(	ccGenericPointCloud* theCloud,
 	for (unsigned i = 0; i < theNormsCodes.currentSize(); i++)
 	{
 		const CompressedNormType& code = theNormsCodes.getValue(i);
-		CCVector3 N = GetNormal(code);
+		CCVector3 N = GetPreciseNormal(code);
 
 		if (preferredOrientation == PREVIOUS)
 		{
@@ -457,19 +590,11 @@ bool ccNormalVectors::ComputeCloudNormals(	ccGenericPointCloud* theCloud,
 		}
 	}
 
-	//we instantiate 3D normal vectors
-	NormsTableType* theNorms = new NormsTableType;
-	CCVector3 blankN(0, 0, 0);
-	if (!theNorms->resize(pointCount, true, blankN.u))
-	{
-		theNormsCodes.clear();
-		if (theOctree && !inputOctree)
-			delete theOctree;
-		return false;
-	}
-	//theNorms->fill(0);
+	//the (compressed) normals are directly written in the output table by the cellular methods
+	//(points without enough neighbours get the 'null' normal)
+	theNormsCodes.fill(static_cast<CompressedNormType>(ccNormalCompressor::NULL_NORM_CODE));
 
-	void* additionalParameters[2] = { reinterpret_cast<void*>(theNorms), reinterpret_cast<void*>(&localRadius) };
+	void* additionalParameters[2] = { reinterpret_cast<void*>(&theNormsCodes), reinterpret_cast<void*>(&localRadius) };
 
 	unsigned processedCells = 0;
 	switch (localModel)
@@ -521,20 +646,6 @@ bool ccNormalVectors::ComputeCloudNormals(	ccGenericPointCloud* theCloud,
 		return false;
 	}
 
-	//we 'compress' each normal
-	theNormsCodes.fill(0);
-	theNorms->placeIteratorAtBegining();
-	for (unsigned i = 0; i < pointCount; i++)
-	{
-		const PointCoordinateType* N = theNorms->getCurrentValue();
-		CompressedNormType nCode = GetNormIndex(N);
-		theNormsCodes.setValue(i, nCode);
-		theNorms->forwardIterator();
-	}
-
-	theNorms->release();
-	theNorms = 0;
-
 	//preferred orientation
 	if (preferredOrientation != UNDEFINED)
 	{
@@ -672,9 +783,12 @@ bool ccNormalVectors::ComputeNormsAtLevelWithQuadric(	const CCLib::DgmOctree::oc
 														CCLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//additional parameters
-	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
+	NormsIndexesTableType* theNormsCodes = static_cast<NormsIndexesTableType*>(additionalParameters[0]);
 	PointCoordinateType radius = *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
+	//neighbours buffers (shared by all the points of the cell)
+	CCLib::NormalEstimationKernels::Points neighbourPoints;
+
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
 	nNSS.level = cell.level;
 	nNSS.prepare(radius, cell.parentOctree->getCellSize(nNSS.level));
@@ -706,12 +820,18 @@ bool ccNormalVectors::ComputeNormsAtLevelWithQuadric(	const CCLib::DgmOctree::oc
 		}
 		if (k >= NUMBER_OF_POINTS_FOR_NORM_WITH_QUADRIC)
 		{
-			CCLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
-
 			CCVector3 N;
-			if (ComputeNormalWithQuadric(&neighbours, nNSS.queryPoint, N))
+			bool success = (	neighbourPoints.gather(nNSS.pointsInNeighbourhood, k, nNSS.queryPoint)
+							&&	CCLib::NormalEstimationKernels::ComputeQuadricNormal(neighbourPoints, nNSS.queryPoint, N) );
+			if (!success)
 			{
-				theNorms->setValue(cell.points->getPointGlobalIndex(i), N.u);
+				//degenerate configuration: we fall back to the generic (slower) method
+				CCLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
+				success = ComputeNormalWithQuadric(&neighbours, nNSS.queryPoint, N);
+			}
+			if (success)
+			{
+				theNormsCodes->setValue(cell.points->getPointGlobalIndex(i), GetNormIndex(N));
 			}
 		}
 
@@ -727,9 +847,12 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCLib::DgmOctree::octreeCe
 												CCLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//additional parameters
-	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
+	NormsIndexesTableType* theNormsCodes = static_cast<NormsIndexesTableType*>(additionalParameters[0]);
 	PointCoordinateType radius = *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
+	//neighbours buffers (shared by all the points of the cell)
+	CCLib::NormalEstimationKernels::Points neighbourPoints;
+
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
 	nNSS.level = cell.level;
 	nNSS.prepare(radius, cell.parentOctree->getCellSize(nNSS.level));
@@ -763,12 +886,18 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCLib::DgmOctree::octreeCe
 		}
 		if (k >= NUMBER_OF_POINTS_FOR_NORM_WITH_LS)
 		{
-			CCLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
-
 			CCVector3 N;
-			if (ComputeNormalWithLS(&neighbours, N))
+			bool success = (	neighbourPoints.gather(nNSS.pointsInNeighbourhood, k, nNSS.queryPoint)
+							&&	CCLib::NormalEstimationKernels::ComputeLSNormal(neighbourPoints, N) );
+			if (!success)
+			{
+				//degenerate configuration: we fall back to the generic (slower) method
+				CCLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
+				success = ComputeNormalWithLS(&neighbours, N);
+			}
+			if (success)
 			{
-				theNorms->setValue(cell.points->getPointGlobalIndex(i), N.u);
+				theNormsCodes->setValue(cell.points->getPointGlobalIndex(i), GetNormIndex(N));
 			}
 		}
 
@@ -786,7 +915,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCLib::DgmOctree::octree
 													CCLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//additional parameters
-	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
+	NormsIndexesTableType* theNormsCodes = static_cast<NormsIndexesTableType*>(additionalParameters[0]);
 
 	CCLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
 	nNSS.level = cell.level;
@@ -821,7 +950,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCLib::DgmOctree::octree
 			CCVector3 N;
 			if (ComputeNormalWithTri(&neighbours, N))
 			{
-				theNorms->setValue(cell.points->getPointGlobalIndex(i), N.u);
+				theNormsCodes->setValue(cell.points->getPointGlobalIndex(i), GetNormIndex(N));
 			}
 		}
 
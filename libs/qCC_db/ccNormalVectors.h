@@ -23,6 +23,7 @@
 
 //Local
 #include "ccGenericPointCloud.h"
+#include "ccNormalCompressor.h"
 
 //! Compressed normal vectors handler
 class QCC_DB_LIB_API ccNormalVectors
@@ -44,12 +45,49 @@ public:
 	static inline const CCVector3& GetNormal(unsigned normIndex) { return GetUniqueInstance()->getNormal(normIndex); }
 
 	//! Returns the precomputed normal corresponding to a given compressed index
-	inline const CCVector3& getNormal(unsigned normIndex) const { return m_theNormalVectors[normIndex]; }
+	/** Only the standard part of 'precise' codes is used (see GetPreciseNormal).
+	**/
+	inline const CCVector3& getNormal(unsigned normIndex) const { return m_theNormalVectors[ccNormalCompressor::GetStandardCode(normIndex)]; }
+
+	//! Returns the normal corresponding to a (standard or precise) compressed index
+	/** Same as GetNormal for standard codes.
+	**/
+	static CCVector3 GetPreciseNormal(CompressedNormType code);
 
 	//! Returns the compressed index corresponding to a normal vector
 	static CompressedNormType GetNormIndex(const PointCoordinateType N[]);
 	//! Returns the compressed index corresponding to a normal vector (shortcut)
 	static inline CompressedNormType GetNormIndex(const CCVector3& N) { return GetNormIndex(N.u); }
+	//! Returns the compressed indexes corresponding to an array of normal vectors
+	/** \param N normal vectors (3 contiguous coordinates per vector)
+		\param count number of vectors
+		\param codes output indexes (must be already allocated with at least 'count' elements)
+	**/
+	static void GetNormIndexes(const PointCoordinateType* N, unsigned count, CompressedNormType* codes);
+
+	//! Returns the higher precision compressed index corresponding to a normal vector
+	/** The standard code is completed (upper bits) by two quantized offsets relatively to
+		the corresponding precomputed normal. Max. angular error: ~0.01 degree (versus
+		~0.16 degree for the standard codes). The standard part of the code remains valid
+		for all the methods that only handle standard codes (see getNormal).
+	**/
+	static CompressedNormType GetPreciseNormIndex(const PointCoordinateType N[]);
+
+	//! Enables the higher precision normal codes (opt-in)
+	/** Once enabled, GetNormIndex and GetNormIndexes (and therefore all the methods
+		that compress normals) return 'precise' codes (see GetPreciseNormIndex).
+	**/
+	static void EnablePreciseNormals(bool state);
+	//! Returns whether the higher precision normal codes are enabled
+	static bool PreciseNormalsEnabled();
+
+	//! Returns the normals corresponding to an array of compressed indexes
+	/** Handles the precise codes (see GetPreciseNormal).
+		\param codes compressed indexes
+		\param count number of indexes
+		\param N output normal vectors (3 contiguous coordinates per vector, must be already allocated)
+	**/
+	void getNormals(const CompressedNormType* codes, unsigned count, PointCoordinateType* N) const;
 
 	//! 'Default' orientations
 	enum Orientation {
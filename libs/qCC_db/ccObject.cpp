@@ -58,8 +58,11 @@
 	v4.5 - 10/06/2016 - Transformation history is now saved
 	v4.6 - 11/03/2016 - Null normal vector code added
 	v4.7 - 12/22/2016 - Return index added to ccWaveform
+	v4.8 - 10/16/2026 - L.O.D. structure saved with point clouds
+	v4.9 - 10/16/2026 - Arrays are saved as compressed blocks
+	v5.0 - 10/16/2026 - Normal codes format added (standard or precise codes)
 **/
-const unsigned c_currentDBVersion = 47; //4.7
+const unsigned c_currentDBVersion = 50; //5.0
 
 //! Default unique ID generator (using the system persistent settings as we did previously proved to be not reliable)
 static ccUniqueIDGenerator::Shared s_uniqueIDGenerator(new ccUniqueIDGenerator);
@@ -99,6 +102,16 @@ unsigned ccObject::GetLastUniqueID()
 	return s_uniqueIDGenerator ? s_uniqueIDGenerator->getLast() : 0;
 }
 
+unsigned ccObject::ReserveUniqueIDs(unsigned count)
+{
+	if (!s_uniqueIDGenerator)
+	{
+		assert(false);
+		s_uniqueIDGenerator = ccUniqueIDGenerator::Shared(new ccUniqueIDGenerator);
+	}
+	return s_uniqueIDGenerator->reserve(count);
+}
+
 ccObject::ccObject(QString name)
 	: m_name(name.isEmpty() ? "unnamed" : name)
 	, m_flags(CC_ENABLED)
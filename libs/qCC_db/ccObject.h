@@ -25,6 +25,9 @@
 #include <QSharedPointer>
 #include <QVariant>
 
+//system
+#include <atomic>
+
 
 //! Object state flag
 enum CC_OBJECT_FLAG {	//CC_UNUSED			= 1, //DGM: not used anymore (former CC_FATHER_DEPENDENT)
@@ -147,6 +150,10 @@ public:
 };
 
 //! Unique ID generator (should be unique for the whole application instance - with plugins, etc.)
+/** The counter is atomic, so that new IDs can be fetched by several threads at the same time.
+	However, the entities loaded with their own IDs (e.g. BIN files) must shift them inside a
+	range reserved beforehand (see reserve), otherwise they may collide with the other new IDs.
+**/
 class QCC_DB_LIB_API ccUniqueIDGenerator
 {
 public:
@@ -161,13 +168,25 @@ public:
 	void reset() { m_lastUniqueID = 0; }
 	//! Returns a (new) unique ID
 	unsigned fetchOne() { return ++m_lastUniqueID; }
+	//! Reserves a range of (new) unique IDs at once
+	/** \param count number of IDs to reserve
+		\return the last unique ID before the range (i.e. the reserved IDs are 'returned value + 1' to 'returned value + count')
+	**/
+	unsigned reserve(unsigned count) { return m_lastUniqueID.fetch_add(count); }
 	//! Returns the value of the last generated unique ID
 	unsigned getLast() const { return m_lastUniqueID; }
 	//! Updates the value of the last generated unique ID with the current one
-	void update(unsigned ID) { if (ID > m_lastUniqueID) m_lastUniqueID = ID; }
+	void update(unsigned ID)
+	{
+		unsigned lastID = m_lastUniqueID;
+		while (ID > lastID && !m_lastUniqueID.compare_exchange_weak(lastID, ID))
+		{
+			//lastID has been updated: we try again
+		}
+	}
 
 protected:
-	unsigned m_lastUniqueID;
+	std::atomic<unsigned> m_lastUniqueID;
 };
 
 //! Generic "CloudCompare Object" template
@@ -254,6 +273,14 @@ public:
 	**/
 	static unsigned GetLastUniqueID();
 
+	//! Reserves a range of new unique IDs at once
+	/** To be used when entities are loaded with their own IDs (which must be shifted
+		so as not to collide with the IDs already assigned or assigned in the meantime).
+		\param count number of IDs to reserve
+		\return the last unique ID before the range (i.e. the reserved IDs are 'returned value + 1' to 'returned value + count')
+	**/
+	static unsigned ReserveUniqueIDs(unsigned count);
+
 	//! Helper: reads out class ID from a binary stream
 	/** Must be called before 'fromFile'!
 	**/
@@ -31,6 +31,9 @@
 #include <ScalarFieldTools.h>
 #include <RayAndBox.h>
 
+//system
+#include <algorithm>
+
 #ifdef QT_DEBUG
 //#define DEBUG_PICKING_MECHANISM
 #endif
@@ -97,6 +100,36 @@ void ccOctree::clear()
 	DgmOctree::clear();
 }
 
+bool ccOctree::insertPoints(const std::vector<unsigned>& pointIndexes)
+{
+	//warn the others that the octree organization is going to change
+	emit updated();
+
+	m_glListIsDeprecated = true;
+	if (m_frustumIntersector)
+	{
+		delete m_frustumIntersector;
+		m_frustumIntersector = 0;
+	}
+
+	return DgmOctree::insertPoints(pointIndexes);
+}
+
+bool ccOctree::removePoints(const std::vector<unsigned>& pointIndexes, bool shiftIndexes)
+{
+	//warn the others that the octree organization is going to change
+	emit updated();
+
+	m_glListIsDeprecated = true;
+	if (m_frustumIntersector)
+	{
+		delete m_frustumIntersector;
+		m_frustumIntersector = 0;
+	}
+
+	return DgmOctree::removePoints(pointIndexes, shiftIndexes);
+}
+
 ccBBox ccOctree::getSquareBB() const
 {
 	return ccBBox(m_dimMin, m_dimMax);
@@ -586,16 +619,6 @@ bool ccOctree::pointPicking(const CCVector2d& clickPos,
 	//no need to go too deep
 	const unsigned char maxLevel = findBestLevelForAGivenPopulationPerCell(10);
 
-	//starting level of subdivision
-	unsigned char level = 1;
-	//binary shift for cell code truncation at current level
-	unsigned char currentBitDec = GET_BIT_SHIFT(level);
-	//current cell code
-	CellCode currentCellCode = INVALID_CELL_CODE;
-	CellCode currentCellTruncatedCode = INVALID_CELL_CODE;
-	//whether the current cell should be skipped or not
-	bool skipThisCell = false;
-
 #ifdef DEBUG_PICKING_MECHANISM
 	m_theAssociatedCloud->enableScalarField();
 #endif
@@ -622,75 +645,74 @@ bool ccOctree::pointPicking(const CCVector2d& clickPos,
 		}
 	}
 
-	//let's sweep through the octree
-	for (cellsContainer::const_iterator it = m_thePointsAndTheirCellCodes.begin(); it != m_thePointsAndTheirCellCodes.end(); ++it)
+	//let's sweep through the octree (only the cells intersecting the picking 'cone' are visited)
+	cellsContainer::const_iterator it = m_thePointsAndTheirCellCodes.begin();
+	CellCode previousCode = INVALID_CELL_CODE;
+	while (it != m_thePointsAndTheirCellCodes.end())
 	{
-		CellCode truncatedCode = (it->theCode >> currentBitDec);
-		
-		//new cell?
-		if (truncatedCode != currentCellTruncatedCode)
+		//the (accepted) parent cells shared with the previous cell don't need to be tested again
+		unsigned char level = 1;
+		if (previousCode != INVALID_CELL_CODE)
 		{
-			//look for the biggest 'parent' cell that englobes this cell and the previous one (if any)
-			while (level > 1)
-			{
-				unsigned char bitDec = GET_BIT_SHIFT(level-1);
-				if ((it->theCode >> bitDec) == (currentCellCode >> bitDec))
-				{
-					//same parent cell, we can stop here
-					break;
-				}
-				--level;
-			}
+			while (level < maxLevel && (it->theCode >> GET_BIT_SHIFT(level)) == (previousCode >> GET_BIT_SHIFT(level)))
+				++level;
+		}
+		previousCode = it->theCode;
 
-			currentCellCode = it->theCode;
+		//now try to go deeper with the new cell
+		bool skipThisCell = false;
+		for (; level < maxLevel; ++level)
+		{
+			Tuple3i cellPos;
+			getCellPos(it->theCode, level, cellPos, false);
 
-			//now try to go deeper with the new cell
-			while (level < maxLevel)
-			{
-				Tuple3i cellPos;
-				getCellPos(it->theCode, level, cellPos, false);
+			//first test with the total bounding box
+			PointCoordinateType halfCellSize = getCellSize(level) / 2;
+			CCVector3 cellCenter(	(2* cellPos.x + 1) * halfCellSize,
+									(2* cellPos.y + 1) * halfCellSize,
+									(2* cellPos.z + 1) * halfCellSize);
 
-				//first test with the total bounding box
-				PointCoordinateType halfCellSize = getCellSize(level) / 2;
-				CCVector3 cellCenter(	(2* cellPos.x + 1) * halfCellSize,
-										(2* cellPos.y + 1) * halfCellSize,
-										(2* cellPos.z + 1) * halfCellSize);
+			CCVector3 halfCell = CCVector3(halfCellSize, halfCellSize, halfCellSize);
 
-				CCVector3 halfCell = CCVector3(halfCellSize, halfCellSize, halfCellSize);
+			if (camera.perspective)
+			{
+				double radialSqDist, sqDistToOrigin;
+				rayLocal.squareDistances(cellCenter, radialSqDist, sqDistToOrigin);
 
-				if (camera.perspective)
-				{
-					double radialSqDist, sqDistToOrigin;
-					rayLocal.squareDistances(cellCenter, radialSqDist, sqDistToOrigin);
+				double dx = sqrt(sqDistToOrigin);
+				double dy = std::max<double>(0, sqrt(radialSqDist) - SQRT_3 * halfCellSize);
+				double fov_rad = atan2(dy, dx);
 
-					double dx = sqrt(sqDistToOrigin);
-					double dy = std::max<double>(0, sqrt(radialSqDist) - SQRT_3 * halfCellSize);
-					double fov_rad = atan2(dy, dx);
+				skipThisCell = (fov_rad > maxFOV_rad);
+			}
+			else
+			{
+				skipThisCell = !AABB<PointCoordinateType>(	cellCenter - halfCell - margin,
+															cellCenter + halfCell + margin).intersects(rayLocal);
+			}
 
-					skipThisCell = (fov_rad > maxFOV_rad);
-				}
-				else
-				{
-					skipThisCell = !AABB<PointCoordinateType>(	cellCenter - halfCell - margin,
-																cellCenter + halfCell + margin).intersects(rayLocal);
-				}
+			if (skipThisCell)
+				break;
+		}
 
-				if (skipThisCell)
-					break;
-				else
-					++level;
-			}
-			
-			currentBitDec = GET_BIT_SHIFT(level);
-			currentCellTruncatedCode = (currentCellCode >> currentBitDec);
+		//we jump to the first point after this cell (at the current level)
+		unsigned char bitDec = GET_BIT_SHIFT(level);
+		IndexAndCode nextCell(0, ((it->theCode >> bitDec) + 1) << bitDec);
+		cellsContainer::const_iterator cellEnd = std::lower_bound(it, m_thePointsAndTheirCellCodes.end(), nextCell, IndexAndCode::codeComp);
+
+		if (skipThisCell)
+		{
+			it = cellEnd;
+			continue;
 		}
 
+		//test the points of the cell
+		for (; it != cellEnd; ++it)
+		{
 #ifdef DEBUG_PICKING_MECHANISM
-		m_theAssociatedCloud->setPointScalarValue(it->theIndex, level);
+			m_theAssociatedCloud->setPointScalarValue(it->theIndex, level);
 #endif
 
-		if (!skipThisCell)
-		{
 			//we shouldn't test points that are actually hidden!
 			if (	(!visTable || visTable->getValue(it->theIndex) == POINT_VISIBLE)
 				&&	(!activeSF || activeSF->getColor(activeSF->getValue(it->theIndex)))
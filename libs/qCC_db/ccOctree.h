@@ -75,6 +75,8 @@ public: //GENERAL METHODS
 
 	//inherited from DgmOctree
 	virtual void clear() override;
+	virtual bool insertPoints(const std::vector<unsigned>& pointIndexes) override;
+	virtual bool removePoints(const std::vector<unsigned>& pointIndexes, bool shiftIndexes) override;
 
 public: //RENDERING
 	
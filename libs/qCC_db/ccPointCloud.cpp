@@ -25,6 +25,7 @@
 #include <GeometricalAnalysisTools.h>
 #include <ReferenceCloud.h>
 #include <ManualSegmentationTools.h>
+#include <ParallelTools.h>
 
 //local
 #include "ccNormalVectors.h"
@@ -54,6 +55,7 @@
 
 //system
 #include <assert.h>
+#include <limits>
 #include <queue>
 
 ccPointCloud::ccPointCloud(QString name) throw()
@@ -530,13 +532,37 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 	if (size() == pointCountBefore) //in some cases points have already been copied! (ok it's tricky)
 	{
 		//we remove structures that are not compatible with fusion process
-		deleteOctree();
 		unallocateVisibilityArray();
 
 		for (unsigned i = 0; i < addedPoints; i++)
 		{
 			addPoint(*addedCloud->getPoint(i));
 		}
+
+		//the octree can be updated (as long as the new points lie inside)
+		ccOctree::Shared octree = getOctree();
+		if (octree && addedPoints != 0)
+		{
+			bool octreeUpdated = false;
+			try
+			{
+				std::vector<unsigned> newPointIndexes(addedPoints);
+				for (unsigned i = 0; i < addedPoints; i++)
+				{
+					newPointIndexes[i] = pointCountBefore + i;
+				}
+				octreeUpdated = octree->insertPoints(newPointIndexes);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+			}
+
+			if (!octreeUpdated)
+			{
+				deleteOctree();
+			}
+		}
 	}
 
 	//deprecate internal structures
@@ -1472,11 +1498,11 @@ const CompressedNormType& ccPointCloud::getPointNormalIndex(unsigned pointIndex)
 	return m_normals->getValue(pointIndex);
 }
 
-const CCVector3& ccPointCloud::getPointNormal(unsigned pointIndex) const
+CCVector3 ccPointCloud::getPointNormal(unsigned pointIndex) const
 {
 	assert(m_normals && pointIndex < m_normals->currentSize());
 
-	return ccNormalVectors::GetNormal(m_normals->getValue(pointIndex));
+	return ccNormalVectors::GetPreciseNormal(m_normals->getValue(pointIndex));
 }
 
 void ccPointCloud::setPointColor(unsigned pointIndex, const ColorCompType* col)
@@ -1575,7 +1601,7 @@ void ccPointCloud::addNormAtIndex(const PointCoordinateType* N, unsigned index)
 {
 	assert(m_normals && m_normals->isAllocated());
 	//we get the real normal vector corresponding to current index
-	CCVector3 P(ccNormalVectors::GetNormal(m_normals->getValue(index)));
+	CCVector3 P(ccNormalVectors::GetPreciseNormal(m_normals->getValue(index)));
 	//we add the provided vector (N)
 	CCVector3::vadd(P.u,N,P.u);
 	P.normalize();
@@ -1609,7 +1635,7 @@ bool ccPointCloud::convertNormalToRGB()
 	unsigned count = size();
 	for (unsigned i = 0; i < count; ++i)
 	{
-		const ColorCompType* rgb = normalHSV + 3 * m_normals->getValue(i);
+		const ColorCompType* rgb = normalHSV + 3 * ccNormalCompressor::GetStandardCode(m_normals->getValue(i));
 		m_rgbColors->setValue(i, rgb);
 	}
 
@@ -1855,65 +1881,185 @@ void ccPointCloud::applyGLTransformation(const ccGLMatrix& trans)
 	return applyRigidTransformation(trans);
 }
 
+//! Applies a rigid transformation to a set of points and computes their new bounding-box
+/** The loop only uses local coefficients so that the compiler can vectorize it.
+	Gives exactly the same results as ccGLMatrix::apply.
+**/
+static void TransformPoints(const ccGLMatrix& trans, PointCoordinateType* P, unsigned count, CCVector3& bbMin, CCVector3& bbMax)
+{
+	assert(count != 0);
+	const float* M = trans.data();
+	const PointCoordinateType r11 = static_cast<PointCoordinateType>(M[0]);
+	const PointCoordinateType r21 = static_cast<PointCoordinateType>(M[1]);
+	const PointCoordinateType r31 = static_cast<PointCoordinateType>(M[2]);
+	const PointCoordinateType r12 = static_cast<PointCoordinateType>(M[4]);
+	const PointCoordinateType r22 = static_cast<PointCoordinateType>(M[5]);
+	const PointCoordinateType r32 = static_cast<PointCoordinateType>(M[6]);
+	const PointCoordinateType r13 = static_cast<PointCoordinateType>(M[8]);
+	const PointCoordinateType r23 = static_cast<PointCoordinateType>(M[9]);
+	const PointCoordinateType r33 = static_cast<PointCoordinateType>(M[10]);
+	const PointCoordinateType tx  = static_cast<PointCoordinateType>(M[12]);
+	const PointCoordinateType ty  = static_cast<PointCoordinateType>(M[13]);
+	const PointCoordinateType tz  = static_cast<PointCoordinateType>(M[14]);
+
+	PointCoordinateType minX = std::numeric_limits<PointCoordinateType>::max();
+	PointCoordinateType minY = minX;
+	PointCoordinateType minZ = minX;
+	PointCoordinateType maxX = -minX;
+	PointCoordinateType maxY = -minX;
+	PointCoordinateType maxZ = -minX;
+
+	for (unsigned i = 0; i < count; ++i, P += 3)
+	{
+		const PointCoordinateType x = P[0];
+		const PointCoordinateType y = P[1];
+		const PointCoordinateType z = P[2];
+
+		const PointCoordinateType X = r11 * x + r12 * y + r13 * z + tx;
+		const PointCoordinateType Y = r21 * x + r22 * y + r23 * z + ty;
+		const PointCoordinateType Z = r31 * x + r32 * y + r33 * z + tz;
+
+		P[0] = X;
+		P[1] = Y;
+		P[2] = Z;
+
+		minX = std::min(minX, X); maxX = std::max(maxX, X);
+		minY = std::min(minY, Y); maxY = std::max(maxY, Y);
+		minZ = std::min(minZ, Z); maxZ = std::max(maxZ, Z);
+	}
+
+	bbMin = CCVector3(minX, minY, minZ);
+	bbMax = CCVector3(maxX, maxY, maxZ);
+}
+
+//! Applies the rotation part of a rigid transformation to a set of compressed normals
+static void RotateCompressedNormals(const ccGLMatrix& trans, const ccNormalVectors* normalVectors, CompressedNormType* codes, unsigned count)
+{
+	//we process the normals by small blocks (with the batch compression methods)
+	static const unsigned BLOCK_SIZE = 1024;
+	CCVector3 N[BLOCK_SIZE];
+
+	for (unsigned blockStart = 0; blockStart < count; blockStart += BLOCK_SIZE)
+	{
+		unsigned blockSize = std::min(BLOCK_SIZE, count - blockStart);
+		normalVectors->getNormals(codes + blockStart, blockSize, N[0].u);
+		for (unsigned i = 0; i < blockSize; ++i)
+		{
+			trans.applyRotation(N[i]);
+		}
+		ccNormalVectors::GetNormIndexes(N[0].u, blockSize, codes + blockStart);
+	}
+}
+
 void ccPointCloud::applyRigidTransformation(const ccGLMatrix& trans)
 {
 	//transparent call
 	ccGenericPointCloud::applyGLTransformation(trans);
 
+	//is it a pure translation?
+	const float* M = trans.data();
+	bool pureTranslation = (	M[0] == 1.0f && M[1] == 0.0f && M[2] == 0.0f
+							&&	M[4] == 0.0f && M[5] == 1.0f && M[6] == 0.0f
+							&&	M[8] == 0.0f && M[9] == 0.0f && M[10] == 1.0f );
+
+	//we transform the points chunk by chunk (in parallel)
+	//and compute the new bounding-box at the same time
 	unsigned count = size();
-	for (unsigned i=0; i<count; i++)
+	unsigned pointChunkCount = m_points->chunksCount();
+	std::vector<CCVector3> chunkBBMin, chunkBBMax;
+	try
+	{
+		chunkBBMin.resize(pointChunkCount);
+		chunkBBMax.resize(pointChunkCount);
+	}
+	catch (const std::bad_alloc&)
 	{
-		trans.apply(*point(i));
+		//the bounding-box will be recomputed afterwards
+		chunkBBMin.clear();
+		chunkBBMax.clear();
 	}
+	bool bbComputed = (pointChunkCount != 0 && chunkBBMin.size() == pointChunkCount);
+
+	CCLib::ParallelTools::ForEach(	pointChunkCount,
+									[&](unsigned c)
+									{
+										CCVector3 bbMin, bbMax;
+										TransformPoints(trans, m_points->chunkStartPtr(c), m_points->chunkSize(c), bbMin, bbMax);
+										if (bbComputed)
+										{
+											chunkBBMin[c] = bbMin;
+											chunkBBMax[c] = bbMax;
+										}
+									},
+									0, 0, 1);
 
 	//we must also take care of the normals!
 	if (hasNormals())
 	{
+		const ccNormalVectors* normalVectors = ccNormalVectors::GetUniqueInstance();
 		bool recoded = false;
 
 		//if there is more points than the size of the compressed normals array,
 		//we recompress the array instead of recompressing each normal
-		if (count > ccNormalVectors::GetNumberOfVectors())
+		//(not with the precise codes, as the table only contains the standard ones)
+		unsigned numberOfVectors = ccNormalVectors::GetNumberOfVectors();
+		if (count > numberOfVectors && !ccNormalVectors::PreciseNormalsEnabled())
 		{
-			NormsIndexesTableType* newNorms = new NormsIndexesTableType;
-			if (newNorms->reserve(ccNormalVectors::GetNumberOfVectors()))
+			std::vector<CompressedNormType> newNormIndexes;
+			try
 			{
-				for (unsigned i=0; i<ccNormalVectors::GetNumberOfVectors(); i++)
-				{
-					CCVector3 new_n(ccNormalVectors::GetNormal(i));
-					trans.applyRotation(new_n);
-					CompressedNormType newNormIndex = ccNormalVectors::GetNormIndex(new_n.u);
-					newNorms->addElement(newNormIndex);
-				}
+				newNormIndexes.resize(numberOfVectors);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory: we'll recode each normal
+			}
 
-				m_normals->placeIteratorAtBegining();
-				for (unsigned j=0; j<count; j++)
+			if (!newNormIndexes.empty())
+			{
+				for (unsigned i = 0; i < numberOfVectors; ++i)
 				{
-					m_normals->setValue(j,newNorms->getValue(m_normals->getCurrentValue()));
-					m_normals->forwardIterator();
+					newNormIndexes[i] = static_cast<CompressedNormType>(i);
 				}
+
+				//rotate the whole table (in parallel)
+				static const unsigned TABLE_BLOCK_SIZE = (1 << 16);
+				unsigned blockCount = (numberOfVectors + TABLE_BLOCK_SIZE - 1) / TABLE_BLOCK_SIZE;
+				CCLib::ParallelTools::ForEach(	blockCount,
+												[&](unsigned b)
+												{
+													unsigned blockStart = b * TABLE_BLOCK_SIZE;
+													RotateCompressedNormals(trans, normalVectors, newNormIndexes.data() + blockStart, std::min(TABLE_BLOCK_SIZE, numberOfVectors - blockStart));
+												},
+												0, 0, 1);
+
+				//then remap the normals (in parallel)
+				CCLib::ParallelTools::ForEach(	m_normals->chunksCount(),
+												[&](unsigned c)
+												{
+													CompressedNormType* _theNormIndexes = m_normals->chunkStartPtr(c);
+													unsigned chunkSize = m_normals->chunkSize(c);
+													for (unsigned i = 0; i < chunkSize; ++i)
+													{
+														_theNormIndexes[i] = newNormIndexes[ccNormalCompressor::GetStandardCode(_theNormIndexes[i])];
+													}
+												},
+												0, 0, 1);
 				recoded = true;
 			}
-			newNorms->clear();
-			newNorms->release();
-			newNorms = 0;
 		}
 
 		//if there is less points than the compressed normals array size
 		//(or if there is not enough memory to instantiate the temporary
-		//array), we recompress each normal ...
+		//array), we recompress each normal (chunk by chunk, in parallel)
 		if (!recoded)
 		{
-			//on recode direct chaque normale
-			m_normals->placeIteratorAtBegining();
-			for (unsigned i=0; i<count; i++)
-			{
-				CompressedNormType* _theNormIndex = m_normals->getCurrentValuePtr();
-				CCVector3 new_n(ccNormalVectors::GetNormal(*_theNormIndex));
-				trans.applyRotation(new_n);
-				*_theNormIndex = ccNormalVectors::GetNormIndex(new_n.u);
-				m_normals->forwardIterator();
-			}
+			CCLib::ParallelTools::ForEach(	m_normals->chunksCount(),
+											[&](unsigned c)
+											{
+												RotateCompressedNormals(trans, normalVectors, m_normals->chunkStartPtr(c), m_normals->chunkSize(c));
+											},
+											0, 0, 1);
 		}
 	}
 
@@ -1933,19 +2079,62 @@ void ccPointCloud::applyRigidTransformation(const ccGLMatrix& trans)
 	}
 
 	//and the waveform!
-	for (ccWaveform& w : m_fwfWaveforms)
+	CCLib::ParallelTools::ForEach(	static_cast<unsigned>(m_fwfWaveforms.size()),
+									[&](unsigned i)
+									{
+										ccWaveform& w = m_fwfWaveforms[i];
+										if (w.descriptorID() != 0)
+										{
+											w.applyRigidTransformation(trans);
+										}
+									});
+
+	if (pureTranslation)
 	{
-		if (w.descriptorID() != 0)
+		//the octree (and the Kd-trees) can simply be translated
+		CCVector3 T(static_cast<PointCoordinateType>(M[12]),
+					static_cast<PointCoordinateType>(M[13]),
+					static_cast<PointCoordinateType>(M[14]));
+
+		ccOctree::Shared octree = getOctree();
+		if (octree)
 		{
-			w.applyRigidTransformation(trans);
+			octree->translateBoundingBox(T);
 		}
-	}
 
-	//the octree is invalidated by rotation...
-	deleteOctree();
+		ccHObject::Container kdtrees;
+		filterChildren(kdtrees, false, CC_TYPES::POINT_KDTREE);
+		for (size_t i = 0; i < kdtrees.size(); ++i)
+		{
+			static_cast<ccKdTree*>(kdtrees[i])->translateBoundingBox(T);
+		}
+	}
+	else
+	{
+		//the octree is invalidated by rotation...
+		deleteOctree();
+	}
 
 	// ... as the bounding box
 	refreshBB(); //calls notifyGeometryUpdate + releaseVBOs
+
+	//but we have already computed the new one!
+	if (bbComputed)
+	{
+		PointCoordinateType* bbMin = m_points->getMin();
+		PointCoordinateType* bbMax = m_points->getMax();
+		for (unsigned char d = 0; d < 3; ++d)
+		{
+			bbMin[d] = chunkBBMin.front().u[d];
+			bbMax[d] = chunkBBMax.front().u[d];
+			for (unsigned c = 1; c < pointChunkCount; ++c)
+			{
+				bbMin[d] = std::min(bbMin[d], chunkBBMin[c].u[d]);
+				bbMax[d] = std::max(bbMax[d], chunkBBMax[c].u[d]);
+			}
+		}
+		m_validBB = true;
+	}
 }
 
 void ccPointCloud::translate(const CCVector3& T)
@@ -2389,18 +2578,10 @@ void ccPointCloud::glChunkSFPointer(const CC_DRAW_CONTEXT& context, unsigned chu
 	{
 		assert(m_currentDisplayedScalarField && m_currentDisplayedScalarField->chunkStartPtr(chunkIndex));
 		//we must convert the scalar values to RGB colors in a dedicated static array
-		ScalarType* _sf = m_currentDisplayedScalarField->chunkStartPtr(chunkIndex);
-		ColorCompType* _sfColors = s_rgbBuffer3ub;
+		const ScalarType* _sf = m_currentDisplayedScalarField->chunkStartPtr(chunkIndex);
 		unsigned chunkSize = m_currentDisplayedScalarField->chunkSize(chunkIndex);
-		for (unsigned j = 0; j < chunkSize; j += decimStep, _sf += decimStep)
-		{
-			//convert the scalar value to a RGB color
-			const ColorCompType* col = m_currentDisplayedScalarField->getColor(*_sf);
-			assert(col);
-			*_sfColors++ = *col++;
-			*_sfColors++ = *col++;
-			*_sfColors++ = *col++;
-		}
+		unsigned colorCount = (chunkSize + decimStep - 1) / decimStep;
+		m_currentDisplayedScalarField->getColors(_sf, colorCount, s_rgbBuffer3ub, decimStep);
 		glFunc->glColorPointer(3, GL_UNSIGNED_BYTE, 0, s_rgbBuffer3ub);
 	}
 }
@@ -2617,7 +2798,8 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 						bool underConstruction = m_lod->isUnderConstruction();
 
 						//if the cloud has less LOD levels than the minimum to display
-						if (underConstruction || maxLevel == 0)
+						//(while the structure is under construction, the coarse levels can already be used)
+						if (maxLevel == 0)
 						{
 							//not yet ready
 							context.moreLODPointsAvailable = underConstruction;
@@ -3332,12 +3514,39 @@ ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool re
 	//shall the visible points be erased from this cloud?
 	if (removeSelectedPoints && !isLocked())
 	{
-		//we drop the octree before modifying this cloud's contents
-		deleteOctree();
 		clearLOD();
 
 		unsigned count = size();
 
+		//the octree is updated rather than dropped (if possible)
+		ccOctree::Shared octree = getOctree();
+		if (octree)
+		{
+			bool octreeUpdated = false;
+			try
+			{
+				std::vector<unsigned> removedPointIndexes;
+				for (unsigned i = 0; i < count; ++i)
+				{
+					if (m_pointsVisibility->getValue(i) == POINT_VISIBLE)
+					{
+						removedPointIndexes.push_back(i);
+					}
+				}
+				//the remaining points keep their order (see below)
+				octreeUpdated = octree->removePoints(removedPointIndexes, true);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+			}
+
+			if (!octreeUpdated)
+			{
+				deleteOctree();
+			}
+		}
+
 		//we have to take care of scan grids first
 		{
 			//we need a map between old and new indexes
@@ -3444,34 +3653,46 @@ bool ccPointCloud::setRGBColorWithCurrentScalarField(bool mixWithExistingColor/*
 		return false;
 	}
 
-	unsigned count = size();
-
 	if (!mixWithExistingColor || !hasColors())
 	{
 		if (!hasColors())
 			if (!resizeTheRGBTable(false))
 				return false;
 
-		for (unsigned i = 0; i < count; i++)
+		//the colors are converted chunk by chunk (with the SF color lookup table)
+		assert(m_currentDisplayedScalarField->currentSize() == size());
+		for (unsigned c = 0; c < m_rgbColors->chunksCount(); ++c)
 		{
-			const ColorCompType* col = getPointScalarValueColor(i);
-			m_rgbColors->setValue(i, col ? col : ccColor::black.rgba);
+			m_currentDisplayedScalarField->getColors(	m_currentDisplayedScalarField->chunkStartPtr(c),
+														m_rgbColors->chunkSize(c),
+														m_rgbColors->chunkStartPtr(c),
+														1,
+														ccColor::black.rgba);
 		}
 	}
 	else
 	{
-		m_rgbColors->placeIteratorAtBegining();
-		for (unsigned i = 0; i < count; i++)
+		//the SF colors are converted by blocks (hidden values get a white color so as to leave the existing colors unchanged)
+		static const unsigned BLOCK_SIZE = 4096;
+		ColorCompType sfColors[3 * BLOCK_SIZE];
+		for (unsigned c = 0; c < m_rgbColors->chunksCount(); ++c)
 		{
-			const ColorCompType* col = getPointScalarValueColor(i);
-			if (col)
+			const ScalarType* _sf = m_currentDisplayedScalarField->chunkStartPtr(c);
+			ColorCompType* _color = m_rgbColors->chunkStartPtr(c);
+			unsigned chunkSize = m_rgbColors->chunkSize(c);
+			for (unsigned blockStart = 0; blockStart < chunkSize; blockStart += BLOCK_SIZE)
 			{
-				ColorCompType* _color = m_rgbColors->getCurrentValue();
-				_color[0] = static_cast<ColorCompType>(_color[0] * (static_cast<float>(col[0]) / ccColor::MAX));
-				_color[1] = static_cast<ColorCompType>(_color[1] * (static_cast<float>(col[1]) / ccColor::MAX));
-				_color[2] = static_cast<ColorCompType>(_color[2] * (static_cast<float>(col[2]) / ccColor::MAX));
+				unsigned blockSize = std::min(BLOCK_SIZE, chunkSize - blockStart);
+				m_currentDisplayedScalarField->getColors(_sf + blockStart, blockSize, sfColors, 1, ccColor::white.rgba);
+
+				const ColorCompType* col = sfColors;
+				for (unsigned i = 0; i < blockSize; i++, col += 3, _color += 3)
+				{
+					_color[0] = static_cast<ColorCompType>(_color[0] * (static_cast<float>(col[0]) / ccColor::MAX));
+					_color[1] = static_cast<ColorCompType>(_color[1] * (static_cast<float>(col[1]) / ccColor::MAX));
+					_color[2] = static_cast<ColorCompType>(_color[2] * (static_cast<float>(col[2]) / ccColor::MAX));
+				}
 			}
-			m_rgbColors->forwardIterator();
 		}
 	}
 
@@ -4213,6 +4434,17 @@ bool ccPointCloud::toFile_MeOnly(QFile& out) const
 		}
 	}
 
+	//L.O.D. structure (dataVersion >= 48)
+	bool withLOD = (m_lod && m_lod->isInitialized());
+	if (out.write((const char*)&withLOD, sizeof(bool)) < 0)
+	{
+		return WriteError();
+	}
+	if (withLOD && !m_lod->toFile(out))
+	{
+		return WriteError();
+	}
+
 	return true;
 }
 
@@ -4535,6 +4767,28 @@ bool ccPointCloud::fromFile_MeOnly(QFile& in, short dataVersion, int flags)
 		}
 	}
 
+	//L.O.D. structure (dataVersion >= 48)
+	if (dataVersion >= 48)
+	{
+		bool withLOD = false;
+		if (in.read((char*)&withLOD, sizeof(bool)) < 0)
+		{
+			return ReadError();
+		}
+		if (withLOD)
+		{
+			if (!m_lod)
+			{
+				m_lod = new ccPointCloudLOD;
+			}
+			//the structure will only be restored when the LOD is initialized (see initLOD)
+			if (!m_lod->fromFile(in, dataVersion, flags))
+			{
+				return ReadError();
+			}
+		}
+	}
+
 	//notifyGeometryUpdate(); //FIXME: we can't call it now as the dependent 'pointers' are not valid yet!
 
 	//We should update the VBOs (just in case)
@@ -4843,19 +5097,10 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 						//copy SF colors in static array
 						{
 							assert(m_vboManager.sourceSF);
-							ColorCompType* _sfColors = s_rgbBuffer3ub;
-							ScalarType* _sf = m_vboManager.sourceSF->chunkStartPtr(i);
+							const ScalarType* _sf = m_vboManager.sourceSF->chunkStartPtr(i);
 							assert(m_vboManager.sourceSF->chunkSize(i) == chunkSize);
-							for (int j = 0; j < chunkSize; j++, _sf++)
-							{
-								//we need to convert scalar value to color into a temporary structure
-								const ColorCompType* col = m_vboManager.sourceSF->getColor(*_sf);
-								if (!col)
-									col = ccColor::lightGrey.rgba;
-								*_sfColors++ = *col++;
-								*_sfColors++ = *col++;
-								*_sfColors++ = *col++;
-							}
+							//we need to convert scalar value to color into a temporary structure
+							m_vboManager.sourceSF->getColors(_sf, chunkSize, s_rgbBuffer3ub, 1, ccColor::lightGrey.rgba);
 						}
 						//then send them in VRAM
 						m_vboManager.vbos[i]->write(m_vboManager.vbos[i]->rgbShift, s_rgbBuffer3ub, sizeof(ColorCompType)*chunkSize * 3);
@@ -451,7 +451,7 @@ public: //other methods
 	virtual ScalarType getPointDisplayedDistance(unsigned pointIndex) const override;
 	virtual const ColorCompType* getPointColor(unsigned pointIndex) const override;
 	virtual const CompressedNormType& getPointNormalIndex(unsigned pointIndex) const override;
-	virtual const CCVector3& getPointNormal(unsigned pointIndex) const override;
+	virtual CCVector3 getPointNormal(unsigned pointIndex) const override;
 	CCLib::ReferenceCloud* crop(const ccBBox& box, bool inside = true) override;
 	virtual void scale(PointCoordinateType fx, PointCoordinateType fy, PointCoordinateType fz, CCVector3 center = CCVector3(0,0,0)) override;
 	/** \warning if removeSelectedPoints is true, any attached octree will be deleted. **/
@@ -20,9 +20,42 @@
 //Local
 #include "ccPointCloud.h"
 
+//CCLib
+#include <GenericProgressCallback.h>
+#include <ParallelTools.h>
+
 //Qt
 #include <QThread>
 #include <QElapsedTimer>
+#include <QFile>
+
+//system
+#include <algorithm>
+
+//! Max duration of the wait when the background computation is canceled (in ms)
+static const unsigned long c_lodThreadStopTimeout_ms = 2000;
+
+//! Number of points processed between two checks of the cancellation flag
+static const uint32_t c_lodCancelCheckStep = (1 << 16);
+
+//! Progress callback only used to relay a cancellation request (e.g. to the octree construction)
+class ccCancelTokenProgress : public CCLib::GenericProgressCallback
+{
+public:
+	//! Default constructor
+	explicit ccCancelTokenProgress(const CCLib::ParallelCancelToken& token) : m_token(token) {}
+
+	//inherited from GenericProgressCallback
+	virtual void update(float) override {}
+	virtual void setMethodTitle(const char*) override {}
+	virtual void setInfo(const char*) override {}
+	virtual void start() override {}
+	virtual void stop() override {}
+	virtual bool isCancelRequested() override { return m_token.isCanceled(); }
+
+protected:
+	const CCLib::ParallelCancelToken& m_token;
+};
 
 //! Thread for background computation
 class ccPointCloudLODThread : public QThread
@@ -45,7 +78,15 @@ public:
 	//!Destructor
 	virtual ~ccPointCloudLODThread()
 	{
-		terminate();
+		//DGM: we can't simply terminate the thread as it may have spawned parallel jobs
+		//(but all its steps check the cancellation flag regularly, so it should stop quickly)
+		m_cancelToken.cancel();
+		if (!wait(c_lodThreadStopTimeout_ms))
+		{
+			//the thread still uses the cloud and the LoD structure: we have no choice but to wait
+			ccLog::Warning(QString("[LoD] Waiting for the construction of the LoD structure of cloud '%1' to stop...").arg(m_cloud.getName()));
+			wait();
+		}
 	}
 	
 protected:
@@ -140,6 +181,12 @@ protected:
 				++node.pointCount;
 				const CCVector3* P = m_cloud.getPoint(cellCodes[codeIndex].theIndex);
 				sumP += CCVector3d::fromArray(P->u);
+
+				//the first cells may contain all the points
+				if ((node.pointCount % c_lodCancelCheckStep) == 0 && m_cancelToken.isCanceled())
+				{
+					return 0; //the structure will be discarded anyway
+				}
 			}
 
 			//compute the radius
@@ -149,6 +196,10 @@ protected:
 				double maxSquareRadius = 0;
 				for (uint32_t i = 0; i < node.pointCount; ++i)
 				{
+					if ((i % c_lodCancelCheckStep) == 0 && i != 0 && m_cancelToken.isCanceled())
+					{
+						return 0; //the structure will be discarded anyway
+					}
 					const CCVector3* P = m_cloud.getPoint(cellCodes[node.firstCodeIndex + i].theIndex);
 					double squareRadius = (CCVector3d::fromArray(P->u) - sumP).norm2();
 					if (squareRadius > maxSquareRadius)
@@ -167,12 +218,151 @@ protected:
 		return static_cast<uint8_t>(currentTruncatedCellCode & 7);
 	}
 
+	//! Subdivides the leaf cells of a given level that have more than a given number of points
+	/** The children cells are first delimited (with a binary search on the sorted cell codes),
+		then they are all filled in parallel (whatever the octree subtree they belong to). They
+		are eventually appended to the next level in the same order as a sequential process would
+		do, and published under lock (so that the already accessible levels can still be displayed
+		during the process).
+		\param level level of the cells to subdivide
+		\param minPointCount only the cells with more points are subdivided
+		\return success (false if not enough memory or if the process has been canceled)
+	**/
+	bool subdivideLevel(uint8_t level, uint32_t minPointCount)
+	{
+		const ccOctree::cellsContainer& cellCodes = m_octree->pointsAndTheirCellCodes();
+		const unsigned char bitDec = CCLib::DgmOctree::GET_BIT_SHIFT(level + 1);
+		const std::vector<ccPointCloudLOD::Node>& cells = m_lod.m_levels[level].data;
+
+		//subdivided cell (and the range of its children in 'newCells')
+		struct SubdividedCell
+		{
+			uint32_t cellIndex;
+			uint32_t firstChildIndex;
+			uint8_t childCount;
+		};
+
+		std::vector<ccPointCloudLOD::Node> newCells;
+		std::vector<SubdividedCell> subdividedCells;
+		try
+		{
+			for (uint32_t i = 0; i < static_cast<uint32_t>(cells.size()); ++i)
+			{
+				const ccPointCloudLOD::Node& cell = cells[i];
+				if (cell.childCount != 0 || cell.pointCount <= minPointCount)
+				{
+					continue;
+				}
+
+				SubdividedCell subdividedCell;
+				subdividedCell.cellIndex = i;
+				subdividedCell.firstChildIndex = static_cast<uint32_t>(newCells.size());
+				subdividedCell.childCount = 0;
+
+				ccOctree::cellsContainer::const_iterator it = cellCodes.begin() + cell.firstCodeIndex;
+				ccOctree::cellsContainer::const_iterator end = it + cell.pointCount;
+				while (it != end)
+				{
+					CCLib::DgmOctree::CellCode truncatedCode = (it->theCode >> bitDec);
+					ccOctree::cellsContainer::const_iterator next = std::upper_bound(	it,
+																						end,
+																						truncatedCode,
+																						[bitDec](CCLib::DgmOctree::CellCode code, const CCLib::DgmOctree::IndexAndCode& c) { return code < (c.theCode >> bitDec); });
+					
+					ccPointCloudLOD::Node childNode(level + 1);
+					childNode.firstCodeIndex = static_cast<uint32_t>(it - cellCodes.begin());
+					newCells.push_back(childNode);
+					++subdividedCell.childCount;
+
+					it = next;
+				}
+
+				subdividedCells.push_back(subdividedCell);
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			return false;
+		}
+
+		if (newCells.empty())
+		{
+			//nothing to do
+			return true;
+		}
+
+		//fill the new cells (in parallel)
+		if (!CCLib::ParallelTools::ForEach(	static_cast<unsigned>(newCells.size()),
+											[&](unsigned i) { fillNode_flat(newCells[i]); },
+											0,
+											&m_cancelToken))
+		{
+			//process canceled
+			return false;
+		}
+
+		//eventually publish the new cells
+		QMutexLocker locker(&m_lod.m_mutex);
+
+		std::vector<ccPointCloudLOD::Node>& nextLevelCells = m_lod.m_levels[level + 1].data;
+		const uint32_t firstNewCellIndex = static_cast<uint32_t>(nextLevelCells.size());
+		try
+		{
+			nextLevelCells.insert(nextLevelCells.end(), newCells.begin(), newCells.end());
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			return false;
+		}
+
+		for (const SubdividedCell& subdividedCell : subdividedCells)
+		{
+			ccPointCloudLOD::Node& node = m_lod.m_levels[level].data[subdividedCell.cellIndex];
+			for (uint8_t j = 0; j < subdividedCell.childCount; ++j)
+			{
+				uint32_t childNodeIndex = subdividedCell.firstChildIndex + j;
+				uint8_t childIndex = static_cast<uint8_t>((cellCodes[newCells[childNodeIndex].firstCodeIndex].theCode >> bitDec) & 7);
+				node.childIndexes[childIndex] = static_cast<int32_t>(firstNewCellIndex + childNodeIndex);
+			}
+			node.childCount = subdividedCell.childCount;
+		}
+
+		if (level < m_lod.m_maxLevel)
+		{
+			//accessible cells have been modified
+			++m_lod.m_version;
+		}
+		else
+		{
+			//a new level is accessible
+			m_lod.m_maxLevel = level + 1;
+		}
+
+		return true;
+	}
+
+	//! Handles a construction failure
+	void abort(const QString& errorMessage)
+	{
+		if (m_cancelToken.isCanceled())
+		{
+			//the structure is being cleared
+			return;
+		}
+		ccLog::Warning(errorMessage);
+		m_lod.setState(ccPointCloudLOD::BROKEN);
+	}
+
 	//reimplemented from QThread
 	virtual void run()
 	{
 		//reset structure
+		m_lod.lock();
 		m_lod.clearData();
-		m_lod.setState(ccPointCloudLOD::UNDER_CONSTRUCTION);
+		m_lod.m_state = ccPointCloudLOD::UNDER_CONSTRUCTION;
+		m_lod.unlock();
 
 		unsigned pointCount = m_cloud.size();
 		if (pointCount == 0)
@@ -190,11 +380,11 @@ protected:
 		if (!m_octree)
 		{
 			m_octree = ccOctree::Shared(new ccOctree(&m_cloud));
-			if (m_octree->build(0/*progressCallback*/) <= 0)
+			ccCancelTokenProgress cancelProgress(m_cancelToken); //to stop the construction if the LoD is cleared
+			if (m_octree->build(&cancelProgress) <= 0)
 			{
-				//not enough memory
-				ccLog::Warning(QString("[LoD] Failed to compute octree on cloud '%1' (not enough memory)").arg(m_cloud.getName()));
-				m_lod.setState(ccPointCloudLOD::BROKEN);
+				//not enough memory (or canceled)
+				abort(QString("[LoD] Failed to compute octree on cloud '%1' (not enough memory)").arg(m_cloud.getName()));
 				return;
 			}
 
@@ -204,18 +394,24 @@ protected:
 			}
 		}
 
+		//make sure we deprecate the LOD structure when this octree is modified!
+		QObject::connect(m_octree.data(), &ccOctree::updated, this, [&](){ m_cloud.clearLOD(); });
+
+		//was the structure loaded from a file?
+		if (m_lod.restoreLoadedData(m_octree))
+		{
+			ccLog::Print(QString("[LoD] Acceleration structure restored for cloud '%1' (max level: %2)").arg(m_cloud.getName()).arg(m_lod.maxLevel()));
+			return;
+		}
+
 		//init LoD structure
 		if (!m_lod.initInternal(m_octree))
 		{
 			//not enough memory
-			ccLog::Warning(QString("[LoD] Failed to compute LOD structure on cloud '%1' (not enough memory)").arg(m_cloud.getName()));
-			m_lod.setState(ccPointCloudLOD::BROKEN);
+			abort(QString("[LoD] Failed to compute LOD structure on cloud '%1' (not enough memory)").arg(m_cloud.getName()));
 			return;
 		}
 
-		//make sure we deprecate the LOD structure when this octree is modified!
-		QObject::connect(m_octree.data(), &ccOctree::updated, this, [&](){ m_cloud.clearLOD(); });
-
 		m_maxLevel = static_cast<uint8_t>(std::max<size_t>(1, m_lod.m_levels.size())) - 1;
 		assert(m_maxLevel <= CCLib::DgmOctree::MAX_OCTREE_LEVEL);
 
@@ -236,52 +432,31 @@ protected:
 
 		//init with root node
 		fillNode_flat(m_lod.root());
+		if (m_cancelToken.isCanceled())
+		{
+			return;
+		}
 
 		//first we allow the division of nodes as deep as possible but with a minimum number of points per cell
+		//(each new level becomes accessible as soon as it is complete)
 		for (uint8_t currentLevel = 0; currentLevel < m_maxLevel; ++currentLevel)
 		{
-			ccPointCloudLOD::Level& level = m_lod.m_levels[currentLevel];
+			const ccPointCloudLOD::Level& level = m_lod.m_levels[currentLevel];
 			if (level.data.empty())
 			{
 				break;
 			}
 
-			//update maxRadius for the previous level
-			//{
-			//	float maxRadius = 0;
-			//	for (ccPointCloudLOD::Node& n : level.data)
-			//	{
-			//		if (n.radius > maxRadius)
-			//		{
-			//			maxRadius = n.radius;
-			//		}
-			//	}
-			//	level.maxRadius = maxRadius;
-			//}
-
 			//the previous level is now ready!
 			ccLog::Print(QString("[LoD] Level %1: %2 cells").arg(currentLevel).arg(level.data.size()));
 
 			//now we can create the next level
 			if (currentLevel + 1 < m_maxLevel)
 			{
-				for (ccPointCloudLOD::Node& node : level.data)
+				if (!subdivideLevel(currentLevel, m_maxCountPerCell))
 				{
-					//do we need to subdivide this cell?
-					if (node.pointCount > m_maxCountPerCell)
-					{
-						for (uint32_t i = 0; i < node.pointCount;)
-						{
-							int32_t childNodeIndex = m_lod.newCell(node.level + 1);
-							ccPointCloudLOD::Node& childNode = m_lod.node(childNodeIndex, node.level + 1);
-							childNode.firstCodeIndex = node.firstCodeIndex + i;
-
-							uint8_t childIndex = fillNode_flat(childNode);
-							node.childIndexes[childIndex] = childNodeIndex;
-							node.childCount++;
-							i += childNode.pointCount;
-						}
-					}
+					abort(QString("[LoD] Failed to compute LOD structure on cloud '%1' (not enough memory)").arg(m_cloud.getName()));
+					return;
 				}
 			}
 		}
@@ -302,44 +477,17 @@ protected:
 				}
 			}
 
-			//now compute the mean radius for this level
-			//double meanRadius = 0;
-			//{
-			//	const ccPointCloudLOD::Level& level = m_lod.m_levels[biggestLevel];
-			//	size_t cellCount = level.data.size();
-			//	for (size_t i = 0; i < cellCount; ++i)
-			//	{
-			//		meanRadius += level.data[i].radius;
-			//	}
-
-			//	meanRadius /= cellCount;
-			//}
-
 			//and divide again the cells (with a lower limit on the number of points)
 			biggestLevel = std::min<uint8_t>(biggestLevel, 10);
 			for (uint8_t currentLevel = 0; currentLevel < biggestLevel; ++currentLevel)
 			{
-				ccPointCloudLOD::Level& level = m_lod.m_levels[currentLevel];
-				assert(!level.data.empty());
+				assert(!m_lod.m_levels[currentLevel].data.empty());
 
 				size_t cellCountBefore = m_lod.m_levels[currentLevel+1].data.size();
-				for (ccPointCloudLOD::Node& node : level.data)
+				if (!subdivideLevel(currentLevel, 16))
 				{
-					//do we need to subdivide this cell?
-					if (node.childCount == 0 && node.pointCount > 16)
-					{
-						for (uint32_t i = 0; i < node.pointCount;)
-						{
-							int32_t childNodeIndex = m_lod.newCell(node.level + 1);
-							ccPointCloudLOD::Node& childNode = m_lod.node(childNodeIndex, node.level + 1);
-							childNode.firstCodeIndex = node.firstCodeIndex + i;
-
-							uint8_t childIndex = fillNode_flat(childNode);
-							node.childIndexes[childIndex] = childNodeIndex;
-							node.childCount++;
-							i += childNode.pointCount;
-						}
-					}
+					abort(QString("[LoD] Failed to compute LOD structure on cloud '%1' (not enough memory)").arg(m_cloud.getName()));
+					return;
 				}
 
 				size_t cellCountAfter = m_lod.m_levels[currentLevel+1].data.size();
@@ -351,7 +499,10 @@ protected:
 		}
 #endif
 
-		m_lod.setState(ccPointCloudLOD::INITIALIZED);
+		m_lod.lock();
+		m_lod.m_maxLevel = m_maxLevel;
+		m_lod.m_state = ccPointCloudLOD::INITIALIZED;
+		m_lod.unlock();
 
 		ccLog::Print(QString("[LoD] Acceleration structure ready for cloud '%1' (max level: %2 / mem. = %3 Mb / duration: %4 s.)")
 			.arg(m_cloud.getName())
@@ -365,6 +516,7 @@ protected:
 	ccOctree::Shared m_octree;
 	uint32_t m_maxCountPerCell;
 	uint8_t m_maxLevel;
+	CCLib::ParallelCancelToken m_cancelToken;
 };
 
 ccPointCloudLOD::ccPointCloudLOD()
@@ -373,6 +525,10 @@ ccPointCloudLOD::ccPointCloudLOD()
 	, m_octree(0)
 	, m_thread(0)
 	, m_state(NOT_INITIALIZED)
+	, m_maxLevel(0)
+	, m_version(0)
+	, m_loadedOctreeMin(0, 0, 0)
+	, m_loadedOctreeMax(0, 0, 0)
 {
 	clearData(); //initializes the root node
 }
@@ -403,6 +559,184 @@ size_t ccPointCloudLOD::memory() const
 	return nodesSize + thisSize;
 }
 
+//! Size of a saved node (see ccPointCloudLOD::toFile)
+static const qint64 c_savedNodeSize = 4 /*pointCount*/ + 4 /*radius*/ + 12 /*center*/ + 32 /*childIndexes*/ + 4 /*firstCodeIndex*/ + 1 /*childCount*/;
+
+bool ccPointCloudLOD::toFile(QFile& out)
+{
+	QMutexLocker locker(&m_mutex);
+
+	if (m_state != INITIALIZED || !m_octree || m_levels.empty())
+	{
+		assert(false);
+		return false;
+	}
+
+	//octree bounding-box (the structure is only valid for the same octree)
+	CCVector3d octreeMin = CCVector3d::fromArray(m_octree->getOctreeMins().u);
+	CCVector3d octreeMax = CCVector3d::fromArray(m_octree->getOctreeMaxs().u);
+	if (	out.write((const char*)octreeMin.u, sizeof(double) * 3) < 0
+		||	out.write((const char*)octreeMax.u, sizeof(double) * 3) < 0)
+	{
+		return false;
+	}
+
+	//number of levels
+	uint8_t levelCount = static_cast<uint8_t>(m_levels.size());
+	if (out.write((const char*)&levelCount, 1) < 0)
+	{
+		return false;
+	}
+
+	//cells
+	for (const Level& level : m_levels)
+	{
+		uint32_t cellCount = static_cast<uint32_t>(level.data.size());
+		if (out.write((const char*)&cellCount, 4) < 0)
+		{
+			return false;
+		}
+
+		for (const Node& node : level.data)
+		{
+			if (	out.write((const char*)&node.pointCount, 4) < 0
+				||	out.write((const char*)&node.radius, 4) < 0
+				||	out.write((const char*)node.center.u, 12) < 0
+				||	out.write((const char*)node.childIndexes.data(), 32) < 0
+				||	out.write((const char*)&node.firstCodeIndex, 4) < 0
+				||	out.write((const char*)&node.childCount, 1) < 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool ccPointCloudLOD::fromFile(QFile& in, short dataVersion, int flags)
+{
+	assert(dataVersion >= 48);
+
+	QMutexLocker locker(&m_mutex);
+
+	m_loadedLevels.clear();
+
+	//octree bounding-box
+	if (	in.read((char*)m_loadedOctreeMin.u, sizeof(double) * 3) < 0
+		||	in.read((char*)m_loadedOctreeMax.u, sizeof(double) * 3) < 0)
+	{
+		return false;
+	}
+
+	//number of levels
+	uint8_t levelCount = 0;
+	if (in.read((char*)&levelCount, 1) < 0)
+	{
+		return false;
+	}
+
+	bool valid = (levelCount != 0 && levelCount <= CCLib::DgmOctree::MAX_OCTREE_LEVEL + 1);
+	try
+	{
+		m_loadedLevels.resize(levelCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory: the structure will be computed again (if necessary)
+		valid = false;
+	}
+
+	//cells
+	for (uint8_t l = 0; l < levelCount; ++l)
+	{
+		uint32_t cellCount = 0;
+		if (in.read((char*)&cellCount, 4) < 0)
+		{
+			return false;
+		}
+
+		if (valid)
+		{
+			try
+			{
+				m_loadedLevels[l].data.resize(cellCount, Node(l));
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory: the structure will be computed again (if necessary)
+				valid = false;
+			}
+		}
+
+		if (!valid)
+		{
+			//skip the cells
+			if (!in.seek(in.pos() + c_savedNodeSize * cellCount))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		for (Node& node : m_loadedLevels[l].data)
+		{
+			if (	in.read((char*)&node.pointCount, 4) < 0
+				||	in.read((char*)&node.radius, 4) < 0
+				||	in.read((char*)node.center.u, 12) < 0
+				||	in.read((char*)node.childIndexes.data(), 32) < 0
+				||	in.read((char*)&node.firstCodeIndex, 4) < 0
+				||	in.read((char*)&node.childCount, 1) < 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	//consistency check (so as to never access invalid cells afterwards)
+	if (valid)
+	{
+		valid = (m_loadedLevels.front().data.size() == 1);
+		uint32_t totalPointCount = valid ? m_loadedLevels.front().data.front().pointCount : 0;
+		for (size_t l = 0; valid && l < m_loadedLevels.size(); ++l)
+		{
+			size_t nextLevelCellCount = (l + 1 < m_loadedLevels.size() ? m_loadedLevels[l + 1].data.size() : 0);
+			for (const Node& node : m_loadedLevels[l].data)
+			{
+				if (static_cast<uint64_t>(node.firstCodeIndex) + node.pointCount > totalPointCount)
+				{
+					valid = false;
+					break;
+				}
+				uint8_t childCount = 0;
+				for (int32_t childIndex : node.childIndexes)
+				{
+					if (childIndex >= 0)
+					{
+						if (static_cast<size_t>(childIndex) >= nextLevelCellCount)
+						{
+							valid = false;
+						}
+						++childCount;
+					}
+				}
+				if (childCount != node.childCount)
+				{
+					valid = false;
+				}
+			}
+		}
+	}
+
+	if (!valid)
+	{
+		ccLog::Warning("[ccPointCloudLOD] Saved LoD structure is invalid or too big (it will be computed again)");
+		m_loadedLevels.clear();
+	}
+
+	return true;
+}
+
 bool ccPointCloudLOD::init(ccPointCloud* cloud)
 {
 	if (!cloud)
@@ -437,6 +771,41 @@ void ccPointCloudLOD::clearData()
 	m_levels.resize(1);
 	m_levels.front().data.resize(1);
 	m_levels.front().data.front() = Node();
+
+	m_maxLevel = 0;
+	++m_version;
+}
+
+bool ccPointCloudLOD::restoreLoadedData(ccOctree::Shared octree)
+{
+	QMutexLocker locker(&m_mutex);
+
+	if (m_loadedLevels.empty())
+	{
+		return false;
+	}
+
+	//the octree must be the same as the one used to build the saved structure
+	//(otherwise the cells don't point on the right codes anymore)
+	const CCVector3& octreeMin = octree->getOctreeMins();
+	const CCVector3& octreeMax = octree->getOctreeMaxs();
+	if (	m_loadedLevels.front().data.front().pointCount != octree->getNumberOfProjectedPoints()
+		||	(CCVector3d::fromArray(octreeMin.u) - m_loadedOctreeMin).norm2() != 0
+		||	(CCVector3d::fromArray(octreeMax.u) - m_loadedOctreeMax).norm2() != 0)
+	{
+		ccLog::Warning("[LoD] The saved LoD structure doesn't match the cloud octree anymore (it will be computed again)");
+		m_loadedLevels.clear();
+		return false;
+	}
+
+	m_levels.swap(m_loadedLevels);
+	m_loadedLevels.clear();
+	m_octree = octree;
+	m_maxLevel = static_cast<unsigned char>(m_levels.size() - 1);
+	++m_version;
+	m_state = INITIALIZED;
+
+	return true;
 }
 
 bool ccPointCloudLOD::initInternal(ccOctree::Shared octree)
@@ -446,11 +815,11 @@ bool ccPointCloudLOD::initInternal(ccOctree::Shared octree)
 		return false;
 	}
 	
+	QMutexLocker locker(&m_mutex);
+
 	//clear the structure (just in case)
 	clearData();
 
-	QMutexLocker locker(&m_mutex);
-
 	try
 	{
 		assert(CCLib::DgmOctree::MAX_OCTREE_LEVEL <= 255);
@@ -523,14 +892,22 @@ void ccPointCloudLOD::shrink_to_fit()
 void ccPointCloudLOD::clear()
 {
 	m_mutex.lock();
+	ccPointCloudLODThread* thread = m_thread;
+	m_thread = 0;
+	m_mutex.unlock();
 
-	if (m_thread)
+	//DGM: the thread must be stopped without holding the lock (as it may be waiting for it)
+	if (thread)
 	{
-		delete m_thread;
-		m_thread = 0;
+		delete thread;
 	}
 
+	m_mutex.lock();
+
 	m_levels.clear();
+	m_loadedLevels.clear();
+	m_maxLevel = 0;
+	++m_version;
 	m_state = NOT_INITIALIZED;
 
 	m_mutex.unlock();
@@ -538,14 +915,16 @@ void ccPointCloudLOD::clear()
 
 void ccPointCloudLOD::resetVisibility()
 {
-	if (m_state != INITIALIZED)
+	if (m_maxLevel == 0)
 	{
 		return;
 	}
 
 	m_currentState = RenderParams();
+	m_currentState.maxLevel = m_maxLevel;
+	m_currentState.version = m_version;
 
-	for (size_t l = 0; l < m_levels.size(); ++l)
+	for (size_t l = 0; l <= m_maxLevel; ++l)
 	{
 		for (Node& n : m_levels[l].data)
 		{
@@ -586,7 +965,7 @@ public:
 	{
 		node.intersection = flag;
 
-		if (node.childCount)
+		if (node.childCount && node.level < m_maxLevel)
 		{
 			for (int i = 0; i < 8; ++i)
 			{
@@ -679,16 +1058,20 @@ public:
 
 uint32_t ccPointCloudLOD::flagVisibility(const Frustum& frustum, ccClipPlaneSet* clipPlanes/*=0*/)
 {
-	if (m_state != INITIALIZED)
+	QMutexLocker locker(&m_mutex);
+
+	if ((m_state != INITIALIZED && m_state != UNDER_CONSTRUCTION) || m_maxLevel == 0)
 	{
 		assert(false);
 		m_currentState = RenderParams();
 		return 0;
 	}
 
+	//the cells of the last accessible level are considered as leaves during the whole rendering sequence
+	//(even if the next level becomes accessible in the meantime)
 	resetVisibility();
 
-	PointCloudLODVisibilityFlagger lodVisibility(*this, frustum, static_cast<unsigned char>(m_levels.size()));
+	PointCloudLODVisibilityFlagger lodVisibility(*this, frustum, m_currentState.maxLevel);
 	if (clipPlanes)
 	{
 		lodVisibility.setClipPlanes(*clipPlanes);
@@ -709,7 +1092,7 @@ uint32_t ccPointCloudLOD::addNPointsToIndexMap(Node& node, uint32_t count)
 	
 	uint32_t displayedCount = 0;
 
-	if (node.childCount)
+	if (!isLeaf(node))
 	{
 		uint32_t thisNodeRemainingCount = (node.pointCount - node.displayedPointCount);
 		assert(count <= thisNodeRemainingCount);
@@ -776,6 +1159,8 @@ uint32_t ccPointCloudLOD::addNPointsToIndexMap(Node& node, uint32_t count)
 
 LODIndexSet* ccPointCloudLOD::getIndexMap(unsigned char level, unsigned& maxCount, unsigned& remainingPointsAtThisLevel)
 {
+	QMutexLocker locker(&m_mutex);
+
 	remainingPointsAtThisLevel = 0;
 	m_lastIndexMap = 0;
 
@@ -786,8 +1171,16 @@ LODIndexSet* ccPointCloudLOD::getIndexMap(unsigned char level, unsigned& maxCoun
 		return 0;
 	}
 
-	if (m_state != INITIALIZED)
+	if ((m_state != INITIALIZED && m_state != UNDER_CONSTRUCTION) || level > m_currentState.maxLevel)
+	{
+		maxCount = 0;
+		return 0;
+	}
+
+	if (m_currentState.version != m_version)
 	{
+		//the structure has been modified since the last visibility test: we stop this rendering sequence
+		m_currentState.displayedPoints = m_currentState.visiblePoints;
 		maxCount = 0;
 		return 0;
 	}
@@ -831,7 +1224,7 @@ LODIndexSet* ccPointCloudLOD::getIndexMap(unsigned char level, unsigned& maxCoun
 		{
 			Node& node = l.data[i];
 
-			if (node.childCount) //skip non leaf cells
+			if (!isLeaf(node)) //skip non leaf cells
 				continue;
 			assert(node.intersection != UNDEFINED);
 			if (node.intersection == Frustum::OUTSIDE)
@@ -903,7 +1296,7 @@ LODIndexSet* ccPointCloudLOD::getIndexMap(unsigned char level, unsigned& maxCoun
 			{
 				nodeMaxCount = nodeRemainingCount;
 			}
-			else if (node.childCount)
+			else if (!isLeaf(node))
 			{
 				double ratio = static_cast<double>(nodeRemainingCount) / totalRemainingCount;
 				nodeMaxCount = static_cast<uint32_t>(ceil(ratio * mapFreeSize));
@@ -926,7 +1319,7 @@ LODIndexSet* ccPointCloudLOD::getIndexMap(unsigned char level, unsigned& maxCoun
 			thisPassDisplayCount += nodeDisplayCount;
 			assert(thisPassDisplayCount == m_indexMap->currentSize());
 
-			if (node.childCount == 0)
+			if (isLeaf(node))
 			{
 				remainingPointsAtThisLevel += (node.pointCount - node.displayedPointCount);
 			}
@@ -943,7 +1336,7 @@ LODIndexSet* ccPointCloudLOD::getIndexMap(unsigned char level, unsigned& maxCoun
 		{
 			Node& node = l.data[i];
 
-			if (node.childCount) //skip non leaf nodes
+			if (!isLeaf(node)) //skip non leaf nodes
 				continue;
 			assert(node.intersection != UNDEFINED);
 			if (node.intersection == Frustum::OUTSIDE)
@@ -35,6 +35,7 @@
 
 class ccPointCloud;
 class ccPointCloudLODThread;
+class QFile;
 
 //! Level descriptor
 struct LODLevelDesc
@@ -94,7 +95,11 @@ public:
 	inline bool isBroken() { return getState() == BROKEN; }
 
 	//! Returns the maximum accessible level
-	inline unsigned char maxLevel() { QMutexLocker locker(&m_mutex); return (m_state == INITIALIZED ? static_cast<unsigned char>(std::max<size_t>(1, m_levels.size()))-1 : 0); }
+	/** While the structure is under construction, the coarse levels are
+		already accessible (the finer ones are published as soon as they
+		are complete).
+	**/
+	inline unsigned char maxLevel() { QMutexLocker locker(&m_mutex); return (m_state == INITIALIZED || m_state == UNDER_CONSTRUCTION ? m_maxLevel : 0); }
 
 	//! Undefined visibility flag
 	static const unsigned char UNDEFINED = 255;
@@ -169,6 +174,18 @@ public:
 	//! Returns the memory used by the structure (in bytes)
 	size_t memory() const;
 
+	//! Saves the structure to a file (must be initialized)
+	/** See ccPointCloud::toFile_MeOnly.
+	**/
+	bool toFile(QFile& out);
+
+	//! Loads a previously saved structure
+	/** The structure is only restored when init is called (as it relies on the
+		cloud octree). If the octree doesn't match anymore, it is computed again.
+		See ccPointCloud::fromFile_MeOnly.
+	**/
+	bool fromFile(QFile& in, short dataVersion, int flags);
+
 protected: //methods
 
 	friend ccPointCloudLODThread;
@@ -185,6 +202,12 @@ protected: //methods
 	//! Clears the internal (nodes) data
 	void clearData();
 
+	//! Restores the loaded structure (if any and if it is compatible with the given octree)
+	bool restoreLoadedData(ccOctree::Shared octree);
+
+	//! Returns whether a node is a leaf for the current rendering pass
+	inline bool isLeaf(const Node& node) const { return node.level >= m_currentState.maxLevel || node.childCount == 0; }
+
 	//! Reserves a new cell at a given level
 	/** \return the new cell index in the array corresponding to this level (see m_levels)
 	**/
@@ -227,6 +250,8 @@ protected: //members
 			, displayedPoints(0)
 			, unfinishedLevel(-1)
 			, unfinishedPoints(0)
+			, maxLevel(0)
+			, version(0)
 		{}
 
 		//! Number of visible points (for the last visibility test)
@@ -237,6 +262,10 @@ protected: //members
 		int unfinishedLevel;
 		//! Previously unfinished level
 		unsigned unfinishedPoints;
+		//! Maximum accessible level (at the time of the last visibility test)
+		unsigned char maxLevel;
+		//! Structure version (at the time of the last visibility test)
+		unsigned version;
 	};
 
 	//! Current rendering state
@@ -259,6 +288,22 @@ protected: //members
 
 	//! State
 	State m_state;
+
+	//! Maximum accessible level
+	unsigned char m_maxLevel;
+
+	//! Structure version
+	/** Incremented each time already accessible cells are modified (i.e. during the
+		refinement step). Any rendering sequence started before is then stopped.
+	**/
+	unsigned m_version;
+
+	//! Loaded structure (see fromFile)
+	std::vector<Level> m_loadedLevels;
+	//! Octree bounding-box (min corner) of the loaded structure
+	CCVector3d m_loadedOctreeMin;
+	//! Octree bounding-box (max corner) of the loaded structure
+	CCVector3d m_loadedOctreeMax;
 };
 
 class PointCloudLODRenderer
@@ -19,6 +19,7 @@
 
 //CCLib
 #include <Delaunay2dMesh.h>
+#include <ParallelTools.h>
 //#include <PointProjectionTools.h>
 
 //qCC_db
@@ -33,6 +34,14 @@
 
 //System
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+//! Max number of tiles for which the empty cells are interpolated with a single (global) triangulation
+static const size_t MAX_TILE_COUNT_FOR_GLOBAL_INTERPOLATION = 4;
+//! Initial margin (in cells) around the tiles for the tiled interpolation of the empty cells
+static const int INTERPOLATION_MIN_MARGIN = 32;
 
 //default field names
 struct DefaultFieldNames : public QMap<ccRasterGrid::ExportableFields, QString>
@@ -57,7 +66,9 @@ QString ccRasterGrid::GetDefaultFieldName(ExportableFields field)
 }
 
 ccRasterGrid::ccRasterGrid()
-	: width(0)
+	: optionalLayers(ALL_OPTIONAL_LAYERS)
+	, scalarFieldCount(0)
+	, width(0)
 	, height(0)
 	, gridStep(1.0)
 	, minCorner(0, 0, 0)
@@ -75,6 +86,26 @@ ccRasterGrid::~ccRasterGrid()
 	clear();
 }
 
+int ccRasterGrid::GetRequiredLayers(ExportableFields field)
+{
+	switch (field)
+	{
+	case PER_CELL_MIN_HEIGHT:
+		return LAYER_MIN_HEIGHT;
+	case PER_CELL_MAX_HEIGHT:
+		return LAYER_MAX_HEIGHT;
+	case PER_CELL_AVG_HEIGHT:
+		return LAYER_AVG_HEIGHT;
+	case PER_CELL_HEIGHT_STD_DEV:
+		return LAYER_AVG_HEIGHT | LAYER_HEIGHT_STD_DEV;
+	case PER_CELL_HEIGHT_RANGE:
+		return LAYER_MIN_HEIGHT | LAYER_MAX_HEIGHT;
+	default:
+		//the height and population layers are always available
+		return NO_OPTIONAL_LAYER;
+	}
+}
+
 bool ccRasterGrid::ComputeGridSize(	unsigned char Z,
 									const ccBBox& box,
 									double gridStep,
@@ -114,8 +145,12 @@ void ccRasterGrid::clear()
 	//reset
 	width = height = 0;
 
-	rows.clear();
-	scalarFields.clear();
+	for (Tile* t : tiles)
+	{
+		delete t;
+	}
+	tiles.clear();
+	scalarFieldCount = 0;
 
 	minHeight = maxHeight = meanHeight = 0;
 	nonEmptyCellCount = validCellCount = 0;
@@ -127,31 +162,139 @@ void ccRasterGrid::clear()
 bool ccRasterGrid::init(unsigned w,
 						unsigned h,
 						double s,
-						const CCVector3d& c)
+						const CCVector3d& c,
+						int layers/*=ALL_OPTIONAL_LAYERS*/)
 {
 	//we always restart from scratch (clearer / safer)
 	clear();
 
+	width = w;
+	height = h;
+	gridStep = s;
+	minCorner = c;
+
+	//the std. dev. is computed from the average height
+	optionalLayers = (layers & LAYER_HEIGHT_STD_DEV) ? (layers | LAYER_AVG_HEIGHT) : layers;
+
+	//the tiles themselves will be allocated on demand
+	try
+	{
+		tiles.resize(static_cast<size_t>(tileCountX()) * tileCountY(), 0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		width = height = 0;
+		return false;
+	}
+
+	return true;
+}
+
+ccRasterGrid::Tile* ccRasterGrid::getOrCreateTile(unsigned tx, unsigned ty, bool withOptionalLayers/*=false*/)
+{
+	assert(tx < tileCountX() && ty < tileCountY());
+
+	Tile*& t = tiles[ty * tileCountX() + tx];
+	if (t)
+	{
+		return t;
+	}
+
+	Tile* newTile = 0;
 	try
 	{
-		rows.resize(h);
-		for (Row& row : rows)
+		newTile = new Tile;
+		newTile->width = std::min(static_cast<unsigned>(TILE_SIZE), width - (tx << TILE_SIZE_SHIFT));
+		newTile->height = std::min(static_cast<unsigned>(TILE_SIZE), height - (ty << TILE_SIZE_SHIFT));
+
+		const unsigned cellCount = newTile->width * newTile->height;
+		newTile->h.resize(cellCount, std::numeric_limits<double>::quiet_NaN());
+		newTile->nbPoints.resize(cellCount, 0);
+
+		if (withOptionalLayers)
 		{
-			row.resize(w);
+			if (optionalLayers & LAYER_MIN_HEIGHT)
+				newTile->minHeight.resize(cellCount, 0);
+			if (optionalLayers & LAYER_MAX_HEIGHT)
+				newTile->maxHeight.resize(cellCount, 0);
+			if (optionalLayers & LAYER_AVG_HEIGHT)
+				newTile->avgHeight.resize(cellCount, 0);
+			if (optionalLayers & LAYER_HEIGHT_STD_DEV)
+				newTile->stdDevHeight.resize(cellCount, 0);
+			if (optionalLayers & LAYER_POINT_INDEX)
+				newTile->pointIndex.resize(cellCount, 0);
+			if (hasColors)
+				newTile->color.resize(cellCount, CCVector3d(0, 0, 0));
+
+			newTile->scalarFields.resize(scalarFieldCount);
+			for (std::vector<double>& sf : newTile->scalarFields)
+			{
+				sf.resize(cellCount, std::numeric_limits<double>::quiet_NaN());
+			}
 		}
 	}
 	catch (const std::bad_alloc&)
 	{
 		//not enough memory
-		rows.clear();
+		delete newTile;
+		return 0;
+	}
+
+	t = newTile;
+	return t;
+}
+
+ccRasterCell ccRasterGrid::cell(unsigned i, unsigned j) const
+{
+	ccRasterCell c;
+
+	const Tile* t = cellTile(i, j);
+	if (t)
+	{
+		unsigned index = t->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1));
+		c.h = t->h[index];
+		c.nbPoints = t->nbPoints[index];
+		if (!t->minHeight.empty())
+			c.minHeight = t->minHeight[index];
+		if (!t->maxHeight.empty())
+			c.maxHeight = t->maxHeight[index];
+		if (!t->avgHeight.empty())
+			c.avgHeight = t->avgHeight[index];
+		if (!t->stdDevHeight.empty())
+			c.stdDevHeight = t->stdDevHeight[index];
+		if (!t->pointIndex.empty())
+			c.pointIndex = t->pointIndex[index];
+		if (!t->color.empty())
+			c.color = t->color[index];
+	}
+
+	return c;
+}
+
+bool ccRasterGrid::setCellHeight(unsigned i, unsigned j, double h)
+{
+	Tile* t = getOrCreateTile(i >> TILE_SIZE_SHIFT, j >> TILE_SIZE_SHIFT);
+	if (!t)
+	{
 		return false;
 	}
 
-	width = w;
-	height = h;
-	gridStep = s;
-	minCorner = c;
+	t->h[t->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1))] = h;
+	return true;
+}
 
+bool ccRasterGrid::setCellHeightAndCount(unsigned i, unsigned j, double h, unsigned nbPoints)
+{
+	Tile* t = getOrCreateTile(i >> TILE_SIZE_SHIFT, j >> TILE_SIZE_SHIFT);
+	if (!t)
+	{
+		return false;
+	}
+
+	unsigned index = t->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1));
+	t->h[index] = h;
+	t->nbPoints[index] = nbPoints;
 	return true;
 }
 
@@ -160,7 +303,8 @@ bool ccRasterGrid::fillWith(	ccGenericPointCloud* cloud,
 								ProjectionType projectionType,
 								bool interpolateEmptyCells,
 								ProjectionType sfInterpolation/*=INVALID_PROJECTION_TYPE*/,
-								ccProgressDialog* progressDialog/*=0*/)
+								ccProgressDialog* progressDialog/*=0*/,
+								int maxThreadCount/*=0*/)
 {
 	if (!cloud)
 	{
@@ -168,8 +312,7 @@ bool ccRasterGrid::fillWith(	ccGenericPointCloud* cloud,
 		return false;
 	}
 
-	unsigned gridTotalSize = width * height;
-	if (gridTotalSize == 0)
+	if (width == 0 || height == 0 || tiles.empty())
 	{
 		assert(false);
 		return false;
@@ -182,480 +325,1513 @@ bool ccRasterGrid::fillWith(	ccGenericPointCloud* cloud,
 		pc = static_cast<ccPointCloud*>(cloud);
 	}
 
+	//the layer corresponding to the projection type is always required
+	switch (projectionType)
+	{
+	case PROJ_MINIMUM_VALUE:
+		optionalLayers |= LAYER_MIN_HEIGHT;
+		break;
+	case PROJ_AVERAGE_VALUE:
+		optionalLayers |= LAYER_AVG_HEIGHT;
+		break;
+	case PROJ_MAXIMUM_VALUE:
+		optionalLayers |= LAYER_MAX_HEIGHT;
+		break;
+	default:
+		assert(false);
+		break;
+	}
+
 	//do we need to interpolate scalar fields?
 	bool interpolateSF = (sfInterpolation != INVALID_PROJECTION_TYPE);
+	scalarFieldCount = 0;
 	if (interpolateSF)
 	{
 		if (pc && pc->hasScalarFields())
 		{
-			unsigned sfCount = pc->getNumberOfScalarFields();
-			try
+			//the SF layers are allocated along with the tiles
+			scalarFieldCount = pc->getNumberOfScalarFields();
+		}
+		else
+		{
+			interpolateSF = false;
+		}
+	}
+
+	//we handle the colors (if any, and if they have been requested)
+	hasColors = (cloud->hasColors() && (optionalLayers & LAYER_COLOR));
+
+	//filling the grid
+	unsigned pointCount = cloud->size();
+
+	if (progressDialog)
+	{
+		progressDialog->setMethodTitle(QObject::tr("Grid generation"));
+		progressDialog->setInfo(QObject::tr("Points: %L1\nCells: %L2 x %L3").arg( pointCount ).arg(width).arg(height));
+		progressDialog->start();
+		progressDialog->show();
+		QCoreApplication::processEvents();
+	}
+	CCLib::NormalizedProgress nProgress(progressDialog, pointCount);
+
+	//vertical dimension
+	assert(Z <= 2);
+	const unsigned char X = Z == 2 ? 0 : Z + 1;
+	const unsigned char Y = X == 2 ? 0 : X + 1;
+
+	const unsigned tileCount = static_cast<unsigned>(tiles.size());
+	const unsigned tileCountX = this->tileCountX();
+
+	if (maxThreadCount <= 0)
+	{
+		maxThreadCount = CCLib::ParallelTools::DefaultMaxThreadCount();
+	}
+
+	//1st step: sort the points by tile (the points order is kept inside each tile)
+	std::vector<unsigned> tileStarts;
+	std::vector<unsigned> sortedIndexes;
+	{
+		//each thread processes a contiguous chunk of points
+		const unsigned chunkCount = std::max(1u, std::min(static_cast<unsigned>(maxThreadCount), pointCount));
+		auto chunkStart = [pointCount, chunkCount](unsigned c) { return static_cast<unsigned>((static_cast<uint64_t>(pointCount) * c) / chunkCount); };
+
+		std::vector<unsigned> pointTiles;
+		std::vector<unsigned> chunkTileOffsets;
+		try
+		{
+			pointTiles.resize(pointCount);
+			chunkTileOffsets.resize(static_cast<size_t>(chunkCount) * tileCount, 0);
+			tileStarts.resize(tileCount + 1, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			ccLog::Warning("[Rasterize] Not enough memory!");
+			return false;
+		}
+
+		//count the points falling in each tile (per chunk)
+		CCLib::ParallelTools::ForEach(	chunkCount,
+										[&](unsigned c)
+										{
+											unsigned* counts = &chunkTileOffsets[static_cast<size_t>(c) * tileCount];
+											for (unsigned n = chunkStart(c); n < chunkStart(c + 1); ++n)
+											{
+												const CCVector3* P = cloud->getPoint(n);
+
+												//project it inside the grid
+												CCVector3d relativePos = CCVector3d::fromArray(P->u) - minCorner;
+												int i = static_cast<int>((relativePos.u[X] / gridStep + 0.5));
+												int j = static_cast<int>((relativePos.u[Y] / gridStep + 0.5));
+
+												//we skip points that fall outside of the grid!
+												if (	i < 0 || i >= static_cast<int>(width)
+													||	j < 0 || j >= static_cast<int>(height) )
+												{
+													pointTiles[n] = tileCount;
+													continue;
+												}
+
+												unsigned t = (static_cast<unsigned>(j) >> TILE_SIZE_SHIFT) * tileCountX + (static_cast<unsigned>(i) >> TILE_SIZE_SHIFT);
+												pointTiles[n] = t;
+												++counts[t];
+											}
+										},
+										maxThreadCount,
+										0,
+										1 );
+
+		//convert the counts to offsets (tile by tile, then chunk by chunk)
+		unsigned sortedCount = 0;
+		for (unsigned t = 0; t < tileCount; ++t)
+		{
+			tileStarts[t] = sortedCount;
+			for (unsigned c = 0; c < chunkCount; ++c)
 			{
-				scalarFields.resize(sfCount);
-				for (unsigned i = 0; i < sfCount; ++i)
+				unsigned& offset = chunkTileOffsets[static_cast<size_t>(c) * tileCount + t];
+				unsigned count = offset;
+				offset = sortedCount;
+				sortedCount += count;
+			}
+		}
+		tileStarts[tileCount] = sortedCount;
+
+		try
+		{
+			sortedIndexes.resize(sortedCount);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			ccLog::Warning("[Rasterize] Not enough memory!");
+			return false;
+		}
+
+		//dispatch the point indexes
+		CCLib::ParallelTools::ForEach(	chunkCount,
+										[&](unsigned c)
+										{
+											unsigned* offsets = &chunkTileOffsets[static_cast<size_t>(c) * tileCount];
+											for (unsigned n = chunkStart(c); n < chunkStart(c + 1); ++n)
+											{
+												unsigned t = pointTiles[n];
+												if (t < tileCount)
+												{
+													sortedIndexes[offsets[t]++] = n;
+												}
+											}
+										},
+										maxThreadCount,
+										0,
+										1 );
+
+		//the points outside of the grid are skipped
+		if (!nProgress.steps(pointCount - sortedCount))
+		{
+			//process cancelled by the user
+			return false;
+		}
+	}
+
+	//2nd step: fill the tiles (each tile is processed by a single thread)
+	CCLib::ParallelCancelToken cancelToken;
+	std::atomic<bool> notEnoughMemory(false);
+	CCLib::ParallelTools::ForEach(	tileCount,
+									[&](unsigned t)
+									{
+										const unsigned first = tileStarts[t];
+										const unsigned last = tileStarts[t + 1];
+										if (first == last)
+										{
+											//empty tile
+											return;
+										}
+
+										const unsigned tx = t % tileCountX;
+										const unsigned ty = t / tileCountX;
+										Tile* tile = getOrCreateTile(tx, ty, true);
+										if (!tile)
+										{
+											notEnoughMemory = true;
+											cancelToken.cancel();
+											return;
+										}
+
+										const unsigned tileCellCount = tile->width * tile->height;
+										const bool hasMin = !tile->minHeight.empty();
+										const bool hasMax = !tile->maxHeight.empty();
+										const bool hasAvg = !tile->avgHeight.empty();
+										const bool hasStdDev = !tile->stdDevHeight.empty();
+										const bool hasPointIndex = !tile->pointIndex.empty();
+
+										//sum of the colors (for the 'average' projection type)
+										std::vector<CCVector3d> colorSums;
+										if (hasColors && projectionType == PROJ_AVERAGE_VALUE)
+										{
+											try
+											{
+												colorSums.resize(tileCellCount, CCVector3d(0, 0, 0));
+											}
+											catch (const std::bad_alloc&)
+											{
+												notEnoughMemory = true;
+												cancelToken.cancel();
+												return;
+											}
+										}
+
+										const int i0 = static_cast<int>(tx << TILE_SIZE_SHIFT);
+										const int j0 = static_cast<int>(ty << TILE_SIZE_SHIFT);
+
+										for (unsigned k = first; k < last; ++k)
+										{
+											const unsigned n = sortedIndexes[k];
+											const CCVector3* P = cloud->getPoint(n);
+
+											//project it inside the grid
+											CCVector3d relativePos = CCVector3d::fromArray(P->u) - minCorner;
+											int i = static_cast<int>((relativePos.u[X] / gridStep + 0.5));
+											int j = static_cast<int>((relativePos.u[Y] / gridStep + 0.5));
+											const unsigned index = tile->cellIndex(static_cast<unsigned>(i - i0), static_cast<unsigned>(j - j0));
+											assert(index < tileCellCount);
+
+											//update the cell statistics
+											unsigned& nbPoints = tile->nbPoints[index];
+											if (nbPoints)
+											{
+												if (hasMin && P->u[Z] < tile->minHeight[index])
+												{
+													tile->minHeight[index] = P->u[Z];
+													if (projectionType == PROJ_MINIMUM_VALUE)
+													{
+														//we keep track of the lowest point
+														if (hasPointIndex)
+														{
+															tile->pointIndex[index] = n;
+														}
+														if (hasColors)
+														{
+															const ColorCompType* col = cloud->getPointColor(n);
+															tile->color[index] = CCVector3d(col[0], col[1], col[2]);
+														}
+													}
+												}
+												if (hasMax && P->u[Z] > tile->maxHeight[index])
+												{
+													tile->maxHeight[index] = P->u[Z];
+													if (projectionType == PROJ_MAXIMUM_VALUE)
+													{
+														//we keep track of the highest point
+														if (hasPointIndex)
+														{
+															tile->pointIndex[index] = n;
+														}
+														if (hasColors)
+														{
+															const ColorCompType* col = cloud->getPointColor(n);
+															tile->color[index] = CCVector3d(col[0], col[1], col[2]);
+														}
+													}
+												}
+
+												if (projectionType == PROJ_AVERAGE_VALUE)
+												{
+													if (hasPointIndex)
+													{
+														//we keep track of the point which is the closest to the cell center (in 2D)
+														CCVector2d C((i + 0.5) * gridStep, (j + 0.5) * gridStep);
+														const CCVector3* Q = cloud->getPoint(tile->pointIndex[index]); //former closest point
+														CCVector3d relativePosQ = CCVector3d::fromArray(Q->u) - minCorner;
+
+														double distToP = (C - CCVector2d(relativePos .u[X], relativePos .u[Y])).norm2();
+														double distToQ = (C - CCVector2d(relativePosQ.u[X], relativePosQ.u[Y])).norm2();
+														if (distToP < distToQ)
+														{
+															tile->pointIndex[index] = n;
+														}
+													}
+
+													if (hasColors)
+													{
+														const ColorCompType* col = cloud->getPointColor(n);
+														colorSums[index] += CCVector3d(col[0], col[1], col[2]);
+													}
+												}
+											}
+											else
+											{
+												if (hasMin)
+													tile->minHeight[index] = P->u[Z];
+												if (hasMax)
+													tile->maxHeight[index] = P->u[Z];
+												if (hasPointIndex)
+													tile->pointIndex[index] = n;
+
+												if (hasColors)
+												{
+													const ColorCompType* col = cloud->getPointColor(n);
+													if (colorSums.empty())
+														tile->color[index] = CCVector3d(col[0], col[1], col[2]);
+													else
+														colorSums[index] = CCVector3d(col[0], col[1], col[2]);
+												}
+											}
+
+											//sum the points heights
+											double Pz = P->u[Z];
+											if (hasAvg)
+											{
+												tile->avgHeight[index] += Pz;
+											}
+											if (hasStdDev)
+											{
+												tile->stdDevHeight[index] += Pz * Pz;
+											}
+
+											//scalar fields
+											if (interpolateSF)
+											{
+												assert(pc);
+												for (unsigned sfIndex = 0; sfIndex < scalarFieldCount; ++sfIndex)
+												{
+													CCLib::ScalarField* sf = pc->getScalarField(static_cast<int>(sfIndex));
+													assert(sf && n < sf->currentSize());
+
+													ScalarType sfValue = sf->getValue(n);
+
+													if (ccScalarField::ValidValue(sfValue))
+													{
+														double& cellValue = tile->scalarFields[sfIndex][index];
+														if (nbPoints && std::isfinite(cellValue))
+														{
+															switch (sfInterpolation)
+															{
+															case PROJ_MINIMUM_VALUE:
+																// keep the minimum value
+																cellValue = std::min<double>(cellValue, sfValue);
+																break;
+															case PROJ_AVERAGE_VALUE:
+																//we sum all values (we will divide them later)
+																cellValue += sfValue;
+																break;
+															case PROJ_MAXIMUM_VALUE:
+																// keep the maximum value
+																cellValue = std::max<double>(cellValue, sfValue);
+																break;
+															default:
+																assert(false);
+																break;
+															}
+														}
+														else
+														{
+															//for the first (valid) point, we simply have to store its SF value (in any case)
+															cellValue = sfValue;
+														}
+													}
+												}
+											}
+
+											//update the number of points in the cell
+											++nbPoints;
+										}
+
+										//update the tile layers (average height and std.dev. computation + current 'height' value)
+										for (unsigned index = 0; index < tileCellCount; ++index)
+										{
+											const unsigned nbPoints = tile->nbPoints[index];
+											if (nbPoints == 0)
+											{
+												continue;
+											}
+
+											if (hasAvg)
+											{
+												double& avgHeight = tile->avgHeight[index];
+												if (nbPoints > 1)
+												{
+													avgHeight /= nbPoints;
+													if (hasStdDev)
+													{
+														tile->stdDevHeight[index] = sqrt(fabs(tile->stdDevHeight[index] / nbPoints - avgHeight*avgHeight));
+													}
+												}
+												else if (hasStdDev)
+												{
+													tile->stdDevHeight[index] = 0;
+												}
+											}
+
+											if (!colorSums.empty())
+											{
+												tile->color[index] = colorSums[index] / nbPoints;
+											}
+
+											//update SF grids for 'average' cases
+											if (sfInterpolation == PROJ_AVERAGE_VALUE && nbPoints > 1)
+											{
+												for (std::vector<double>& sf : tile->scalarFields)
+												{
+													if (std::isfinite(sf[index])) //valid SF value
+													{
+														sf[index] /= nbPoints;
+													}
+												}
+											}
+
+											//set the right 'height' value
+											switch (projectionType)
+											{
+											case PROJ_MINIMUM_VALUE:
+												tile->h[index] = tile->minHeight[index];
+												break;
+											case PROJ_AVERAGE_VALUE:
+												tile->h[index] = tile->avgHeight[index];
+												break;
+											case PROJ_MAXIMUM_VALUE:
+												tile->h[index] = tile->maxHeight[index];
+												break;
+											default:
+												assert(false);
+												break;
+											}
+										}
+
+										if (!nProgress.steps(last - first))
+										{
+											//process cancelled by the user
+											cancelToken.cancel();
+										}
+									},
+									maxThreadCount,
+									&cancelToken,
+									1 );
+
+	if (notEnoughMemory)
+	{
+		ccLog::Warning("[Rasterize] Not enough memory!");
+		return false;
+	}
+	else if (cancelToken.isCanceled())
+	{
+		//process cancelled by the user
+		return false;
+	}
+
+	//we don't need the sorted indexes anymore
+	sortedIndexes.clear();
+	sortedIndexes.shrink_to_fit();
+
+	//compute the number of non empty cells
+	nonEmptyCellCount = 0;
+	for (const Tile* tile : tiles)
+	{
+		if (tile)
+		{
+			for (unsigned nbPoints : tile->nbPoints)
+				if (nbPoints)
+					++nonEmptyCellCount;
+		}
+	}
+
+	//specific case: interpolate the empty cells
+	if (interpolateEmptyCells)
+	{
+		fillEmptyCellsByInterpolation(maxThreadCount);
+	}
+
+	//computation of the average and extreme height values in the grid
+	{
+		minHeight = 0;
+		maxHeight = 0;
+		meanHeight = 0;
+		validCellCount = 0;
+
+		for (unsigned j = 0; j < height; ++j)
+		{
+			for (unsigned i = 0; i < width; ++i)
+			{
+				double h = cellHeight(i, j);
+
+				if (std::isfinite(h)) //valid height
 				{
-					scalarFields[i].resize(gridTotalSize, std::numeric_limits<SF::value_type>::quiet_NaN());
+					if (validCellCount)
+					{
+						if (h < minHeight)
+							minHeight = h;
+						else if (h > maxHeight)
+							maxHeight = h;
+
+						meanHeight += h;
+					}
+					else
+					{
+						//first valid cell
+						meanHeight = minHeight = maxHeight = h;
+					}
+					++validCellCount;
 				}
 			}
-			catch (const std::bad_alloc&)
+		}
+		
+		if (validCellCount)
+		{
+			meanHeight /= validCellCount;
+		}
+	}
+
+	setValid(true);
+
+	return true;
+}
+
+int ccRasterGrid::interpolateTriangle(	const int P[3][2],
+										int xMin,
+										int yMin,
+										int xMax,
+										int yMax,
+										bool countOnly/*=false*/,
+										std::vector<int>* cellOwners/*=0*/,
+										int ownerIndex/*=-1*/)
+{
+	//pre-computation for barycentric coordinates
+	ccRasterCell cellA, cellB, cellC;
+	if (!countOnly)
+	{
+		cellA = cell(P[0][0], P[0][1]);
+		cellB = cell(P[1][0], P[1][1]);
+		cellC = cell(P[2][0], P[2][1]);
+	}
+
+	int det = (P[1][1] - P[2][1])*(P[0][0] - P[2][0]) + (P[2][0] - P[1][0])*(P[0][1] - P[2][1]);
+
+	int insideCount = 0;
+	for (int j = yMin; j <= yMax; ++j)
+	{
+		for (int i = xMin; i <= xMax; ++i)
+		{
+			//if the cell is empty
+			if (!cellPointCount(i, j))
 			{
-				//not enough memory
-				scalarFields.clear();
-				ccLog::Warning("[Rasterize] Failed to allocate memory for scalar fields!");
+				//we test if it's included or not in the current triangle
+				//Point Inclusion in Polygon Test (inspired from W. Randolph Franklin - WRF)
+				bool inside = false;
+				for (int ti = 0; ti < 3; ++ti)
+				{
+					const int* P1 = P[ti];
+					const int* P2 = P[(ti + 1) % 3];
+					if ((P2[1] <= j &&j < P1[1]) || (P1[1] <= j && j < P2[1]))
+					{
+						int t = (i - P2[0])*(P1[1] - P2[1]) - (P1[0] - P2[0])*(j - P2[1]);
+						if (P1[1] < P2[1])
+							t = -t;
+						if (t < 0)
+							inside = !inside;
+					}
+				}
+				if (!inside)
+				{
+					continue;
+				}
+
+				if (cellOwners)
+				{
+					const Tile* tile = cellTile(i, j);
+					assert(tile && tile->h.size() == cellOwners->size());
+					int& owner = (*cellOwners)[tile->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1))];
+					if (countOnly)
+					{
+						if (owner >= 0)
+						{
+							//already assigned to another triangle
+							continue;
+						}
+						owner = ownerIndex;
+					}
+					else if (owner != ownerIndex)
+					{
+						//assigned to another triangle
+						continue;
+					}
+				}
+
+				++insideCount;
+				if (countOnly)
+				{
+					continue;
+				}
+
+				//we can interpolate
+				double l1 = static_cast<double>((P[1][1] - P[2][1])*(i - P[2][0]) + (P[2][0] - P[1][0])*(j - P[2][1])) / det;
+				double l2 = static_cast<double>((P[2][1] - P[0][1])*(i - P[2][0]) + (P[0][0] - P[2][0])*(j - P[2][1])) / det;
+				double l3 = 1.0-l1-l2;
+
+				//the cell may belong to an empty tile
+				Tile* tile = getOrCreateTile(i >> TILE_SIZE_SHIFT, j >> TILE_SIZE_SHIFT);
+				if (!tile)
+				{
+					return -1;
+				}
+				const unsigned index = tile->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1));
+
+				tile->h[index] = l1 * cellA.h + l2 * cellB.h + l3 * cellC.h;
+				assert(std::isfinite(tile->h[index]));
+
+				try
+				{
+					//interpolate color as well!
+					if (hasColors)
+					{
+						if (tile->color.empty())
+						{
+							tile->color.resize(tile->h.size(), CCVector3d(0, 0, 0));
+						}
+						CCVector3d col = l1 * cellA.color + l2 * cellB.color + l3 * cellC.color;
+						tile->color[index] = col;
+					}
+
+					//interpolate the SFs as well!
+					if (scalarFieldCount != 0 && tile->scalarFields.empty())
+					{
+						tile->scalarFields.resize(scalarFieldCount, std::vector<double>(tile->h.size(), std::numeric_limits<double>::quiet_NaN()));
+					}
+				}
+				catch (const std::bad_alloc&)
+				{
+					//not enough memory
+					return -1;
+				}
+				for (unsigned sfIndex = 0; sfIndex < scalarFieldCount; ++sfIndex)
+				{
+					const double sfValA = cellSFValue(sfIndex, P[0][0], P[0][1]);
+					const double sfValB = cellSFValue(sfIndex, P[1][0], P[1][1]);
+					const double sfValC = cellSFValue(sfIndex, P[2][0], P[2][1]);
+					tile->scalarFields[sfIndex][index] = l1 * sfValA + l2 * sfValB + l3 * sfValC;
+				}
+			}
+		}
+	}
+
+	return insideCount;
+}
+
+bool ccRasterGrid::fillEmptyCellsByInterpolation(int maxThreadCount/*=0*/)
+{
+	if (nonEmptyCellCount < 3)
+	{
+		ccLog::Warning("[Rasterize] Not enough non-empty cells for interpolation!");
+		return false;
+	}
+	if (nonEmptyCellCount == static_cast<size_t>(width) * height)
+	{
+		//nothing to do
+		return true;
+	}
+
+	//big grids are processed tile by tile
+	if (tiles.size() > MAX_TILE_COUNT_FOR_GLOBAL_INTERPOLATION && CCLib::Delaunay2dMesh::Available())
+	{
+		return interpolateEmptyCellsByTiles(maxThreadCount);
+	}
+
+	std::vector<CCVector2> the2DPoints;
+	try
+	{
+		the2DPoints.resize(nonEmptyCellCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//out of memory
+		ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+		return false;
+	}
+
+	//fill 2D vector with non-empty cell indexes
+	unsigned index = 0;
+	for (unsigned j = 0; j < height; ++j)
+	{
+		for (unsigned i = 0; i < width; ++i)
+		{
+			if (cellPointCount(i, j))
+			{
+				//we only use the non-empty cells for interpolation
+				the2DPoints[index++] = CCVector2(static_cast<PointCoordinateType>(i), static_cast<PointCoordinateType>(j));
+			}
+		}
+	}
+	assert(index == nonEmptyCellCount);
+
+	//mesh the '2D' points
+	CCLib::Delaunay2dMesh delaunayMesh;
+	char errorStr[1024];
+	if (!delaunayMesh.buildMesh(the2DPoints, 0, errorStr))
+	{
+		ccLog::Warning(QString("[Rasterize] Empty cells interpolation failed: Triangle lib. said '%1'").arg(errorStr));
+		return false;
+	}
+
+	unsigned triNum = delaunayMesh.size();
+	//now we are going to 'project' all triangles on the grid
+	delaunayMesh.placeIteratorAtBegining();
+	for (unsigned k = 0; k < triNum; ++k)
+	{
+		const CCLib::VerticesIndexes* tsi = delaunayMesh.getNextTriangleVertIndexes();
+		//get the triangle bounding box (in grid coordinates)
+		int P[3][2];
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			const CCVector2& P2D = the2DPoints[tsi->i[j]];
+			P[j][0] = static_cast<int>(P2D.x);
+			P[j][1] = static_cast<int>(P2D.y);
+		}
+		int xMin = std::min(std::min(P[0][0], P[1][0]), P[2][0]);
+		int yMin = std::min(std::min(P[0][1], P[1][1]), P[2][1]);
+		int xMax = std::max(std::max(P[0][0], P[1][0]), P[2][0]);
+		int yMax = std::max(std::max(P[0][1], P[1][1]), P[2][1]);
+
+		//now scan the cells
+		if (interpolateTriangle(P, xMin, yMin, xMax, yMax, false) < 0)
+		{
+			//out of memory
+			ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//! Summed-area table of the number of cells (per block of cells) satisfying a given criterion
+class CellBlockCounts
+{
+public:
+
+	//! Block size (as a power of 2)
+	static const unsigned BLOCK_SIZE_SHIFT = 5;
+
+	//! Default constructor
+	CellBlockCounts() : m_blockCountX(0), m_blockCountY(0) {}
+
+	//! Initializes the table (for a given grid size)
+	bool init(unsigned width, unsigned height)
+	{
+		m_blockCountX = ((width - 1) >> BLOCK_SIZE_SHIFT) + 1;
+		m_blockCountY = ((height - 1) >> BLOCK_SIZE_SHIFT) + 1;
+		try
+		{
+			m_sums.resize(static_cast<size_t>(m_blockCountX + 1) * (m_blockCountY + 1), 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			return false;
+		}
+		return true;
+	}
+
+	//! Adds a cell (must be called before 'integrate')
+	inline void add(unsigned i, unsigned j) { ++m_sums[((j >> BLOCK_SIZE_SHIFT) + 1) * (m_blockCountX + 1) + (i >> BLOCK_SIZE_SHIFT) + 1]; }
+
+	//! Converts the per-block counts to the summed-area table
+	void integrate()
+	{
+		const size_t rowSize = m_blockCountX + 1;
+		for (unsigned by = 1; by <= m_blockCountY; ++by)
+		{
+			for (unsigned bx = 1; bx <= m_blockCountX; ++bx)
+			{
+				m_sums[by * rowSize + bx] += m_sums[(by - 1) * rowSize + bx] + m_sums[by * rowSize + bx - 1] - m_sums[(by - 1) * rowSize + bx - 1];
+			}
+		}
+	}
+
+	//! Returns the number of cells in a range of blocks (bounds included)
+	inline unsigned count(unsigned bx0, unsigned by0, unsigned bx1, unsigned by1) const
+	{
+		const size_t rowSize = m_blockCountX + 1;
+		return m_sums[(by1 + 1) * rowSize + bx1 + 1] - m_sums[by0 * rowSize + bx1 + 1] - m_sums[(by1 + 1) * rowSize + bx0] + m_sums[by0 * rowSize + bx0];
+	}
+
+protected:
+
+	//! Number of blocks along X
+	unsigned m_blockCountX;
+	//! Number of blocks along Y
+	unsigned m_blockCountY;
+	//! Summed-area table ((m_blockCountX + 1) x (m_blockCountY + 1))
+	std::vector<unsigned> m_sums;
+};
+
+//! Returns whether a non-empty cell is on the border of the non-empty areas
+/** I.e. whether it has an empty neighbor (or whether it is on the grid border).
+	Only such cells can be the vertices of a Delaunay triangle including empty cells:
+	a circle of radius > 0.77 passing through a cell always includes one of its 8 neighbors.
+**/
+static bool IsBorderCell(const ccRasterGrid& grid, unsigned i, unsigned j)
+{
+	if (i == 0 || j == 0 || i + 1 == grid.width || j + 1 == grid.height)
+	{
+		return true;
+	}
+	for (unsigned v = j - 1; v <= j + 1; ++v)
+	{
+		for (unsigned u = i - 1; u <= i + 1; ++u)
+		{
+			if (!grid.cellPointCount(u, v))
+			{
+				return true;
 			}
 		}
+	}
+	return false;
+}
+
+//! Collects the border cells (see IsBorderCell) inside a window
+static void CollectBorderCells(	const ccRasterGrid& grid,
+								const CellBlockCounts& borderCells,
+								const int window[4],
+								unsigned bx0,
+								unsigned by0,
+								unsigned bx1,
+								unsigned by1,
+								std::vector<CCVector2>& points)
+{
+	if (borderCells.count(bx0, by0, bx1, by1) == 0)
+	{
+		return;
+	}
+
+	if (bx0 == bx1 && by0 == by1)
+	{
+		int x0 = std::max(window[0], static_cast<int>(bx0 << CellBlockCounts::BLOCK_SIZE_SHIFT));
+		int y0 = std::max(window[1], static_cast<int>(by0 << CellBlockCounts::BLOCK_SIZE_SHIFT));
+		int x1 = std::min(window[2], static_cast<int>(((bx0 + 1) << CellBlockCounts::BLOCK_SIZE_SHIFT) - 1));
+		int y1 = std::min(window[3], static_cast<int>(((by0 + 1) << CellBlockCounts::BLOCK_SIZE_SHIFT) - 1));
+		for (int j = y0; j <= y1; ++j)
+		{
+			for (int i = x0; i <= x1; ++i)
+			{
+				if (grid.cellPointCount(i, j) && IsBorderCell(grid, i, j))
+				{
+					points.push_back(CCVector2(static_cast<PointCoordinateType>(i), static_cast<PointCoordinateType>(j)));
+				}
+			}
+		}
+	}
+	else if (bx1 - bx0 >= by1 - by0)
+	{
+		unsigned bxm = (bx0 + bx1) / 2;
+		CollectBorderCells(grid, borderCells, window, bx0, by0, bxm, by1, points);
+		CollectBorderCells(grid, borderCells, window, bxm + 1, by0, bx1, by1, points);
+	}
+	else
+	{
+		unsigned bym = (by0 + by1) / 2;
+		CollectBorderCells(grid, borderCells, window, bx0, by0, bx1, bym, points);
+		CollectBorderCells(grid, borderCells, window, bx0, bym + 1, bx1, by1, points);
+	}
+}
+
+//! Circle circumscribed to a triangle of cells
+struct CellTriangleCircle
+{
+	//! Triangle vertices (counter-clockwise)
+	int A[2], B[2], C[2];
+	//! Circle center
+	double cx, cy;
+	//! Squared radius (slightly enlarged, to be conservative)
+	double r2;
+
+	//! Initializes the circle (returns false if the triangle is degenerate)
+	bool init(const int P[3][2])
+	{
+		const double bx = P[1][0] - P[0][0], by = P[1][1] - P[0][1];
+		const double ex = P[2][0] - P[0][0], ey = P[2][1] - P[0][1];
+		const double d = 2 * (bx * ey - by * ex);
+		if (d == 0)
+		{
+			return false;
+		}
+
+		A[0] = P[0][0]; A[1] = P[0][1];
+		if (d > 0)
+		{
+			B[0] = P[1][0]; B[1] = P[1][1];
+			C[0] = P[2][0]; C[1] = P[2][1];
+		}
 		else
 		{
-			interpolateSF = false;
+			B[0] = P[2][0]; B[1] = P[2][1];
+			C[0] = P[1][0]; C[1] = P[1][1];
 		}
+
+		const double ux = (ey * (bx * bx + by * by) - by * (ex * ex + ey * ey)) / d;
+		const double uy = (bx * (ex * ex + ey * ey) - ex * (bx * bx + by * by)) / d;
+		cx = P[0][0] + ux;
+		cy = P[0][1] + uy;
+		r2 = (ux * ux + uy * uy) * (1.0 + 1.0e-9) + 1.0e-6;
+
+		return true;
+	}
+
+	//! Returns whether a cell lies strictly inside the circle
+	/** Exact for reasonable grid sizes (as all the products are integers).
+	**/
+	bool strictlyContains(int i, int j) const
+	{
+		const double adx = A[0] - i, ady = A[1] - j;
+		const double bdx = B[0] - i, bdy = B[1] - j;
+		const double cdx = C[0] - i, cdy = C[1] - j;
+		const double det =	  (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy)
+							+ (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy)
+							+ (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+		return det > 0;
+	}
+};
+
+//! Returns whether a non-empty cell lies strictly inside a circle (in a range of blocks)
+static bool HasNonEmptyCellsInCircle(	const ccRasterGrid& grid,
+										const CellBlockCounts& nonEmptyCells,
+										const CellTriangleCircle& circle,
+										unsigned bx0,
+										unsigned by0,
+										unsigned bx1,
+										unsigned by1)
+{
+	if (nonEmptyCells.count(bx0, by0, bx1, by1) == 0)
+	{
+		return false;
+	}
+
+	//cells range
+	const double x0 = static_cast<double>(bx0 << CellBlockCounts::BLOCK_SIZE_SHIFT);
+	const double y0 = static_cast<double>(by0 << CellBlockCounts::BLOCK_SIZE_SHIFT);
+	const double x1 = std::min(static_cast<double>(((bx1 + 1) << CellBlockCounts::BLOCK_SIZE_SHIFT) - 1), grid.width - 1.0);
+	const double y1 = std::min(static_cast<double>(((by1 + 1) << CellBlockCounts::BLOCK_SIZE_SHIFT) - 1), grid.height - 1.0);
+
+	//the range is outside the circle
+	const double nx = std::max(std::max(x0 - circle.cx, circle.cx - x1), 0.0);
+	const double ny = std::max(std::max(y0 - circle.cy, circle.cy - y1), 0.0);
+	if (nx * nx + ny * ny >= circle.r2)
+	{
+		return false;
+	}
+
+	//the range is (clearly) inside the circle
+	const double fx = std::max(circle.cx - x0, x1 - circle.cx);
+	const double fy = std::max(circle.cy - y0, y1 - circle.cy);
+	if ((fx * fx + fy * fy) * (1.0 + 1.0e-6) + 1.0 < circle.r2)
+	{
+		return true;
+	}
+
+	if (bx0 == bx1 && by0 == by1)
+	{
+		//we test the cells
+		const double r = sqrt(circle.r2);
+		int j0 = static_cast<int>(std::max(y0, ceil(circle.cy - r)));
+		int j1 = static_cast<int>(std::min(y1, floor(circle.cy + r)));
+		for (int j = j0; j <= j1; ++j)
+		{
+			const double dy = j - circle.cy;
+			const double halfWidth = sqrt(std::max(0.0, circle.r2 - dy * dy));
+			int i0 = static_cast<int>(std::max(x0, ceil(circle.cx - halfWidth)));
+			int i1 = static_cast<int>(std::min(x1, floor(circle.cx + halfWidth)));
+			for (int i = i0; i <= i1; ++i)
+			{
+				if (grid.cellPointCount(i, j) && circle.strictlyContains(i, j))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+	else if (bx1 - bx0 >= by1 - by0)
+	{
+		unsigned bxm = (bx0 + bx1) / 2;
+		return	HasNonEmptyCellsInCircle(grid, nonEmptyCells, circle, bx0, by0, bxm, by1)
+			||	HasNonEmptyCellsInCircle(grid, nonEmptyCells, circle, bxm + 1, by0, bx1, by1);
 	}
+	else
+	{
+		unsigned bym = (by0 + by1) / 2;
+		return	HasNonEmptyCellsInCircle(grid, nonEmptyCells, circle, bx0, by0, bx1, bym)
+			||	HasNonEmptyCellsInCircle(grid, nonEmptyCells, circle, bx0, bym + 1, bx1, by1);
+	}
+}
 
-	//filling the grid
-	unsigned pointCount = cloud->size();
-
-	if (progressDialog)
+//! Returns whether a triangle of non-empty cells belongs to the Delaunay triangulation of all the non-empty cells
+/** I.e. whether no non-empty cell lies strictly inside its circumcircle.
+**/
+static bool IsGlobalDelaunayTriangle(const ccRasterGrid& grid, const CellBlockCounts& nonEmptyCells, const int P[3][2])
+{
+	CellTriangleCircle circle;
+	if (!circle.init(P))
 	{
-		progressDialog->setMethodTitle(QObject::tr("Grid generation"));
-		progressDialog->setInfo(QObject::tr("Points: %L1\nCells: %L2 x %L3").arg( pointCount ).arg(width).arg(height));
-		progressDialog->start();
-		progressDialog->show();
-		QCoreApplication::processEvents();
+		return false;
 	}
-	CCLib::NormalizedProgress nProgress(progressDialog, pointCount);
 
-	//vertical dimension
-	assert(Z <= 2);
-	const unsigned char X = Z == 2 ? 0 : Z + 1;
-	const unsigned char Y = X == 2 ? 0 : X + 1;
+	//blocks range
+	const double r = sqrt(circle.r2);
+	const double xMin = std::max(0.0, circle.cx - r);
+	const double yMin = std::max(0.0, circle.cy - r);
+	const double xMax = std::min(grid.width - 1.0, circle.cx + r);
+	const double yMax = std::min(grid.height - 1.0, circle.cy + r);
+	if (xMin > xMax || yMin > yMax)
+	{
+		return true;
+	}
 
-	//we always handle the colors (if any)
-	hasColors = cloud->hasColors();
+	return !HasNonEmptyCellsInCircle(	grid,
+										nonEmptyCells,
+										circle,
+										static_cast<unsigned>(xMin) >> CellBlockCounts::BLOCK_SIZE_SHIFT,
+										static_cast<unsigned>(yMin) >> CellBlockCounts::BLOCK_SIZE_SHIFT,
+										static_cast<unsigned>(xMax) >> CellBlockCounts::BLOCK_SIZE_SHIFT,
+										static_cast<unsigned>(yMax) >> CellBlockCounts::BLOCK_SIZE_SHIFT);
+}
 
-	for (unsigned n = 0; n<pointCount; ++n)
+//! Tests whether a cell is inside a polygon (W. Randolph Franklin's inclusion test, as for the triangles)
+/** As the same half-open rules are used, a cell is inside the convex hull of the
+	non-empty cells if and only if it is inside one of the Delaunay triangles.
+**/
+static bool IsInsidePolygon(const std::vector<CCVector2i>& polygon, int i, int j)
+{
+	bool inside = false;
+	for (size_t n = 0; n < polygon.size(); ++n)
 	{
-		//for each point
-		const CCVector3* P = cloud->getPoint(n);
+		const CCVector2i& P1 = polygon[n];
+		const CCVector2i& P2 = polygon[(n + 1) % polygon.size()];
+		if ((P2.y <= j && j < P1.y) || (P1.y <= j && j < P2.y))
+		{
+			long long t = static_cast<long long>(i - P2.x) * (P1.y - P2.y) - static_cast<long long>(P1.x - P2.x) * (j - P2.y);
+			if (P1.y < P2.y)
+				t = -t;
+			if (t < 0)
+				inside = !inside;
+		}
+	}
+	return inside;
+}
 
-		//project it inside the grid
-		CCVector3d relativePos = CCVector3d::fromArray(P->u) - minCorner;
-		int i = static_cast<int>((relativePos.u[X] / gridStep + 0.5));
-		int j = static_cast<int>((relativePos.u[Y] / gridStep + 0.5));
+bool ccRasterGrid::interpolateEmptyCellsByTiles(int maxThreadCount)
+{
+	const unsigned tileCountX = this->tileCountX();
+	const unsigned tileCountY = this->tileCountY();
+
+	//look for the non-empty cells (and the border ones)
+	CellBlockCounts nonEmptyCells, borderCells;
+	std::vector<int> rowMin, rowMax;
+	if (	!nonEmptyCells.init(width, height)
+		||	!borderCells.init(width, height))
+	{
+		ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+		return false;
+	}
+	try
+	{
+		rowMin.resize(height, -1);
+		rowMax.resize(height, -1);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+		return false;
+	}
 
-		//we skip points that fall outside of the grid!
-		if (	i < 0 || i >= static_cast<int>(width)
-			||	j < 0 || j >= static_cast<int>(height) )
+	for (unsigned ty = 0; ty < tileCountY; ++ty)
+	{
+		for (unsigned tx = 0; tx < tileCountX; ++tx)
 		{
-			if (!nProgress.oneStep())
+			const Tile* tile = this->tile(tx, ty);
+			if (!tile)
 			{
-				//process cancelled by the user
-				return false;
+				continue;
 			}
-			continue;
-		}
-		assert(i >= 0 && j >= 0);
-
-		//update the cell statistics
-		ccRasterCell& aCell = rows[j][i];
-		if (aCell.nbPoints)
-		{
-			if (P->u[Z] < aCell.minHeight)
+			for (unsigned lj = 0; lj < tile->height; ++lj)
 			{
-				aCell.minHeight = P->u[Z];
-				if (projectionType == PROJ_MINIMUM_VALUE)
+				const unsigned j = (ty << TILE_SIZE_SHIFT) + lj;
+				for (unsigned li = 0; li < tile->width; ++li)
 				{
-					//we keep track of the lowest point
-					aCell.pointIndex = n;
-
-					if (hasColors)
+					if (tile->nbPoints[tile->cellIndex(li, lj)] == 0)
 					{
-						assert(cloud->hasColors());
-						const ColorCompType* col = cloud->getPointColor(n);
-						aCell.color = CCVector3d(col[0], col[1], col[2]);
+						continue;
 					}
-				}
-			}
-			else if (P->u[Z] > aCell.maxHeight)
-			{
-				aCell.maxHeight = P->u[Z];
-				if (projectionType == PROJ_MAXIMUM_VALUE)
-				{
-					//we keep track of the highest point
-					aCell.pointIndex = n;
-
-					if (hasColors)
+					const unsigned i = (tx << TILE_SIZE_SHIFT) + li;
+					nonEmptyCells.add(i, j);
+					if (IsBorderCell(*this, i, j))
 					{
-						assert(cloud->hasColors());
-						const ColorCompType* col = cloud->getPointColor(n);
-						aCell.color = CCVector3d(col[0], col[1], col[2]);
+						borderCells.add(i, j);
 					}
+					if (rowMin[j] < 0 || static_cast<int>(i) < rowMin[j])
+						rowMin[j] = i;
+					if (static_cast<int>(i) > rowMax[j])
+						rowMax[j] = i;
 				}
 			}
+		}
+	}
+	nonEmptyCells.integrate();
+	borderCells.integrate();
 
-			if (projectionType == PROJ_AVERAGE_VALUE)
+	//convex hull of the non-empty cells (Andrew's monotone chain)
+	std::vector<CCVector2i> hull;
+	{
+		std::vector<CCVector2i> extremities;
+		try
+		{
+			for (unsigned j = 0; j < height; ++j)
 			{
-				//we keep track of the point which is the closest to the cell center (in 2D)
-				CCVector2d C((i + 0.5) * gridStep, (j + 0.5) * gridStep);
-				const CCVector3* Q = cloud->getPoint(aCell.pointIndex); //former closest point
-				CCVector3d relativePosQ = CCVector3d::fromArray(Q->u) - minCorner;
-
-				double distToP = (C - CCVector2d(relativePos .u[X], relativePos .u[Y])).norm2();
-				double distToQ = (C - CCVector2d(relativePosQ.u[X], relativePosQ.u[Y])).norm2();
-				if (distToP < distToQ)
-				{
-					aCell.pointIndex = n;
-				}
-
-				if (hasColors)
+				if (rowMin[j] >= 0)
 				{
-					assert(cloud->hasColors());
-					const ColorCompType* col = cloud->getPointColor(n);
-					aCell.color += CCVector3d(col[0], col[1], col[2]);
+					extremities.push_back(CCVector2i(rowMin[j], j));
+					if (rowMax[j] != rowMin[j])
+						extremities.push_back(CCVector2i(rowMax[j], j));
 				}
-
 			}
+			hull.resize(2 * extremities.size());
 		}
-		else
+		catch (const std::bad_alloc&)
 		{
-			aCell.minHeight = aCell.maxHeight = P->u[Z];
-			aCell.pointIndex = n;
-
-			if (hasColors)
-			{
-				assert(cloud->hasColors());
-				const ColorCompType* col = cloud->getPointColor(n);
-				aCell.color = CCVector3d(col[0], col[1], col[2]);
-			}
+			ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+			return false;
 		}
-		
-		//sum the points heights
-		double Pz = P->u[Z];
-		aCell.avgHeight += Pz;
-		aCell.stdDevHeight += Pz * Pz;
 
-		//scalar fields
-		if (interpolateSF)
+		std::sort(extremities.begin(), extremities.end(), [](const CCVector2i& a, const CCVector2i& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+		auto cross = [](const CCVector2i& o, const CCVector2i& a, const CCVector2i& b) -> long long
 		{
-			assert(pc);
-
-			//absolute position of the cell (e.g. in the 2D SF grid(s))
-			int pos = j * static_cast<int>(width)+i;
-			assert(pos < static_cast<int>(gridTotalSize));
-
-			for (size_t k = 0; k < scalarFields.size(); ++k)
-			{
-				assert(!scalarFields[k].empty());
+			return static_cast<long long>(a.x - o.x) * (b.y - o.y) - static_cast<long long>(a.y - o.y) * (b.x - o.x);
+		};
 
-				CCLib::ScalarField* sf = pc->getScalarField(static_cast<unsigned>(k));
-				assert(sf && pos < static_cast<int>(sf->currentSize()));
-
-				ScalarType sfValue = sf->getValue(n);
-
-				if (ccScalarField::ValidValue(sfValue))
-				{
-					SF::value_type formerValue = scalarFields[k][pos];
-					if (aCell.nbPoints && std::isfinite(formerValue))
-					{
-						switch (sfInterpolation)
-						{
-						case PROJ_MINIMUM_VALUE:
-							// keep the minimum value
-							scalarFields[k][pos] = std::min<SF::value_type>(formerValue, sfValue);
-							break;
-						case PROJ_AVERAGE_VALUE:
-							//we sum all values (we will divide them later)
-							scalarFields[k][pos] += sfValue;
-							break;
-						case PROJ_MAXIMUM_VALUE:
-							// keep the maximum value
-							scalarFields[k][pos] = std::max<SF::value_type>(formerValue, sfValue);
-							break;
-						default:
-							assert(false);
-							break;
-						}
-					}
-					else
-					{
-						//for the first (valid) point, we simply have to store its SF value (in any case)
-						scalarFields[k][pos] = sfValue;
-					}
-				}
-			}
+		size_t k = 0;
+		for (size_t n = 0; n < extremities.size(); ++n)
+		{
+			while (k >= 2 && cross(hull[k - 2], hull[k - 1], extremities[n]) <= 0)
+				--k;
+			hull[k++] = extremities[n];
 		}
-
-		//update the number of points in the cell
-		++aCell.nbPoints;
-
-		if (!nProgress.oneStep())
+		for (size_t n = extremities.size() - 1, t = k + 1; n > 0; --n)
 		{
-			//process cancelled by user
-			return false;
+			while (k >= t && cross(hull[k - 2], hull[k - 1], extremities[n - 1]) <= 0)
+				--k;
+			hull[k++] = extremities[n - 1];
 		}
+		hull.resize(k - 1);
+	}
+	if (hull.size() < 3)
+	{
+		//the non-empty cells are aligned: nothing to interpolate
+		return true;
 	}
 
-	//update SF grids for 'average' cases
-	if (sfInterpolation == PROJ_AVERAGE_VALUE)
+	//extents of the hull for each row
+	std::vector<double> hullMin, hullMax;
+	int hullRowMin = height, hullRowMax = -1;
+	try
+	{
+		hullMin.resize(height, std::numeric_limits<double>::max());
+		hullMax.resize(height, -std::numeric_limits<double>::max());
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+		return false;
+	}
+	for (size_t n = 0; n < hull.size(); ++n)
 	{
-		for (size_t k = 0; k < scalarFields.size(); ++k)
+		const CCVector2i& a = hull[n];
+		const CCVector2i& b = hull[(n + 1) % hull.size()];
+		for (int j = std::min(a.y, b.y); j <= std::max(a.y, b.y); ++j)
 		{
-			assert(!scalarFields[k].empty());
-
-			double* _gridSF = &scalarFields[k].front();
-			for (unsigned j = 0; j < height; ++j)
+			double x0 = a.x, x1 = b.x;
+			if (a.y != b.y)
 			{
-				Row& row = rows[j];
-				for (unsigned i = 0; i < width; ++i, ++_gridSF)
-				{
-					if (row[i].nbPoints > 1)
-					{
-						if (std::isfinite(*_gridSF)) //valid SF value
-						{
-							*_gridSF /= row[i].nbPoints;
-						}
-					}
-				}
+				x0 = x1 = a.x + static_cast<double>(j - a.y) * (b.x - a.x) / (b.y - a.y);
 			}
+			hullMin[j] = std::min(hullMin[j], std::min(x0, x1));
+			hullMax[j] = std::max(hullMax[j], std::max(x0, x1));
 		}
+		hullRowMin = std::min(hullRowMin, a.y);
+		hullRowMax = std::max(hullRowMax, a.y);
 	}
 
-	//update the main grid (average height and std.dev. computation + current 'height' value)
+	//tiles with empty cells inside the hull
+	std::vector<char> pendingTiles;
+	try
 	{
-		for (unsigned j = 0; j < height; ++j)
+		pendingTiles.resize(tiles.size(), 0);
+
+		for (unsigned ty = 0; ty < tileCountY; ++ty)
 		{
-			Row& row = rows[j];
-			for (unsigned i = 0; i < width; ++i)
+			const int y0 = std::max(static_cast<int>(ty << TILE_SIZE_SHIFT), hullRowMin);
+			const int y1 = std::min(static_cast<int>(std::min((ty + 1) << TILE_SIZE_SHIFT, height) - 1), hullRowMax);
+			for (unsigned tx = 0; tx < tileCountX; ++tx)
 			{
-				ccRasterCell& cell = row[i];
-				if (cell.nbPoints > 1)
+				const double x0 = (tx << TILE_SIZE_SHIFT) - 1.0e-6;
+				const double x1 = std::min((tx + 1) << TILE_SIZE_SHIFT, width) - 1 + 1.0e-6;
+				bool inHull = false;
+				for (int j = y0; j <= y1 && !inHull; ++j)
 				{
-					cell.avgHeight /= cell.nbPoints;
-					cell.stdDevHeight = sqrt(fabs(cell.stdDevHeight / cell.nbPoints - cell.avgHeight*cell.avgHeight));
-					if (hasColors && projectionType == PROJ_AVERAGE_VALUE)
-					{
-						cell.color /= cell.nbPoints;
-					}
+					inHull = (hullMin[j] <= x1 && hullMax[j] >= x0);
 				}
-				else
+				if (!inHull)
 				{
-					cell.stdDevHeight = 0;
+					continue;
 				}
 
-				if (cell.nbPoints != 0)
+				Tile* tile = this->tile(tx, ty);
+				if (tile && std::find(tile->nbPoints.begin(), tile->nbPoints.end(), 0) == tile->nbPoints.end())
 				{
-					//set the right 'height' value
-					switch (projectionType)
-					{
-					case PROJ_MINIMUM_VALUE:
-						cell.h = cell.minHeight;
-						break;
-					case PROJ_AVERAGE_VALUE:
-						cell.h = cell.avgHeight;
-						break;
-					case PROJ_MAXIMUM_VALUE:
-						cell.h = cell.maxHeight;
-						break;
-					default:
-						assert(false);
-						break;
-					}
+					//no empty cell
+					continue;
 				}
+
+				//the tiles (and their layers) are allocated beforehand, as they are processed in parallel
+				tile = getOrCreateTile(tx, ty);
+				if (!tile)
+				{
+					throw std::bad_alloc();
+				}
+				if (hasColors && tile->color.empty())
+				{
+					tile->color.resize(tile->h.size(), CCVector3d(0, 0, 0));
+				}
+				if (scalarFieldCount != 0 && tile->scalarFields.empty())
+				{
+					tile->scalarFields.resize(scalarFieldCount, std::vector<double>(tile->h.size(), std::numeric_limits<double>::quiet_NaN()));
+				}
+
+				pendingTiles[ty * tileCountX + tx] = 1;
 			}
 		}
 	}
-
-	//compute the number of non empty cells
-	nonEmptyCellCount = 0;
+	catch (const std::bad_alloc&)
 	{
-		for (unsigned i = 0; i < height; ++i)
-			for (unsigned j = 0; j < width; ++j)
-				if (rows[i][j].nbPoints)
-					++nonEmptyCellCount;
+		ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+		return false;
 	}
 
-	//specific case: interpolate the empty cells
-	if (interpolateEmptyCells)
+	std::atomic<bool> memoryError(false);
+
+	//the pending tiles are processed by blocks of increasing size (and with increasing margins)
+	for (unsigned level = 0; ; ++level)
 	{
-		std::vector<CCVector2> the2DPoints;
-		if (nonEmptyCellCount < 3)
-		{
-			ccLog::Warning("[Rasterize] Not enough non-empty cells for interpolation!");
-		}
-		else if (nonEmptyCellCount < width * height) //otherwise it's useless!
+		const unsigned blockShift = TILE_SIZE_SHIFT + level;
+		const unsigned blockCountX = ((width - 1) >> blockShift) + 1;
+		const unsigned blockCountY = ((height - 1) >> blockShift) + 1;
+		const int margin = INTERPOLATION_MIN_MARGIN << level;
+		//if a single block covers the whole grid, the whole grid is triangulated (its triangles are then used as they are)
+		const bool lastLevel = (blockCountX == 1 && blockCountY == 1);
+
+		//blocks with pending tiles
+		std::vector<unsigned> blocks;
+		for (unsigned ty = 0; ty < tileCountY; ++ty)
 		{
-			try
+			for (unsigned tx = 0; tx < tileCountX; ++tx)
 			{
-				the2DPoints.resize(nonEmptyCellCount);
-			}
-			catch (const std::bad_alloc&)
-			{
-				//out of memory
-				ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+				if (pendingTiles[ty * tileCountX + tx])
+				{
+					unsigned blockIndex = (ty >> level) * blockCountX + (tx >> level);
+					if (blocks.empty() || blocks.back() != blockIndex)
+						blocks.push_back(blockIndex);
+				}
 			}
 		}
+		std::sort(blocks.begin(), blocks.end());
+		blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+		if (blocks.empty())
+		{
+			break;
+		}
 
-		//fill 2D vector with non-empty cell indexes
-		if (!the2DPoints.empty())
+		//each block is processed by a single thread (which only writes in the tiles of this block)
+		CCLib::ParallelTools::ForEach(static_cast<unsigned>(blocks.size()), [&](unsigned k)
 		{
-			unsigned index = 0;
-			for (unsigned j = 0; j < height; ++j)
+			//the block cells
+			const int x0 = static_cast<int>((blocks[k] % blockCountX) << blockShift);
+			const int y0 = static_cast<int>((blocks[k] / blockCountX) << blockShift);
+			const int x1 = static_cast<int>(std::min(static_cast<unsigned>(x0) + (1u << blockShift), width)) - 1;
+			const int y1 = static_cast<int>(std::min(static_cast<unsigned>(y0) + (1u << blockShift), height)) - 1;
+			//the block tiles
+			const unsigned tx0 = static_cast<unsigned>(x0) >> TILE_SIZE_SHIFT;
+			const unsigned ty0 = static_cast<unsigned>(y0) >> TILE_SIZE_SHIFT;
+			const unsigned blockTileCountX = (static_cast<unsigned>(x1) >> TILE_SIZE_SHIFT) - tx0 + 1;
+			const unsigned blockTileCountY = (static_cast<unsigned>(y1) >> TILE_SIZE_SHIFT) - ty0 + 1;
+
+			//window around the pending tiles of the block
+			int window[4] = { x1, y1, x0, y0 };
+			for (unsigned ty = ty0; ty < ty0 + blockTileCountY; ++ty)
 			{
-				const Row& row = rows[j];
-				for (unsigned i = 0; i < width; ++i)
+				for (unsigned tx = tx0; tx < tx0 + blockTileCountX; ++tx)
 				{
-					if (row[i].nbPoints)
+					if (pendingTiles[ty * tileCountX + tx])
 					{
-						//we only use the non-empty cells for interpolation
-						the2DPoints[index++] = CCVector2(static_cast<PointCoordinateType>(i), static_cast<PointCoordinateType>(j));
+						window[0] = std::min(window[0], static_cast<int>(tx << TILE_SIZE_SHIFT));
+						window[1] = std::min(window[1], static_cast<int>(ty << TILE_SIZE_SHIFT));
+						window[2] = std::max(window[2], std::min(static_cast<int>((tx + 1) << TILE_SIZE_SHIFT), x1 + 1) - 1);
+						window[3] = std::max(window[3], std::min(static_cast<int>((ty + 1) << TILE_SIZE_SHIFT), y1 + 1) - 1);
 					}
 				}
 			}
-			assert(index == nonEmptyCellCount);
+			if (lastLevel)
+			{
+				//the triangles can't be checked anymore: they must come from the triangulation of all the (border) cells
+				window[0] = 0;
+				window[1] = 0;
+				window[2] = static_cast<int>(width) - 1;
+				window[3] = static_cast<int>(height) - 1;
+			}
+			else
+			{
+				window[0] = std::max(window[0] - margin, 0);
+				window[1] = std::max(window[1] - margin, 0);
+				window[2] = std::min(window[2] + margin, static_cast<int>(width) - 1);
+				window[3] = std::min(window[3] + margin, static_cast<int>(height) - 1);
+			}
 
-			//mesh the '2D' points
-			CCLib::Delaunay2dMesh delaunayMesh;
-			char errorStr[1024];
-			if (delaunayMesh.buildMesh(the2DPoints, 0, errorStr))
+			try
 			{
-				unsigned triNum = delaunayMesh.size();
-				//now we are going to 'project' all triangles on the grid
-				delaunayMesh.placeIteratorAtBegining();
-				for (unsigned k = 0; k < triNum; ++k)
+				std::vector<CCVector2> points;
+				CollectBorderCells(	*this,
+									borderCells,
+									window,
+									static_cast<unsigned>(window[0]) >> CellBlockCounts::BLOCK_SIZE_SHIFT,
+									static_cast<unsigned>(window[1]) >> CellBlockCounts::BLOCK_SIZE_SHIFT,
+									static_cast<unsigned>(window[2]) >> CellBlockCounts::BLOCK_SIZE_SHIFT,
+									static_cast<unsigned>(window[3]) >> CellBlockCounts::BLOCK_SIZE_SHIFT,
+									points);
+
+				//triangles crossing the block (dispatched between the pending tiles)
+				struct Triangle
 				{
-					const CCLib::VerticesIndexes* tsi = delaunayMesh.getNextTriangleVertIndexes();
-					//get the triangle bounding box (in grid coordinates)
 					int P[3][2];
-					int xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+					//! Whether the triangle belongs to the global triangulation (-1 = unknown)
+					int global;
+				};
+				std::vector<Triangle> triangles;
+				std::vector< std::vector<unsigned> > tileTriangles(static_cast<size_t>(blockTileCountX) * blockTileCountY);
+
+				CCLib::Delaunay2dMesh delaunayMesh;
+				if (points.size() >= 3 && delaunayMesh.buildMesh(points))
+				{
+					unsigned triNum = delaunayMesh.size();
+					delaunayMesh.placeIteratorAtBegining();
+					for (unsigned n = 0; n < triNum; ++n)
 					{
+						const CCLib::VerticesIndexes* tsi = delaunayMesh.getNextTriangleVertIndexes();
+						Triangle tri;
 						for (unsigned j = 0; j < 3; ++j)
 						{
-							const CCVector2& P2D = the2DPoints[tsi->i[j]];
-							P[j][0] = static_cast<int>(P2D.x);
-							P[j][1] = static_cast<int>(P2D.y);
+							const CCVector2& P2D = points[tsi->i[j]];
+							tri.P[j][0] = static_cast<int>(P2D.x);
+							tri.P[j][1] = static_cast<int>(P2D.y);
+						}
+						tri.global = -1;
+
+						//tiles crossed by the triangle bounding box (inside the block)
+						int xMin = std::max(std::min(std::min(tri.P[0][0], tri.P[1][0]), tri.P[2][0]), x0);
+						int yMin = std::max(std::min(std::min(tri.P[0][1], tri.P[1][1]), tri.P[2][1]), y0);
+						int xMax = std::min(std::max(std::max(tri.P[0][0], tri.P[1][0]), tri.P[2][0]), x1);
+						int yMax = std::min(std::max(std::max(tri.P[0][1], tri.P[1][1]), tri.P[2][1]), y1);
+						bool used = false;
+						for (unsigned ty = (yMin >> TILE_SIZE_SHIFT); yMin <= yMax && ty <= static_cast<unsigned>(yMax >> TILE_SIZE_SHIFT); ++ty)
+						{
+							for (unsigned tx = (xMin >> TILE_SIZE_SHIFT); xMin <= xMax && tx <= static_cast<unsigned>(xMax >> TILE_SIZE_SHIFT); ++tx)
+							{
+								if (pendingTiles[ty * tileCountX + tx])
+								{
+									tileTriangles[(ty - ty0) * blockTileCountX + (tx - tx0)].push_back(static_cast<unsigned>(triangles.size()));
+									used = true;
+								}
+							}
+						}
+						if (used)
+						{
+							triangles.push_back(tri);
 						}
-						xMin = std::min(std::min(P[0][0], P[1][0]), P[2][0]);
-						yMin = std::min(std::min(P[0][1], P[1][1]), P[2][1]);
-						xMax = std::max(std::max(P[0][0], P[1][0]), P[2][0]);
-						yMax = std::max(std::max(P[0][1], P[1][1]), P[2][1]);
 					}
-					//now scan the cells
+				}
+
+				std::vector<int> cellOwners;
+				std::vector<unsigned> tileClaims;
+				for (unsigned ty = ty0; ty < ty0 + blockTileCountY; ++ty)
+				{
+					for (unsigned tx = tx0; tx < tx0 + blockTileCountX; ++tx)
 					{
-						//pre-computation for barycentric coordinates
-						const double& valA = rows[ P[0][1] ][ P[0][0] ].h;
-						const double& valB = rows[ P[1][1] ][ P[1][0] ].h;
-						const double& valC = rows[ P[2][1] ][ P[2][0] ].h;
+						if (!pendingTiles[ty * tileCountX + tx])
+						{
+							continue;
+						}
+						Tile* tile = tiles[ty * tileCountX + tx];
+						assert(tile);
+
+						//the tile cells
+						const int ti0 = static_cast<int>(tx << TILE_SIZE_SHIFT);
+						const int tj0 = static_cast<int>(ty << TILE_SIZE_SHIFT);
+						const int ti1 = ti0 + static_cast<int>(tile->width) - 1;
+						const int tj1 = tj0 + static_cast<int>(tile->height) - 1;
+
+						//assign the empty cells to the triangles
+						cellOwners.assign(tile->h.size(), -1);
+						tileClaims.clear();
+						bool complete = true;
+						for (unsigned triIndex : tileTriangles[(ty - ty0) * blockTileCountX + (tx - tx0)])
+						{
+							Triangle& tri = triangles[triIndex];
+							int xMin = std::max(std::min(std::min(tri.P[0][0], tri.P[1][0]), tri.P[2][0]), ti0);
+							int yMin = std::max(std::min(std::min(tri.P[0][1], tri.P[1][1]), tri.P[2][1]), tj0);
+							int xMax = std::min(std::max(std::max(tri.P[0][0], tri.P[1][0]), tri.P[2][0]), ti1);
+							int yMax = std::min(std::max(std::max(tri.P[0][1], tri.P[1][1]), tri.P[2][1]), tj1);
 
-						int det = (P[1][1] - P[2][1])*(P[0][0] - P[2][0]) + (P[2][0] - P[1][0])*(P[0][1] - P[2][1]);
+							if (interpolateTriangle(tri.P, xMin, yMin, xMax, yMax, true, &cellOwners, -1) == 0)
+							{
+								//no (free) empty cell inside this triangle
+								continue;
+							}
 
-						for (int j = yMin; j <= yMax; ++j)
-						{
-							Row& row = rows[static_cast<unsigned>(j)];
+							if (!lastLevel)
+							{
+								if (tri.global < 0)
+								{
+									tri.global = IsGlobalDelaunayTriangle(*this, nonEmptyCells, tri.P) ? 1 : 0;
+								}
+								if (tri.global == 0)
+								{
+									//the window is too small
+									complete = false;
+									break;
+								}
+							}
 
-							for (int i = xMin; i <= xMax; ++i)
+							interpolateTriangle(tri.P, xMin, yMin, xMax, yMax, true, &cellOwners, static_cast<int>(triIndex));
+							tileClaims.push_back(triIndex);
+						}
+
+						if (complete && !lastLevel)
+						{
+							//all the empty cells inside the (global) hull should be covered
+							for (int j = std::max(tj0, hullRowMin); j <= std::min(tj1, hullRowMax) && complete; ++j)
 							{
-								//if the cell is empty
-								if (!row[i].nbPoints)
+								for (int i = ti0; i <= ti1; ++i)
 								{
-									//we test if it's included or not in the current triangle
-									//Point Inclusion in Polygon Test (inspired from W. Randolph Franklin - WRF)
-									bool inside = false;
-									for (int ti = 0; ti < 3; ++ti)
+									const unsigned index = tile->cellIndex(i - ti0, j - tj0);
+									if (	i + 1.0e-6 >= hullMin[j]
+										&&	i - 1.0e-6 <= hullMax[j]
+										&&	cellOwners[index] < 0
+										&&	tile->nbPoints[index] == 0
+										&&	IsInsidePolygon(hull, i, j))
 									{
-										const int* P1 = P[ti];
-										const int* P2 = P[(ti + 1) % 3];
-										if ((P2[1] <= j &&j < P1[1]) || (P1[1] <= j && j < P2[1]))
-										{
-											int t = (i - P2[0])*(P1[1] - P2[1]) - (P1[0] - P2[0])*(j - P2[1]);
-											if (P1[1] < P2[1])
-												t = -t;
-											if (t < 0)
-												inside = !inside;
-										}
+										complete = false;
+										break;
 									}
-									//can we interpolate?
-									if (inside)
-									{
-										double l1 = static_cast<double>((P[1][1] - P[2][1])*(i - P[2][0]) + (P[2][0] - P[1][0])*(j - P[2][1])) / det;
-										double l2 = static_cast<double>((P[2][1] - P[0][1])*(i - P[2][0]) + (P[0][0] - P[2][0])*(j - P[2][1])) / det;
-										double l3 = 1.0-l1-l2;
-
-										row[i].h = l1 * valA + l2 * valB + l3 * valC;
-										assert(std::isfinite(row[i].h));
-
-										//interpolate color as well!
-										if (hasColors)
-										{
-											const CCVector3d& colA = rows[P[0][1]][P[0][0]].color;
-											const CCVector3d& colB = rows[P[1][1]][P[1][0]].color;
-											const CCVector3d& colC = rows[P[2][1]][P[2][0]].color;
-											row[i].color = l1 * colA + l2 * colB + l3 * colC;
-										}
+								}
+							}
+						}
 
-										//interpolate the SFs as well!
-										for (size_t sfIndex = 0; sfIndex < scalarFields.size(); ++sfIndex)
-										{
-											assert(!scalarFields[sfIndex].empty());
+						if (!complete)
+						{
+							//we'll try again with a bigger block
+							continue;
+						}
 
-											SF& gridSF = scalarFields[sfIndex];
-											const double& sfValA = gridSF[P[0][0] + P[0][1] * width];
-											const double& sfValB = gridSF[P[1][0] + P[1][1] * width];
-											const double& sfValC = gridSF[P[2][0] + P[2][1] * width];
-											gridSF[i + j*width] = l1 * sfValA + l2 * sfValB + l3 * sfValC;
-										}
-									}
-								}
+						//eventually we can interpolate the cells
+						for (unsigned triIndex : tileClaims)
+						{
+							const Triangle& tri = triangles[triIndex];
+							int xMin = std::max(std::min(std::min(tri.P[0][0], tri.P[1][0]), tri.P[2][0]), ti0);
+							int yMin = std::max(std::min(std::min(tri.P[0][1], tri.P[1][1]), tri.P[2][1]), tj0);
+							int xMax = std::min(std::max(std::max(tri.P[0][0], tri.P[1][0]), tri.P[2][0]), ti1);
+							int yMax = std::min(std::max(std::max(tri.P[0][1], tri.P[1][1]), tri.P[2][1]), tj1);
+							if (interpolateTriangle(tri.P, xMin, yMin, xMax, yMax, false, &cellOwners, static_cast<int>(triIndex)) < 0)
+							{
+								memoryError = true;
+								return;
 							}
 						}
+						pendingTiles[ty * tileCountX + tx] = 0;
 					}
 				}
 			}
-			else
+			catch (const std::bad_alloc&)
 			{
-				ccLog::Warning(QString("[Rasterize] Empty cells interpolation failed: Triangle lib. said '%1'").arg(errorStr));
+				//not enough memory
+				memoryError = true;
 			}
-		}
-	}
-
-	//computation of the average and extreme height values in the grid
-	{
-		minHeight = 0;
-		maxHeight = 0;
-		meanHeight = 0;
-		validCellCount = 0;
-
-		for (unsigned i=0; i<height; ++i)
-		{
-			for (unsigned j=0; j<width; ++j)
-			{
-				double h = rows[i][j].h;
 
-				if (std::isfinite(h)) //valid height
-				{
-					if (validCellCount)
-					{
-						if (h < minHeight)
-							minHeight = h;
-						else if (h > maxHeight)
-							maxHeight = h;
+		}, maxThreadCount, 0, 1);
 
-						meanHeight += h;
-					}
-					else
-					{
-						//first valid cell
-						meanHeight = minHeight = maxHeight = h;
-					}
-					++validCellCount;
-				}
-			}
-		}
-		
-		if (validCellCount)
+		if (memoryError || lastLevel)
 		{
-			meanHeight /= validCellCount;
+			break;
 		}
 	}
 
-	setValid(true);
+	if (memoryError)
+	{
+		ccLog::Warning("[Rasterize] Not enough memory to interpolate empty cells!");
+		return false;
+	}
 
 	return true;
 }
@@ -688,13 +1864,24 @@ void ccRasterGrid::fillEmptyCells(	EmptyCellFillOption fillEmptyCellsStrategy,
 		}
 		assert(defaultHeight != 0);
 
-		for (unsigned i = 0; i < height; ++i)
+		//the empty tiles must be created (only their height layer is allocated)
+		for (unsigned ty = 0; ty < tileCountY(); ++ty)
 		{
-			for (unsigned j = 0; j < width; ++j)
+			for (unsigned tx = 0; tx < tileCountX(); ++tx)
 			{
-				if (!std::isfinite(rows[i][j].h)) //empty cell (NaN)
+				Tile* tile = getOrCreateTile(tx, ty);
+				if (!tile)
+				{
+					ccLog::Warning("[Rasterize] Not enough memory to fill the empty cells!");
+					return;
+				}
+
+				for (double& h : tile->h)
 				{
-					rows[i][j].h = defaultHeight;
+					if (!std::isfinite(h)) //empty cell (NaN)
+					{
+						h = defaultHeight;
+					}
 				}
 			}
 		}
@@ -732,6 +1919,12 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 		return 0;
 	}
 
+	if (resampleInputCloudXY && !(optionalLayers & LAYER_POINT_INDEX))
+	{
+		ccLog::Warning("[Rasterize] Can't resample the input cloud (the grid has no point index layer)");
+		return 0;
+	}
+
 	ccPointCloud* cloudGrid = 0;
 	
 	//if we 'resample' the input cloud, we actually resample it (one point in each cell)
@@ -749,10 +1942,10 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 		{
 			for (unsigned i = 0; i < width; ++i)
 			{
-				const ccRasterCell& cell = rows[j][i];
-				if (cell.nbPoints) //non empty cell
+				const ccRasterCell c = cell(i, j);
+				if (c.nbPoints) //non empty cell
 				{
-					refCloud.addPointIndex(cell.pointIndex);
+					refCloud.addPointIndex(c.pointIndex);
 				}
 			}
 		}
@@ -774,10 +1967,9 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 			{
 				for (unsigned i = 0; i < width; ++i)
 				{
-					const ccRasterCell& cell = rows[j][i];
-					if (cell.nbPoints) //non empty cell
+					if (cellPointCount(i, j)) //non empty cell
 					{
-						const_cast<CCVector3*>(cloudGrid->getPoint(pointIndex))->u[Z] = static_cast<PointCoordinateType>(cell.h);
+						const_cast<CCVector3*>(cloudGrid->getPoint(pointIndex))->u[Z] = static_cast<PointCoordinateType>(cellHeight(i, j));
 						++pointIndex;
 					}
 				}
@@ -816,6 +2008,12 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 			case PER_CELL_HEIGHT_RANGE:
 			{
 				QString sfName = GetDefaultFieldName(exportedFields[i]);
+				int requiredLayers = GetRequiredLayers(exportedFields[i]);
+				if ((optionalLayers & requiredLayers) != requiredLayers)
+				{
+					ccLog::Warning(QString("[Rasterize] Layer '%1' is not available (it has not been computed)").arg(sfName));
+					continue;
+				}
 				sfIndex = cloudGrid->getScalarFieldIndexByName(qPrintable(sfName));
 				if (sfIndex >= 0)
 				{
@@ -890,29 +2088,30 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 
 	for (unsigned j = 0; j < height; ++j)
 	{
-		const ccRasterCell* aCell = &(rows[j].front());
 		double Px = box.minCorner().u[X] + gridStep / 2;
 		
-		for (unsigned i = 0; i < width; ++i, ++aCell)
+		for (unsigned i = 0; i < width; ++i)
 		{
-			if (std::isfinite(aCell->h)) //valid cell (could have been interpolated)
+			const ccRasterCell aCell = cell(i, j);
+
+			if (std::isfinite(aCell.h)) //valid cell (could have been interpolated)
 			{
 				//if we haven't resampled the original cloud, we must add the point
 				//corresponding to this non-empty cell
-				if (!resampleInputCloudXY || aCell->nbPoints == 0)
+				if (!resampleInputCloudXY || aCell.nbPoints == 0)
 				{
 					CCVector3 Pf;
 					Pf.u[outX] = static_cast<PointCoordinateType>(Px);
 					Pf.u[outY] = static_cast<PointCoordinateType>(Py);
-					Pf.u[outZ] = static_cast<PointCoordinateType>(aCell->h);
+					Pf.u[outZ] = static_cast<PointCoordinateType>(aCell.h);
 
 					cloudGrid->addPoint(Pf);
 
 					if (interpolateColors)
 					{
-						ccColor::Rgb col(	static_cast<ColorCompType>(std::min(255.0, aCell->color.x)),
-											static_cast<ColorCompType>(std::min(255.0, aCell->color.y)),
-											static_cast<ColorCompType>(std::min(255.0, aCell->color.z)) );
+						ccColor::Rgb col(	static_cast<ColorCompType>(std::min(255.0, aCell.color.x)),
+											static_cast<ColorCompType>(std::min(255.0, aCell.color.y)),
+											static_cast<ColorCompType>(std::min(255.0, aCell.color.z)) );
 						
 						cloudGrid->addRGBColor(col.rgb);
 					}
@@ -933,25 +2132,25 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 					switch (exportedFields[i])
 					{
 					case PER_CELL_HEIGHT:
-						sVal = static_cast<ScalarType>(aCell->h);
+						sVal = static_cast<ScalarType>(aCell.h);
 						break;
 					case PER_CELL_COUNT:
-						sVal = static_cast<ScalarType>(aCell->nbPoints);
+						sVal = static_cast<ScalarType>(aCell.nbPoints);
 						break;
 					case PER_CELL_MIN_HEIGHT:
-						sVal = static_cast<ScalarType>(aCell->minHeight);
+						sVal = static_cast<ScalarType>(aCell.minHeight);
 						break;
 					case PER_CELL_MAX_HEIGHT:
-						sVal = static_cast<ScalarType>(aCell->maxHeight);
+						sVal = static_cast<ScalarType>(aCell.maxHeight);
 						break;
 					case PER_CELL_AVG_HEIGHT:
-						sVal = static_cast<ScalarType>(aCell->avgHeight);
+						sVal = static_cast<ScalarType>(aCell.avgHeight);
 						break;
 					case PER_CELL_HEIGHT_STD_DEV:
-						sVal = static_cast<ScalarType>(aCell->stdDevHeight);
+						sVal = static_cast<ScalarType>(aCell.stdDevHeight);
 						break;
 					case PER_CELL_HEIGHT_RANGE:
-						sVal = static_cast<ScalarType>(aCell->maxHeight - aCell->minHeight);
+						sVal = static_cast<ScalarType>(aCell.maxHeight - aCell.minHeight);
 						break;
 					default:
 						assert(false);
@@ -1031,12 +2230,10 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 		if (interpolateSF && inputCloud && inputCloud->isA(CC_TYPES::POINT_CLOUD))
 		{
 			ccPointCloud* pc = static_cast<ccPointCloud*>(inputCloud);
-			assert(scalarFields.size() == pc->getNumberOfScalarFields());
+			assert(scalarFieldCount == 0 || scalarFieldCount == pc->getNumberOfScalarFields());
 			
-			for (size_t k = 0; k < scalarFields.size(); ++k)
+			for (unsigned k = 0; k < scalarFieldCount; ++k)
 			{
-				assert(!scalarFields[k].empty());
-
 				//the corresponding SF should exist on the input cloud
 				ccScalarField* formerSf = static_cast<ccScalarField*>(pc->getScalarField(static_cast<int>(k)));
 				assert(formerSf);
@@ -1059,15 +2256,13 @@ ccPointCloud* ccRasterGrid::convertToCloud(	const std::vector<ExportableFields>&
 					//set sf values
 					unsigned n = 0;
 					const ScalarType emptyCellSFValue = CCLib::ScalarField::NaN();
-					const double* _sfGrid = &(scalarFields[k].front());
 					for (unsigned j = 0; j < height; ++j)
 					{
-						const ccRasterGrid::Row& row = rows[j];
-						for (unsigned i = 0; i < width; ++i, ++_sfGrid)
+						for (unsigned i = 0; i < width; ++i)
 						{
-							if (std::isfinite(row[i].h)) //valid cell (could have been interpolated)
+							if (std::isfinite(cellHeight(i, j))) //valid cell (could have been interpolated)
 							{
-								ScalarType s = static_cast<ScalarType>(*_sfGrid);
+								ScalarType s = static_cast<ScalarType>(cellSFValue(k, i, j));
 								sf->setValue(n++, s);
 							}
 							else if (fillEmptyCells)
@@ -24,12 +24,16 @@
 
 //system
 #include <limits>
+#include <vector>
 
 class ccGenericPointCloud;
 class ccPointCloud;
 class ccProgressDialog;
 
 //! Raster grid cell
+/** Aggregated view of the values of a given cell (see ccRasterGrid::cell).
+	The grid itself stores its values layer by layer (see ccRasterGrid::Tile).
+**/
 struct QCC_DB_LIB_API ccRasterCell
 {
 	//! Default constructor
@@ -63,6 +67,12 @@ struct QCC_DB_LIB_API ccRasterCell
 };
 
 //! Raster grid type
+/** The grid is split in square tiles of TILE_SIZE x TILE_SIZE cells. Each tile
+	stores its values as one array per layer (height, population, etc.) and is
+	only allocated once a value is written in it. Apart from the height and the
+	population, the layers are only allocated if they have been requested (see
+	OptionalLayers).
+**/
 struct QCC_DB_LIB_API ccRasterGrid
 {
 	//! Default constructor
@@ -71,6 +81,59 @@ struct QCC_DB_LIB_API ccRasterGrid
 	//! Destructor
 	virtual ~ccRasterGrid();
 
+	//! Optional layers (the height and population layers are always allocated)
+	enum OptionalLayers {	NO_OPTIONAL_LAYER		= 0,
+							LAYER_MIN_HEIGHT		= 1,
+							LAYER_MAX_HEIGHT		= 2,
+							LAYER_AVG_HEIGHT		= 4,
+							LAYER_HEIGHT_STD_DEV	= 8,
+							LAYER_POINT_INDEX		= 16,
+							LAYER_COLOR				= 32,
+							ALL_OPTIONAL_LAYERS		= 63,
+	};
+
+	//! Tile size (as a power of 2)
+	static const unsigned TILE_SIZE_SHIFT = 8;
+	//! Tile size (in cells)
+	static const unsigned TILE_SIZE = (1 << TILE_SIZE_SHIFT);
+
+	//! Grid tile
+	/** Optional layers may be empty (if they have not been requested, or if
+		the tile has only been created to store interpolated/filled heights).
+	**/
+	struct Tile
+	{
+		//! Default constructor
+		Tile() : width(0), height(0) {}
+
+		//! Returns the index of a cell in the layers (local coordinates)
+		inline unsigned cellIndex(unsigned li, unsigned lj) const { return lj * width + li; }
+
+		//! Number of columns
+		unsigned width;
+		//! Number of rows
+		unsigned height;
+
+		//! Height values
+		std::vector<double> h;
+		//! Number of points projected in each cell
+		std::vector<unsigned> nbPoints;
+		//! Min height values
+		std::vector<PointCoordinateType> minHeight;
+		//! Max height values
+		std::vector<PointCoordinateType> maxHeight;
+		//! Average height values
+		std::vector<double> avgHeight;
+		//! Height std.dev. values
+		std::vector<double> stdDevHeight;
+		//! Index of the point (closest to the cell center or at the min/max height)
+		std::vector<unsigned> pointIndex;
+		//! Colors
+		std::vector<CCVector3d> color;
+		//! Scalar fields values
+		std::vector< std::vector<double> > scalarFields;
+	};
+
 	//! Computes the raster size for a given bounding-box
 	static bool ComputeGridSize(unsigned char Z,
 								const ccBBox& box,
@@ -80,10 +143,20 @@ struct QCC_DB_LIB_API ccRasterGrid
 
 
 	//! Initializes / resets the grid
+	/** Only the tiles index is allocated at this point (the tiles are created
+		on demand, as the grid is filled).
+		\param w grid width (number of columns)
+		\param h grid height (number of rows)
+		\param gridStep grid step
+		\param minCorner grid min corner (3D)
+		\param optionalLayers optional layers to allocate (see OptionalLayers)
+		\return false if there's not enough memory
+	**/
 	bool init(	unsigned w,
 				unsigned h,
 				double gridStep,
-				const CCVector3d& minCorner);
+				const CCVector3d& minCorner,
+				int optionalLayers = ALL_OPTIONAL_LAYERS);
 
 	//! Clears the grid
 	void clear();
@@ -102,6 +175,9 @@ struct QCC_DB_LIB_API ccRasterGrid
 	//! Returns the default name of a given field
 	static QString GetDefaultFieldName(ExportableFields field);
 
+	//! Returns the optional layers required to export a given field
+	static int GetRequiredLayers(ExportableFields field);
+
 	//! Converts the grid to a cloud with scalar field(s)
 	ccPointCloud* convertToCloud(	const std::vector<ExportableFields>& exportedFields,
 									bool interpolateSF,
@@ -125,13 +201,16 @@ struct QCC_DB_LIB_API ccRasterGrid
 	//! Fills the grid with a point cloud
 	/** Since version 2.8, we now use the "PixelIsArea" convention by default (as GDAL)
 	This means that the height is computed at the center of the grid cell.
+	The points are first sorted by tile, then the tiles are filled in parallel
+	(each tile being processed by a single thread, in the points order).
 	**/
 	bool fillWith(	ccGenericPointCloud* cloud,
 					unsigned char projectionDimension,
 					ProjectionType projectionType,
 					bool interpolateEmptyCells,
 					ProjectionType sfInterpolation = INVALID_PROJECTION_TYPE,
-					ccProgressDialog* progressDialog = 0);
+					ccProgressDialog* progressDialog = 0,
+					int maxThreadCount = 0);
 
 	//! Option for handling empty cells
 	enum EmptyCellFillOption {	LEAVE_EMPTY				= 0,
@@ -146,6 +225,20 @@ struct QCC_DB_LIB_API ccRasterGrid
 	void fillEmptyCells(EmptyCellFillOption fillEmptyCellsStrategy,
 						double customCellHeight = 0);
 
+	//! Interpolates the empty cells from the non-empty ones (see fillWith)
+	/** The empty cells are interpolated inside the triangles of the 2D Delaunay
+		triangulation of the non-empty cells. Small grids are processed with a single
+		(global) triangulation. Bigger grids are processed tile by tile (in parallel):
+		each tile is triangulated with the non-empty cells of a surrounding window.
+		The tiles for which this window is too small (i.e. for which the triangles
+		can't be proven to be those of the global triangulation) are processed again
+		by bigger blocks of tiles, with bigger windows. Therefore the result only
+		differs from the global triangulation in case of co-circular cells (ties).
+		\param maxThreadCount max number of threads (0 = all available)
+		\return success
+	**/
+	bool fillEmptyCellsByInterpolation(int maxThreadCount = 0);
+
 	//! Sets valid
 	inline void setValid(bool state) { valid = state; }
 	//! Returns whether the grid is 'valid' or not
@@ -169,17 +262,70 @@ struct QCC_DB_LIB_API ccRasterGrid
 		return CCVector2d(minCorner.u[X] + (i + 0.5) * gridStep, minCorner.u[Y] + (j + 0.5) * gridStep);
 	}
 
-	//! Row
-	typedef std::vector<ccRasterCell> Row;
+	//! Returns the number of tiles along the X dimension
+	inline unsigned tileCountX() const { return (width + TILE_SIZE - 1) >> TILE_SIZE_SHIFT; }
+	//! Returns the number of tiles along the Y dimension
+	inline unsigned tileCountY() const { return (height + TILE_SIZE - 1) >> TILE_SIZE_SHIFT; }
+
+	//! Returns a given tile (or 0 if it has not been allocated yet)
+	inline const Tile* tile(unsigned tx, unsigned ty) const { return tiles[ty * tileCountX() + tx]; }
+	//! Returns a given tile (or 0 if it has not been allocated yet)
+	inline Tile* tile(unsigned tx, unsigned ty) { return tiles[ty * tileCountX() + tx]; }
+	//! Returns the tile including a given cell (or 0 if it has not been allocated yet)
+	inline const Tile* cellTile(unsigned i, unsigned j) const { return tile(i >> TILE_SIZE_SHIFT, j >> TILE_SIZE_SHIFT); }
+
+	//! Returns (or creates) a given tile
+	/** \param tx tile index along X
+		\param ty tile index along Y
+		\param withOptionalLayers whether to allocate the optional layers (if the tile is created)
+		\return the tile (or 0 if not enough memory)
+	**/
+	Tile* getOrCreateTile(unsigned tx, unsigned ty, bool withOptionalLayers = false);
+
+	//! Returns the height of a given cell (NaN if the cell is empty)
+	inline double cellHeight(unsigned i, unsigned j) const
+	{
+		const Tile* t = cellTile(i, j);
+		return t ? t->h[t->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1))] : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	//! Returns the number of points projected in a given cell
+	inline unsigned cellPointCount(unsigned i, unsigned j) const
+	{
+		const Tile* t = cellTile(i, j);
+		return t ? t->nbPoints[t->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1))] : 0;
+	}
+
+	//! Returns the value of a given scalar field for a given cell (NaN if not available)
+	inline double cellSFValue(unsigned sfIndex, unsigned i, unsigned j) const
+	{
+		const Tile* t = cellTile(i, j);
+		return t && sfIndex < t->scalarFields.size() ? t->scalarFields[sfIndex][t->cellIndex(i & (TILE_SIZE - 1), j & (TILE_SIZE - 1))] : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	//! Returns all the values of a given cell (slower than the dedicated accessors)
+	ccRasterCell cell(unsigned i, unsigned j) const;
+
+	//! Sets the height of a given cell
+	/** The corresponding tile is created if necessary.
+		\return false if there's not enough memory
+	**/
+	bool setCellHeight(unsigned i, unsigned j, double h);
 
-	//! All cells
-	std::vector<Row> rows;
+	//! Sets the height and the number of points of a given cell
+	/** The corresponding tile is created if necessary.
+		\return false if there's not enough memory
+	**/
+	bool setCellHeightAndCount(unsigned i, unsigned j, double h, unsigned nbPoints);
 
-	//! Scalar field
-	typedef std::vector<double> SF;
+	//! Tiles (row by row, 0 if not allocated)
+	std::vector<Tile*> tiles;
 
-	//! Associated scalar fields
-	std::vector<SF> scalarFields;
+	//! Optional layers (see OptionalLayers)
+	int optionalLayers;
+
+	//! Number of interpolated scalar fields (see fillWith)
+	unsigned scalarFieldCount;
 
 	//! Number of columns
 	unsigned width;
@@ -206,6 +352,39 @@ struct QCC_DB_LIB_API ccRasterGrid
 
 	//! Whether the grid is valid/up-to-date
 	bool valid;
+
+private:
+
+	//! Interpolates the empty cells of the grid tile by tile (see fillEmptyCellsByInterpolation)
+	bool interpolateEmptyCellsByTiles(int maxThreadCount);
+
+	//! Interpolates the empty cells lying inside a triangle of non-empty cells
+	/** Only the cells inside [xMin ; xMax] x [yMin ; yMax] are considered.
+		If per-cell owners are provided (for the tile including these cells), only the
+		cells without owner are counted (and then assigned to 'ownerIndex') in 'count only'
+		mode, and only the cells assigned to 'ownerIndex' are interpolated otherwise.
+		\param P triangle vertices (grid coordinates)
+		\param xMin min column
+		\param yMin min row
+		\param xMax max column
+		\param yMax max row
+		\param countOnly whether the cells should only be counted (and not interpolated)
+		\param cellOwners optional per-cell owners (index of the triangle the cell is assigned to, or -1)
+		\param ownerIndex owner index (see above)
+		\return the number of empty cells inside the triangle (or -1 if there's not enough memory)
+	**/
+	int interpolateTriangle(const int P[3][2],
+							int xMin,
+							int yMin,
+							int xMax,
+							int yMax,
+							bool countOnly = false,
+							std::vector<int>* cellOwners = 0,
+							int ownerIndex = -1);
+
+	//the tiles can't be shared between grids
+	ccRasterGrid(const ccRasterGrid&);
+	ccRasterGrid& operator=(const ccRasterGrid&);
 };
 
 #endif //CC_RASTER_GRID_HEADER
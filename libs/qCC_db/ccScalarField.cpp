@@ -25,12 +25,16 @@
 
 //system
 #include <algorithm>
+#include <limits>
 
 using namespace CCLib;
 
 //! Default number of classes for associated histogram
 const unsigned MAX_HISTOGRAM_SIZE = 512;
 
+//! Number of value bins of the color lookup table
+static const unsigned COLOR_LUT_SIZE = (1 << 16);
+
 ccScalarField::ccScalarField(const char* name/*=0*/)
 	: ScalarField(name)
 	, m_showNaNValuesInGrey(true)
@@ -116,6 +120,145 @@ ScalarType ccScalarField::normalize(ScalarType d) const
 	return static_cast<ScalarType>(-1);
 }
 
+bool ccScalarField::isColorLUTUpToDate() const
+{
+	if (m_colorLUT.colorIndexes.empty())
+	{
+		return false;
+	}
+
+	return (	m_colorLUT.parameters[0] == m_displayRange.start()
+			&&	m_colorLUT.parameters[1] == m_displayRange.stop()
+			&&	m_colorLUT.parameters[2] == m_saturationRange.start()
+			&&	m_colorLUT.parameters[3] == m_saturationRange.stop()
+			&&	m_colorLUT.parameters[4] == m_logSaturationRange.start()
+			&&	m_colorLUT.parameters[5] == m_logSaturationRange.stop()
+			&&	m_colorLUT.colorRampSteps == m_colorRampSteps
+			&&	m_colorLUT.logScale == m_logScale
+			&&	m_colorLUT.symmetricalScale == m_symmetricalScale );
+}
+
+bool ccScalarField::updateColorLUT() const
+{
+	try
+	{
+		m_colorLUT.colorIndexes.resize(COLOR_LUT_SIZE);
+	}
+	catch (const std::bad_alloc&)
+	{
+		m_colorLUT.colorIndexes.clear();
+		return false;
+	}
+
+	m_colorLUT.parameters[0] = m_displayRange.start();
+	m_colorLUT.parameters[1] = m_displayRange.stop();
+	m_colorLUT.parameters[2] = m_saturationRange.start();
+	m_colorLUT.parameters[3] = m_saturationRange.stop();
+	m_colorLUT.parameters[4] = m_logSaturationRange.start();
+	m_colorLUT.parameters[5] = m_logSaturationRange.stop();
+	m_colorLUT.colorRampSteps = m_colorRampSteps;
+	m_colorLUT.logScale = m_logScale;
+	m_colorLUT.symmetricalScale = m_symmetricalScale;
+
+	//the bins cover the displayed range
+	double start = m_displayRange.start();
+	double stop = m_displayRange.stop();
+	double binWidth = (stop - start) / COLOR_LUT_SIZE;
+	m_colorLUT.binsPerUnit = (binWidth > 0 ? static_cast<ScalarType>(1.0 / binWidth) : 0);
+
+	//the bin index of a value is computed in single precision: we enlarge the bins
+	//a bit so as to be sure that the values falling in a bin are really inside
+	double margin = binWidth / 20 + 4 * std::numeric_limits<ScalarType>::epsilon() * std::max(fabs(start), fabs(stop));
+
+	for (unsigned i = 0; i < COLOR_LUT_SIZE; ++i)
+	{
+		ScalarType binStart = static_cast<ScalarType>(std::max(start, start + i * binWidth - margin));
+		ScalarType binStop = static_cast<ScalarType>(std::min(stop, start + (i + 1) * binWidth + margin));
+
+		//the color is a monotonic function of the value (or of its absolute value in log scale)
+		//so that the whole bin has a single color if both its boundaries have the same one
+		unsigned short colorIndex = ColorLUT::INVALID_INDEX;
+		if (!(m_logScale && binStart <= 0 && binStop >= 0))
+		{
+			unsigned startIndex = ccColorScale::GetColorIndex(normalize(binStart), m_colorRampSteps);
+			unsigned stopIndex = ccColorScale::GetColorIndex(normalize(binStop), m_colorRampSteps);
+			if (startIndex == stopIndex)
+			{
+				colorIndex = static_cast<unsigned short>(startIndex);
+			}
+		}
+		m_colorLUT.colorIndexes[i] = colorIndex;
+	}
+
+	return true;
+}
+
+void ccScalarField::getColors(	const ScalarType* values,
+								unsigned count,
+								ColorCompType* rgb,
+								unsigned stride/*=1*/,
+								const ColorCompType* hiddenColor/*=ccColor::black.rgba*/) const
+{
+	assert(m_colorScale && values && rgb);
+
+	if (!isColorLUTUpToDate() && !updateColorLUT())
+	{
+		//not enough memory: we use the standard (slower) path
+		for (unsigned i = 0; i < count; ++i, values += stride, rgb += 3)
+		{
+			const ColorCompType* col = getColor(*values);
+			if (!col)
+			{
+				if (!hiddenColor)
+					continue;
+				col = hiddenColor;
+			}
+			rgb[0] = col[0];
+			rgb[1] = col[1];
+			rgb[2] = col[2];
+		}
+		return;
+	}
+
+	const ScalarType start = m_displayRange.start();
+	const ScalarType stop = m_displayRange.stop();
+	const ScalarType binsPerUnit = m_colorLUT.binsPerUnit;
+	const unsigned short* colorIndexes = m_colorLUT.colorIndexes.data();
+	const ColorCompType* outOfRangeColor = (m_showNaNValuesInGrey ? ccColor::lightGrey.rgba : hiddenColor);
+
+	for (unsigned i = 0; i < count; ++i, values += stride, rgb += 3)
+	{
+		const ScalarType value = *values;
+
+		const ColorCompType* col = 0;
+		if (value >= start && value <= stop) //NaN values are also rejected here
+		{
+			unsigned bin = std::min(static_cast<unsigned>((value - start) * binsPerUnit), COLOR_LUT_SIZE - 1);
+			unsigned short colorIndex = colorIndexes[bin];
+			if (colorIndex != ColorLUT::INVALID_INDEX)
+			{
+				col = m_colorScale->getColorByIndex(colorIndex).rgba;
+			}
+			else
+			{
+				//the bin overlaps several colors
+				col = getColor(value);
+			}
+		}
+		else
+		{
+			col = outOfRangeColor;
+		}
+
+		if (col)
+		{
+			rgb[0] = col[0];
+			rgb[1] = col[1];
+			rgb[2] = col[2];
+		}
+	}
+}
+
 void ccScalarField::setColorScale(ccColorScale::Shared scale)
 {
 	if (m_colorScale != scale)
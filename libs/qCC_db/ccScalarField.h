@@ -142,6 +142,24 @@ public:
 	//! Shortcut to getColor
 	inline const ColorCompType* getValueColor(unsigned index) const { return getColor(getValue(index)); }
 
+	//! Converts an array of scalar values to RGB colors (wrt to the current display parameters)
+	/** Relies on a quantized 'value to color' lookup table, automatically rebuilt when the
+		display range, the saturation, the scale mode or the number of color steps change.
+		Gives exactly the same colors as getColor.
+		Warning: must no be called if the SF is not associated to a color scale!
+		\warning Not thread-safe if the display parameters have changed since the last call
+		\param values scalar values
+		\param count number of values to convert
+		\param rgb output RGB colors (3 components per value)
+		\param stride increment between two consecutive input values
+		\param hiddenColor color of the 'hidden' values (i.e. values for which getColor returns 0). If 0, the corresponding output colors are left untouched.
+	**/
+	void getColors(	const ScalarType* values,
+					unsigned count,
+					ColorCompType* rgb,
+					unsigned stride = 1,
+					const ColorCompType* hiddenColor = ccColor::black.rgba) const;
+
 	//! Sets whether NaN/out of displayed range values should be displayed in grey or hidden
 	void showNaNValuesInGrey(bool state);
 
@@ -285,6 +303,37 @@ protected:
 
 	//! Global shift
 	double m_globalShift;
+
+	//! Quantized 'value to color' lookup table (see getColors)
+	struct ColorLUT
+	{
+		//! Color index (in the color scale) of each value bin (or INVALID_INDEX)
+		std::vector<unsigned short> colorIndexes;
+		//! Invalid color index (the bin overlaps two or more colors)
+		static const unsigned short INVALID_INDEX = 0xFFFF;
+		//! Number of bins per scalar value unit
+		ScalarType binsPerUnit;
+		//! Display parameters for which the table has been built
+		ScalarType parameters[6];
+		//! Number of color steps for which the table has been built
+		unsigned colorRampSteps;
+		//! Scale mode for which the table has been built
+		bool logScale, symmetricalScale;
+
+		//! Default constructor
+		ColorLUT() : binsPerUnit(0), colorRampSteps(0), logScale(false), symmetricalScale(false) {}
+	};
+
+	//! Returns whether the color lookup table is up to date or not
+	bool isColorLUTUpToDate() const;
+
+	//! Rebuilds the color lookup table
+	/** \return success
+	**/
+	bool updateColorLUT() const;
+
+	//! Color lookup table
+	mutable ColorLUT m_colorLUT;
 };
 
 #endif //CC_DB_SCALAR_FIELD_HEADER
@@ -0,0 +1,535 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccSerializableObject.h"
+
+//CCLib
+#include <CompressionTools.h>
+#include <ParallelTools.h>
+
+//System
+#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <string.h>
+
+/** Compressed array data format (dataVersion>=49):
+	- type size (1 byte): bytes are 'shuffled' by groups of this size before compression
+	- block size (4 bytes): uncompressed size of each block (except the last one)
+	- for each block:
+		- stored size (4 bytes): the highest bit is set if the block is stored uncompressed
+		- stored data
+**/
+
+//! Targeted (uncompressed) size of each block
+static const size_t c_blockSize = (1 << 20); //1 Mb
+//! Flag set in the block header when the block is stored uncompressed
+static const ::uint32_t c_rawBlockFlag = (1u << 31);
+
+//! Error raised by a block task
+enum BlockError { NO_BLOCK_ERROR = 0, BLOCK_READ_ERROR, BLOCK_WRITE_ERROR, BLOCK_MEMORY_ERROR, BLOCK_CORRUPT_ERROR };
+
+//! Buffers associated to a block
+struct BlockBuffer
+{
+	std::vector<char> gathered; //uncompressed data (if it doesn't lie in a single segment)
+	std::vector<char> shuffled; //shuffled data
+	std::vector<char> stored; //compressed data
+	const char* storedData; //data actually written (or read)
+	::uint32_t storedSize; //size of the data actually written (or read)
+	bool raw; //whether the block is stored uncompressed
+
+	BlockBuffer() : storedData(0), storedSize(0), raw(false) {}
+};
+
+//! Data cut in blocks (whatever its memory layout)
+class BlockLayout
+{
+public:
+
+	BlockLayout(const ccSerializationHelper::MemorySegments& segments, size_t blockSize)
+		: m_segments(segments)
+		, m_blockSize(blockSize)
+		, m_totalSize(0)
+	{
+		m_segmentStarts.reserve(segments.size());
+		for (size_t i = 0; i < segments.size(); ++i)
+		{
+			m_segmentStarts.push_back(m_totalSize);
+			m_totalSize += segments[i].size;
+		}
+	}
+
+	//! Constructor for data that doesn't lie in memory as a whole (see ccSerializationHelper::BlockReceiver)
+	BlockLayout(qint64 totalSize, size_t blockSize)
+		: m_segments(s_noSegments)
+		, m_blockSize(blockSize)
+		, m_totalSize(totalSize)
+	{
+	}
+
+	inline qint64 blockOffset(unsigned index) const { return static_cast<qint64>(index) * m_blockSize; }
+	inline unsigned blockCount() const { return static_cast<unsigned>((m_totalSize + m_blockSize - 1) / m_blockSize); }
+	inline size_t blockSize(unsigned index) const { return static_cast<size_t>(std::min<qint64>(m_blockSize, m_totalSize - static_cast<qint64>(index) * m_blockSize)); }
+
+	//! Returns the address of a block if it lies in a single segment (0 otherwise)
+	char* blockData(unsigned index) const
+	{
+		if (m_segments.empty())
+			return 0;
+		qint64 start = static_cast<qint64>(index) * m_blockSize;
+		size_t i = segmentIndex(start);
+		if (start + static_cast<qint64>(blockSize(index)) <= m_segmentStarts[i] + m_segments[i].size)
+			return m_segments[i].data + (start - m_segmentStarts[i]);
+		return 0;
+	}
+
+	//! Copies a block to a contiguous buffer
+	void gather(unsigned index, char* dest) const
+	{
+		qint64 pos = static_cast<qint64>(index) * m_blockSize;
+		qint64 remaining = static_cast<qint64>(blockSize(index));
+		for (size_t i = segmentIndex(pos); remaining != 0; ++i)
+		{
+			qint64 offset = pos - m_segmentStarts[i];
+			qint64 count = std::min(remaining, m_segments[i].size - offset);
+			memcpy(dest, m_segments[i].data + offset, static_cast<size_t>(count));
+			dest += count;
+			pos += count;
+			remaining -= count;
+		}
+	}
+
+	//! Copies a contiguous buffer to a block
+	void scatter(unsigned index, const char* source) const
+	{
+		qint64 pos = static_cast<qint64>(index) * m_blockSize;
+		qint64 remaining = static_cast<qint64>(blockSize(index));
+		for (size_t i = segmentIndex(pos); remaining != 0; ++i)
+		{
+			qint64 offset = pos - m_segmentStarts[i];
+			qint64 count = std::min(remaining, m_segments[i].size - offset);
+			memcpy(m_segments[i].data + offset, source, static_cast<size_t>(count));
+			source += count;
+			pos += count;
+			remaining -= count;
+		}
+	}
+
+protected:
+
+	//! Returns the index of the segment containing a given position
+	size_t segmentIndex(qint64 pos) const
+	{
+		//we look for the last segment starting before 'pos' (skipping the empty ones)
+		std::vector<qint64>::const_iterator it = std::upper_bound(m_segmentStarts.begin(), m_segmentStarts.end(), pos);
+		size_t i = static_cast<size_t>(it - m_segmentStarts.begin()) - 1;
+		while (m_segments[i].size == 0)
+			++i;
+		return i;
+	}
+
+	static const ccSerializationHelper::MemorySegments s_noSegments;
+
+	const ccSerializationHelper::MemorySegments& m_segments;
+	std::vector<qint64> m_segmentStarts;
+	const qint64 m_blockSize;
+	qint64 m_totalSize;
+};
+
+const ccSerializationHelper::MemorySegments BlockLayout::s_noSegments;
+
+//! Returns the number of blocks processed (in parallel) at once
+static unsigned BlockGroupSize()
+{
+	return static_cast<unsigned>(std::max(1, CCLib::ParallelTools::DefaultMaxThreadCount()));
+}
+
+//! Reports a block error (in the calling thread)
+static bool BlockErrorToLog(int error)
+{
+	switch (error)
+	{
+	case BLOCK_READ_ERROR:
+		return ccSerializableObject::ReadError();
+	case BLOCK_WRITE_ERROR:
+		return ccSerializableObject::WriteError();
+	case BLOCK_MEMORY_ERROR:
+		return ccSerializableObject::MemoryError();
+	case BLOCK_CORRUPT_ERROR:
+		return ccSerializableObject::CorruptError();
+	default:
+		break;
+	}
+	return true;
+}
+
+
+//! Compresses a block
+/** \return the error (if any)
+**/
+static int CompressBlock(const BlockLayout& layout, unsigned blockIndex, size_t typeSize, BlockBuffer& buffer)
+{
+	size_t size = layout.blockSize(blockIndex);
+	try
+	{
+		const char* data = layout.blockData(blockIndex);
+		if (!data)
+		{
+			buffer.gathered.resize(size);
+			layout.gather(blockIndex, buffer.gathered.data());
+			data = buffer.gathered.data();
+		}
+
+		if (typeSize > 1)
+		{
+			buffer.shuffled.resize(size);
+			CCLib::CompressionTools::Shuffle(data, buffer.shuffled.data(), size, typeSize);
+		}
+
+		buffer.stored.resize(CCLib::CompressionTools::CompressBound(size));
+		size_t storedSize = CCLib::CompressionTools::Compress(typeSize > 1 ? buffer.shuffled.data() : data, size, buffer.stored.data(), buffer.stored.size());
+		buffer.raw = (storedSize == 0 || storedSize >= size);
+		buffer.storedData = (buffer.raw ? data : buffer.stored.data());
+		buffer.storedSize = static_cast<::uint32_t>(buffer.raw ? size : storedSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return BLOCK_MEMORY_ERROR;
+	}
+
+	return NO_BLOCK_ERROR;
+}
+
+//! Writes a (compressed) block
+/** \return the error (if any)
+**/
+static int WriteBlock(const BlockBuffer& buffer, QFile& out)
+{
+	::uint32_t header = buffer.storedSize | (buffer.raw ? c_rawBlockFlag : 0);
+	if (	out.write((const char*)&header, 4) < 0
+		||	out.write(buffer.storedData, buffer.storedSize) < 0)
+	{
+		return BLOCK_WRITE_ERROR;
+	}
+	return NO_BLOCK_ERROR;
+}
+
+//! Reads a (compressed) block
+/** \return the error (if any)
+**/
+static int ReadBlock(QFile& in, size_t maxStoredSize, BlockBuffer& buffer)
+{
+	::uint32_t header = 0;
+	if (in.read((char*)&header, 4) != 4)
+	{
+		return BLOCK_READ_ERROR;
+	}
+	buffer.raw = ((header & c_rawBlockFlag) != 0);
+	buffer.storedSize = (header & ~c_rawBlockFlag);
+	if (buffer.storedSize > maxStoredSize)
+	{
+		return BLOCK_CORRUPT_ERROR;
+	}
+	try
+	{
+		buffer.stored.resize(buffer.storedSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return BLOCK_MEMORY_ERROR;
+	}
+	if (in.read(buffer.stored.data(), buffer.storedSize) != static_cast<qint64>(buffer.storedSize))
+	{
+		return BLOCK_READ_ERROR;
+	}
+	return NO_BLOCK_ERROR;
+}
+
+//! Decompresses a block
+/** The block is either copied to its final location, or forwarded to the receiver (if any)
+	\return the error (if any)
+**/
+static int DecompressBlock(	const BlockLayout& layout,
+							unsigned blockIndex,
+							size_t typeSize,
+							BlockBuffer& buffer,
+							const ccSerializationHelper::BlockReceiver* receiver)
+{
+	size_t size = layout.blockSize(blockIndex);
+	try
+	{
+		char* data = layout.blockData(blockIndex);
+		char* output = data;
+		if (!output)
+		{
+			buffer.gathered.resize(size);
+			output = buffer.gathered.data();
+		}
+
+		if (buffer.raw)
+		{
+			if (buffer.storedSize != size)
+			{
+				return BLOCK_CORRUPT_ERROR;
+			}
+			memcpy(output, buffer.stored.data(), size);
+		}
+		else if (typeSize > 1)
+		{
+			buffer.shuffled.resize(size);
+			if (!CCLib::CompressionTools::Decompress(buffer.stored.data(), buffer.storedSize, buffer.shuffled.data(), size))
+			{
+				return BLOCK_CORRUPT_ERROR;
+			}
+			CCLib::CompressionTools::Unshuffle(buffer.shuffled.data(), output, size, typeSize);
+		}
+		else if (!CCLib::CompressionTools::Decompress(buffer.stored.data(), buffer.storedSize, output, size))
+		{
+			return BLOCK_CORRUPT_ERROR;
+		}
+
+		if (receiver)
+		{
+			(*receiver)(layout.blockOffset(blockIndex), output, size);
+		}
+		else if (!data)
+		{
+			layout.scatter(blockIndex, output);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return BLOCK_MEMORY_ERROR;
+	}
+
+	return NO_BLOCK_ERROR;
+}
+
+bool ccSerializationHelper::CompressedDataToFile(const MemorySegments& segments, size_t typeSize, QFile& out)
+{
+	assert(out.isOpen() && (out.openMode() & QIODevice::WriteOnly));
+
+	if (typeSize == 0 || typeSize > 255)
+	{
+		//no shuffling
+		typeSize = 1;
+	}
+	//each block contains a whole number of elements
+	size_t blockSize = std::max<size_t>(1, c_blockSize / typeSize) * typeSize;
+
+	::uint8_t typeSize_u8 = static_cast<::uint8_t>(typeSize);
+	::uint32_t blockSize_u32 = static_cast<::uint32_t>(blockSize);
+	if (	out.write((const char*)&typeSize_u8, 1) < 0
+		||	out.write((const char*)&blockSize_u32, 4) < 0)
+	{
+		return ccSerializableObject::WriteError();
+	}
+
+	BlockLayout layout(segments, blockSize);
+	unsigned blockCount = layout.blockCount();
+	if (blockCount == 0)
+		return true;
+
+	unsigned groupSize = BlockGroupSize();
+	if (blockCount == 1 || groupSize == 1)
+	{
+		//small data (or no parallelism): no need to start any thread
+		BlockBuffer buffer;
+		for (unsigned blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+		{
+			int error = CompressBlock(layout, blockIndex, typeSize, buffer);
+			if (error == NO_BLOCK_ERROR)
+				error = WriteBlock(buffer, out);
+			if (error != NO_BLOCK_ERROR)
+				return BlockErrorToLog(error);
+		}
+		return true;
+	}
+
+	//double buffering: the blocks of a group are compressed while the previous group is written
+	std::vector<BlockBuffer> buffers[2];
+	try
+	{
+		buffers[0].resize(groupSize);
+		buffers[1].resize(groupSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return ccSerializableObject::MemoryError();
+	}
+
+	std::atomic<int> error(NO_BLOCK_ERROR);
+	CCLib::ParallelCancelToken cancelToken;
+
+	unsigned groupCount = (blockCount + groupSize - 1) / groupSize;
+	for (unsigned g = 0; g <= groupCount; ++g)
+	{
+		//blocks to compress
+		unsigned firstBlock = g * groupSize;
+		unsigned compressCount = (g < groupCount ? std::min(groupSize, blockCount - firstBlock) : 0);
+		std::vector<BlockBuffer>& compressBuffers = buffers[g & 1];
+		//blocks to write
+		unsigned writeCount = (g != 0 ? std::min(groupSize, blockCount - (g - 1) * groupSize) : 0);
+		const std::vector<BlockBuffer>& writeBuffers = buffers[(g + 1) & 1];
+
+		CCLib::ParallelTools::IndexedTask task = [&](unsigned i)
+		{
+			int blockError = NO_BLOCK_ERROR;
+			if (i == compressCount)
+			{
+				//write the previous group
+				for (unsigned j = 0; j < writeCount && blockError == NO_BLOCK_ERROR; ++j)
+				{
+					blockError = WriteBlock(writeBuffers[j], out);
+				}
+			}
+			else
+			{
+				blockError = CompressBlock(layout, firstBlock + i, typeSize, compressBuffers[i]);
+			}
+
+			if (blockError != NO_BLOCK_ERROR)
+			{
+				error = blockError;
+				cancelToken.cancel();
+			}
+		};
+
+		//one more task (and thread) for the file I/O
+		CCLib::ParallelTools::ForEach(compressCount + 1, task, static_cast<int>(groupSize) + 1, &cancelToken, 1);
+
+		if (error != NO_BLOCK_ERROR)
+			return BlockErrorToLog(error);
+	}
+
+	return true;
+}
+
+//! Reads data saved as independently compressed blocks (see ccSerializationHelper::CompressedDataFromFile)
+static bool CompressedBlocksFromFile(	const ccSerializationHelper::MemorySegments* segments,
+										qint64 totalSize,
+										const ccSerializationHelper::BlockReceiver* receiver,
+										QFile& in)
+{
+	assert(in.isOpen() && (in.openMode() & QIODevice::ReadOnly));
+
+	::uint8_t typeSize_u8 = 0;
+	::uint32_t blockSize_u32 = 0;
+	if (	in.read((char*)&typeSize_u8, 1) != 1
+		||	in.read((char*)&blockSize_u32, 4) != 4)
+	{
+		return ccSerializableObject::ReadError();
+	}
+
+	size_t typeSize = typeSize_u8;
+	size_t blockSize = blockSize_u32;
+	if (typeSize == 0 || blockSize == 0 || (blockSize % typeSize) != 0)
+		return ccSerializableObject::CorruptError();
+
+	BlockLayout layout = (segments ? BlockLayout(*segments, blockSize) : BlockLayout(totalSize, blockSize));
+	unsigned blockCount = layout.blockCount();
+	if (blockCount == 0)
+		return true;
+
+	//the stored size of a block can't exceed this limit
+	const size_t maxStoredSize = std::max(blockSize, CCLib::CompressionTools::CompressBound(blockSize));
+
+	unsigned groupSize = BlockGroupSize();
+	if (blockCount == 1 || groupSize == 1)
+	{
+		//small data (or no parallelism): no need to start any thread
+		BlockBuffer buffer;
+		for (unsigned blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+		{
+			int error = ReadBlock(in, maxStoredSize, buffer);
+			if (error == NO_BLOCK_ERROR)
+				error = DecompressBlock(layout, blockIndex, typeSize, buffer, receiver);
+			if (error != NO_BLOCK_ERROR)
+				return BlockErrorToLog(error);
+		}
+		return true;
+	}
+
+	//double buffering: the blocks of a group are decompressed while the next group is read
+	std::vector<BlockBuffer> buffers[2];
+	try
+	{
+		buffers[0].resize(groupSize);
+		buffers[1].resize(groupSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return ccSerializableObject::MemoryError();
+	}
+
+	std::atomic<int> error(NO_BLOCK_ERROR);
+	CCLib::ParallelCancelToken cancelToken;
+
+	unsigned groupCount = (blockCount + groupSize - 1) / groupSize;
+	for (unsigned g = 0; g <= groupCount; ++g)
+	{
+		//blocks to read
+		unsigned readCount = (g < groupCount ? std::min(groupSize, blockCount - g * groupSize) : 0);
+		std::vector<BlockBuffer>& readBuffers = buffers[g & 1];
+		//blocks to decompress
+		unsigned firstBlock = (g != 0 ? (g - 1) * groupSize : 0);
+		unsigned decompressCount = (g != 0 ? std::min(groupSize, blockCount - firstBlock) : 0);
+		std::vector<BlockBuffer>& decompressBuffers = buffers[(g + 1) & 1];
+
+		CCLib::ParallelTools::IndexedTask task = [&](unsigned i)
+		{
+			int blockError = NO_BLOCK_ERROR;
+			if (i == decompressCount)
+			{
+				//read the next group
+				for (unsigned j = 0; j < readCount && blockError == NO_BLOCK_ERROR; ++j)
+				{
+					blockError = ReadBlock(in, maxStoredSize, readBuffers[j]);
+				}
+			}
+			else
+			{
+				blockError = DecompressBlock(layout, firstBlock + i, typeSize, decompressBuffers[i], receiver);
+			}
+
+			if (blockError != NO_BLOCK_ERROR)
+			{
+				error = blockError;
+				cancelToken.cancel();
+			}
+		};
+
+		//one more task (and thread) for the file I/O
+		CCLib::ParallelTools::ForEach(decompressCount + 1, task, static_cast<int>(groupSize) + 1, &cancelToken, 1);
+
+		if (error != NO_BLOCK_ERROR)
+			return BlockErrorToLog(error);
+	}
+
+	return true;
+}
+
+bool ccSerializationHelper::CompressedDataFromFile(const MemorySegments& segments, QFile& in)
+{
+	return CompressedBlocksFromFile(&segments, 0, 0, in);
+}
+
+bool ccSerializationHelper::CompressedDataFromFile(qint64 totalSize, const BlockReceiver& receiver, QFile& in)
+{
+	return CompressedBlocksFromFile(0, totalSize, &receiver, in);
+}
@@ -19,6 +19,7 @@
 #define CC_SERIALIZABLE_OBJECT_HEADER
 
 //Local
+#include "qCC_db.h"
 #include "ccLog.h"
 
 //CCLib
@@ -26,7 +27,9 @@
 #include <CCTypes.h>
 
 //System
+#include <functional>
 #include <stdint.h>
+#include <vector>
 
 //Qt
 #include <QFile>
@@ -91,7 +94,7 @@ public:
 };
 
 //! Serialization helpers
-class ccSerializationHelper
+class QCC_DB_LIB_API ccSerializationHelper
 {
 public:
 
@@ -163,40 +166,12 @@ public:
 		if (out.write((const char*)&elementCount, 4) < 0)
 			return ccSerializableObject::WriteError();
 
-		//array data (dataVersion>=20)
-		{
-#ifdef CC_ENV_64
-			//DGM: do it by chunks, in case it's too big to be processed by the system
-			const char* _data = (const char*)chunkArray.data();
-			qint64 byteCount = static_cast<qint64>(elementCount);
-			byteCount *= N * sizeof(ElementType);
-			while (byteCount != 0)
-			{
-				static const qint64 s_maxByteSaveCount = (1 << 26); //64 Mb each time
-				qint64 saveCount = std::min(byteCount, s_maxByteSaveCount);
-				if (out.write(_data, saveCount) < 0)
-					return ccSerializableObject::WriteError();
-				_data += saveCount;
-				byteCount -= saveCount;
-			}
-#else
-			//--> we write each chunk as a block (faster)
-			while (elementCount != 0)
-			{
-				unsigned chunksCount = chunkArray.chunksCount();
-				for (unsigned i=0; i<chunksCount; ++i)
-				{
-					//DGM: since dataVersion>=22, we make sure to write as much items as declared in 'currentSize'!
-					unsigned toWrite = std::min<unsigned>(elementCount,chunkArray.chunkSize(i));
-					if (out.write((const char*)chunkArray.chunkStartPtr(i),sizeof(ElementType)*N*toWrite) < 0)
-						return ccSerializableObject::WriteError();
-					assert(toWrite <= elementCount);
-					elementCount -= toWrite;
-				}
-			}
-#endif //CC_ENV_64
-		}
-		return true;
+		//array data (compressed blocks since dataVersion>=49)
+		MemorySegments segments;
+		if (!GetMemorySegments(chunkArray, segments))
+			return ccSerializableObject::MemoryError();
+
+		return CompressedDataToFile(segments, N * sizeof(ElementType), out);
 	}
 
 	//! Helper: loads a GenericChunkedArray structure from file
@@ -220,7 +195,16 @@ public:
 			if (!chunkArray.resize(elementCount))
 				return ccSerializableObject::MemoryError();
 
-			//array data (dataVersion>=20)
+			if (dataVersion >= 49)
+			{
+				//array data (compressed blocks)
+				MemorySegments segments;
+				if (!GetMemorySegments(chunkArray, segments))
+					return ccSerializableObject::MemoryError();
+				if (!CompressedDataFromFile(segments, in))
+					return false;
+			}
+			else //array data (dataVersion>=20)
 			{
 #ifdef CC_ENV_64
 				//Apparently Qt and/or Windows don't like to read too many bytes in a row...
@@ -272,6 +256,44 @@ public:
 			if (!chunkArray.resize(elementCount))
 				return ccSerializableObject::MemoryError();
 
+			if (dataVersion >= 49)
+			{
+				//array data (compressed blocks)
+				//--> we convert the values of each block as soon as it is decompressed
+				const qint64 totalSize = static_cast<qint64>(elementCount) * N * sizeof(FileElementType);
+				BlockReceiver converter = [&chunkArray](qint64 offset, const char* data, size_t size)
+				{
+					//the blocks contain a whole number of values
+					assert((offset % sizeof(FileElementType)) == 0 && (size % sizeof(FileElementType)) == 0);
+					qint64 valueIndex = offset / static_cast<qint64>(sizeof(FileElementType));
+					size_t valueCount = size / sizeof(FileElementType);
+#ifdef CC_ENV_64
+					ElementType* dest = chunkArray.data() + valueIndex;
+					for (size_t k = 0; k < valueCount; ++k, data += sizeof(FileElementType))
+					{
+						FileElementType value;
+						memcpy(&value, data, sizeof(FileElementType));
+						*dest++ = static_cast<ElementType>(value);
+					}
+#else
+					for (size_t k = 0; k < valueCount; ++k, ++valueIndex, data += sizeof(FileElementType))
+					{
+						unsigned elementIndex = static_cast<unsigned>(valueIndex / N);
+						ElementType* chunkStart = chunkArray.chunkStartPtr(elementIndex >> CHUNK_INDEX_BIT_DEC);
+						FileElementType value;
+						memcpy(&value, data, sizeof(FileElementType));
+						chunkStart[(elementIndex & ELEMENT_INDEX_BIT_MASK) * N + static_cast<unsigned>(valueIndex % N)] = static_cast<ElementType>(value);
+					}
+#endif //CC_ENV_64
+				};
+				if (!CompressedDataFromFile(totalSize, converter, in))
+					return false;
+
+				//update array boundaries
+				chunkArray.computeMinAndMax();
+				return true;
+			}
+
 			//array data (dataVersion>=20)
 			//--> saldy we can't read it as a block...
 			//we must convert each element, value by value!
@@ -318,8 +340,92 @@ public:
 		return true;
 	}
 
+	//! Contiguous part of an array in memory
+	struct MemorySegment
+	{
+		char* data;
+		qint64 size;
+	};
+	//! Memory layout of an array
+	typedef std::vector<MemorySegment> MemorySegments;
+
+	//! Receives the decompressed blocks (see CompressedDataFromFile)
+	/** May be called by several threads at the same time (for different blocks).
+		\param offset position of the block in the data (in bytes)
+		\param data block data
+		\param size block size (in bytes)
+	**/
+	typedef std::function<void(qint64 offset, const char* data, size_t size)> BlockReceiver;
+
 protected:
 
+	//! Returns the memory layout of the 'currentSize' first elements of a GenericChunkedArray structure
+	/** Contiguous chunks are merged.
+		\return false if not enough memory
+	**/
+	template <int N, class ElementType> static bool GetMemorySegments(const GenericChunkedArray<N, ElementType>& chunkArray, MemorySegments& segments)
+	{
+		segments.clear();
+
+		try
+		{
+			unsigned remainingCount = chunkArray.currentSize();
+			unsigned chunksCount = chunkArray.chunksCount();
+			for (unsigned i = 0; i < chunksCount && remainingCount != 0; ++i)
+			{
+				unsigned count = std::min(remainingCount, chunkArray.chunkSize(i));
+				char* data = reinterpret_cast<char*>(const_cast<ElementType*>(chunkArray.chunkStartPtr(i)));
+				qint64 size = static_cast<qint64>(count) * N * sizeof(ElementType);
+				if (!segments.empty() && segments.back().data + segments.back().size == data)
+				{
+					segments.back().size += size;
+				}
+				else
+				{
+					MemorySegment segment;
+					segment.data = data;
+					segment.size = size;
+					segments.push_back(segment);
+				}
+				remainingCount -= count;
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	//! Writes data as independently compressed blocks (dataVersion>=49)
+	/** Blocks are compressed in parallel while the previous ones are written
+		(small data is simply compressed and written by the calling thread).
+		\param segments memory layout of the data to save
+		\param typeSize size of each array element (in bytes) - used to shuffle the bytes before compression
+		\param out output file (must be already opened)
+		\return success
+	**/
+	static bool CompressedDataToFile(const MemorySegments& segments, size_t typeSize, QFile& out);
+
+	//! Reads data saved as independently compressed blocks (dataVersion>=49)
+	/** Blocks are decompressed in parallel while the next ones are read
+		(small data is simply read and decompressed by the calling thread).
+		\param segments memory layout of the data to load (the total size must match the saved data size)
+		\param in input file (must be already opened)
+		\return success
+	**/
+	static bool CompressedDataFromFile(const MemorySegments& segments, QFile& in);
+
+	//! Reads data saved as independently compressed blocks (dataVersion>=49) and forwards each decompressed block
+	/** Same as the above version, but the data is never stored as a whole.
+		\param totalSize size of the data to load (must match the saved data size)
+		\param receiver called once for each decompressed block
+		\param in input file (must be already opened)
+		\return success
+	**/
+	static bool CompressedDataFromFile(qint64 totalSize, const BlockReceiver& receiver, QFile& in);
+
 	static bool ReadArrayHeader(QFile& in,
 								short dataVersion,
 								::uint8_t &componentCount,
@@ -25,6 +25,7 @@
 
 //CClib
 #include <ScalarField.h>
+#include <ParallelTools.h>
 
 //qCC_db
 #include <ccPointCloud.h>
@@ -35,6 +36,8 @@
 //System
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 
 //declaration of static members
 AutoDeletePtr<AsciiSaveDlg> AsciiFilter::s_saveDialog(0);
@@ -675,15 +678,16 @@ cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequen
 	return cloudDesc;
 }
 
-CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filename,
-															ccHObject& container,
-															const AsciiOpenDlg::Sequence& openSequence,
-															char separator,
-															unsigned approximateNumberOfLines,
-															qint64 fileSize,
-															unsigned maxCloudSize,
-															unsigned skipLines,
-															LoadParameters& parameters)
+//! Line by line loader (legacy engine, used when the file can't be mapped in memory)
+static CC_FILE_ERROR LoadCloudLineByLine(	const QString& filename,
+											ccHObject& container,
+											const AsciiOpenDlg::Sequence& openSequence,
+											char separator,
+											unsigned approximateNumberOfLines,
+											qint64 fileSize,
+											unsigned maxCloudSize,
+											unsigned skipLines,
+											FileIOFilter::LoadParameters& parameters)
 {
 	//we may have to "slice" clouds when opening them if they are too big!
 	maxCloudSize = std::min(maxCloudSize, CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
@@ -877,7 +881,7 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 				//first point: check for 'big' coordinates
 				if (pointsRead == 0)
 				{
-					if (HandleGlobalShift(P, Pshift, parameters))
+					if (FileIOFilter::HandleGlobalShift(P, Pshift, parameters))
 					{
 						cloudDesc.cloud->setGlobalShift(Pshift);
 						ccLog::Warning("[ASCIIFilter::loadFile] Cloud has been recentered! Translation: (%.2f ; %.2f ; %.2f)", Pshift.x, Pshift.y, Pshift.z);
@@ -1001,3 +1005,677 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 
 	return result;
 }
+
+//! Powers of ten that are exactly representable as doubles
+static const double s_exactPowersOf10[] = {	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+											1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+//! Removes the leading and trailing blank characters of a token
+static inline void TrimToken(const char*& begin, const char*& end)
+{
+	while (begin < end && (*begin == ' ' || *begin == '\t'))
+		++begin;
+	while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+		--end;
+}
+
+//! Locale-free conversion of a token to a double value
+/** Equivalent to QString::toDouble: the whole token must be a valid number.
+	The common case (up to 19 significant digits and a small exponent) is
+	handled without any allocation and is exactly rounded. The other cases
+	are delegated to QByteArray::toDouble (which uses the 'C' locale as well).
+**/
+static bool ParseDouble(const char* begin, const char* end, double& value)
+{
+	TrimToken(begin, end);
+	if (begin == end)
+		return false;
+
+	const char* p = begin;
+	bool negative = false;
+	if (*p == '-' || *p == '+')
+	{
+		negative = (*p == '-');
+		++p;
+	}
+
+	uint64_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool hasDigits = false;
+	bool truncated = false;
+
+	//integer part
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+	{
+		hasDigits = true;
+		unsigned digit = static_cast<unsigned>(*p - '0');
+		if (mantissa == 0 && digit == 0)
+			continue;
+		if (significantDigits < 19)
+		{
+			mantissa = mantissa * 10 + digit;
+			++significantDigits;
+		}
+		else
+		{
+			++exponent;
+			truncated = true;
+		}
+	}
+
+	//decimal part
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+		{
+			hasDigits = true;
+			unsigned digit = static_cast<unsigned>(*p - '0');
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + digit;
+				if (mantissa != 0)
+					++significantDigits;
+				--exponent;
+			}
+			else
+			{
+				truncated = true;
+			}
+		}
+	}
+
+	if (hasDigits)
+	{
+		//exponent
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			bool negativeExp = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExp = (*p == '-');
+				++p;
+			}
+			if (p == end || *p < '0' || *p > '9')
+				return false;
+			int expValue = 0;
+			for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			{
+				if (expValue < 100000)
+					expValue = expValue * 10 + (*p - '0');
+			}
+			exponent += (negativeExp ? -expValue : expValue);
+		}
+
+		if (p != end)
+			return false;
+
+		//fast path
+		static const uint64_t c_maxExactMantissa = (static_cast<uint64_t>(1) << 53);
+		if (!truncated && mantissa <= c_maxExactMantissa && exponent >= -22 && exponent <= 22)
+		{
+			double v = static_cast<double>(mantissa);
+			if (exponent < 0)
+				v /= s_exactPowersOf10[-exponent];
+			else
+				v *= s_exactPowersOf10[exponent];
+			value = (negative ? -v : v);
+			return true;
+		}
+	}
+
+	//slow path (long numbers, 'nan', 'inf', etc.)
+	bool ok = false;
+	value = QByteArray(begin, static_cast<int>(end - begin)).toDouble(&ok);
+	return ok;
+}
+
+//! Locale-free conversion of a token to an integer value (equivalent to QString::toInt)
+static int ParseInt(const char* begin, const char* end)
+{
+	TrimToken(begin, end);
+	if (begin == end)
+		return 0;
+
+	bool negative = false;
+	if (*begin == '-' || *begin == '+')
+	{
+		negative = (*begin == '-');
+		++begin;
+	}
+	if (begin == end)
+		return 0;
+
+	int64_t value = 0;
+	for (const char* p = begin; p < end; ++p)
+	{
+		if (*p < '0' || *p > '9')
+			return 0;
+		value = value * 10 + (*p - '0');
+		if (value > static_cast<int64_t>(INT_MAX) + 1)
+			return 0;
+	}
+	if (negative)
+		value = -value;
+
+	return (value >= INT_MIN && value <= INT_MAX ? static_cast<int>(value) : 0);
+}
+
+//! Locale-free conversion of a token to a float value (equivalent to QString::toFloat)
+static inline float ParseFloat(const char* begin, const char* end)
+{
+	double value = 0;
+	return ParseDouble(begin, end, value) ? static_cast<float>(value) : 0.0f;
+}
+
+//! Block of lines parsed by the multi-threaded ASCII loader
+struct AsciiParsedBlock
+{
+	//! Corrupted line
+	struct CorruptedLine
+	{
+		//! Line index (inside the block, starting at 1)
+		unsigned lineIndex;
+		//! Number of parts found (or one of the values below)
+		int nParts;
+	};
+	static const int EMPTY_LINE = -1;
+	static const int NON_NUMERICAL_VALUE = -2;
+
+	//! Beginning of the block (in the mapped file)
+	const char* begin;
+	//! End of the block (excluded)
+	const char* end;
+	//! Number of lines in the block
+	unsigned lineCount;
+	//! Whether memory was missing to store the block values
+	bool notEnoughMemory;
+
+	//! Points (not shifted yet)
+	std::vector<CCVector3d> points;
+	//! Normals (if any)
+	std::vector<CCVector3> normals;
+	//! Colors (if any)
+	std::vector<ccColor::Rgb> colors;
+	//! Scalar values (interleaved, one per scalar field and per point)
+	std::vector<ScalarType> scalars;
+	//! Corrupted lines
+	std::vector<CorruptedLine> corruptedLines;
+
+	AsciiParsedBlock()
+		: begin(0)
+		, end(0)
+		, lineCount(0)
+		, notEnoughMemory(false)
+	{}
+};
+
+//! Parses a block of lines (thread-safe)
+static void ParseBlock(	AsciiParsedBlock& block,
+						const cloudAttributesDescriptor& cloudDesc,
+						int maxPartIndex,
+						char separator)
+{
+	const size_t sfCount = cloudDesc.scalarIndexes.size();
+	const bool hasColors = (cloudDesc.hasRGBColors || cloudDesc.greyIndex >= 0);
+
+	//the token boundaries of the current line
+	std::vector<const char*> tokens;
+
+	try
+	{
+		tokens.reserve(2 * (std::max(maxPartIndex, 0) + 1));
+
+		const char* lineStart = block.begin;
+		while (lineStart < block.end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(lineStart, '\n', block.end - lineStart));
+			const char* next = (lineEnd ? lineEnd + 1 : block.end);
+			if (!lineEnd)
+				lineEnd = block.end;
+			if (lineEnd > lineStart && lineEnd[-1] == '\r')
+				--lineEnd;
+
+			++block.lineCount;
+
+			//comment
+			if (lineEnd - lineStart >= 2 && lineStart[0] == '/' && lineStart[1] == '/')
+			{
+				lineStart = next;
+				continue;
+			}
+
+			if (lineEnd == lineStart)
+			{
+				AsciiParsedBlock::CorruptedLine cl = { block.lineCount, AsciiParsedBlock::EMPTY_LINE };
+				block.corruptedLines.push_back(cl);
+				lineStart = next;
+				continue;
+			}
+
+			//we split current line (empty parts are skipped)
+			tokens.clear();
+			for (const char* c = lineStart; c < lineEnd; )
+			{
+				const char* tokenEnd = static_cast<const char*>(memchr(c, separator, lineEnd - c));
+				if (!tokenEnd)
+					tokenEnd = lineEnd;
+				if (tokenEnd != c)
+				{
+					tokens.push_back(c);
+					tokens.push_back(tokenEnd);
+				}
+				c = tokenEnd + 1;
+			}
+			int nParts = static_cast<int>(tokens.size() / 2);
+
+			if (nParts <= maxPartIndex)
+			{
+				AsciiParsedBlock::CorruptedLine cl = { block.lineCount, nParts };
+				block.corruptedLines.push_back(cl);
+				lineStart = next;
+				continue;
+			}
+
+			//read the point coordinates
+			CCVector3d P(0, 0, 0);
+			if (	(cloudDesc.xCoordIndex >= 0 && !ParseDouble(tokens[2 * cloudDesc.xCoordIndex], tokens[2 * cloudDesc.xCoordIndex + 1], P.x))
+				||	(cloudDesc.yCoordIndex >= 0 && !ParseDouble(tokens[2 * cloudDesc.yCoordIndex], tokens[2 * cloudDesc.yCoordIndex + 1], P.y))
+				||	(cloudDesc.zCoordIndex >= 0 && !ParseDouble(tokens[2 * cloudDesc.zCoordIndex], tokens[2 * cloudDesc.zCoordIndex + 1], P.z)) )
+			{
+				AsciiParsedBlock::CorruptedLine cl = { block.lineCount, AsciiParsedBlock::NON_NUMERICAL_VALUE };
+				block.corruptedLines.push_back(cl);
+				lineStart = next;
+				continue;
+			}
+			block.points.push_back(P);
+
+			//Normal vector
+			if (cloudDesc.hasNorms)
+			{
+				CCVector3 N(0, 0, 0);
+				if (cloudDesc.xNormIndex >= 0)
+					N.x = static_cast<PointCoordinateType>(ParseFloat(tokens[2 * cloudDesc.xNormIndex], tokens[2 * cloudDesc.xNormIndex + 1]));
+				if (cloudDesc.yNormIndex >= 0)
+					N.y = static_cast<PointCoordinateType>(ParseFloat(tokens[2 * cloudDesc.yNormIndex], tokens[2 * cloudDesc.yNormIndex + 1]));
+				if (cloudDesc.zNormIndex >= 0)
+					N.z = static_cast<PointCoordinateType>(ParseFloat(tokens[2 * cloudDesc.zNormIndex], tokens[2 * cloudDesc.zNormIndex + 1]));
+				block.normals.push_back(N);
+			}
+
+			//Colors
+			if (hasColors)
+			{
+				ccColor::Rgb col;
+				if (cloudDesc.hasRGBColors)
+				{
+					if (cloudDesc.iRgbaIndex >= 0)
+					{
+						const uint32_t rgb = static_cast<uint32_t>(ParseInt(tokens[2 * cloudDesc.iRgbaIndex], tokens[2 * cloudDesc.iRgbaIndex + 1]));
+						col.r = ((rgb >> 16) & 0x0000ff);
+						col.g = ((rgb >> 8) & 0x0000ff);
+						col.b = ((rgb) & 0x0000ff);
+					}
+					else if (cloudDesc.fRgbaIndex >= 0)
+					{
+						const float rgbf = ParseFloat(tokens[2 * cloudDesc.fRgbaIndex], tokens[2 * cloudDesc.fRgbaIndex + 1]);
+						uint32_t rgb = 0;
+						memcpy(&rgb, &rgbf, sizeof(uint32_t));
+						col.r = ((rgb >> 16) & 0x0000ff);
+						col.g = ((rgb >> 8) & 0x0000ff);
+						col.b = ((rgb) & 0x0000ff);
+					}
+					else
+					{
+						if (cloudDesc.redIndex >= 0)
+						{
+							float multiplier = cloudDesc.hasFloatRGBColors[0] ? static_cast<float>(ccColor::MAX) : 1.0f;
+							col.r = static_cast<ColorCompType>(ParseFloat(tokens[2 * cloudDesc.redIndex], tokens[2 * cloudDesc.redIndex + 1]) * multiplier);
+						}
+						if (cloudDesc.greenIndex >= 0)
+						{
+							float multiplier = cloudDesc.hasFloatRGBColors[1] ? static_cast<float>(ccColor::MAX) : 1.0f;
+							col.g = static_cast<ColorCompType>(ParseFloat(tokens[2 * cloudDesc.greenIndex], tokens[2 * cloudDesc.greenIndex + 1]) * multiplier);
+						}
+						if (cloudDesc.blueIndex >= 0)
+						{
+							float multiplier = cloudDesc.hasFloatRGBColors[2] ? static_cast<float>(ccColor::MAX) : 1.0f;
+							col.b = static_cast<ColorCompType>(ParseFloat(tokens[2 * cloudDesc.blueIndex], tokens[2 * cloudDesc.blueIndex + 1]) * multiplier);
+						}
+					}
+				}
+				else //grey level
+				{
+					col.r = col.g = col.b = static_cast<ColorCompType>(ParseInt(tokens[2 * cloudDesc.greyIndex], tokens[2 * cloudDesc.greyIndex + 1]));
+				}
+				block.colors.push_back(col);
+			}
+
+			//Scalar values
+			for (size_t j = 0; j < sfCount; ++j)
+			{
+				double d = 0;
+				ParseDouble(tokens[2 * cloudDesc.scalarIndexes[j]], tokens[2 * cloudDesc.scalarIndexes[j] + 1], d);
+				block.scalars.push_back(static_cast<ScalarType>(d));
+			}
+
+			lineStart = next;
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		block.notEnoughMemory = true;
+	}
+}
+
+//! Finalizes a cloud filled by the multi-threaded loader and adds it to the output container
+static void StoreCloud(cloudAttributesDescriptor& cloudDesc, ccHObject& container)
+{
+	if (cloudDesc.cloud->size() < cloudDesc.cloud->capacity())
+		cloudDesc.cloud->resize(cloudDesc.cloud->size());
+
+	if (!cloudDesc.scalarFields.empty())
+	{
+		for (size_t j = 0; j < cloudDesc.scalarFields.size(); ++j)
+			cloudDesc.scalarFields[j]->computeMinAndMax();
+		cloudDesc.cloud->setCurrentDisplayedScalarField(0);
+		cloudDesc.cloud->showSF(true);
+	}
+
+	container.addChild(cloudDesc.cloud);
+	cloudDesc.reset();
+}
+
+//! Multi-threaded loader
+/** The file is memory-mapped and processed by 'waves' of newline-aligned blocks.
+	The blocks of a wave are parsed in parallel (each thread fills its own block
+	buffers) then concatenated in order, so that the resulting clouds are the same
+	as with the line by line loader.
+	\param[out] unsupported whether the file can't be handled by this engine
+**/
+static CC_FILE_ERROR LoadCloudByBlocks(	const QString& filename,
+										ccHObject& container,
+										const AsciiOpenDlg::Sequence& openSequence,
+										char separator,
+										unsigned approximateNumberOfLines,
+										unsigned maxCloudSize,
+										unsigned skipLines,
+										FileIOFilter::LoadParameters& parameters,
+										bool& unsupported)
+{
+	unsupported = false;
+
+	//size of the blocks processed by each thread
+	static const qint64 c_blockSize = (qint64(4) << 20); //4 Mb
+
+	QFile file(filename);
+	if (!file.open(QFile::ReadOnly))
+		return CC_FERR_READING;
+
+	//UTF-16 files must be decoded first
+	QByteArray bom = file.peek(3);
+	if (	bom.startsWith("\xFF\xFE")
+		||	bom.startsWith("\xFE\xFF"))
+	{
+		unsupported = true;
+		return CC_FERR_NO_ERROR;
+	}
+	if (bom.startsWith("\xEF\xBB\xBF")) //UTF-8 BOM
+	{
+		file.seek(3);
+	}
+
+	//we skip lines as defined on input
+	for (unsigned i = 0; i < skipLines; ++i)
+	{
+		file.readLine();
+	}
+
+	//we may have to "slice" clouds when opening them if they are too big!
+	maxCloudSize = std::min(maxCloudSize, CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
+	unsigned chunkRank = 1;
+
+	//we initialize the loading accelerator structure and point cloud
+	int maxPartIndex = -1;
+	cloudAttributesDescriptor cloudDesc = prepareCloud(openSequence, std::min(maxCloudSize, approximateNumberOfLines), maxPartIndex, separator, chunkRank);
+	if (!cloudDesc.cloud)
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+
+	//progress indicator
+	QScopedPointer<ccProgressDialog> pDlg(0);
+	if (parameters.parentWidget)
+	{
+		pDlg.reset(new ccProgressDialog(true, parameters.parentWidget));
+		pDlg->setMethodTitle(QObject::tr("Open ASCII file [%1]").arg(filename));
+		pDlg->setInfo(QObject::tr("Approximate number of points: %1").arg(approximateNumberOfLines));
+		pDlg->start();
+	}
+
+	const int threadCount = CCLib::ParallelTools::DefaultMaxThreadCount();
+	qint64 waveSize = c_blockSize * 2 * threadCount;
+	const qint64 fileSize = file.size();
+	const qint64 startPos = file.pos();
+	qint64 pos = startPos;
+
+	CCVector3d Pshift(0, 0, 0);
+	unsigned linesRead = 0;
+	unsigned pointsRead = 0;
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+
+	std::vector<AsciiParsedBlock> blocks;
+	while (pos < fileSize)
+	{
+		qint64 mappedSize = std::min(waveSize, fileSize - pos);
+		const char* data = reinterpret_cast<const char*>(file.map(pos, mappedSize));
+		if (!data)
+		{
+			if (pos == startPos)
+			{
+				//nothing has been loaded yet: the line by line loader will take over
+				clearStructure(cloudDesc);
+				unsupported = true;
+			}
+			else
+			{
+				result = CC_FERR_READING;
+			}
+			break;
+		}
+
+		//the wave must end with a complete line
+		qint64 waveLength = mappedSize;
+		if (pos + mappedSize < fileSize)
+		{
+			waveLength = 0;
+			for (qint64 i = mappedSize; i > 0; --i)
+			{
+				if (data[i - 1] == '\n')
+				{
+					waveLength = i;
+					break;
+				}
+			}
+			if (waveLength == 0)
+			{
+				//very long line: we retry with a bigger window
+				file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+				waveSize *= 2;
+				continue;
+			}
+		}
+
+		//split the wave in newline-aligned blocks
+		blocks.clear();
+		try
+		{
+			const char* waveEnd = data + waveLength;
+			for (const char* blockStart = data; blockStart < waveEnd; )
+			{
+				const char* blockEnd = waveEnd;
+				if (waveEnd - blockStart > c_blockSize)
+				{
+					const char* nl = static_cast<const char*>(memchr(blockStart + c_blockSize, '\n', waveEnd - (blockStart + c_blockSize)));
+					if (nl)
+						blockEnd = nl + 1;
+				}
+
+				AsciiParsedBlock block;
+				block.begin = blockStart;
+				block.end = blockEnd;
+				blocks.push_back(block);
+
+				blockStart = blockEnd;
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+			result = CC_FERR_NOT_ENOUGH_MEMORY;
+			break;
+		}
+
+		//parse the blocks in parallel
+		CCLib::ParallelTools::ForEach(	static_cast<unsigned>(blocks.size()),
+										[&](unsigned index) { ParseBlock(blocks[index], cloudDesc, maxPartIndex, separator); },
+										threadCount,
+										0,
+										1);
+
+		file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+		pos += waveLength;
+
+		//concatenate the blocks (in order)
+		for (size_t b = 0; b < blocks.size() && result == CC_FERR_NO_ERROR; ++b)
+		{
+			AsciiParsedBlock& block = blocks[b];
+			if (block.notEnoughMemory)
+			{
+				ccLog::Error("Not enough memory! Process stopped ...");
+				result = CC_FERR_NOT_ENOUGH_MEMORY;
+				break;
+			}
+
+			//report the corrupted lines
+			for (size_t k = 0; k < block.corruptedLines.size(); ++k)
+			{
+				const AsciiParsedBlock::CorruptedLine& cl = block.corruptedLines[k];
+				unsigned lineNumber = linesRead + cl.lineIndex;
+				if (cl.nParts == AsciiParsedBlock::EMPTY_LINE)
+					ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (empty)!", lineNumber);
+				else if (cl.nParts == AsciiParsedBlock::NON_NUMERICAL_VALUE)
+					ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (non numerical value found)", lineNumber);
+				else
+					ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (found %i part(s) on %i expected)!", lineNumber, cl.nParts, maxPartIndex + 1);
+			}
+			linesRead += block.lineCount;
+
+			const unsigned blockPointCount = static_cast<unsigned>(block.points.size());
+			const size_t sfCount = cloudDesc.scalarFields.size();
+			for (unsigned i = 0; i < blockPointCount; )
+			{
+				//first point: check for 'big' coordinates
+				if (pointsRead == 0)
+				{
+					if (FileIOFilter::HandleGlobalShift(block.points[0], Pshift, parameters))
+					{
+						cloudDesc.cloud->setGlobalShift(Pshift);
+						ccLog::Warning("[ASCIIFilter::loadFile] Cloud has been recentered! Translation: (%.2f ; %.2f ; %.2f)", Pshift.x, Pshift.y, Pshift.z);
+					}
+				}
+
+				//if we have reached the max. number of points per cloud
+				if (cloudDesc.cloud->size() == maxCloudSize)
+				{
+					ccLog::PrintDebug("[ASCII] Point %i -> end of chunk (%i points)", pointsRead, maxCloudSize);
+					StoreCloud(cloudDesc, container);
+
+					//we estimate the number of remaining points
+					double averageLineSize = static_cast<double>(pos) / (linesRead + skipLines);
+					unsigned remainingPoints = static_cast<unsigned>(std::min(static_cast<double>(maxCloudSize), std::max(1.0, static_cast<double>(fileSize - pos) / averageLineSize)));
+					cloudDesc = prepareCloud(openSequence, std::max(remainingPoints, blockPointCount - i), maxPartIndex, separator, ++chunkRank);
+					if (!cloudDesc.cloud)
+					{
+						ccLog::Error("Not enough memory! Process stopped ...");
+						result = CC_FERR_NOT_ENOUGH_MEMORY;
+						break;
+					}
+					cloudDesc.cloud->setGlobalShift(Pshift);
+				}
+
+				ccPointCloud* cloud = cloudDesc.cloud;
+				unsigned count = std::min(blockPointCount - i, maxCloudSize - cloud->size());
+				if (cloud->capacity() < cloud->size() + count)
+				{
+					//geometric growth (to limit reallocations)
+					unsigned newCapacity = std::min(maxCloudSize, std::max(cloud->size() + count, cloud->capacity() + cloud->capacity() / 2));
+					if (!cloud->reserve(newCapacity))
+					{
+						ccLog::Error("Not enough memory! Process stopped ...");
+						result = CC_FERR_NOT_ENOUGH_MEMORY;
+						break;
+					}
+				}
+
+				for (unsigned j = i; j < i + count; ++j)
+				{
+					cloud->addPoint(CCVector3::fromArray((block.points[j] + Pshift).u));
+					if (!block.normals.empty())
+						cloud->addNorm(block.normals[j]);
+					if (!block.colors.empty())
+						cloud->addRGBColor(block.colors[j].rgb);
+					for (size_t k = 0; k < sfCount; ++k)
+						cloudDesc.scalarFields[k]->addElement(block.scalars[j * sfCount + k]);
+				}
+
+				i += count;
+				pointsRead += count;
+			}
+
+			//release the block memory as soon as possible
+			block = AsciiParsedBlock();
+		}
+
+		if (result != CC_FERR_NO_ERROR)
+			break;
+
+		if (pDlg)
+		{
+			pDlg->update(static_cast<float>(100.0 * pos / fileSize));
+			if (pDlg->isCancelRequested())
+			{
+				result = CC_FERR_CANCELED_BY_USER;
+				break;
+			}
+		}
+	}
+
+	file.close();
+
+	if (cloudDesc.cloud)
+	{
+		StoreCloud(cloudDesc, container);
+	}
+
+	return result;
+}
+
+CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filename,
+															ccHObject& container,
+															const AsciiOpenDlg::Sequence& openSequence,
+															char separator,
+															unsigned approximateNumberOfLines,
+															qint64 fileSize,
+															unsigned maxCloudSize,
+															unsigned skipLines,
+															LoadParameters& parameters)
+{
+	bool unsupported = false;
+	CC_FILE_ERROR result = LoadCloudByBlocks(filename, container, openSequence, separator, approximateNumberOfLines, maxCloudSize, skipLines, parameters, unsupported);
+	if (!unsupported)
+		return result;
+
+	ccLog::PrintDebug("[ASCII] File can't be mapped in memory: we switch to the line by line loader");
+	return LoadCloudLineByLine(filename, container, openSequence, separator, approximateNumberOfLines, fileSize, maxCloudSize, skipLines, parameters);
+}
@@ -504,9 +504,6 @@ CC_FILE_ERROR BinFilter::LoadFileV2(QFile& in, ccHObject& container, int flags)
 	QString scalarFormat = ((flags & ccSerializableObject::DF_SCALAR_VAL_32_BITS) ? "float" : "double");
 	ccLog::Print(QString("[BIN] Version %1.%2 (coords: %3 / scalar: %4)").arg(binVersion / 10).arg(binVersion % 10).arg(coordsFormat).arg(scalarFormat));
 
-	//we keep track of the last unique ID before load
-	unsigned lastUniqueIDBeforeLoad = ccObject::GetLastUniqueID();
-
 	//we read first entity type
 	CC_CLASS_ENUM classID = ccObject::ReadClassIDFromFile(in, static_cast<short>(binVersion));
 	if (classID == CC_TYPES::OBJECT)
@@ -975,9 +972,9 @@ CC_FILE_ERROR BinFilter::LoadFileV2(QFile& in, ccHObject& container, int flags)
 	}
 
 	//check for unique IDs duplicate (yes it happens :-( )
+	unsigned maxUniqueID = root->findMaxUniqueID_recursive();
 	{
 		std::unordered_set<unsigned> uniqueIDs;
-		unsigned maxUniqueID = root->findMaxUniqueID_recursive();
 		assert(toCheck.empty());
 		toCheck.push_back(root);
 		while (!toCheck.empty())
@@ -1007,6 +1004,9 @@ CC_FILE_ERROR BinFilter::LoadFileV2(QFile& in, ccHObject& container, int flags)
 	}
 
 	//update 'unique IDs'
+	//DGM: the whole range is reserved at once, as other entities may be created at the same time
+	//(by other threads) and their IDs must not collide with the loaded ones
+	unsigned lastUniqueIDBeforeLoad = ccObject::ReserveUniqueIDs(maxUniqueID);
 	toCheck.push_back(root);
 	while (!toCheck.empty())
 	{
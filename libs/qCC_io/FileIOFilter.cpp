@@ -169,6 +169,38 @@ void FileIOFilter::UnregisterAll()
 	s_ioFilters.clear();
 }
 
+bool FileIOFilter::PointFilter::checkValidity(QString& error) const
+{
+	if (useBox)
+	{
+		for (unsigned char d = 0; d < 3; ++d)
+		{
+			if (boxMin.u[d] > boxMax.u[d])
+			{
+				error = QString("invalid filtering box (min %1 is greater than max)").arg(QChar('X' + d));
+				return false;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < classes.size(); ++i)
+	{
+		if (classes[i] > MAX_CLASS_VALUE)
+		{
+			error = QString("invalid classification value: %1 (should be between 0 and %2)").arg(static_cast<unsigned>(classes[i])).arg(MAX_CLASS_VALUE);
+			return false;
+		}
+	}
+
+	if (decimationStep == 0)
+	{
+		error = "invalid decimation step (should be greater than 0)";
+		return false;
+	}
+
+	return true;
+}
+
 FileIOFilter::Shared FileIOFilter::GetFilter(QString fileFilter, bool onImport)
 {
 	if (!fileFilter.isEmpty())
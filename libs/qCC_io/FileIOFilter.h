@@ -59,6 +59,45 @@ public: //initialization
 	//! Destructor
 	virtual ~FileIOFilter() {}
 
+	//! Filter applied on the fly to the points being loaded
+	/** Only honoured by the filters able to stream their points (LAS).
+		Rejected points are skipped as soon as they are decoded, so that
+		they are never stored in memory.
+	**/
+	struct PointFilter
+	{
+		//! Default constructor (inactive filter)
+		PointFilter()
+			: useBox(false)
+			, boxMin(0, 0, 0)
+			, boxMax(0, 0, 0)
+			, decimationStep(1)
+		{}
+
+		//! Max classification value (LAS classes are coded on 5 bits)
+		static const unsigned MAX_CLASS_VALUE = 31;
+
+		//! Returns whether the filter rejects some points
+		inline bool isActive() const { return useBox || !classes.empty() || decimationStep > 1; }
+
+		//! Checks the filter parameters
+		/** \param error error message (if the parameters are invalid)
+			\return whether the parameters are valid
+		**/
+		bool checkValidity(QString& error) const;
+
+		//! Whether to only keep the points inside the box [boxMin ; boxMax]
+		bool useBox;
+		//! Box min corner (original coordinates, i.e. before any global shift)
+		CCVector3d boxMin;
+		//! Box max corner (original coordinates, i.e. before any global shift)
+		CCVector3d boxMax;
+		//! Classification values to keep (empty = all)
+		std::vector<unsigned char> classes;
+		//! Decimation step (only one point out of 'decimationStep' is kept, after the other tests)
+		unsigned decimationStep;
+	};
+
 	//! Generic loading parameters
 	struct LoadParameters
 	{
@@ -84,6 +123,8 @@ public: //initialization
 		bool autoComputeNormals;
 		//! Parent widget (if any)
 		QWidget* parentWidget;
+		//! Points filter (if supported by the I/O filter)
+		PointFilter pointFilter;
 	};
 
 	//! Generic saving parameters
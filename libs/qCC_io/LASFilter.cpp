@@ -514,6 +514,9 @@ CC_FILE_ERROR LASFilter::saveToFile(ccHObject* entity, QString filename, SavePar
 
 QSharedPointer<LASOpenDlg> s_lasOpenDlg(0);
 
+//! Memory reservation step when the points are filtered on the fly
+static const unsigned c_filteredReserveStep = (1 << 20);
+
 //! LAS 1.4 EVLR record
 struct EVLR
 {
@@ -849,6 +852,49 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 			}
 		}
 
+		//points filter (applied while the points are decoded)
+		const PointFilter& pointFilter = parameters.pointFilter;
+		bool filterPoints = pointFilter.isActive();
+		bool filterByBox = pointFilter.useBox;
+		bool filterByClass = !pointFilter.classes.empty();
+		bool acceptedClasses[256];
+		unsigned candidateCount = 0;
+		unsigned keptCount = 0;
+		if (filterPoints)
+		{
+			QString filterError;
+			if (!pointFilter.checkValidity(filterError))
+			{
+				ccLog::Warning(QString("[LAS] Points filter: %1").arg(filterError));
+				ifs.close();
+				return CC_FERR_BAD_ARGUMENT;
+			}
+
+			if (filterByBox)
+			{
+				if (	pointFilter.boxMin.x > bbMax.x || pointFilter.boxMax.x < bbMin.x
+					||	pointFilter.boxMin.y > bbMax.y || pointFilter.boxMax.y < bbMin.y
+					||	pointFilter.boxMin.z > bbMax.z || pointFilter.boxMax.z < bbMin.z)
+				{
+					ccLog::Warning("[LAS] The filtering box doesn't intersect the file bounding-box");
+					ifs.close();
+					return CC_FERR_NO_LOAD;
+				}
+				//no need to test the points if the file is entirely inside the box
+				if (	pointFilter.boxMin.x <= bbMin.x && pointFilter.boxMax.x >= bbMax.x
+					&&	pointFilter.boxMin.y <= bbMin.y && pointFilter.boxMax.y >= bbMax.y
+					&&	pointFilter.boxMin.z <= bbMin.z && pointFilter.boxMax.z >= bbMax.z)
+				{
+					filterByBox = false;
+				}
+			}
+
+			for (unsigned i = 0; i < 256; ++i)
+				acceptedClasses[i] = !filterByClass;
+			for (size_t i = 0; i < pointFilter.classes.size(); ++i)
+				acceptedClasses[pointFilter.classes[i]] = true;
+		}
+
 		//RGB color
 		liblas::Color rgbColorMask; //(0,0,0) on construction
 		if (s_lasOpenDlg->doLoad(LAS_RED))
@@ -901,6 +947,31 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 				break;
 			}
 
+			//points filter
+			if (filterPoints && newPointAvailable)
+			{
+				const liblas::Point& p = reader.GetPoint();
+				if (filterByBox)
+				{
+					double x = p.GetX(), y = p.GetY(), z = p.GetZ();
+					if (	x < pointFilter.boxMin.x || x > pointFilter.boxMax.x
+						||	y < pointFilter.boxMin.y || y > pointFilter.boxMax.y
+						||	z < pointFilter.boxMin.z || z > pointFilter.boxMax.z)
+					{
+						continue;
+					}
+				}
+				if (filterByClass && !acceptedClasses[p.GetClassification().GetClass()])
+				{
+					continue;
+				}
+				if ((candidateCount++ % pointFilter.decimationStep) != 0)
+				{
+					continue;
+				}
+				++keptCount;
+			}
+
 			//special operation: tiling mode
 			if (tiling)
 			{
@@ -1015,7 +1086,8 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 				fileChunkPos = pointsRead;
 				fileChunkSize = std::min(nbOfPoints - pointsRead, CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
 				loadedCloud = new ccPointCloud();
-				if (!loadedCloud->reserveThePointsTable(fileChunkSize))
+				//when points are filtered, the final size is unknown: we reserve the memory progressively
+				if (!loadedCloud->reserveThePointsTable(filterPoints ? std::min(fileChunkSize, c_filteredReserveStep) : fileChunkSize))
 				{
 					ccLog::Warning("[LAS] Not enough memory!");
 					delete loadedCloud;
@@ -1149,6 +1221,26 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 			assert(newPointAvailable);
 			const liblas::Point& p = reader.GetPoint();
 
+			//enlarge the cloud if necessary (filtered mode only)
+			if (loadedCloud->size() == loadedCloud->capacity())
+			{
+				assert(filterPoints);
+				unsigned newCapacity = std::min(fileChunkSize, loadedCloud->capacity() * 2);
+				bool success = loadedCloud->reserve(newCapacity);
+				for (size_t i = 0; i < fieldsToLoad.size() && success; ++i)
+				{
+					if (fieldsToLoad[i]->sf)
+						success = fieldsToLoad[i]->sf->reserve(newCapacity);
+				}
+				if (!success)
+				{
+					ccLog::Warning("[LAS] Not enough memory!");
+					delete loadedCloud;
+					ifs.close();
+					return CC_FERR_NOT_ENOUGH_MEMORY;
+				}
+			}
+
 			//first point: check for 'big' coordinates
 			if (pointsRead == 0)
 			{
@@ -1376,7 +1468,7 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 						||	(field->firstValue != field->defaultValue && field->firstValue >= field->minValue))
 					{
 						field->sf = new ccScalarField(qPrintable(field->getName()));
-						if (field->sf->reserve(fileChunkSize))
+						if (field->sf->reserve(loadedCloud->capacity()))
 						{
 							field->sf->link();
 
@@ -1412,6 +1504,11 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 			++pointsRead;
 		}
 
+		if (filterPoints)
+		{
+			ccLog::Print(QString("[LAS] Points filter: %1 point(s) kept").arg(keptCount));
+		}
+
 		if (tiling)
 		{
 			size_t tileCount = tiler.tileCount();
@@ -249,7 +249,7 @@ int FastMarchingForFacetExtraction::step()
 							float t_new = computeT(nIndex);
 
 							if (t_new < t_old)
-								nCell->T = t_new;
+								updateTrialCell(nIndex, t_new);
 						}
 					}
 				}
@@ -447,10 +447,10 @@ void FastMarchingForFacetExtraction::initTrialCells()
 			if (nCell/* && nCell->state == PlanarCell::FAR_CELL*/)
 			{
 				assert(nCell->state == PlanarCell::FAR_CELL);
-				addTrialCell(nIndex);
-
 				//compute its approximate arrival time
 				nCell->T = seedCell->T + m_neighboursDistance[i] * computeTCoefApprox(seedCell,nCell);
+
+				addTrialCell(nIndex);
 			}
 		}
 	}
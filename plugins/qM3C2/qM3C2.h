@@ -51,6 +51,7 @@ public:
 	//inherited from ccStdPluginInterface
 	void onNewSelection(const ccHObject::Container& selectedEntities);
 	virtual void getActions(QActionGroup& group);
+	virtual void registerCommands(ccCommandLineInterface* cmd) override;
 
 protected slots:
 
@@ -0,0 +1,385 @@
+//##########################################################################
+//#                                                                        #
+//#                       CLOUDCOMPARE PLUGIN: qM3C2                       #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#            COPYRIGHT: UNIVERSITE EUROPEENNE DE BRETAGNE                #
+//#                                                                        #
+//##########################################################################
+
+#ifndef Q_M3C2_COMMANDS_HEADER
+#define Q_M3C2_COMMANDS_HEADER
+
+#include "../ccCommandLineInterface.h"
+
+//Local
+#include "qM3C2Process.h"
+
+//qCC_db
+#include <ccPointCloud.h>
+#include <ccProgressDialog.h>
+
+//Qt
+#include <QScopedPointer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+//System
+#include <random>
+
+static const char COMMAND_M3C2[] = "M3C2";
+static const char COMMAND_M3C2_BENCHMARK[] = "BENCHMARK"; //+ point count (optional)
+
+//! Returns the scalar field with a given name (case insensitive) or null if none
+/** Only exact matches are accepted (e.g. 'sx' but not 'my sx notes'), as the
+	user has no way to check the selected fields in command line mode.
+**/
+static CCLib::ScalarField* FindPMScalarField(ccPointCloud* cloud, const QString& name)
+{
+	for (unsigned i = 0; i < cloud->getNumberOfScalarFields(); ++i)
+	{
+		if (QString(cloud->getScalarFieldName(i)).compare(name, Qt::CaseInsensitive) == 0)
+		{
+			return cloud->getScalarField(static_cast<int>(i));
+		}
+	}
+	return 0;
+}
+
+//! M3C2 distances computation (-M3C2 {parameter file})
+/** The first two loaded clouds are compared. If a third cloud is loaded, it is
+	used as core points. The parameter file is the one saved from the M3C2 dialog.
+	The output cloud is added to the loaded clouds.
+
+	'-M3C2 -BENCHMARK {point count}' runs a benchmark on a synthetic dataset instead.
+**/
+struct CommandM3C2 : public ccCommandLineInterface::Command
+{
+	CommandM3C2() : ccCommandLineInterface::Command("M3C2", COMMAND_M3C2) {}
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		cmd.print("[M3C2]");
+		if (!cmd.arguments().empty() && ccCommandLineInterface::IsCommand(cmd.arguments().front(), COMMAND_M3C2_BENCHMARK))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			return benchmark(cmd);
+		}
+
+		if (cmd.arguments().empty())
+		{
+			return cmd.error(QString("Missing parameter: parameter file after \"-%1\"").arg(COMMAND_M3C2));
+		}
+
+		//load the parameters
+		QString paramFilename(cmd.arguments().takeFirst());
+		qM3C2Process::Parameters params;
+		QString errorMessage;
+		if (!qM3C2Process::LoadParameters(paramFilename, params, errorMessage))
+		{
+			return cmd.error(QString("Failed to load parameter file '%1': %2").arg(paramFilename, errorMessage));
+		}
+		cmd.print(QString("Parameter file: '%1'").arg(paramFilename));
+
+		if (cmd.clouds().size() < 2)
+		{
+			return cmd.error(QString("At least two clouds must be loaded before \"-%1\" (cloud #1 and cloud #2, then optionally the core points)").arg(COMMAND_M3C2));
+		}
+
+		ccPointCloud* cloud1 = cmd.clouds()[0].pc;
+		ccPointCloud* cloud2 = cmd.clouds()[1].pc;
+		ccPointCloud* corePoints = (cmd.clouds().size() > 2 ? cmd.clouds()[2].pc : 0);
+		assert(cloud1 && cloud2);
+
+		//precision maps
+		if (params.usePrecisionMaps)
+		{
+			params.cloud1PM.sX = FindPMScalarField(cloud1, "sx");
+			params.cloud1PM.sY = FindPMScalarField(cloud1, "sy");
+			params.cloud1PM.sZ = FindPMScalarField(cloud1, "sz");
+			params.cloud2PM.sX = FindPMScalarField(cloud2, "sx");
+			params.cloud2PM.sY = FindPMScalarField(cloud2, "sy");
+			params.cloud2PM.sZ = FindPMScalarField(cloud2, "sz");
+			if (!params.cloud1PM.valid() || !params.cloud2PM.valid())
+			{
+				return cmd.error("Precision maps require scalar fields named exactly 'sx', 'sy' and 'sz' on both clouds");
+			}
+		}
+
+		if (params.normalMode == qM3C2Normals::USE_CLOUD1_NORMALS && !cloud1->hasNormals())
+		{
+			return cmd.error("Cloud #1 has no normals");
+		}
+
+		QScopedPointer<ccProgressDialog> progressDialog(0);
+		if (!cmd.silentMode())
+		{
+			progressDialog.reset(new ccProgressDialog(true, cmd.widgetParent()));
+			progressDialog->setAutoClose(false);
+		}
+
+		qM3C2Process process(params);
+		qM3C2Process::Output output;
+		bool success = process.compute(cloud1, cloud2, corePoints, 0, output, progressDialog.data(), errorMessage);
+
+		if (progressDialog)
+		{
+			progressDialog->close();
+			QCoreApplication::processEvents();
+		}
+
+		if (!success)
+		{
+			delete output.subsampledCorePoints;
+			return cmd.error(errorMessage);
+		}
+
+		//the output cloud is either a new cloud, the sub-sampled core points or one of the loaded clouds
+		if (output.subsampledCorePoints && output.subsampledCorePoints != output.cloud)
+		{
+			delete output.subsampledCorePoints;
+			output.subsampledCorePoints = 0;
+		}
+
+		int outputIndex = -1;
+		for (size_t i = 0; i < cmd.clouds().size(); ++i)
+		{
+			if (cmd.clouds()[i].pc == output.cloud)
+			{
+				outputIndex = static_cast<int>(i);
+				break;
+			}
+		}
+
+		if (outputIndex < 0)
+		{
+			CLCloudDesc cloudDesc(output.cloud, cmd.clouds()[0].basename, cmd.clouds()[0].path, cmd.clouds()[0].indexInFile);
+			if (cmd.autoSaveMode())
+			{
+				QString errorStr = cmd.exportEntity(cloudDesc, "M3C2");
+				if (!errorStr.isEmpty())
+				{
+					delete output.cloud;
+					return cmd.error(errorStr);
+				}
+			}
+			cloudDesc.basename += QString("_M3C2");
+			cmd.clouds().push_back(cloudDesc);
+		}
+		else if (cmd.autoSaveMode())
+		{
+			//the scalar fields have been added to one of the loaded clouds
+			QString errorStr = cmd.exportEntity(cmd.clouds()[outputIndex], "M3C2");
+			if (!errorStr.isEmpty())
+			{
+				return cmd.error(errorStr);
+			}
+		}
+
+		return true;
+	}
+
+	//! Synthetic terrain (gently undulating) with some noise
+	static ccPointCloud* GenerateTerrain(unsigned pointCount, PointCoordinateType side, PointCoordinateType zShift, std::mt19937& gen)
+	{
+		ccPointCloud* cloud = new ccPointCloud();
+		if (!cloud->reserve(pointCount))
+		{
+			delete cloud;
+			return 0;
+		}
+
+		std::uniform_real_distribution<PointCoordinateType> pos(0, side);
+		std::uniform_real_distribution<PointCoordinateType> noise(-0.01f, 0.01f);
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			PointCoordinateType x = pos(gen);
+			PointCoordinateType y = pos(gen);
+			cloud->addPoint(CCVector3(x, y, 2 * sin(x / 10) * cos(y / 10) + zShift + noise(gen)));
+		}
+
+		return cloud;
+	}
+
+	//! Regular grid of core points lying on the synthetic terrain
+	static ccPointCloud* GenerateCorePoints(PointCoordinateType side, PointCoordinateType step)
+	{
+		unsigned count = static_cast<unsigned>(side / step);
+		ccPointCloud* cloud = new ccPointCloud();
+		if (!cloud->reserve(count * count))
+		{
+			delete cloud;
+			return 0;
+		}
+
+		for (unsigned j = 0; j < count; ++j)
+		{
+			for (unsigned i = 0; i < count; ++i)
+			{
+				PointCoordinateType x = (i + 0.5f) * step;
+				PointCoordinateType y = (j + 0.5f) * step;
+				cloud->addPoint(CCVector3(x, y, 2 * sin(x / 10) * cos(y / 10)));
+			}
+		}
+
+		return cloud;
+	}
+
+	//! Benchmark: compares two synthetic clouds (the second one being 5 cm above the first one)
+	bool benchmark(ccCommandLineInterface& cmd)
+	{
+		unsigned pointCount = 1000000; //1M points per cloud by default
+
+		//optional point count
+		if (!cmd.arguments().empty())
+		{
+			bool ok = false;
+			unsigned count = cmd.arguments().front().toUInt(&ok);
+			if (ok)
+			{
+				cmd.arguments().pop_front();
+				if (count == 0)
+					return cmd.error(QString("Invalid point count after '-%1'").arg(COMMAND_M3C2_BENCHMARK));
+				pointCount = count;
+			}
+		}
+
+		static const PointCoordinateType ZShift = 0.05f;
+		static const unsigned RunCount = 4; //one by one, batched by cell, then 2 concurrent comparisons
+
+		cmd.print(QString("[M3C2][Benchmark] Generating two clouds of %1 points").arg(pointCount));
+
+		//~100 points per m2
+		PointCoordinateType side = static_cast<PointCoordinateType>(sqrt(pointCount / 100.0));
+		std::mt19937 gen(0);
+		QScopedPointer<ccPointCloud> cloud1(GenerateTerrain(pointCount, side, 0, gen));
+		QScopedPointer<ccPointCloud> cloud2(GenerateTerrain(pointCount, side, ZShift, gen));
+		if (!cloud1 || !cloud2)
+			return cmd.error("Not enough memory");
+
+		//the octrees are computed beforehand, so that the concurrent comparisons share them
+		if (!cloud1->computeOctree() || !cloud2->computeOctree())
+			return cmd.error("Failed to compute the octrees (not enough memory?)");
+
+		qM3C2Process::Parameters params;
+		params.normalMode = qM3C2Normals::DEFAULT_MODE;
+		params.normalScale = 1.0;
+		params.projectionScale = 1.0;
+		params.projectionDepth = 1.0;
+
+		//each run has its own core points (as they are modified by the process)
+		std::vector<ccPointCloud*> corePoints(RunCount, 0);
+		std::vector<qM3C2Process::Output> outputs(RunCount);
+		std::vector<QString> errorMessages(RunCount);
+		std::vector<char> success(RunCount, 0); //not std::vector<bool> (written concurrently)
+		auto releaseRuns = [&]()
+		{
+			for (unsigned r = 0; r < RunCount; ++r)
+			{
+				if (outputs[r].cloud != corePoints[r])
+					delete outputs[r].cloud;
+				delete corePoints[r];
+			}
+		};
+		for (unsigned r = 0; r < RunCount; ++r)
+		{
+			corePoints[r] = GenerateCorePoints(side, 0.5f);
+			if (!corePoints[r])
+			{
+				releaseRuns();
+				return cmd.error("Not enough memory");
+			}
+		}
+
+		auto run = [&](unsigned r, bool batchByCell, int maxThreadCount)
+		{
+			qM3C2Process::Parameters runParams = params;
+			runParams.batchByCell = batchByCell;
+			runParams.maxThreadCount = maxThreadCount;
+			qM3C2Process process(runParams);
+			success[r] = process.compute(cloud1.data(), cloud2.data(), corePoints[r], 0, outputs[r], 0, errorMessages[r]);
+		};
+
+		QElapsedTimer timer;
+		qint64 times_ms[3] = { 0, 0, 0 };
+
+		//core points one by one
+		timer.start();
+		run(0, false, 0);
+		times_ms[0] = timer.elapsed();
+
+		//core points batched by cell
+		timer.start();
+		run(1, true, 0);
+		times_ms[1] = timer.elapsed();
+
+		//2 comparisons at once (sharing the cores)
+		int halfThreadCount = std::max(1, CCLib::ParallelTools::DefaultMaxThreadCount() / 2);
+		timer.start();
+		CCLib::ParallelTools::ForEach(2, [&](unsigned i) { run(2 + i, true, halfThreadCount); }, 2, 0, 1);
+		times_ms[2] = timer.elapsed();
+
+		for (unsigned r = 0; r < RunCount; ++r)
+		{
+			if (!success[r])
+			{
+				QString errorMessage = errorMessages[r];
+				releaseRuns();
+				return cmd.error(QString("[M3C2][Benchmark] Run #%1 failed: %2").arg(r + 1).arg(errorMessage));
+			}
+		}
+
+		//all the runs should give exactly the same distances
+		const CCLib::ScalarField* refDistances = outputs[0].cloud->getScalarField(outputs[0].cloud->getScalarFieldIndexByName("M3C2 distance"));
+		unsigned coreCount = corePoints[0]->size();
+		bool identical = (refDistances != 0 && refDistances->currentSize() == coreCount);
+		for (unsigned r = 1; identical && r < RunCount; ++r)
+		{
+			const CCLib::ScalarField* distances = outputs[r].cloud->getScalarField(outputs[r].cloud->getScalarFieldIndexByName("M3C2 distance"));
+			identical = (distances != 0 && distances->currentSize() == coreCount);
+			for (unsigned i = 0; identical && i < coreCount; ++i)
+			{
+				ScalarType d = distances->getValue(i);
+				ScalarType refD = refDistances->getValue(i);
+				identical = (d == refD || (!CCLib::ScalarField::ValidValue(d) && !CCLib::ScalarField::ValidValue(refD))); //NaN = no distance
+			}
+		}
+
+		//average distance (should be close to the shift between both clouds)
+		double sum = 0;
+		unsigned validCount = 0;
+		for (unsigned i = 0; refDistances && i < coreCount; ++i)
+		{
+			ScalarType d = refDistances->getValue(i);
+			if (CCLib::ScalarField::ValidValue(d))
+			{
+				sum += d;
+				++validCount;
+			}
+		}
+
+		releaseRuns();
+
+		if (!identical)
+			return cmd.error("[M3C2][Benchmark] The runs don't give the same distances!");
+
+		cmd.print(QString("[M3C2][Benchmark] %1 core points (%2 with a distance) - average distance: %3 (shift: %4)").arg(coreCount).arg(validCount).arg(validCount ? sum / validCount : 0, 0, 'f', 4).arg(ZShift));
+		cmd.print(QString("[M3C2][Benchmark] One by one: %1 ms").arg(times_ms[0]));
+		cmd.print(QString("[M3C2][Benchmark] Batched by cell: %1 ms").arg(times_ms[1]));
+		cmd.print(QString("[M3C2][Benchmark] 2 concurrent comparisons: %1 ms (%2 thread(s) each)").arg(times_ms[2]).arg(halfThreadCount));
+
+		return true;
+	}
+};
+
+#endif //Q_M3C2_COMMANDS_HEADER
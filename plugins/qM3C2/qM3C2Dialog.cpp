@@ -328,22 +328,22 @@ qM3C2Dialog::ExportOptions qM3C2Dialog::getExportOption() const
 	switch (projDestComboBox->currentIndex())
 	{
 	case 0:
-		return PROJECT_ON_CLOUD1;
+		return qM3C2Process::PROJECT_ON_CLOUD1;
 	case 1:
-		return PROJECT_ON_CLOUD2;
+		return qM3C2Process::PROJECT_ON_CLOUD2;
 	case 2:
-		return PROJECT_ON_CORE_POINTS;
+		return qM3C2Process::PROJECT_ON_CORE_POINTS;
 	default:
 		assert(false);
 		break;
 	}
 
-	return PROJECT_ON_CORE_POINTS;
+	return qM3C2Process::PROJECT_ON_CORE_POINTS;
 }
 
 void qM3C2Dialog::projDestIndexChanged(int index)
 {
-	useOriginalCloudCheckBox->setEnabled(getExportOption() == PROJECT_ON_CORE_POINTS);
+	useOriginalCloudCheckBox->setEnabled(getExportOption() == qM3C2Process::PROJECT_ON_CORE_POINTS);
 }
 
 bool qM3C2Dialog::keepOriginalCloud() const
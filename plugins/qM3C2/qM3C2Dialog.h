@@ -22,6 +22,7 @@
 
 //Local
 #include <qM3C2Tools.h>
+#include <qM3C2Process.h>
 
 //Qt
 #include <QSettings>
@@ -61,10 +62,7 @@ public:
 	unsigned getMinPointsForStats(unsigned defaultValue = 5) const;
 
 	//! Exportation options
-	enum ExportOptions {	PROJECT_ON_CLOUD1,
-							PROJECT_ON_CLOUD2,
-							PROJECT_ON_CORE_POINTS,
-	};
+	typedef qM3C2Process::ExportOptions ExportOptions;
 
 	//! Returns selected export option
 	ExportOptions getExportOption() const;
@@ -0,0 +1,1124 @@
+//##########################################################################
+//#                                                                        #
+//#                       CLOUDCOMPARE PLUGIN: qM3C2                       #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#            COPYRIGHT: UNIVERSITE EUROPEENNE DE BRETAGNE                #
+//#                                                                        #
+//##########################################################################
+
+#include "qM3C2Process.h"
+
+//CCLib
+#include <CloudSamplingTools.h>
+
+//qCC_db
+#include <ccPointCloud.h>
+#include <ccNormalVectors.h>
+#include <ccScalarField.h>
+#include <ccLog.h>
+
+//Qt
+#include <QSettings>
+#include <QFileInfo>
+#include <QElapsedTimer>
+
+//system
+#include <algorithm>
+
+//! Default name for M3C2 scalar fields
+static const char M3C2_DIST_SF_NAME[]			= "M3C2 distance";
+static const char DIST_UNCERTAINTY_SF_NAME[]	= "distance uncertainty";
+static const char SIG_CHANGE_SF_NAME[]			= "significant change";
+static const char STD_DEV_CLOUD1_SF_NAME[]		= "%1_cloud1";
+static const char STD_DEV_CLOUD2_SF_NAME[]		= "%1_cloud2";
+static const char DENSITY_CLOUD1_SF_NAME[]		= "Npoints_cloud1";
+static const char DENSITY_CLOUD2_SF_NAME[]		= "Npoints_cloud2";
+static const char NORMAL_SCALE_SF_NAME[]		= "normal scale";
+
+static const ScalarType SCALAR_ZERO = 0;
+static const ScalarType SCALAR_ONE = 1;
+
+static void RemoveScalarField(ccPointCloud* cloud, const char sfName[])
+{
+	int sfIdx = cloud ? cloud->getScalarFieldIndexByName(sfName) : -1;
+	if (sfIdx >= 0)
+	{
+		cloud->deleteScalarField(sfIdx);
+	}
+}
+
+// Computes the uncertainty based on 'precision maps' (as scattered scalar fields)
+static double ComputePMUncertainty(CCLib::DgmOctree::NeighboursSet& set, const CCVector3& N, const qM3C2Process::PrecisionMaps& PM)
+{
+	size_t count = set.size();
+	if (count == 0)
+	{
+		assert(false);
+		return 0;
+	}
+	
+	int minIndex = -1;
+	if (count == 1)
+	{
+		minIndex = 0;
+	}
+	else
+	{
+		//compute gravity center
+		CCVector3d G(0, 0, 0);
+		for (size_t i = 0; i < count; ++i)
+		{
+			G.x += set[i].point->x;
+			G.y += set[i].point->y;
+			G.z += set[i].point->z;
+		}
+
+		G.x /= count;
+		G.y /= count;
+		G.z /= count;
+
+		//now look for the point that is the closest to the gravity center
+		double minSquareDist = -1.0;
+		minIndex = -1;
+		for (size_t i = 0; i < count; ++i)
+		{
+			CCVector3d dG(	G.x - set[i].point->x,
+							G.y - set[i].point->y,
+							G.z - set[i].point->z );
+			double squareDist = dG.norm2();
+			if (minIndex < 0 || squareDist < minSquareDist)
+			{
+				minSquareDist = squareDist;
+				minIndex = static_cast<int>(i);
+			}
+		}
+	}
+	
+	assert(minIndex >= 0);
+	unsigned pointIndex = set[minIndex].pointIndex;
+	CCVector3d sigma(	PM.sX->getValue(pointIndex) * PM.scale,
+						PM.sY->getValue(pointIndex) * PM.scale,
+						PM.sZ->getValue(pointIndex) * PM.scale);
+
+	CCVector3d NS(	N.x * sigma.x,
+					N.y * sigma.y,
+					N.z * sigma.z);
+	
+	return NS.norm();
+}
+
+qM3C2Process::Parameters::Parameters()
+	: normalMode(qM3C2Normals::DEFAULT_MODE)
+	, normalScale(0)
+	, normalMinScale(0)
+	, normalStep(0)
+	, normalMaxScale(0)
+	, normalUseCorePoints(false)
+	, normalPreferredOrientation(ccNormalVectors::PLUS_Z)
+	, subsamplingDistance(0)
+	, projectionScale(0)
+	, projectionDepth(0)
+	, registrationRms(0)
+	, useMedian(false)
+	, progressiveSearch(true)
+	, onlyPositiveSearch(false)
+	, minPoints4Stats(5)
+	, exportOption(PROJECT_ON_CORE_POINTS)
+	, keepOriginalCloud(false)
+	, exportStdDevInfo(false)
+	, exportDensityAtProjScale(false)
+	, usePrecisionMaps(false)
+	, maxThreadCount(0)
+	, batchByCell(true)
+{
+}
+
+bool qM3C2Process::LoadParameters(const QString& filename, Parameters& params, QString& errorMessage)
+{
+	if (!QFileInfo(filename).exists())
+	{
+		errorMessage = QString("File '%1' doesn't exist").arg(filename);
+		return false;
+	}
+
+	QSettings settings(filename, QSettings::IniFormat);
+	//check validity
+	if (!settings.contains("M3C2VER"))
+	{
+		errorMessage = "File doesn't seem to be a valid M3C2 parameters file ('M3C2VER' not found)";
+		return false;
+	}
+
+	//same keys as qM3C2Dialog::saveParamsTo
+	int normModeInt = settings.value("NormalMode", static_cast<int>(params.normalMode)).toInt();
+	if (normModeInt < qM3C2Normals::DEFAULT_MODE || normModeInt > qM3C2Normals::HORIZ_MODE)
+	{
+		errorMessage = QString("Invalid normal mode (%1)").arg(normModeInt);
+		return false;
+	}
+	params.normalMode = static_cast<qM3C2Normals::ComputationMode>(normModeInt);
+	params.normalScale = settings.value("NormalScale", params.normalScale).toDouble();
+	params.normalMinScale = settings.value("NormalMinScale", params.normalMinScale).toDouble();
+	params.normalStep = settings.value("NormalStep", params.normalStep).toDouble();
+	params.normalMaxScale = settings.value("NormalMaxScale", params.normalMaxScale).toDouble();
+	params.normalUseCorePoints = settings.value("NormalUseCorePoints", params.normalUseCorePoints).toBool();
+	params.normalPreferredOrientation = settings.value("NormalPreferedOri", params.normalPreferredOrientation).toInt();
+
+	params.projectionScale = settings.value("SearchScale", params.projectionScale).toDouble();
+	params.projectionDepth = settings.value("SearchDepth", params.projectionDepth).toDouble();
+
+	bool subsampleEnabled = settings.value("SubsampleEnabled", params.subsamplingDistance > 0).toBool();
+	params.subsamplingDistance = subsampleEnabled ? settings.value("SubsampleRadius", params.subsamplingDistance).toDouble() : 0.0;
+
+	bool registrationErrorEnabled = settings.value("RegistrationErrorEnabled", params.registrationRms > 0).toBool();
+	params.registrationRms = registrationErrorEnabled ? settings.value("RegistrationError", params.registrationRms).toDouble() : 0.0;
+
+	params.progressiveSearch = !settings.value("UseSinglePass4Depth", !params.progressiveSearch).toBool();
+	params.onlyPositiveSearch = settings.value("PositiveSearchOnly", params.onlyPositiveSearch).toBool();
+	params.useMedian = settings.value("UseMedian", params.useMedian).toBool();
+
+	if (settings.value("UseMinPoints4Stat", true).toBool())
+	{
+		params.minPoints4Stats = settings.value("MinPoints4Stat", params.minPoints4Stats).toUInt();
+	}
+
+	int projDestIndex = settings.value("ProjDestIndex", static_cast<int>(params.exportOption)).toInt();
+	if (projDestIndex < PROJECT_ON_CLOUD1 || projDestIndex > PROJECT_ON_CORE_POINTS)
+	{
+		errorMessage = QString("Invalid projection destination (%1)").arg(projDestIndex);
+		return false;
+	}
+	params.exportOption = static_cast<ExportOptions>(projDestIndex);
+	params.keepOriginalCloud = (params.exportOption == PROJECT_ON_CORE_POINTS && settings.value("UseOriginalCloud", params.keepOriginalCloud).toBool());
+
+	params.exportStdDevInfo = settings.value("ExportStdDevInfo", params.exportStdDevInfo).toBool();
+	params.exportDensityAtProjScale = settings.value("ExportDensityAtProjScale", params.exportDensityAtProjScale).toBool();
+
+	params.maxThreadCount = settings.value("MaxThreadCount", params.maxThreadCount).toInt();
+
+	params.usePrecisionMaps = settings.value("UsePrecisionMaps", params.usePrecisionMaps).toBool();
+	params.cloud1PM.scale = settings.value("PM1Scale", params.cloud1PM.scale).toDouble();
+	params.cloud2PM.scale = settings.value("PM2Scale", params.cloud2PM.scale).toDouble();
+
+	return true;
+}
+
+qM3C2Process::Job::Job()
+	: outputCloud(0)
+	, corePoints(0)
+	, coreNormals(0)
+	, projectionRadius(0)
+	, projectionDepth(0)
+	, updateNormal(false)
+	, exportNormal(false)
+	, computeConfidence(false)
+	, level1(0)
+	, level2(0)
+	, normalScaleSF(0)
+	, m3c2DistSF(0)
+	, distUncertaintySF(0)
+	, sigChangeSF(0)
+	, stdDevCloud1SF(0)
+	, stdDevCloud2SF(0)
+	, densityCloud1SF(0)
+	, densityCloud2SF(0)
+	, nProgress(0)
+{
+}
+
+qM3C2Process::qM3C2Process(const Parameters& params)
+	: m_params(params)
+{
+}
+
+qM3C2Process::~qM3C2Process()
+{
+	releaseJob();
+}
+
+void qM3C2Process::releaseJob()
+{
+	if (m_job.normalScaleSF)
+		m_job.normalScaleSF->release();
+	if (m_job.coreNormals)
+		m_job.coreNormals->release();
+	if (m_job.m3c2DistSF)
+		m_job.m3c2DistSF->release();
+	if (m_job.sigChangeSF)
+		m_job.sigChangeSF->release();
+	if (m_job.distUncertaintySF)
+		m_job.distUncertaintySF->release();
+	if (m_job.stdDevCloud1SF)
+		m_job.stdDevCloud1SF->release();
+	if (m_job.stdDevCloud2SF)
+		m_job.stdDevCloud2SF->release();
+	if (m_job.densityCloud1SF)
+		m_job.densityCloud1SF->release();
+	if (m_job.densityCloud2SF)
+		m_job.densityCloud2SF->release();
+
+	m_job = Job();
+}
+
+void qM3C2Process::computeDistForPoint(unsigned index)
+{
+	if (m_cancelToken.isCanceled())
+		return;
+
+	ScalarType dist = NAN_VALUE;
+
+	//get core point #i
+	CCVector3 P;
+	m_job.corePoints->getPoint(index, P);
+
+	//get core point's normal #i
+	CCVector3 N(0, 0, 1);
+	if (m_job.updateNormal) //i.e. all cases but the VERTICAL mode
+	{
+		N = ccNormalVectors::GetNormal(m_job.coreNormals->getValue(index));
+	}
+
+	//output point
+	CCVector3 outputP = P;
+
+	//compute M3C2 distance
+	{
+		double mean1 = 0, stdDev1 = 0;
+		bool validStats1 = false;
+
+		//extract cloud #1's neighbourhood
+		CCLib::DgmOctree::ProgressiveCylindricalNeighbourhood cn1;
+		cn1.center = P;
+		cn1.dir = N;
+		cn1.level = m_job.level1;
+		cn1.maxHalfLength = m_job.projectionDepth;
+		cn1.radius = m_job.projectionRadius;
+		cn1.onlyPositiveDir = m_params.onlyPositiveSearch;
+
+		if (m_params.progressiveSearch)
+		{
+			//progressive search
+			size_t previousNeighbourCount = 0;
+			while (cn1.currentHalfLength < cn1.maxHalfLength)
+			{
+				size_t neighbourCount = m_job.cloud1Octree->getPointsInCylindricalNeighbourhoodProgressive(cn1);
+				if (neighbourCount != previousNeighbourCount)
+				{
+					//do we have enough points for computing stats?
+					if (neighbourCount >= m_params.minPoints4Stats)
+					{
+						qM3C2Tools::ComputeStatistics(cn1.neighbours, m_params.useMedian, mean1, stdDev1);
+						validStats1 = true;
+						//do we have a sharp enough 'mean' to stop?
+						if (fabs(mean1) + 2 * stdDev1 < static_cast<double>(cn1.currentHalfLength))
+							break;
+					}
+					previousNeighbourCount = neighbourCount;
+				}
+			}
+		}
+		else
+		{
+			m_job.cloud1Octree->getPointsInCylindricalNeighbourhood(cn1);
+		}
+		
+		size_t n1 = cn1.neighbours.size();
+		if (n1 != 0)
+		{
+			//compute stat. dispersion on cloud #1 neighbours (if necessary)
+			if (!validStats1)
+			{
+				qM3C2Tools::ComputeStatistics(cn1.neighbours, m_params.useMedian, mean1, stdDev1);
+			}
+
+			if (m_params.usePrecisionMaps && (m_job.computeConfidence || m_job.stdDevCloud1SF))
+			{
+				//compute the Precision Maps derived sigma
+				stdDev1 = ComputePMUncertainty(cn1.neighbours, N, m_params.cloud1PM);
+			}
+
+			if (m_params.exportOption == PROJECT_ON_CLOUD1)
+			{
+				//shift output point on the 1st cloud
+				outputP += static_cast<PointCoordinateType>(mean1) * N;
+			}
+
+			//save cloud #1's std. dev.
+			if (m_job.stdDevCloud1SF)
+			{
+				ScalarType val = static_cast<ScalarType>(stdDev1);
+				m_job.stdDevCloud1SF->setValue(index, val);
+			}
+		}
+
+		//save cloud #1's density
+		if (m_job.densityCloud1SF)
+		{
+			ScalarType val = static_cast<ScalarType>(n1);
+			m_job.densityCloud1SF->setValue(index, val);
+		}
+
+		//now we can process cloud #2
+		if (	n1 != 0
+			||	m_params.exportOption == PROJECT_ON_CLOUD2
+			||	m_job.stdDevCloud2SF
+			||	m_job.densityCloud2SF
+			)
+		{
+			double mean2 = 0, stdDev2 = 0;
+			bool validStats2 = false;
+			
+			//extract cloud #2's neighbourhood
+			CCLib::DgmOctree::ProgressiveCylindricalNeighbourhood cn2;
+			cn2.center = P;
+			cn2.dir = N;
+			cn2.level = m_job.level2;
+			cn2.maxHalfLength = m_job.projectionDepth;
+			cn2.radius = m_job.projectionRadius;
+			cn2.onlyPositiveDir = m_params.onlyPositiveSearch;
+
+			if (m_params.progressiveSearch)
+			{
+				//progressive search
+				size_t previousNeighbourCount = 0;
+				while (cn2.currentHalfLength < cn2.maxHalfLength)
+				{
+					size_t neighbourCount = m_job.cloud2Octree->getPointsInCylindricalNeighbourhoodProgressive(cn2);
+					if (neighbourCount != previousNeighbourCount)
+					{
+						//do we have enough points for computing stats?
+						if (neighbourCount >= m_params.minPoints4Stats)
+						{
+							qM3C2Tools::ComputeStatistics(cn2.neighbours, m_params.useMedian, mean2, stdDev2);
+							validStats2 = true;
+							//do we have a sharp enough 'mean' to stop?
+							if (fabs(mean2) + 2 * stdDev2 < static_cast<double>(cn2.currentHalfLength))
+								break;
+						}
+						previousNeighbourCount = neighbourCount;
+					}
+				}
+			}
+			else
+			{
+				m_job.cloud2Octree->getPointsInCylindricalNeighbourhood(cn2);
+			}
+
+			size_t n2 = cn2.neighbours.size();
+			if (n2 != 0)
+			{
+				//compute stat. dispersion on cloud #2 neighbours (if necessary)
+				if (!validStats2)
+				{
+					qM3C2Tools::ComputeStatistics(cn2.neighbours, m_params.useMedian, mean2, stdDev2);
+				}
+				assert(stdDev2 != stdDev2 || stdDev2 >= 0); //first inequality fails if stdDev2 is NaN ;)
+
+				if (m_params.exportOption == PROJECT_ON_CLOUD2)
+				{
+					//shift output point on the 2nd cloud
+					outputP += static_cast<PointCoordinateType>(mean2) * N;
+				}
+
+				if (m_params.usePrecisionMaps && (m_job.computeConfidence || m_job.stdDevCloud2SF))
+				{
+					//compute the Precision Maps derived sigma
+					stdDev2 = ComputePMUncertainty(cn2.neighbours, N, m_params.cloud2PM);
+				}
+
+				if (n1 != 0)
+				{
+					//m3c2 dist = distance between i1 and i2 (i.e. either the mean or the median of both neighborhoods)
+					dist = static_cast<ScalarType>(mean2 - mean1);
+					m_job.m3c2DistSF->setValue(index, dist);
+
+					//confidence interval
+					if (m_job.computeConfidence)
+					{
+						ScalarType LODStdDev = NAN_VALUE;
+						if (m_params.usePrecisionMaps)
+						{
+							LODStdDev = stdDev1*stdDev1 + stdDev2*stdDev2; //equation (2) in M3C2-PM article
+						}
+						//standard M3C2 algortihm: have we enough points for computing the confidence interval?
+						else if (n1 >= m_params.minPoints4Stats && n2 >= m_params.minPoints4Stats)
+						{
+							LODStdDev = (stdDev1*stdDev1) / n1 + (stdDev2*stdDev2) / n2;
+						}
+
+						if (!std::isnan(LODStdDev))
+						{
+							//distance uncertainty (see eq. (1) in M3C2 article)
+							ScalarType LOD = static_cast<ScalarType>(1.96 * (sqrt(LODStdDev) + m_params.registrationRms));
+
+							if (m_job.distUncertaintySF)
+							{
+								m_job.distUncertaintySF->setValue(index, LOD);
+							}
+
+							if (m_job.sigChangeSF)
+							{
+								bool significant = (dist < -LOD || dist > LOD);
+								if (significant)
+								{
+									m_job.sigChangeSF->setValue(index, SCALAR_ONE); //already equal to SCALAR_ZERO otherwise
+								}
+							}
+						}
+						//else //DGM: scalar fields have already been initialized with the right 'default' values
+						//{
+						//	if (distUncertaintySF)
+						//		distUncertaintySF->setValue(index, NAN_VALUE);
+						//	if (sigChangeSF)
+						//		sigChangeSF->setValue(index, SCALAR_ZERO);
+						//}
+					}
+				}
+
+				//save cloud #2's std. dev.
+				if (m_job.stdDevCloud2SF)
+				{
+					ScalarType val = static_cast<ScalarType>(stdDev2);
+					m_job.stdDevCloud2SF->setValue(index, val);
+				}
+			}
+
+			//save cloud #2's density
+			if (m_job.densityCloud2SF)
+			{
+				ScalarType val = static_cast<ScalarType>(n2);
+				m_job.densityCloud2SF->setValue(index, val);
+			}
+		}
+	}
+
+	//output point
+	if (m_job.outputCloud != m_job.corePoints)
+	{
+		*const_cast<CCVector3*>(m_job.outputCloud->getPoint(index)) = outputP;
+	}
+	if (m_job.exportNormal)
+	{
+		m_job.outputCloud->setPointNormal(index, N);
+	}
+
+	//progress notification
+	if (m_job.nProgress && !m_job.nProgress->oneStep())
+	{
+		m_cancelToken.cancel();
+	}
+}
+
+bool qM3C2Process::sortCorePointsByCell(std::vector<unsigned>& order, std::vector<unsigned>& cellStarts) const
+{
+	assert(m_job.corePoints && m_job.cloud1Octree);
+	unsigned corePointCount = m_job.corePoints->size();
+	const int maxCellPos = (1 << m_job.level1) - 1;
+
+	std::vector< std::pair<CCLib::DgmOctree::CellCode, unsigned> > codes;
+	try
+	{
+		codes.resize(corePointCount);
+		order.resize(corePointCount);
+		cellStarts.clear();
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	//the core points may lie outside of cloud #1's octree: we use the nearest cell
+	for (unsigned i = 0; i < corePointCount; ++i)
+	{
+		Tuple3i cellPos;
+		m_job.cloud1Octree->getTheCellPosWhichIncludesThePoint(m_job.corePoints->getPoint(i), cellPos, m_job.level1);
+		cellPos.x = std::max(0, std::min(cellPos.x, maxCellPos));
+		cellPos.y = std::max(0, std::min(cellPos.y, maxCellPos));
+		cellPos.z = std::max(0, std::min(cellPos.z, maxCellPos));
+		codes[i] = std::make_pair(CCLib::DgmOctree::GenerateTruncatedCellCode(cellPos, m_job.level1), i);
+	}
+	std::sort(codes.begin(), codes.end());
+
+	try
+	{
+		for (unsigned i = 0; i < corePointCount; ++i)
+		{
+			if (i == 0 || codes[i].first != codes[i - 1].first)
+			{
+				cellStarts.push_back(i);
+			}
+			order[i] = codes[i].second;
+		}
+		cellStarts.push_back(corePointCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool qM3C2Process::compute(	ccPointCloud* cloud1,
+							ccPointCloud* cloud2,
+							ccPointCloud* corePoints,
+							ccPointCloud* normalsOrientationCloud,
+							Output& output,
+							CCLib::GenericProgressCallback* progressCb,
+							QString& errorMessage)
+{
+	output = Output();
+	releaseJob();
+
+	if (!cloud1 || !cloud2)
+	{
+		assert(false);
+		errorMessage = "Invalid input clouds";
+		return false;
+	}
+	if (m_params.projectionScale <= 0 || m_params.projectionDepth <= 0)
+	{
+		errorMessage = "Invalid projection scale or depth";
+		return false;
+	}
+	if (m_params.usePrecisionMaps && (!m_params.cloud1PM.valid() || !m_params.cloud2PM.valid()))
+	{
+		errorMessage = "Invalid 'Precision maps' settings!";
+		return false;
+	}
+	if (m_cancelToken.isCanceled())
+	{
+		errorMessage = "Process canceled by user!";
+		return false;
+	}
+
+	m_job.projectionRadius = static_cast<PointCoordinateType>(m_params.projectionScale / 2); //we want the radius in fact ;)
+	m_job.projectionDepth = static_cast<PointCoordinateType>(m_params.projectionDepth);
+	m_job.corePoints = corePoints;
+
+	qM3C2Normals::ComputationMode normMode = m_params.normalMode;
+
+	//Duration: initialization & normals computation
+	QElapsedTimer initTimer;
+	initTimer.start();
+
+	//compute octree(s) if necessary
+	m_job.cloud1Octree = cloud1->getOctree();
+	if (!m_job.cloud1Octree)
+	{
+		m_job.cloud1Octree = cloud1->computeOctree(progressCb);
+		output.cloud1OctreeComputed = !m_job.cloud1Octree.isNull();
+	}
+	if (!m_job.cloud1Octree)
+	{
+		errorMessage = "Failed to compute cloud #1's octree!";
+		return false;
+	}
+
+	m_job.cloud2Octree = cloud2->getOctree();
+	if (!m_job.cloud2Octree)
+	{
+		m_job.cloud2Octree = cloud2->computeOctree(progressCb);
+		output.cloud2OctreeComputed = !m_job.cloud2Octree.isNull();
+	}
+	if (!m_job.cloud2Octree)
+	{
+		errorMessage = "Failed to compute cloud #2's octree!";
+		return false;
+	}
+
+	//start the job
+	bool error = false;
+
+	//should we generate the core points?
+	bool corePointsHaveBeenSubsampled = false;
+	if (!m_job.corePoints)
+	{
+		if (m_params.subsamplingDistance > 0)
+		{
+			CCLib::CloudSamplingTools::SFModulationParams modParams(false);
+			CCLib::ReferenceCloud* subsampled = CCLib::CloudSamplingTools::resampleCloudSpatially(	cloud1,
+																									static_cast<PointCoordinateType>(m_params.subsamplingDistance),
+																									modParams,
+																									m_job.cloud1Octree.data(),
+																									progressCb);
+
+			if (subsampled)
+			{
+				m_job.corePoints = cloud1->partialClone(subsampled);
+
+				//don't need those references anymore
+				delete subsampled;
+				subsampled = 0;
+			}
+
+			if (m_job.corePoints)
+			{
+				m_job.corePoints->setName(QString("%1.subsampled [min dist. = %2]").arg(cloud1->getName()).arg(m_params.subsamplingDistance));
+				m_job.corePoints->setVisible(true);
+				m_job.corePoints->setDisplay(cloud1->getDisplay());
+				output.subsampledCorePoints = m_job.corePoints;
+				corePointsHaveBeenSubsampled = true;
+			}
+			else
+			{
+				errorMessage = "Failed to compute sub-sampled core points!";
+				error = true;
+			}
+		}
+		else
+		{
+			m_job.corePoints = cloud1;
+		}
+	}
+
+	//output
+	QString outputName(m_params.usePrecisionMaps ? "M3C2-PM output" : "M3C2 output");
+
+	if (!error)
+	{
+		//whatever the case, at this point we should have core points
+		assert(m_job.corePoints);
+		ccLog::Print(QString("[M3C2] Core points: %1").arg(m_job.corePoints->size()));
+
+		if (m_params.keepOriginalCloud)
+		{
+			m_job.outputCloud = m_job.corePoints;
+		}
+		else
+		{
+			m_job.outputCloud = new ccPointCloud(/*outputName*/); //setName will be called at the end
+			if (!m_job.outputCloud->resize(m_job.corePoints->size())) //resize as we will 'set' the new points positions in 'computeDistForPoint'
+			{
+				errorMessage = "Not enough memory!";
+				error = true;
+			}
+			m_job.corePoints->setEnabled(false); //we can hide the core points
+		}
+	}
+
+	//compute normals
+	if (!error)
+	{
+		bool normalsAreOk = false;
+
+		switch (normMode)
+		{
+		case qM3C2Normals::HORIZ_MODE:
+			outputName += QString(" [HORIZONTAL]");
+		case qM3C2Normals::DEFAULT_MODE:
+		case qM3C2Normals::MULTI_SCALE_MODE:
+			{
+				m_job.coreNormals = new NormsIndexesTableType();
+				m_job.coreNormals->link(); //will be released anyway at the end of the process
+
+				std::vector<PointCoordinateType> radii;
+				if (normMode == qM3C2Normals::MULTI_SCALE_MODE)
+				{
+					//get multi-scale parameters
+					double startScale = m_params.normalMinScale;
+					double step = m_params.normalStep;
+					double stopScale = std::max(startScale, m_params.normalMaxScale); //just to be sure
+					if (step <= 0)
+					{
+						errorMessage = "Invalid multi-scale step!";
+						error = true;
+						break;
+					}
+					//generate all corresponding 'scales'
+					for (double scale = startScale; scale <= stopScale; scale += step)
+					{
+						radii.push_back(static_cast<PointCoordinateType>(scale / 2));
+					}
+
+					outputName += QString(" scale=[%1:%2:%3]").arg(startScale).arg(step).arg(stopScale);
+
+					m_job.normalScaleSF = new ccScalarField(NORMAL_SCALE_SF_NAME);
+					m_job.normalScaleSF->link(); //will be released anyway at the end of the process
+				}
+				else
+				{
+					outputName += QString(" scale=%1").arg(m_params.normalScale);
+					//otherwise, we use a unique scale by default
+					radii.push_back(static_cast<PointCoordinateType>(m_params.normalScale / 2)); //we want the radius in fact ;)
+				}
+
+				bool invalidNormals = false;
+				ccPointCloud* baseCloud = (m_params.normalUseCorePoints ? m_job.corePoints : cloud1);
+				ccOctree* baseOctree = (baseCloud == cloud1 ? m_job.cloud1Octree.data() : 0);
+
+				//dedicated core points method
+				normalsAreOk = qM3C2Normals::ComputeCorePointsNormals(	m_job.corePoints,
+																		m_job.coreNormals,
+																		baseCloud,
+																		radii,
+																		invalidNormals,
+																		m_params.maxThreadCount,
+																		m_job.normalScaleSF,
+																		progressCb,
+																		baseOctree);
+
+				//now fix the orientation
+				if (normalsAreOk)
+				{
+					//some invalid normals?
+					if (invalidNormals)
+					{
+						ccLog::Warning("[M3C2] Some normals are invalid! You may have to increase the scale.");
+					}
+
+					//make normals horizontal if necessary
+					if (normMode == qM3C2Normals::HORIZ_MODE)
+					{
+						qM3C2Normals::MakeNormalsHorizontal(*m_job.coreNormals);
+					}
+
+					//then either use a simple heuristic
+					if (!normalsOrientationCloud)
+					{
+						int preferredOrientation = m_params.normalPreferredOrientation;
+						if (	preferredOrientation < ccNormalVectors::PLUS_X
+							||	preferredOrientation > ccNormalVectors::MINUS_ZERO
+							||	!ccNormalVectors::UpdateNormalOrientations(	m_job.corePoints,
+																			*m_job.coreNormals,
+																			static_cast<ccNormalVectors::Orientation>(preferredOrientation)))
+						{
+							errorMessage = "[M3C2] Failed to re-orient the normals (invalid parameter?)";
+							error = true;
+						}
+					}
+					else //or use external points
+					{
+						if (!qM3C2Normals::UpdateNormalOrientationsWithCloud(	m_job.corePoints,
+																				*m_job.coreNormals,
+																				normalsOrientationCloud,
+																				m_params.maxThreadCount,
+																				progressCb ))
+						{
+							errorMessage = "[M3C2] Failed to re-orient the normals with input point cloud!";
+							error = true;
+						}
+					}
+
+					if (!error && m_job.coreNormals)
+					{
+						m_job.outputCloud->setNormsTable(m_job.coreNormals);
+						m_job.outputCloud->showNormals(true);
+					}
+				}
+			}
+			break;
+
+		case qM3C2Normals::USE_CLOUD1_NORMALS:
+			{
+				outputName += QString(" scale=%1").arg(m_params.normalScale);
+				ccPointCloud* sourceCloud = (corePointsHaveBeenSubsampled ? m_job.corePoints : cloud1);
+				m_job.coreNormals = sourceCloud->normals();
+				normalsAreOk = (m_job.coreNormals && m_job.coreNormals->currentSize() == sourceCloud->size());
+				if (m_job.coreNormals)
+				{
+					m_job.coreNormals->link(); //will be released anyway at the end of the process
+				}
+
+				//DGM TODO: should we export the normals to the output cloud?
+			}
+			break;
+
+		case qM3C2Normals::VERT_MODE:
+			{
+				outputName += QString(" scale=%1").arg(m_params.normalScale);
+				outputName += QString(" [VERTICAL]");
+
+				//nothing to do
+				normalsAreOk = true;
+			}
+			break;
+		}
+
+		if (!error && !normalsAreOk)
+		{
+			errorMessage = "Failed to compute normals!";
+			error = true;
+		}
+	}
+
+	if (!error && m_job.coreNormals && corePointsHaveBeenSubsampled)
+	{
+		if (m_job.corePoints->hasNormals() || m_job.corePoints->resizeTheNormsTable())
+		{
+			for (unsigned i = 0; i < m_job.coreNormals->currentSize(); ++i)
+				m_job.corePoints->setPointNormalIndex(i, m_job.coreNormals->getValue(i));
+			m_job.corePoints->showNormals(true);
+		}
+		else
+		{
+			ccLog::Warning("Failed to allocate memory for core points normals!");
+		}
+	}
+
+	qint64 initTime_ms = initTimer.elapsed();
+
+	while (!error) //fake loop for easy break
+	{
+		//we display init. timing only if no error occurred!
+		ccLog::Print(QString("[M3C2] Initialization & normal computation: %1 s.").arg(static_cast<double>(initTime_ms) / 1000.0, 0, 'f', 3));
+
+		QElapsedTimer distCompTimer;
+		distCompTimer.start();
+
+		//we are either in vertical mode or we have as many normals as core points
+		unsigned corePointCount = m_job.corePoints->size();
+		assert(normMode == qM3C2Normals::VERT_MODE || (m_job.coreNormals && corePointCount == m_job.coreNormals->currentSize()));
+
+		if (progressCb)
+		{
+			if (progressCb->textCanBeEdited())
+			{
+				progressCb->setMethodTitle("M3C2 Distances Computation");
+				progressCb->setInfo(qPrintable(QString("Core points: %1").arg(corePointCount)));
+			}
+			progressCb->update(0);
+			progressCb->start();
+		}
+		CCLib::NormalizedProgress nProgress(progressCb, corePointCount);
+		m_job.nProgress = (progressCb ? &nProgress : 0);
+
+		//allocate distances SF
+		m_job.m3c2DistSF = new ccScalarField(M3C2_DIST_SF_NAME);
+		m_job.m3c2DistSF->link();
+		if (!m_job.m3c2DistSF->resize(corePointCount, true, NAN_VALUE))
+		{
+			errorMessage = "Failed to allocate memory for distance values!";
+			error = true;
+			break;
+		}
+		//allocate dist. uncertainty SF
+		m_job.distUncertaintySF = new ccScalarField(DIST_UNCERTAINTY_SF_NAME);
+		m_job.distUncertaintySF->link();
+		if (!m_job.distUncertaintySF->resize(corePointCount, true, NAN_VALUE))
+		{
+			errorMessage = "Failed to allocate memory for dist. uncertainty values!";
+			error = true;
+			break;
+		}
+		//allocate change significance SF
+		m_job.sigChangeSF = new ccScalarField(SIG_CHANGE_SF_NAME);
+		m_job.sigChangeSF->link();
+		if (!m_job.sigChangeSF->resize(corePointCount, true, SCALAR_ZERO))
+		{
+			ccLog::Warning("Failed to allocate memory for change significance values!");
+			m_job.sigChangeSF->release();
+			m_job.sigChangeSF = 0;
+			//no need to stop just for this SF!
+		}
+
+		if (m_params.exportStdDevInfo)
+		{
+			QString prefix("STD");
+			if (m_params.usePrecisionMaps)
+			{
+				prefix = "SigmaN";
+			}
+			else if (m_params.useMedian)
+			{
+				prefix = "IQR";
+			}
+			//allocate cloud #1 std. dev. SF
+			QString stdDevSFName1 = QString(STD_DEV_CLOUD1_SF_NAME).arg(prefix);
+			m_job.stdDevCloud1SF = new ccScalarField(qPrintable(stdDevSFName1));
+			m_job.stdDevCloud1SF->link();
+			if (!m_job.stdDevCloud1SF->resize(corePointCount, true, NAN_VALUE))
+			{
+				ccLog::Warning("Failed to allocate memory for cloud #1 std. dev. values!");
+				m_job.stdDevCloud1SF->release();
+				m_job.stdDevCloud1SF = 0;
+			}
+			//allocate cloud #2 std. dev. SF
+			QString stdDevSFName2 = QString(STD_DEV_CLOUD2_SF_NAME).arg(prefix);
+			m_job.stdDevCloud2SF = new ccScalarField(qPrintable(stdDevSFName2));
+			m_job.stdDevCloud2SF->link();
+			if (!m_job.stdDevCloud2SF->resize(corePointCount, true, NAN_VALUE))
+			{
+				ccLog::Warning("Failed to allocate memory for cloud #2 std. dev. values!");
+				m_job.stdDevCloud2SF->release();
+				m_job.stdDevCloud2SF = 0;
+			}
+		}
+		if (m_params.exportDensityAtProjScale)
+		{
+			//allocate cloud #1 density SF
+			m_job.densityCloud1SF = new ccScalarField(DENSITY_CLOUD1_SF_NAME);
+			m_job.densityCloud1SF->link();
+			if (!m_job.densityCloud1SF->resize(corePointCount, true, NAN_VALUE))
+			{
+				ccLog::Warning("Failed to allocate memory for cloud #1 density values!");
+				m_job.densityCloud1SF->release();
+				m_job.densityCloud1SF = 0;
+			}
+			//allocate cloud #2 density SF
+			m_job.densityCloud2SF = new ccScalarField(DENSITY_CLOUD2_SF_NAME);
+			m_job.densityCloud2SF->link();
+			if (!m_job.densityCloud2SF->resize(corePointCount, true, NAN_VALUE))
+			{
+				ccLog::Warning("Failed to allocate memory for cloud #2 density values!");
+				m_job.densityCloud2SF->release();
+				m_job.densityCloud2SF = 0;
+			}
+		}
+
+		//get best levels for neighbourhood extraction on both octrees
+		assert(m_job.cloud1Octree && m_job.cloud2Octree);
+
+		m_job.level1 = m_job.cloud1Octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(static_cast<PointCoordinateType>(2.5 * m_job.projectionRadius)); //2.5 = empirical!
+		ccLog::Print(QString("[M3C2] Working subdivision level (cloud #1): %1").arg(m_job.level1));
+
+		m_job.level2 = m_job.cloud2Octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(static_cast<PointCoordinateType>(2.5 * m_job.projectionRadius)); //2.5 = empirical!
+		ccLog::Print(QString("[M3C2] Working subdivision level (cloud #2): %1").arg(m_job.level2));
+
+		//other options
+		m_job.updateNormal = (normMode != qM3C2Normals::VERT_MODE);
+		m_job.exportNormal = m_job.updateNormal && !m_job.outputCloud->hasNormals();
+		if (m_job.exportNormal && !m_job.outputCloud->resizeTheNormsTable()) //resize because we will 'set' the normal in computeDistForPoint
+		{
+			ccLog::Warning("Failed to allocate memory for exporting normals!");
+			m_job.exportNormal = false;
+		}
+		m_job.computeConfidence = (m_job.distUncertaintySF || m_job.sigChangeSF);
+
+		//compute distances
+		{
+			//consecutive core points in the same cell share most of their neighbourhood
+			//(i.e. the same octree cells): processing them together improves the memory locality
+			std::vector<unsigned> order, cellStarts;
+			bool batchByCell = m_params.batchByCell && sortCorePointsByCell(order, cellStarts);
+			if (m_params.batchByCell && !batchByCell)
+			{
+				ccLog::Warning("[M3C2] Not enough memory to sort the core points by cell (they will be processed in their original order)");
+			}
+
+			int maxThreadCount = m_params.maxThreadCount;
+#ifdef _DEBUG
+			maxThreadCount = 1;
+#endif
+
+			//the job uses its own thread pool (the global Qt thread pool is left untouched)
+			if (batchByCell)
+			{
+				unsigned cellCount = static_cast<unsigned>(cellStarts.size()) - 1;
+				CCLib::ParallelTools::ForEach(	cellCount,
+												[&](unsigned cellIndex)
+												{
+													for (unsigned i = cellStarts[cellIndex]; i < cellStarts[cellIndex + 1] && !m_cancelToken.isCanceled(); ++i)
+													{
+														computeDistForPoint(order[i]);
+													}
+												},
+												maxThreadCount,
+												&m_cancelToken );
+			}
+			else
+			{
+				CCLib::ParallelTools::ForEach(	corePointCount,
+												[this](unsigned index) { computeDistForPoint(index); },
+												maxThreadCount,
+												&m_cancelToken );
+			}
+		}
+
+		m_job.nProgress = 0;
+
+		if (m_cancelToken.isCanceled())
+		{
+			errorMessage = "Process canceled by user!";
+			error = true;
+		}
+		else
+		{
+			qint64 distTime_ms = distCompTimer.elapsed();
+			//we display init. timing only if no error occurred!
+			ccLog::Print(QString("[M3C2] Distances computation: %1 s.").arg(static_cast<double>(distTime_ms) / 1000.0, 0, 'f', 3));
+		}
+
+		break; //to break from fake loop
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	//associate scalar fields to the output cloud
+	//(use reverse order so as to get the index of
+	//the most important one at the end)
+	if (!error)
+	{
+		assert(m_job.outputCloud && m_job.corePoints);
+		int sfIdx = -1;
+
+		ccScalarField* sfs[] = {	m_job.normalScaleSF,		//normal scales
+									m_job.densityCloud1SF,		//clouds' density SFs
+									m_job.densityCloud2SF,
+									m_job.stdDevCloud1SF,		//clouds' std. dev. SFs
+									m_job.stdDevCloud2SF,
+									m_job.sigChangeSF,			//significance SF
+									m_job.distUncertaintySF,	//dist. uncertainty SF
+									m_job.m3c2DistSF			//M3C2 distances SF
+		};
+
+		for (ccScalarField* sf : sfs)
+		{
+			if (!sf)
+				continue;
+
+			sf->computeMinAndMax();
+			if (sf == m_job.sigChangeSF)
+			{
+				sf->setMinDisplayed(SCALAR_ONE);
+			}
+			else if (sf == m_job.m3c2DistSF)
+			{
+				sf->setSymmetricalScale(true);
+			}
+			//in case the output cloud is the original cloud, we must remove the former SF
+			RemoveScalarField(m_job.outputCloud, sf->getName());
+			sfIdx = m_job.outputCloud->addScalarField(sf);
+		}
+
+		m_job.outputCloud->invalidateBoundingBox(); //see 'const_cast<...>' in computeDistForPoint ;)
+		m_job.outputCloud->setCurrentDisplayedScalarField(sfIdx);
+		m_job.outputCloud->showSF(true);
+		m_job.outputCloud->showNormals(true);
+		m_job.outputCloud->setVisible(true);
+
+		if (m_job.outputCloud != m_job.corePoints)
+		{
+			m_job.outputCloud->setName(outputName);
+			m_job.outputCloud->setDisplay(m_job.corePoints->getDisplay());
+			m_job.outputCloud->importParametersFrom(m_job.corePoints);
+		}
+
+		output.cloud = m_job.outputCloud;
+	}
+	else if (m_job.outputCloud)
+	{
+		if (m_job.outputCloud != m_job.corePoints)
+		{
+			delete m_job.outputCloud;
+		}
+		m_job.outputCloud = 0;
+	}
+
+	//release structures
+	releaseJob();
+
+	return !error;
+}
@@ -0,0 +1,227 @@
+//##########################################################################
+//#                                                                        #
+//#                       CLOUDCOMPARE PLUGIN: qM3C2                       #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#            COPYRIGHT: UNIVERSITE EUROPEENNE DE BRETAGNE                #
+//#                                                                        #
+//##########################################################################
+
+#ifndef Q_M3C2_PROCESS_HEADER
+#define Q_M3C2_PROCESS_HEADER
+
+//Local
+#include "qM3C2Tools.h"
+
+//CCLib
+#include <ParallelTools.h>
+
+//qCC_db
+#include <ccOctree.h>
+#include <ccAdvancedTypes.h>
+
+//Qt
+#include <QString>
+
+class ccPointCloud;
+class ccScalarField;
+
+//! M3C2 computation engine (GUI-free)
+/** All the state of a comparison is held by the instance, so that several
+	comparisons can run concurrently (e.g. from different threads, or from
+	the command line). The clouds are only read (apart from their octrees,
+	computed if necessary, and the core points cloud if it is used as output).
+**/
+class qM3C2Process
+{
+public:
+
+	//! Exportation options
+	/** \warning Don't change the associated values! (for parameter files)
+	**/
+	enum ExportOptions {	PROJECT_ON_CLOUD1 = 0,
+							PROJECT_ON_CLOUD2 = 1,
+							PROJECT_ON_CORE_POINTS = 2,
+	};
+
+	//! Precision maps
+	/** See "3D uncertainty-based topographic change detection with SfM photogrammetry:
+		precision maps for ground control and directly georeferenced surveys" by James et al.
+	**/
+	struct PrecisionMaps
+	{
+		PrecisionMaps() : sX(0), sY(0), sZ(0), scale(1.0) {}
+		bool valid() const { return (sX != 0 && sY != 0 && sZ != 0); }
+		CCLib::ScalarField *sX, *sY, *sZ;
+		double scale;
+	};
+
+	//! M3C2 parameters
+	struct Parameters
+	{
+		//! Default constructor
+		Parameters();
+
+		//normals
+		qM3C2Normals::ComputationMode normalMode;
+		double normalScale;
+		double normalMinScale;
+		double normalStep;
+		double normalMaxScale;
+		bool normalUseCorePoints;
+		int normalPreferredOrientation; //see ccNormalVectors::Orientation (only used without orientation cloud)
+
+		//core points
+		double subsamplingDistance; //only used if no core points are provided (<= 0 = use cloud #1)
+
+		//projection
+		double projectionScale; //cylinder diameter
+		double projectionDepth; //cylinder half height
+		double registrationRms; //0 = ignored
+		bool useMedian;
+		bool progressiveSearch;
+		bool onlyPositiveSearch;
+		unsigned minPoints4Stats;
+
+		//export
+		ExportOptions exportOption;
+		bool keepOriginalCloud;
+		bool exportStdDevInfo;
+		bool exportDensityAtProjScale;
+
+		//precision maps
+		bool usePrecisionMaps;
+		PrecisionMaps cloud1PM;
+		PrecisionMaps cloud2PM;
+
+		//! Max number of threads for this comparison (0 = all)
+		int maxThreadCount;
+		//! Whether core points should be processed cell by cell (better memory locality)
+		bool batchByCell;
+	};
+
+	//! Loads the parameters from a parameter file (as saved by the M3C2 dialog)
+	/** Precision maps scalar fields are not stored in the file and must be set afterwards.
+		\param filename parameter file
+		\param params parameters (only the ones found in the file are updated)
+		\param errorMessage error message (if any)
+		\return success
+	**/
+	static bool LoadParameters(const QString& filename, Parameters& params, QString& errorMessage);
+
+	//! Comparison output
+	struct Output
+	{
+		Output() : cloud(0), subsampledCorePoints(0), cloud1OctreeComputed(false), cloud2OctreeComputed(false) {}
+
+		//! Output cloud (may be the core points cloud if 'keepOriginalCloud' is set)
+		ccPointCloud* cloud;
+		//! Sub-sampled core points (if any - the caller takes ownership)
+		ccPointCloud* subsampledCorePoints;
+		//! Whether cloud #1's octree has been computed
+		bool cloud1OctreeComputed;
+		//! Whether cloud #2's octree has been computed
+		bool cloud2OctreeComputed;
+	};
+
+	//! Default constructor
+	qM3C2Process(const Parameters& params);
+
+	//! Destructor
+	virtual ~qM3C2Process();
+
+	//! Returns the parameters
+	const Parameters& parameters() const { return m_params; }
+
+	//! Computes the M3C2 distances between two clouds
+	/** \param cloud1 reference cloud
+		\param cloud2 compared cloud
+		\param corePoints core points (if null, either cloud #1 or its sub-sampled version is used)
+		\param normalsOrientationCloud cloud used to orient the normals (if null, the preferred orientation is used)
+		\param output comparison output (the caller takes ownership of the created clouds)
+		\param progressCb progress notification (optional)
+		\param errorMessage error message (if any)
+		\return success
+	**/
+	bool compute(	ccPointCloud* cloud1,
+					ccPointCloud* cloud2,
+					ccPointCloud* corePoints,
+					ccPointCloud* normalsOrientationCloud,
+					Output& output,
+					CCLib::GenericProgressCallback* progressCb,
+					QString& errorMessage);
+
+	//! Cancels the current computation (can be called from any thread)
+	/** \warning A canceled instance can't be used for another computation.
+	**/
+	void cancel() { m_cancelToken.cancel(); }
+
+protected:
+
+	//! Computes the M3C2 distance for a given core point
+	void computeDistForPoint(unsigned index);
+
+	//! Sorts the core points by cell (of cloud #1's octree)
+	/** \param order core points indexes sorted by cell
+		\param cellStarts index of the first point of each cell in 'order' (+ the total count)
+		\return success
+	**/
+	bool sortCorePointsByCell(std::vector<unsigned>& order, std::vector<unsigned>& cellStarts) const;
+
+	//! Releases the job structures
+	void releaseJob();
+
+	//! Job state (per comparison)
+	struct Job
+	{
+		Job();
+
+		//input data
+		ccPointCloud* outputCloud;
+		ccPointCloud* corePoints;
+		NormsIndexesTableType* coreNormals;
+
+		//main options
+		PointCoordinateType projectionRadius;
+		PointCoordinateType projectionDepth;
+		bool updateNormal;
+		bool exportNormal;
+		bool computeConfidence;
+
+		//octrees
+		ccOctree::Shared cloud1Octree;
+		unsigned char level1;
+		ccOctree::Shared cloud2Octree;
+		unsigned char level2;
+
+		//scalar fields
+		ccScalarField* normalScaleSF;		//normal scale (multi-scale mode only)
+		ccScalarField* m3c2DistSF;			//M3C2 distance
+		ccScalarField* distUncertaintySF;	//distance uncertainty
+		ccScalarField* sigChangeSF;			//significant change
+		ccScalarField* stdDevCloud1SF;		//standard deviation information for cloud #1
+		ccScalarField* stdDevCloud2SF;		//standard deviation information for cloud #2
+		ccScalarField* densityCloud1SF;		//export point density at projection scale for cloud #1
+		ccScalarField* densityCloud2SF;		//export point density at projection scale for cloud #2
+
+		//progress notification
+		CCLib::NormalizedProgress* nProgress;
+	};
+
+	//! Parameters
+	Parameters m_params;
+	//! Current job
+	Job m_job;
+	//! Cancellation token
+	CCLib::ParallelCancelToken m_cancelToken;
+};
+
+#endif //Q_M3C2_PROCESS_HEADER
@@ -21,6 +21,7 @@
 #include <Neighbourhood.h>
 #include <DistanceComputationTools.h>
 #include <Jacobi.h>
+#include <ParallelTools.h>
 
 //qCC_db
 #include <ccGenericPointCloud.h>
@@ -40,7 +41,6 @@
 #include <QApplication>
 #include <QMainWindow>
 #include <QProgressDialog>
-#include <QtConcurrentMap>
 
 //system
 #include <vector>
@@ -269,33 +269,10 @@ bool qM3C2Normals::ComputeCorePointsNormals(CCLib::GenericIndexedCloud* corePoin
 	useParallelStrategy = false;
 #endif
 
-	std::vector<unsigned> corePointsIndexes;
 	if (useParallelStrategy)
 	{
-		try
-		{
-			corePointsIndexes.resize(corePtsCount);
-		}
-		catch (const std::bad_alloc&)
-		{
-			//not enough memory
-			useParallelStrategy = false;
-		}
-	}
-
-	if (useParallelStrategy)
-	{
-		for (unsigned i = 0; i < corePtsCount; ++i)
-		{
-			corePointsIndexes[i] = i;
-		}
-
-		if (maxThreadCount == 0)
-		{
-			maxThreadCount = QThread::idealThreadCount();
-		}
-		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-		QtConcurrent::blockingMap(corePointsIndexes, ComputeCorePointNormal);
+		//the job uses its own thread pool (the global Qt thread pool is left untouched)
+		CCLib::ParallelTools::ForEach(corePtsCount, ComputeCorePointNormal, maxThreadCount);
 	}
 	else
 	{
@@ -416,37 +393,15 @@ bool qM3C2Normals::UpdateNormalOrientationsWithCloud(	CCLib::GenericIndexedCloud
 
 	//we check each normal's orientation
 	{
-		std::vector<unsigned> pointIndexes;
 		bool useParallelStrategy = true;
 #ifdef _DEBUG
 		useParallelStrategy = false;
 #endif
-		if (useParallelStrategy)
-		{
-			try
-			{
-				pointIndexes.resize(count);
-			}
-			catch (const std::bad_alloc&)
-			{
-				//not enough memory
-				useParallelStrategy = false;
-			}
-		}
 
 		if (useParallelStrategy)
 		{
-			for (unsigned i = 0; i < count; ++i)
-			{
-				pointIndexes[i] = i;
-			}
-
-			if (maxThreadCount == 0)
-			{
-				maxThreadCount = QThread::idealThreadCount();
-			}
-			QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-			QtConcurrent::blockingMap(pointIndexes, OrientPointNormalWithCloud);
+			//the job uses its own thread pool (the global Qt thread pool is left untouched)
+			CCLib::ParallelTools::ForEach(count, OrientPointNormalWithCloud, maxThreadCount);
 		}
 		else
 		{
@@ -4,6 +4,7 @@
 #include "ccCommandLineInterface.h"
 
 //CCLib
+#include <ArrayStorage.h>
 #include <AutoSegmentationTools.h>
 #include <CCConst.h>
 #include <CloudSamplingTools.h>
@@ -11,9 +12,15 @@
 #include <StatisticalTestingTools.h>
 #include <WeibullDistribution.h>
 #include <MeshSamplingTools.h>
+#include <ParallelTools.h>
+#include <CCMiscTools.h>
+#include <DgmOctreeReferenceCloud.h>
+#include <FastMarchingForPropagation.h>
+#include <SortAlgo.h>
 
 //qCC_db
 #include <ccNormalVectors.h>
+#include <ccOctree.h>
 #include <ccPlane.h>
 #include <ccPolyline.h>
 #include <ccProgressDialog.h>
@@ -22,6 +29,7 @@
 
 //qCC_io
 #include <AsciiFilter.h>
+#include <BinFilter.h>
 #include <BundlerFilter.h>
 #include <FBXFilter.h>
 #include <PlyFilter.h>
@@ -39,6 +47,12 @@
 
 //Qt
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QFileInfo>
+
+//System
+#include <random>
 
 //commands
 static const char COMMAND_CLOUD_EXPORT_FORMAT[]				= "C_EXPORT_FMT";
@@ -52,6 +66,9 @@ static const char COMMAND_OPEN[]							= "O";				//+file name
 static const char COMMAND_OPEN_SKIP_LINES[]					= "SKIP";			//+number of lines to skip
 static const char COMMAND_OPEN_SHIFT_ON_LOAD[]				= "GLOBAL_SHIFT";	//+global shift
 static const char COMMAND_OPEN_SHIFT_ON_LOAD_AUTO[]			= "AUTO";			//"AUTO" keyword
+static const char COMMAND_OPEN_FILTER_BOX[]					= "BBOX";			//+box extents (Xmin:Ymin:Zmin:Xmax:Ymax:Zmax)
+static const char COMMAND_OPEN_FILTER_CLASSIF[]				= "CLASSIF";		//+classification values (comma separated)
+static const char COMMAND_OPEN_FILTER_DECIM[]				= "DECIM";			//+decimation step
 static const char COMMAND_SUBSAMPLE[]						= "SS";				//+ method (RANDOM/SPATIAL/OCTREE) + parameter (resp. point count / spatial step / octree level)
 static const char COMMAND_EXTRACT_CC[]						= "EXTRACT_CC";
 static const char COMMAND_CURVATURE[]						= "CURV";			//+ curvature type (MEAN/GAUSS)
@@ -86,6 +103,7 @@ static const char COMMAND_BUNDLER_UNDISTORT[]				= "UNDISTORT";
 static const char COMMAND_BUNDLER_COLOR_DTM[]				= "COLOR_DTM";
 static const char COMMAND_C2M_DIST[]						= "C2M_DIST";
 static const char COMMAND_C2M_DIST_FLIP_NORMALS[]			= "FLIP_NORMS";
+static const char COMMAND_C2M_DIST_USE_BVH[]				= "USE_BVH";
 static const char COMMAND_C2C_DIST[]						= "C2C_DIST";
 static const char COMMAND_C2C_SPLIT_XYZ[]					= "SPLIT_XYZ";
 static const char COMMAND_C2C_LOCAL_MODEL[]					= "MODEL";
@@ -109,10 +127,14 @@ static const char COMMAND_ICP_RANDOM_SAMPLING_LIMIT[]		= "RANDOM_SAMPLING_LIMIT"
 static const char COMMAND_ICP_ENABLE_FARTHEST_REMOVAL[]		= "FARTHEST_REMOVAL";
 static const char COMMAND_ICP_USE_MODEL_SF_AS_WEIGHT[]		= "MODEL_SF_AS_WEIGHTS";
 static const char COMMAND_ICP_USE_DATA_SF_AS_WEIGHT[]		= "DATA_SF_AS_WEIGHTS";
+static const char COMMAND_ICP_STATIC_INDEX[]				= "STATIC_INDEX";
+static const char COMMAND_ICP_POINT_TO_PLANE[]				= "POINT_TO_PLANE";
+static const char COMMAND_ICP_BENCHMARK[]					= "BENCHMARK";
 static const char COMMAND_FBX_EXPORT_FORMAT[]				= "FBX_EXPORT_FMT";
 static const char COMMAND_PLY_EXPORT_FORMAT[]				= "PLY_EXPORT_FMT";
 static const char COMMAND_COMPUTE_GRIDDED_NORMALS[]			= "COMPUTE_NORMALS";
 static const char COMMAND_COMPUTE_OCTREE_NORMALS[]			= "OCTREE_NORMALS";
+static const char COMMAND_OCTREE_NORMALS_BENCHMARK[]		= "BENCHMARK";
 static const char COMMAND_CLEAR_NORMALS[]					= "CLEAR_NORMALS";
 static const char COMMAND_MESH_VOLUME[]                     = "MESH_VOLUME";
 static const char COMMAND_VOLUME_TO_FILE[]					= "TO_FILE";
@@ -126,6 +148,13 @@ static const char COMMAND_POP_CLOUDS[]						= "POP_CLOUDS";
 static const char COMMAND_CLEAR_MESHES[]					= "CLEAR_MESHES";
 static const char COMMAND_POP_MESHES[]						= "POP_MESHES";
 static const char COMMAND_NO_TIMESTAMP[]					= "NO_TIMESTAMP";
+static const char COMMAND_SCRATCH_STORAGE[]					= "SCRATCH_STORAGE";	//+ directory or "OFF"
+static const char COMMAND_PRECISE_NORMALS[]					= "PRECISE_NORMALS";	//+ "ON" or "OFF"
+static const char COMMAND_BIN_BENCHMARK[]					= "BIN_BENCHMARK";		//+ point count (optional)
+static const char COMMAND_PICKING_BENCHMARK[]				= "PICKING_BENCHMARK";	//+ max point count (optional)
+static const char COMMAND_OCTREE_STRESS[]					= "OCTREE_STRESS";		//+ job count (optional)
+static const char COMMAND_OCTREE_BUILD_BENCHMARK[]			= "OCTREE_BUILD_BENCHMARK";	//+ max point count (optional)
+static const char COMMAND_FAST_MARCHING_BENCHMARK[]			= "FAST_MARCHING_BENCHMARK";	//+ max grid level (optional)
 
 //options / modifiers
 static const char COMMAND_MAX_THREAD_COUNT[]				= "MAX_TCOUNT";
@@ -365,10 +394,91 @@ struct CommandLoad : public ccCommandLineInterface::Command
 
 		//optional parameters
 		int skipLines = 0;
+		FileIOFilter::PointFilter pointFilter;
 		while (!cmd.arguments().empty())
 		{
 			QString argument = cmd.arguments().front();
-			if (ccCommandLineInterface::IsCommand(argument, COMMAND_OPEN_SKIP_LINES))
+			if (ccCommandLineInterface::IsCommand(argument, COMMAND_OPEN_FILTER_BOX))
+			{
+				//local option confirmed, we can move on
+				cmd.arguments().pop_front();
+
+				if (cmd.arguments().empty())
+				{
+					return cmd.error(QString("Missing parameter: box extents after '%1' (Xmin:Ymin:Zmin:Xmax:Ymax:Zmax)").arg(COMMAND_OPEN_FILTER_BOX));
+				}
+
+				QStringList tokens = cmd.arguments().takeFirst().split(':');
+				if (tokens.size() != 6)
+				{
+					return cmd.error(QString("Invalid parameter: box extents after '%1' (expected format is 'Xmin:Ymin:Zmin:Xmax:Ymax:Zmax')").arg(COMMAND_OPEN_FILTER_BOX));
+				}
+
+				for (int i = 0; i < 6; ++i)
+				{
+					CCVector3d* vec = (i < 3 ? &pointFilter.boxMin : &pointFilter.boxMax);
+					bool ok = true;
+					vec->u[i % 3] = tokens[i].toDouble(&ok);
+					if (!ok)
+					{
+						return cmd.error(QString("Invalid parameter: box extents after '%1' (component #%2 is not a valid number)").arg(COMMAND_OPEN_FILTER_BOX).arg(i + 1));
+					}
+				}
+				pointFilter.useBox = true;
+
+				cmd.print(QString("Will only load the points inside the box [%1 ; %2 ; %3] - [%4 ; %5 ; %6]")
+					.arg(pointFilter.boxMin.x).arg(pointFilter.boxMin.y).arg(pointFilter.boxMin.z)
+					.arg(pointFilter.boxMax.x).arg(pointFilter.boxMax.y).arg(pointFilter.boxMax.z));
+			}
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_OPEN_FILTER_CLASSIF))
+			{
+				//local option confirmed, we can move on
+				cmd.arguments().pop_front();
+
+				if (cmd.arguments().empty())
+				{
+					return cmd.error(QString("Missing parameter: classification values after '%1' (comma separated)").arg(COMMAND_OPEN_FILTER_CLASSIF));
+				}
+
+				QStringList tokens = cmd.arguments().takeFirst().split(',', QString::SkipEmptyParts);
+				if (tokens.empty())
+				{
+					return cmd.error(QString("Invalid parameter: no classification value after '%1'").arg(COMMAND_OPEN_FILTER_CLASSIF));
+				}
+				pointFilter.classes.clear();
+				for (int i = 0; i < tokens.size(); ++i)
+				{
+					bool ok = true;
+					unsigned value = tokens[i].toUInt(&ok);
+					if (!ok || value > FileIOFilter::PointFilter::MAX_CLASS_VALUE)
+					{
+						return cmd.error(QString("Invalid parameter: classification value '%1' after '%2' (should be between 0 and %3)").arg(tokens[i], COMMAND_OPEN_FILTER_CLASSIF).arg(FileIOFilter::PointFilter::MAX_CLASS_VALUE));
+					}
+					pointFilter.classes.push_back(static_cast<unsigned char>(value));
+				}
+
+				cmd.print(QString("Will only load the points with the following classification values: %1").arg(tokens.join(", ")));
+			}
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_OPEN_FILTER_DECIM))
+			{
+				//local option confirmed, we can move on
+				cmd.arguments().pop_front();
+
+				if (cmd.arguments().empty())
+				{
+					return cmd.error(QString("Missing parameter: decimation step after '%1'").arg(COMMAND_OPEN_FILTER_DECIM));
+				}
+
+				bool ok;
+				pointFilter.decimationStep = cmd.arguments().takeFirst().toUInt(&ok);
+				if (!ok || pointFilter.decimationStep == 0)
+				{
+					return cmd.error(QString("Invalid parameter: decimation step after '%1'").arg(COMMAND_OPEN_FILTER_DECIM));
+				}
+
+				cmd.print(QString("Will only load one point out of %1").arg(pointFilter.decimationStep));
+			}
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_OPEN_SKIP_LINES))
 			{
 				//local option confirmed, we can move on
 				cmd.arguments().pop_front();
@@ -448,7 +558,28 @@ struct CommandLoad : public ccCommandLineInterface::Command
 
 		//open specified file
 		QString filename(cmd.arguments().takeFirst());
-		return cmd.importFile(filename);
+
+		if (!pointFilter.isActive())
+		{
+			return cmd.importFile(filename);
+		}
+
+		//the points filter only applies to this file
+		QString upperExt = QFileInfo(filename).suffix().toUpper();
+		if (upperExt != "LAS" && upperExt != "LAZ")
+		{
+			return cmd.error(QString("Points filtering (-%1/-%2/-%3) is only supported by the LAS format").arg(COMMAND_OPEN_FILTER_BOX, COMMAND_OPEN_FILTER_CLASSIF, COMMAND_OPEN_FILTER_DECIM));
+		}
+		QString filterError;
+		if (!pointFilter.checkValidity(filterError))
+		{
+			return cmd.error(QString("Invalid points filter: %1").arg(filterError));
+		}
+		cmd.fileLoadingParams().pointFilter = pointFilter;
+		bool success = cmd.importFile(filename);
+		cmd.fileLoadingParams().pointFilter = FileIOFilter::PointFilter();
+
+		return success;
 	}
 };
 
@@ -509,6 +640,158 @@ struct CommandOctreeNormal : public ccCommandLineInterface::Command
 {
 	CommandOctreeNormal() : ccCommandLineInterface::Command("Compute normals with octree", COMMAND_COMPUTE_OCTREE_NORMALS) {}
 
+	//! Min number of neighbours for a quadric normal (same as ccNormalVectors)
+	static const unsigned MinNeighbourCount = 6;
+
+	//! Legacy cell function: generic Neighbourhood on a reference cloud for each point (quadric model)
+	/** Former ccNormalVectors::ComputeNormsAtLevelWithQuadric (before NormalEstimationKernels).
+		additionalParameters: std::vector<CCVector3>* (uncompressed normals), PointCoordinateType* (radius)
+	**/
+	static bool LegacyComputeNormsAtLevelWithQuadric(const CCLib::DgmOctree::octreeCell& cell, void** additionalParameters, CCLib::NormalizedProgress*)
+	{
+		std::vector<CCVector3>& normals = *static_cast<std::vector<CCVector3>*>(additionalParameters[0]);
+		PointCoordinateType radius = *static_cast<PointCoordinateType*>(additionalParameters[1]);
+
+		CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+		nNSS.level = cell.level;
+		nNSS.prepare(radius, cell.parentOctree->getCellSize(nNSS.level));
+		cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
+		cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
+
+		//we already know which points are lying in the current cell
+		unsigned pointCount = cell.points->size();
+		nNSS.pointsInNeighbourhood.resize(pointCount);
+		CCLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+		for (unsigned j = 0; j < pointCount; ++j, ++it)
+		{
+			it->point = cell.points->getPointPersistentPtr(j);
+			it->pointIndex = cell.points->getPointGlobalIndex(j);
+		}
+		nNSS.alreadyVisitedNeighbourhoodSize = 1;
+
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			cell.points->getPoint(i, nNSS.queryPoint);
+
+			unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, radius, false);
+			float cur_radius = radius;
+			while (k < MinNeighbourCount && cur_radius < 16 * radius)
+			{
+				cur_radius *= 1.189207115f;
+				k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, cur_radius, false);
+			}
+			if (k >= MinNeighbourCount)
+			{
+				CCLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood, k);
+				CCVector3 N;
+				if (ccNormalVectors::ComputeNormalWithQuadric(&neighbours, nNSS.queryPoint, N))
+				{
+					normals[cell.points->getPointGlobalIndex(i)] = N;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	//! Times the legacy (generic Neighbourhood) and current (NormalEstimationKernels) quadric normals on a cloud
+	bool benchmark(ccCommandLineInterface& cmd, ccPointCloud* cloud, PointCoordinateType radius)
+	{
+		ccOctree::Shared octree = cloud->getOctree();
+		if (!octree)
+		{
+			octree = cloud->computeOctree(cmd.progressDialog());
+			if (!octree)
+				return cmd.error("Failed to compute the octree (not enough memory?)");
+		}
+
+		unsigned pointCount = cloud->size();
+		QElapsedTimer timer;
+
+		//legacy path (uncompressed normals, compressed afterwards)
+		NormsIndexesTableType* legacyCodes = new NormsIndexesTableType;
+		legacyCodes->link();
+		std::vector<CCVector3> legacyNormals;
+		timer.start();
+		try
+		{
+			legacyNormals.resize(pointCount, CCVector3(0, 0, 0));
+		}
+		catch (const std::bad_alloc&)
+		{
+			legacyCodes->release();
+			return cmd.error("Not enough memory");
+		}
+		if (!legacyCodes->resize(pointCount))
+		{
+			legacyCodes->release();
+			return cmd.error("Not enough memory");
+		}
+		{
+			void* additionalParameters[2] = { static_cast<void*>(&legacyNormals), static_cast<void*>(&radius) };
+			unsigned char level = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(radius);
+			if (octree->executeFunctionForAllCellsAtLevel(level, LegacyComputeNormsAtLevelWithQuadric, additionalParameters, true) == 0)
+			{
+				legacyCodes->release();
+				return cmd.error("[OCTREE NORMALS][Benchmark] Legacy computation failed");
+			}
+			for (unsigned i = 0; i < pointCount; ++i)
+				legacyCodes->setValue(i, ccNormalVectors::GetNormIndex(legacyNormals[i]));
+		}
+		qint64 legacyTime_ms = timer.elapsed();
+		legacyCodes->release();
+
+		//current path
+		NormsIndexesTableType* codes = new NormsIndexesTableType;
+		codes->link();
+		timer.start();
+		if (!ccNormalVectors::ComputeCloudNormals(cloud, *codes, QUADRIC, radius, ccNormalVectors::UNDEFINED, 0, octree.data()))
+		{
+			codes->release();
+			return cmd.error("[OCTREE NORMALS][Benchmark] Computation failed");
+		}
+		qint64 kernelsTime_ms = timer.elapsed();
+
+		//compare the normals
+		unsigned legacyCount = 0;
+		unsigned count = 0;
+		double sumAngle_deg = 0;
+		double maxAngle_deg = 0;
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			const CCVector3& legacyN = legacyNormals[i];
+			CCVector3 N = ccNormalVectors::GetPreciseNormal(codes->getValue(i));
+			bool legacyValid = (legacyN.norm2() != 0);
+			bool valid = (N.norm2() != 0);
+			if (legacyValid)
+				++legacyCount;
+			if (valid)
+				++count;
+			if (legacyValid && valid)
+			{
+				double cosAngle = std::min(1.0, std::abs(static_cast<double>(legacyN.dot(N))));
+				double angle_deg = acos(cosAngle) * CC_RAD_TO_DEG;
+				sumAngle_deg += angle_deg;
+				maxAngle_deg = std::max(maxAngle_deg, angle_deg);
+			}
+		}
+		codes->release();
+
+		cmd.print(QString("[OCTREE NORMALS][Benchmark] Cloud '%1' (%2 points): legacy %3 ms - kernels %4 ms (x%5)")
+			.arg(cloud->getName())
+			.arg(pointCount)
+			.arg(legacyTime_ms)
+			.arg(kernelsTime_ms)
+			.arg(static_cast<double>(legacyTime_ms) / std::max<qint64>(1, kernelsTime_ms), 0, 'f', 1));
+		cmd.print(QString("[OCTREE NORMALS][Benchmark] Normals: %1 (legacy) / %2 (kernels) - angle between them: mean %3 deg. / max %4 deg.")
+			.arg(legacyCount)
+			.arg(count)
+			.arg(std::min(legacyCount, count) ? sumAngle_deg / std::min(legacyCount, count) : 0, 0, 'f', 3)
+			.arg(maxAngle_deg, 0, 'f', 3));
+
+		return true;
+	}
+
 	virtual bool process(ccCommandLineInterface& cmd) override
 	{
 		cmd.print("[OCTREE NORMALS CALCULATION]");
@@ -531,12 +814,25 @@ struct CommandOctreeNormal : public ccCommandLineInterface::Command
 
 		cmd.print(QString("\tRadius: %1").arg(radius));
 
+		bool benchmarkMode = false;
+		if (!cmd.arguments().empty() && ccCommandLineInterface::IsCommand(cmd.arguments().front(), COMMAND_OCTREE_NORMALS_BENCHMARK))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			benchmarkMode = true;
+		}
+
 		CC_LOCAL_MODEL_TYPES model = QUADRIC;
 		ccNormalVectors::Orientation  orientation = ccNormalVectors::Orientation::UNDEFINED;
 
 		for (const CLCloudDesc& thisCloudDesc : cmd.clouds())
 		{
 			ccPointCloud* cloud = thisCloudDesc.pc;
+			if (benchmarkMode && !benchmark(cmd, cloud, radius))
+			{
+				return false;
+			}
 			cmd.print("computeNormalsWithOctree started...\n");
 			bool success = cloud->computeNormalsWithOctree(QUADRIC, orientation, radius, nullptr);
 			if(success)
@@ -1989,6 +2285,21 @@ struct CommandSORFilter : public ccCommandLineInterface::Command
 		if (!ok || nSigma < 0)
 			return cmd.error(QString("Invalid parameter: sigma multiplier (%1)").arg(nSigma));
 
+		//optional parameters
+		int maxThreadCount = 0;
+		if (!cmd.arguments().empty() && ccCommandLineInterface::IsCommand(cmd.arguments().front(), COMMAND_MAX_THREAD_COUNT))
+		{
+			//local option confirmed, we can move on
+			cmd.arguments().pop_front();
+
+			if (cmd.arguments().empty())
+				return cmd.error(QString("Missing parameter: max thread count after '%1'").arg(COMMAND_MAX_THREAD_COUNT));
+
+			maxThreadCount = cmd.arguments().takeFirst().toInt(&ok);
+			if (!ok || maxThreadCount < 0)
+				return cmd.error(QString("Invalid thread count! (after %1)").arg(COMMAND_MAX_THREAD_COUNT));
+		}
+
 		if (cmd.clouds().empty())
 			return cmd.error(QString("No cloud available. Be sure to open one first!"));
 
@@ -2004,12 +2315,13 @@ struct CommandSORFilter : public ccCommandLineInterface::Command
 			ccPointCloud* cloud = cmd.clouds()[i].pc;
 			assert(cloud);
 
-			//computation
+			//computation (the neighbors search is done in parallel)
 			CCLib::ReferenceCloud* selection = CCLib::CloudSamplingTools::sorFilter(cloud,
 																					knn,
 																					nSigma,
-																					0,
-																					progressDialog.data());
+																					cloud->getOctree().data(),
+																					progressDialog.data(),
+																					maxThreadCount);
 
 			if (selection)
 			{
@@ -2623,6 +2935,7 @@ struct CommandDist : public ccCommandLineInterface::Command
 
 		//inner loop for Distance computation options
 		bool flipNormals = false;
+		bool useTriangleBVH = false;
 		double maxDist = 0.0;
 		unsigned octreeLevel = 0;
 		int maxThreadCount = 0;
@@ -2645,6 +2958,16 @@ struct CommandDist : public ccCommandLineInterface::Command
 				if (!m_cloud2meshDist)
 					cmd.warning("Parameter \"-%1\" ignored: only for C2M distance!");
 			}
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_C2M_DIST_USE_BVH))
+			{
+				//local option confirmed, we can move on
+				cmd.arguments().pop_front();
+
+				useTriangleBVH = true;
+
+				if (!m_cloud2meshDist)
+					cmd.warning(QString("Parameter \"-%1\" ignored: only for C2M distance!").arg(COMMAND_C2M_DIST_USE_BVH));
+			}
 			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_C2X_MAX_DISTANCE))
 			{
 				//local option confirmed, we can move on
@@ -2748,67 +3071,79 @@ struct CommandDist : public ccCommandLineInterface::Command
 			}
 		}
 
-		//spawn dialog (virtually) so as to prepare the comparison process
-		ccComparisonDlg compDlg(compCloud.pc,
-								refEntity,
-								m_cloud2meshDist ? ccComparisonDlg::CLOUDMESH_DIST : ccComparisonDlg::CLOUDCLOUD_DIST,
-								cmd.widgetParent(),
-								true);
-
-		//update parameters
-		if (maxDist > 0)
-		{
-			compDlg.maxDistCheckBox->setChecked(true);
-			compDlg.maxSearchDistSpinBox->setValue(maxDist);
-		}
-		if (octreeLevel > 0)
-		{
-			compDlg.octreeLevelComboBox->setCurrentIndex(octreeLevel);
-		}
-		if (maxThreadCount != 0)
-		{
-			compDlg.maxThreadCountSpinBox->setValue(maxThreadCount);
-		}
-
-		//C2M-only parameters
-		if (m_cloud2meshDist)
+		if (cmd.silentMode())
 		{
-			if (flipNormals)
-				compDlg.flipNormalsCheckBox->setChecked(true);
+			//no dialog: we call the distance computation tools directly
+			//(so that this command can be processed outside of the main thread in batch mode)
+			if (!computeDistances(cmd, compCloud.pc, refEntity, flipNormals, useTriangleBVH, maxDist, octreeLevel, maxThreadCount, splitXYZ, modelIndex, useKNN, nSize))
+				return false;
 		}
-		//C2C-only parameters
 		else
 		{
-			if (splitXYZ)
+			//spawn dialog (virtually) so as to prepare the comparison process
+			ccComparisonDlg compDlg(compCloud.pc,
+									refEntity,
+									m_cloud2meshDist ? ccComparisonDlg::CLOUDMESH_DIST : ccComparisonDlg::CLOUDCLOUD_DIST,
+									cmd.widgetParent(),
+									true);
+
+			//update parameters
+			if (maxDist > 0)
+			{
+				compDlg.maxDistCheckBox->setChecked(true);
+				compDlg.maxSearchDistSpinBox->setValue(maxDist);
+			}
+			if (octreeLevel > 0)
+			{
+				compDlg.octreeLevelComboBox->setCurrentIndex(octreeLevel);
+			}
+			if (maxThreadCount != 0)
+			{
+				compDlg.maxThreadCountSpinBox->setValue(maxThreadCount);
+			}
+
+			//C2M-only parameters
+			if (m_cloud2meshDist)
 			{
-				//DGM: not true anymore
-				//if (maxDist > 0)
-				//	cmd.warning("'Split XYZ' option is ignored if max distance is defined!");
-				compDlg.split3DCheckBox->setChecked(true);
+				if (flipNormals)
+					compDlg.flipNormalsCheckBox->setChecked(true);
+				if (useTriangleBVH)
+					compDlg.useTriangleBVHCheckBox->setChecked(true);
 			}
-			if (modelIndex != 0)
+			//C2C-only parameters
+			else
 			{
-				compDlg.localModelComboBox->setCurrentIndex(modelIndex);
-				if (useKNN)
+				if (splitXYZ)
 				{
-					compDlg.lmKNNRadioButton->setChecked(true);
-					compDlg.lmKNNSpinBox->setValue(static_cast<int>(nSize));
+					//DGM: not true anymore
+					//if (maxDist > 0)
+					//	cmd.warning("'Split XYZ' option is ignored if max distance is defined!");
+					compDlg.split3DCheckBox->setChecked(true);
 				}
-				else
+				if (modelIndex != 0)
 				{
-					compDlg.lmRadiusRadioButton->setChecked(true);
-					compDlg.lmRadiusDoubleSpinBox->setValue(nSize);
+					compDlg.localModelComboBox->setCurrentIndex(modelIndex);
+					if (useKNN)
+					{
+						compDlg.lmKNNRadioButton->setChecked(true);
+						compDlg.lmKNNSpinBox->setValue(static_cast<int>(nSize));
+					}
+					else
+					{
+						compDlg.lmRadiusRadioButton->setChecked(true);
+						compDlg.lmRadiusDoubleSpinBox->setValue(nSize);
+					}
 				}
 			}
-		}
 
-		if (!compDlg.computeDistances())
-		{
-			compDlg.cancelAndExit();
-			return cmd.error("An error occurred during distances computation!");
-		}
+			if (!compDlg.computeDistances())
+			{
+				compDlg.cancelAndExit();
+				return cmd.error("An error occurred during distances computation!");
+			}
 
-		compDlg.applyAndExit();
+			compDlg.applyAndExit();
+		}
 
 		QString suffix(m_cloud2meshDist ? "_C2M_DIST" : "_C2C_DIST");
 		if (maxDist > 0)
@@ -2826,6 +3161,220 @@ struct CommandDist : public ccCommandLineInterface::Command
 		return true;
 	}
 
+	//! Computes the distances without the comparison dialog (silent mode)
+	/** Same process as ccComparisonDlg (approximate distances, automatic
+		octree level, etc.) but without any widget.
+	**/
+	bool computeDistances(	ccCommandLineInterface& cmd,
+							ccPointCloud* compCloud,
+							ccHObject* refEntity,
+							bool flipNormals,
+							bool useTriangleBVH,
+							double maxDist,
+							unsigned octreeLevel,
+							int maxThreadCount,
+							bool splitXYZ,
+							int modelIndex,
+							bool useKNN,
+							double nSize)
+	{
+		assert(compCloud && refEntity);
+
+		ccGenericMesh* refMesh = 0;
+		ccGenericPointCloud* refCloud = 0;
+		ccOctree::Shared refOctree;
+		if (m_cloud2meshDist)
+		{
+			refMesh = ccHObjectCaster::ToGenericMesh(refEntity);
+			if (!refMesh)
+				return cmd.error("Invalid reference mesh!");
+		}
+		else
+		{
+			refCloud = ccHObjectCaster::ToGenericPointCloud(refEntity);
+			if (!refCloud)
+				return cmd.error("Invalid reference cloud!");
+			refOctree = refCloud->getOctree();
+			if (!refOctree)
+				refOctree = ccOctree::Shared(new ccOctree(refCloud));
+		}
+
+		//the octree will be built (if necessary) by the distance computation tools
+		ccOctree::Shared compOctree = compCloud->getOctree();
+		if (!compOctree)
+			compOctree = ccOctree::Shared(new ccOctree(compCloud));
+
+		if (octreeLevel == 0)
+		{
+			//approximate distances (to guess the best octree level)
+			int sfIdx = compCloud->getScalarFieldIndexByName(CC_TEMP_APPROX_DISTANCES_DEFAULT_SF_NAME);
+			if (sfIdx < 0)
+				sfIdx = compCloud->addScalarField(CC_TEMP_APPROX_DISTANCES_DEFAULT_SF_NAME);
+			if (sfIdx < 0)
+				return cmd.error("Not enough memory!");
+			compCloud->setCurrentScalarField(sfIdx);
+
+			int approxResult = -1;
+			if (m_cloud2meshDist)
+			{
+				CCLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams c2mParams;
+				{
+					c2mParams.octreeLevel = 7;
+					c2mParams.maxSearchDist = 0;
+					c2mParams.useDistanceMap = true;
+					c2mParams.signedDistances = false;
+					c2mParams.flipNormals = false;
+					c2mParams.multiThread = false;
+				}
+				approxResult = CCLib::DistanceComputationTools::computeCloud2MeshDistance(compCloud, refMesh, c2mParams, 0, compOctree.data());
+			}
+			else
+			{
+				approxResult = CCLib::DistanceComputationTools::computeApproxCloud2CloudDistance(compCloud, refCloud, 7, 0, 0, compOctree.data(), refOctree.data());
+			}
+
+			int bestOctreeLevel = -1;
+			if (approxResult >= 0)
+			{
+				bestOctreeLevel = ccComparisonDlg::DetermineBestOctreeLevel(compOctree.data(),
+																			compCloud->getScalarField(sfIdx),
+																			refOctree.data(),
+																			refMesh,
+																			maxDist);
+			}
+			compCloud->deleteScalarField(sfIdx);
+
+			if (bestOctreeLevel <= 0)
+				return cmd.error(QString("Can't evaluate best octree level! Try to set it manually (-%1)").arg(COMMAND_C2X_OCTREE_LEVEL));
+
+			octreeLevel = static_cast<unsigned>(bestOctreeLevel);
+			cmd.print(QString("[Distances] Octree level (auto): %1").arg(octreeLevel));
+		}
+
+		int sfIdx = compCloud->getScalarFieldIndexByName(CC_TEMP_DISTANCES_DEFAULT_SF_NAME);
+		if (sfIdx < 0)
+			sfIdx = compCloud->addScalarField(CC_TEMP_DISTANCES_DEFAULT_SF_NAME);
+		if (sfIdx < 0)
+			return cmd.error("Not enough memory!");
+		compCloud->setCurrentScalarField(sfIdx);
+
+		//0 = default thread count (i.e. the per-job budget in batch mode)
+		CCLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams c2cParams;
+		CCLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams c2mParams;
+		c2cParams.maxThreadCount = c2mParams.maxThreadCount = maxThreadCount;
+
+		//signed distances are always computed with meshes (as with the dialog)
+		bool signedDistances = m_cloud2meshDist;
+
+		int result = -1;
+		if (m_cloud2meshDist)
+		{
+			c2mParams.octreeLevel = static_cast<unsigned char>(octreeLevel);
+			c2mParams.maxSearchDist = static_cast<ScalarType>(maxDist);
+			c2mParams.useDistanceMap = false;
+			c2mParams.signedDistances = signedDistances;
+			c2mParams.flipNormals = flipNormals;
+			//max search distance is not supported by the multi-threaded octree path
+			c2mParams.multiThread = (maxDist <= 0 || useTriangleBVH);
+			c2mParams.useTriangleBVH = useTriangleBVH;
+			if (!c2mParams.multiThread)
+				cmd.warning("Max search distance is not supported in multi-thread mode! Switching to single thread mode...");
+
+			result = CCLib::DistanceComputationTools::computeCloud2MeshDistance(compCloud, refMesh, c2mParams, 0, compOctree.data());
+		}
+		else
+		{
+			flipNormals = false;
+
+			if (splitXYZ)
+			{
+				//we create 3 new scalar fields, one for each dimension
+				for (unsigned j = 0; j < 3; ++j)
+				{
+					ccScalarField* sfDim = new ccScalarField();
+					sfDim->link();
+					c2cParams.splitDistances[j] = sfDim;
+					if (!sfDim->resize(compCloud->size()))
+					{
+						for (unsigned k = 0; k <= j; ++k)
+						{
+							c2cParams.splitDistances[k]->release();
+							c2cParams.splitDistances[k] = 0;
+						}
+						cmd.warning("Not enough memory to generate 3D split fields!");
+						break;
+					}
+				}
+			}
+
+			c2cParams.octreeLevel = static_cast<unsigned char>(octreeLevel);
+			c2cParams.localModel = static_cast<CC_LOCAL_MODEL_TYPES>(modelIndex);
+			if (c2cParams.localModel != NO_MODEL)
+			{
+				c2cParams.useSphericalSearchForLocalModel = !useKNN;
+				c2cParams.kNNForLocalModel = static_cast<unsigned>(std::max(0.0, nSize));
+				c2cParams.radiusForLocalModel = static_cast<ScalarType>(nSize);
+				c2cParams.reuseExistingLocalModels = false;
+			}
+			c2cParams.maxSearchDist = static_cast<ScalarType>(maxDist);
+			c2cParams.multiThread = true;
+			c2cParams.CPSet = 0;
+
+			result = CCLib::DistanceComputationTools::computeCloud2CloudDistance(compCloud, refCloud, c2cParams, 0, compOctree.data(), refOctree.data());
+		}
+
+		if (result >= 0)
+		{
+			QString sfName = ccComparisonDlg::GetDistancesSFName(	m_cloud2meshDist ? ccComparisonDlg::CLOUDMESH_DIST : ccComparisonDlg::CLOUDCLOUD_DIST,
+																	c2cParams,
+																	signedDistances,
+																	flipNormals,
+																	maxDist);
+
+			//we delete any existing scalar field with the exact same name
+			int _sfIdx = compCloud->getScalarFieldIndexByName(qPrintable(sfName));
+			if (_sfIdx >= 0)
+			{
+				compCloud->deleteScalarField(_sfIdx);
+				sfIdx = compCloud->getScalarFieldIndexByName(CC_TEMP_DISTANCES_DEFAULT_SF_NAME);
+			}
+			compCloud->renameScalarField(sfIdx, qPrintable(sfName));
+			compCloud->getScalarField(sfIdx)->computeMinAndMax();
+			compCloud->setCurrentDisplayedScalarField(sfIdx);
+
+			//we add the split scalar fields (one for each dimension)
+			static const QChar charDim[3] = { 'X', 'Y', 'Z' };
+			for (unsigned j = 0; j < 3; ++j)
+			{
+				CCLib::ScalarField* sf = c2cParams.splitDistances[j];
+				if (sf)
+				{
+					sf->setName(qPrintable(sfName + QString(" (%1)").arg(charDim[j])));
+					sf->computeMinAndMax();
+					int sfExist = compCloud->getScalarFieldIndexByName(sf->getName());
+					if (sfExist >= 0)
+						compCloud->deleteScalarField(sfExist);
+					compCloud->addScalarField(static_cast<ccScalarField*>(sf));
+				}
+			}
+		}
+		else
+		{
+			compCloud->deleteScalarField(sfIdx);
+		}
+
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			if (c2cParams.splitDistances[j])
+				c2cParams.splitDistances[j]->release();
+		}
+
+		if (result < 0)
+			return cmd.error(QString("An error occurred during distances computation! (error code %1)").arg(result));
+
+		return true;
+	}
+
 	bool m_cloud2meshDist;
 };
 
@@ -3328,42 +3877,66 @@ struct CommandICP : public ccCommandLineInterface::Command
 		int modelSFAsWeights = -1;
 		int dataSFAsWeights = -1;
 		int maxThreadCount = 0;
+		bool useStaticModelIndex = false;
+		bool pointToPlane = false;
+		bool benchmark = false;
 
 		while (!cmd.arguments().empty())
 		{
 			QString argument = cmd.arguments().front();
-			if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_REFERENCE_IS_FIRST))
+			if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_STATIC_INDEX))
 			{
 				//local option confirmed, we can move on
 				cmd.arguments().pop_front();
 
-				referenceIsFirst = true;
+				useStaticModelIndex = true;
 			}
-			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_ADJUST_SCALE))
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_POINT_TO_PLANE))
 			{
 				//local option confirmed, we can move on
 				cmd.arguments().pop_front();
 
-				adjustScale = true;
+				pointToPlane = true;
 			}
-			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_ENABLE_FARTHEST_REMOVAL))
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_BENCHMARK))
 			{
 				//local option confirmed, we can move on
 				cmd.arguments().pop_front();
 
-				enableFarthestPointRemoval = true;
+				benchmark = true;
 			}
-			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_MIN_ERROR_DIIF))
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_REFERENCE_IS_FIRST))
 			{
 				//local option confirmed, we can move on
 				cmd.arguments().pop_front();
 
-				if (cmd.arguments().empty())
-					return cmd.error(QString("Missing parameter: min error difference after '%1'").arg(COMMAND_ICP_MIN_ERROR_DIIF));
-				bool ok;
-				minErrorDiff = cmd.arguments().takeFirst().toDouble(&ok);
-				if (!ok || minErrorDiff <= 0)
-					return cmd.error(QString("Invalid value for min. error difference! (after %1)").arg(COMMAND_ICP_MIN_ERROR_DIIF));
+				referenceIsFirst = true;
+			}
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_ADJUST_SCALE))
+			{
+				//local option confirmed, we can move on
+				cmd.arguments().pop_front();
+
+				adjustScale = true;
+			}
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_ENABLE_FARTHEST_REMOVAL))
+			{
+				//local option confirmed, we can move on
+				cmd.arguments().pop_front();
+
+				enableFarthestPointRemoval = true;
+			}
+			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_MIN_ERROR_DIIF))
+			{
+				//local option confirmed, we can move on
+				cmd.arguments().pop_front();
+
+				if (cmd.arguments().empty())
+					return cmd.error(QString("Missing parameter: min error difference after '%1'").arg(COMMAND_ICP_MIN_ERROR_DIIF));
+				bool ok;
+				minErrorDiff = cmd.arguments().takeFirst().toDouble(&ok);
+				if (!ok || minErrorDiff <= 0)
+					return cmd.error(QString("Invalid value for min. error difference! (after %1)").arg(COMMAND_ICP_MIN_ERROR_DIIF));
 			}
 			else if (ccCommandLineInterface::IsCommand(argument, COMMAND_ICP_ITERATION_COUNT))
 			{
@@ -3522,10 +4095,50 @@ struct CommandICP : public ccCommandLineInterface::Command
 			}
 		}
 
+		//benchmark mode: we first run the legacy ICP (per-iteration octrees) as reference
+		//(the data entity is only transformed at the very end)
+		qint64 legacyTime_ms = -1;
+		if (benchmark && (useStaticModelIndex || pointToPlane))
+		{
+			ccGLMatrix legacyTransMat;
+			double legacyError = 0.0;
+			double legacyScale = 1.0;
+			unsigned legacyPointCount = 0;
+			QElapsedTimer timer;
+			timer.start();
+			if (!ccRegistrationTools::ICP(	dataAndModel[0]->getEntity(),
+											dataAndModel[1]->getEntity(),
+											legacyTransMat,
+											legacyScale,
+											legacyError,
+											legacyPointCount,
+											minErrorDiff,
+											iterationCount,
+											randomSamplingLimit,
+											enableFarthestPointRemoval,
+											iterationCount != 0 ? CCLib::ICPRegistrationTools::MAX_ITER_CONVERGENCE : CCLib::ICPRegistrationTools::MAX_ERROR_CONVERGENCE,
+											adjustScale,
+											overlap / 100.0,
+											dataSFAsWeights >= 0,
+											modelSFAsWeights >= 0,
+											CCLib::ICPRegistrationTools::SKIP_NONE,
+											maxThreadCount,
+											false,
+											false,
+											cmd.widgetParent()))
+			{
+				return cmd.error("[ICP][Benchmark] Legacy registration failed");
+			}
+			legacyTime_ms = timer.elapsed();
+			cmd.print(QString("[ICP][Benchmark] Legacy: %1 ms (RMS: %2)").arg(legacyTime_ms).arg(legacyError));
+		}
+
 		ccGLMatrix transMat;
 		double finalError = 0.0;
 		double finalScale = 1.0;
 		unsigned finalPointCount = 0;
+		QElapsedTimer timer;
+		timer.start();
 		if (ccRegistrationTools::ICP(	dataAndModel[0]->getEntity(),
 										dataAndModel[1]->getEntity(),
 										transMat,
@@ -3543,8 +4156,18 @@ struct CommandICP : public ccCommandLineInterface::Command
 										modelSFAsWeights >= 0,
 										CCLib::ICPRegistrationTools::SKIP_NONE,
 										maxThreadCount,
+										useStaticModelIndex,
+										pointToPlane,
 										cmd.widgetParent()))
 		{
+			if (benchmark)
+			{
+				qint64 time_ms = timer.elapsed();
+				cmd.print(QString("[ICP][Benchmark] %1%2: %3 ms").arg(pointToPlane ? "Point-to-plane" : "Point-to-point").arg(useStaticModelIndex ? " (static index)" : "").arg(time_ms));
+				if (legacyTime_ms > 0 && time_ms > 0)
+					cmd.print(QString("[ICP][Benchmark] Speed-up: x%1").arg(static_cast<double>(legacyTime_ms) / time_ms, 0, 'f', 2));
+			}
+
 			ccHObject* data = dataAndModel[0]->getEntity();
 			data->applyGLTransformation_recursive(&transMat);
 			cmd.print(QString("Entity '%1' has been registered").arg(data->getName()));
@@ -3816,4 +4439,807 @@ struct CommandSetNoTimestamp : public ccCommandLineInterface::Command
 	}
 };
 
+struct CommandScratchStorage : public ccCommandLineInterface::Command
+{
+	CommandScratchStorage() : ccCommandLineInterface::Command("Scratch storage", COMMAND_SCRATCH_STORAGE) {}
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		if (cmd.arguments().empty())
+			return cmd.error(QString("Missing parameter: directory (or '%1') after '%2'").arg(OPTION_OFF, COMMAND_SCRATCH_STORAGE));
+
+		QString option = cmd.arguments().takeFirst();
+		if (option.toUpper() == OPTION_OFF)
+		{
+			ArrayStorage::SetDefaultBackend(ArrayStorage::HEAP_MEMORY);
+			cmd.print("New entities will be stored in memory");
+			return true;
+		}
+
+#ifdef CC_ENV_64
+		QDir dir(option);
+		if (!dir.exists())
+			return cmd.error(QString("Scratch directory '%1' doesn't exist").arg(option));
+
+		//the new arrays (coordinates, colors, normals, scalar fields, etc.) will be mapped on (temporary) files
+		ArrayStorage::SetScratchDirectory(QDir::toNativeSeparators(dir.absolutePath()).toStdString());
+		ArrayStorage::SetDefaultBackend(ArrayStorage::MAPPED_FILE);
+		cmd.print(QString("New entities will be stored in scratch files (in '%1') as soon as they exceed %2 MB").arg(dir.absolutePath()).arg(ArrayStorage::GetMappingThreshold() >> 20));
+#else
+		cmd.warning(QString("'%1' is only supported by 64 bits versions").arg(COMMAND_SCRATCH_STORAGE));
+#endif
+
+		return true;
+	}
+};
+
+struct CommandPreciseNormals : public ccCommandLineInterface::Command
+{
+	CommandPreciseNormals() : ccCommandLineInterface::Command("Precise normals", COMMAND_PRECISE_NORMALS) {}
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		if (cmd.arguments().empty())
+			return cmd.error(QString("Missing parameter: '%1' or '%2' after '%3'").arg(OPTION_ON, OPTION_OFF, COMMAND_PRECISE_NORMALS));
+
+		QString option = cmd.arguments().takeFirst().toUpper();
+		if (option == OPTION_ON)
+		{
+			//the normals will be compressed with the higher precision codes (saved in BIN files version 5.0 or later)
+			ccNormalVectors::EnablePreciseNormals(true);
+			cmd.print("Normals will be stored with the higher precision codes");
+		}
+		else if (option == OPTION_OFF)
+		{
+			ccNormalVectors::EnablePreciseNormals(false);
+			cmd.print("Normals will be stored with the standard codes");
+		}
+		else
+		{
+			return cmd.error(QString("Invalid parameter: '%1' or '%2' expected after '%3'").arg(OPTION_ON, OPTION_OFF, COMMAND_PRECISE_NORMALS));
+		}
+
+		return true;
+	}
+};
+
+struct CommandBinBenchmark : public ccCommandLineInterface::Command
+{
+	CommandBinBenchmark() : ccCommandLineInterface::Command("BIN benchmark", COMMAND_BIN_BENCHMARK) {}
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		unsigned pointCount = 100000000; //100M points by default
+
+		//optional point count
+		if (!cmd.arguments().empty())
+		{
+			bool ok = false;
+			unsigned count = cmd.arguments().front().toUInt(&ok);
+			if (ok)
+			{
+				cmd.arguments().pop_front();
+				if (count == 0)
+					return cmd.error(QString("Invalid point count after '%1'").arg(COMMAND_BIN_BENCHMARK));
+				pointCount = count;
+			}
+		}
+
+		static const unsigned SFCount = 5;
+		static const char* SFNames[SFCount] = { "Intensity", "Return number", "GPS time", "Classification", "Distance" };
+
+		cmd.print(QString("[BIN][Benchmark] Generating a cloud of %1 points (with normals, colors and %2 scalar fields)").arg(pointCount).arg(SFCount));
+
+		//synthetic cloud: a gently undulating terrain scanned line by line
+		QScopedPointer<ccPointCloud> cloud(new ccPointCloud("BIN benchmark"));
+		if (!cloud->reserve(pointCount) || !cloud->reserveTheNormsTable() || !cloud->reserveTheRGBTable())
+			return cmd.error("Not enough memory");
+
+		static const unsigned PointsPerLine = 10000;
+		static const float Step = 0.01f;
+		std::mt19937 gen(0);
+		std::uniform_real_distribution<float> noise(-0.005f, 0.005f);
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			float x = (i % PointsPerLine) * Step;
+			float y = (i / PointsPerLine) * Step;
+			float z = 2.0f * sin(x / 10) * cos(y / 10);
+			cloud->addPoint(CCVector3(x, y, z + noise(gen)));
+
+			CCVector3 N(-0.2f * cos(x / 10) * cos(y / 10), 0.2f * sin(x / 10) * sin(y / 10), 1.0f);
+			N.normalize();
+			cloud->addNorm(N);
+
+			ColorCompType c = static_cast<ColorCompType>(std::min(255.0f, 64.0f * (z + 2.0f)));
+			cloud->addRGBColor(c, c, static_cast<ColorCompType>(255 - c));
+		}
+
+		for (unsigned k = 0; k < SFCount; ++k)
+		{
+			int sfIdx = cloud->addScalarField(SFNames[k]);
+			if (sfIdx < 0)
+				return cmd.error("Not enough memory");
+			CCLib::ScalarField* sf = cloud->getScalarField(sfIdx);
+			for (unsigned i = 0; i < pointCount; ++i)
+			{
+				ScalarType value = 0;
+				switch (k)
+				{
+				case 0: //intensity
+					value = static_cast<ScalarType>(static_cast<int>(1000 + 500 * cloud->getPoint(i)->z) + static_cast<int>(gen() % 50));
+					break;
+				case 1: //return number
+					value = static_cast<ScalarType>(1 + (gen() % 8 == 0 ? 1 : 0));
+					break;
+				case 2: //GPS time
+					value = static_cast<ScalarType>(i / PointsPerLine) + static_cast<ScalarType>(i % PointsPerLine) * 1.0e-5f;
+					break;
+				case 3: //classification
+					value = static_cast<ScalarType>(cloud->getPoint(i)->z > 1.0f ? 5 : 2);
+					break;
+				default: //distance
+					value = static_cast<ScalarType>(cloud->getPoint(i)->z + noise(gen));
+					break;
+				}
+				sf->setValue(i, value);
+			}
+			sf->computeMinAndMax();
+		}
+
+		//raw size of the arrays
+		qint64 rawSize = static_cast<qint64>(pointCount) * (sizeof(CCVector3) + sizeof(CompressedNormType) + 3 * sizeof(ColorCompType) + SFCount * sizeof(ScalarType));
+
+		QString filename = QDir::temp().absoluteFilePath(QString("cc_bin_benchmark_%1.bin").arg(QCoreApplication::applicationPid()));
+
+		//save
+		QElapsedTimer timer;
+		timer.start();
+		{
+			FileIOFilter::SaveParameters parameters;
+			parameters.alwaysDisplaySaveDialog = false;
+			parameters.parentWidget = cmd.widgetParent();
+			CC_FILE_ERROR result = FileIOFilter::SaveToFile(cloud.data(), filename, parameters, BinFilter::GetFileFilter());
+			if (result != CC_FERR_NO_ERROR)
+			{
+				QFile::remove(filename);
+				return cmd.error("[BIN][Benchmark] Failed to save the cloud");
+			}
+		}
+		qint64 saveTime_ms = std::max<qint64>(1, timer.elapsed());
+		qint64 fileSize = QFileInfo(filename).size();
+
+		//load
+		timer.start();
+		ccHObject* container = 0;
+		{
+			FileIOFilter::LoadParameters parameters;
+			parameters.alwaysDisplayLoadDialog = false;
+			parameters.shiftHandlingMode = ccGlobalShiftManager::NO_DIALOG;
+			parameters.parentWidget = cmd.widgetParent();
+			CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+			container = FileIOFilter::LoadFromFile(filename, parameters, result, BinFilter::GetFileFilter());
+		}
+		qint64 loadTime_ms = std::max<qint64>(1, timer.elapsed());
+		QFile::remove(filename);
+
+		ccPointCloud* loadedCloud = 0;
+		if (container)
+		{
+			ccHObject::Container clouds;
+			if (container->isA(CC_TYPES::POINT_CLOUD))
+				clouds.push_back(container);
+			else
+				container->filterChildren(clouds, true, CC_TYPES::POINT_CLOUD, true);
+			if (clouds.size() == 1)
+				loadedCloud = ccHObjectCaster::ToPointCloud(clouds.front());
+		}
+		if (!loadedCloud)
+		{
+			delete container;
+			return cmd.error("[BIN][Benchmark] Failed to load the cloud back");
+		}
+
+		//check that the round trip is lossless
+		bool identical = (	loadedCloud->size() == pointCount
+						&&	loadedCloud->hasNormals()
+						&&	loadedCloud->hasColors()
+						&&	loadedCloud->getNumberOfScalarFields() == SFCount);
+		for (unsigned i = 0; identical && i < pointCount; ++i)
+		{
+			identical = (	memcmp(loadedCloud->getPoint(i)->u, cloud->getPoint(i)->u, sizeof(CCVector3)) == 0
+						&&	loadedCloud->getPointNormalIndex(i) == cloud->getPointNormalIndex(i)
+						&&	memcmp(loadedCloud->getPointColor(i), cloud->getPointColor(i), 3 * sizeof(ColorCompType)) == 0);
+		}
+		for (unsigned k = 0; identical && k < SFCount; ++k)
+		{
+			const CCLib::ScalarField* sf = cloud->getScalarField(static_cast<int>(k));
+			const CCLib::ScalarField* loadedSF = loadedCloud->getScalarField(loadedCloud->getScalarFieldIndexByName(sf->getName()));
+			identical = (loadedSF != 0);
+			for (unsigned i = 0; identical && i < pointCount; ++i)
+				identical = (loadedSF->getValue(i) == sf->getValue(i));
+		}
+		delete container;
+
+		if (!identical)
+			return cmd.error("[BIN][Benchmark] The loaded cloud differs from the saved one!");
+
+		cmd.print(QString("[BIN][Benchmark] Data: %1 MB / file: %2 MB (ratio: %3%)").arg(rawSize / 1048576).arg(fileSize / 1048576).arg(100.0 * fileSize / rawSize, 0, 'f', 1));
+		cmd.print(QString("[BIN][Benchmark] Save: %1 ms (%2 MB/s)").arg(saveTime_ms).arg(rawSize / 1048.576 / saveTime_ms, 0, 'f', 0));
+		cmd.print(QString("[BIN][Benchmark] Load: %1 ms (%2 MB/s)").arg(loadTime_ms).arg(rawSize / 1048.576 / loadTime_ms, 0, 'f', 0));
+		cmd.print(QString("[BIN][Benchmark] Round trip is lossless (%1 thread(s))").arg(CCLib::ParallelTools::DefaultMaxThreadCount()));
+
+		return true;
+	}
+};
+
+struct CommandPickingBenchmark : public ccCommandLineInterface::Command
+{
+	CommandPickingBenchmark() : ccCommandLineInterface::Command("Picking benchmark", COMMAND_PICKING_BENCHMARK) {}
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		unsigned maxPointCount = 10000000; //up to 10M points by default
+
+		//optional (max) point count
+		if (!cmd.arguments().empty())
+		{
+			bool ok = false;
+			unsigned count = cmd.arguments().front().toUInt(&ok);
+			if (ok)
+			{
+				cmd.arguments().pop_front();
+				if (count == 0)
+					return cmd.error(QString("Invalid point count after '%1'").arg(COMMAND_PICKING_BENCHMARK));
+				maxPointCount = count;
+			}
+		}
+
+		static const unsigned PickCount = 100;
+		static const int ViewportSize = 1000; //in pixels
+		static const double PickWidth_pix = 3.0;
+
+		//the same clicks are used for all clouds
+		std::mt19937 gen(0);
+		std::vector<CCVector2d> clicks(PickCount);
+		{
+			std::uniform_real_distribution<double> pos(0.0, ViewportSize);
+			for (CCVector2d& click : clicks)
+			{
+				click.x = pos(gen);
+				click.y = pos(gen);
+			}
+		}
+
+		//clouds of increasing size (x10 each time)
+		for (unsigned pointCount = std::min(100000u, maxPointCount); ; pointCount = static_cast<unsigned>(std::min<qint64>(static_cast<qint64>(pointCount) * 10, maxPointCount)))
+		{
+			//synthetic cloud: a gently undulating terrain (~1 point per cm2)
+			PointCoordinateType side = static_cast<PointCoordinateType>(sqrt(static_cast<double>(pointCount)) / 100);
+			QScopedPointer<ccPointCloud> cloud(new ccPointCloud("Picking benchmark"));
+			if (!cloud->reserve(pointCount))
+				return cmd.error("Not enough memory");
+			{
+				std::uniform_real_distribution<PointCoordinateType> pos(0, side);
+				for (unsigned i = 0; i < pointCount; ++i)
+				{
+					PointCoordinateType x = pos(gen);
+					PointCoordinateType y = pos(gen);
+					cloud->addPoint(CCVector3(x, y, 2 * sin(x / 10) * cos(y / 10)));
+				}
+			}
+
+			//orthographic camera looking down at the whole cloud
+			ccGLCameraParameters camera;
+			{
+				camera.perspective = false;
+				camera.viewport[2] = camera.viewport[3] = ViewportSize;
+				camera.pixelSize = static_cast<float>(side / ViewportSize);
+				camera.modelViewMat.setTranslation(CCVector3d(-side / 2.0, -side / 2.0, -4.0));
+				camera.projectionMat = ccGL::Ortho(side / 2.0, side / 2.0, 8.0);
+			}
+
+			//brute force (no octree yet)
+			std::vector<int> bruteForceIndexes(PickCount, -1);
+			std::vector<double> bruteForceSquareDists(PickCount, -1.0);
+			QElapsedTimer timer;
+			timer.start();
+			for (unsigned k = 0; k < PickCount; ++k)
+			{
+				cloud->pointPicking(clicks[k], camera, bruteForceIndexes[k], bruteForceSquareDists[k], PickWidth_pix, PickWidth_pix, false);
+			}
+			qint64 bruteForceTime_ns = timer.nsecsElapsed();
+
+			//octree-driven
+			timer.start();
+			ccOctree::Shared octree = cloud->computeOctree(0, false);
+			if (!octree)
+				return cmd.error("Failed to compute the octree (not enough memory?)");
+			qint64 octreeBuildTime_ms = timer.elapsed();
+
+			unsigned hitCount = 0;
+			unsigned mismatchCount = 0;
+			timer.start();
+			for (unsigned k = 0; k < PickCount; ++k)
+			{
+				ccOctree::PointDescriptor output;
+				if (!octree->pointPicking(clicks[k], camera, output, PickWidth_pix))
+					return cmd.error("[Picking][Benchmark] Octree-driven picking failed");
+
+				//both methods use the same criterion (ties aside, they should find the same point)
+				if (output.point)
+				{
+					++hitCount;
+					if (bruteForceIndexes[k] < 0 || output.squareDistd != bruteForceSquareDists[k])
+						++mismatchCount;
+				}
+				else if (bruteForceIndexes[k] >= 0)
+				{
+					++mismatchCount;
+				}
+			}
+			qint64 octreeTime_ns = timer.nsecsElapsed();
+
+			cmd.print(QString("[Picking][Benchmark] %1 points: brute force %2 ms/pick - octree %3 ms/pick (x%4) - octree build %5 ms - %6/%7 hits")
+				.arg(pointCount)
+				.arg(bruteForceTime_ns / 1.0e6 / PickCount, 0, 'f', 3)
+				.arg(octreeTime_ns / 1.0e6 / PickCount, 0, 'f', 3)
+				.arg(static_cast<double>(bruteForceTime_ns) / std::max<qint64>(1, octreeTime_ns), 0, 'f', 1)
+				.arg(octreeBuildTime_ms)
+				.arg(hitCount)
+				.arg(PickCount));
+
+			if (mismatchCount != 0)
+				return cmd.error(QString("[Picking][Benchmark] The octree-driven and brute force picks differ (%1 time(s))!").arg(mismatchCount));
+
+			if (pointCount == maxPointCount)
+				break;
+		}
+
+		return true;
+	}
+};
+
+struct CommandOctreeStress : public ccCommandLineInterface::Command
+{
+	CommandOctreeStress() : ccCommandLineInterface::Command("Octree stress test", COMMAND_OCTREE_STRESS) {}
+
+	//! Cell function: stores, for each point, the cell level and its distance to the cell barycenter
+	/** additionalParameters: std::vector<ScalarType>* (one value per point)
+	**/
+	static bool StoreCellDistances(const CCLib::DgmOctree::octreeCell& cell, void** additionalParameters, CCLib::NormalizedProgress*)
+	{
+		std::vector<ScalarType>& values = *static_cast<std::vector<ScalarType>*>(additionalParameters[0]);
+
+		unsigned count = cell.points->size();
+		CCVector3d G(0, 0, 0);
+		for (unsigned i = 0; i < count; ++i)
+			G += CCVector3d::fromArray(cell.points->getPoint(i)->u);
+		G /= count;
+
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const CCVector3* P = cell.points->getPoint(i);
+			double dist = (CCVector3d::fromArray(P->u) - G).normd();
+			values[cell.points->getPointGlobalIndex(i)] = static_cast<ScalarType>(1000.0 * cell.level + dist);
+		}
+
+		return true;
+	}
+
+	//! Octree job (either at a given level or starting at a given level)
+	struct Job
+	{
+		bool startingAtLevel;
+		unsigned char level;
+		unsigned cellCount;
+		std::vector<ScalarType> values;
+
+		bool run(CCLib::DgmOctree& octree, bool multiThread)
+		{
+			void* additionalParameters[1] = { static_cast<void*>(&values) };
+			if (startingAtLevel)
+				cellCount = octree.executeFunctionForAllCellsStartingAtLevel(level, StoreCellDistances, additionalParameters, 50, 500, multiThread);
+			else
+				cellCount = octree.executeFunctionForAllCellsAtLevel(level, StoreCellDistances, additionalParameters, multiThread);
+			return (cellCount != 0);
+		}
+	};
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		unsigned jobCount = 8;
+
+		//optional job count
+		if (!cmd.arguments().empty())
+		{
+			bool ok = false;
+			unsigned count = cmd.arguments().front().toUInt(&ok);
+			if (ok)
+			{
+				cmd.arguments().pop_front();
+				if (count == 0)
+					return cmd.error(QString("Invalid job count after '%1'").arg(COMMAND_OCTREE_STRESS));
+				jobCount = count;
+			}
+		}
+
+		static const unsigned PointCount = 1000000;
+
+		cmd.print(QString("[Octree][Stress] Generating a cloud of %1 points").arg(PointCount));
+
+		//synthetic cloud: a noisy sphere
+		QScopedPointer<ccPointCloud> cloud(new ccPointCloud("Octree stress test"));
+		if (!cloud->reserve(PointCount))
+			return cmd.error("Not enough memory");
+		{
+			std::mt19937 gen(0);
+			std::normal_distribution<PointCoordinateType> dir(0, 1);
+			std::uniform_real_distribution<PointCoordinateType> noise(-0.01f, 0.01f);
+			for (unsigned i = 0; i < PointCount; ++i)
+			{
+				CCVector3 P(dir(gen), dir(gen), dir(gen));
+				P.normalize();
+				cloud->addPoint(P * (1 + noise(gen)));
+			}
+		}
+
+		CCLib::DgmOctree octree(cloud.data());
+		if (octree.build() <= 0)
+			return cmd.error("Failed to compute the octree (not enough memory?)");
+
+		//the jobs alternate between both traversal methods and different levels
+		std::vector<Job> jobs(jobCount);
+		for (unsigned j = 0; j < jobCount; ++j)
+		{
+			jobs[j].startingAtLevel = ((j & 1) != 0);
+			jobs[j].level = static_cast<unsigned char>(5 + (j / 2) % 4);
+			jobs[j].cellCount = 0;
+			try
+			{
+				jobs[j].values.resize(PointCount, NAN_VALUE);
+			}
+			catch (const std::bad_alloc&)
+			{
+				return cmd.error("Not enough memory");
+			}
+		}
+
+		//reference: serial runs (one job after the other)
+		QElapsedTimer timer;
+		timer.start();
+		std::vector<Job> references(jobs);
+		for (Job& job : references)
+		{
+			if (!job.run(octree, false))
+				return cmd.error("[Octree][Stress] Serial job failed");
+		}
+		qint64 serialTime_ms = timer.elapsed();
+
+		//all the (multi-threaded) jobs at once
+		timer.start();
+		std::atomic<unsigned> failedJobs(0);
+		CCLib::ParallelTools::ForEach(jobCount, [&](unsigned j)
+		{
+			if (!jobs[j].run(octree, true))
+				++failedJobs;
+		}, static_cast<int>(jobCount), 0, 1);
+		qint64 concurrentTime_ms = timer.elapsed();
+
+		if (failedJobs != 0)
+			return cmd.error(QString("[Octree][Stress] %1 concurrent job(s) failed").arg(failedJobs.load()));
+
+		unsigned mismatchCount = 0;
+		for (unsigned j = 0; j < jobCount; ++j)
+		{
+			if (	jobs[j].cellCount != references[j].cellCount
+				||	memcmp(jobs[j].values.data(), references[j].values.data(), PointCount * sizeof(ScalarType)) != 0)
+			{
+				cmd.warning(QString("[Octree][Stress] Job #%1 (%2 level %3) differs from its serial run").arg(j + 1).arg(jobs[j].startingAtLevel ? "starting at" : "at").arg(jobs[j].level));
+				++mismatchCount;
+			}
+		}
+
+		cmd.print(QString("[Octree][Stress] %1 job(s): serial %2 ms - concurrent %3 ms (%4 thread(s) per job)").arg(jobCount).arg(serialTime_ms).arg(concurrentTime_ms).arg(CCLib::ParallelTools::DefaultMaxThreadCount()));
+
+		if (mismatchCount != 0)
+			return cmd.error(QString("[Octree][Stress] %1 concurrent job(s) differ from their serial run!").arg(mismatchCount));
+
+		cmd.print("[Octree][Stress] All concurrent jobs match their serial run");
+
+		return true;
+	}
+};
+
+struct CommandOctreeBuildBenchmark : public ccCommandLineInterface::Command
+{
+	CommandOctreeBuildBenchmark() : ccCommandLineInterface::Command("Octree build benchmark", COMMAND_OCTREE_BUILD_BENCHMARK) {}
+
+	//! Order-sensitive hash of the octree cell codes (and optionally of the point indexes)
+	static quint64 Hash(const CCLib::DgmOctree::cellsContainer& elements, bool withIndexes)
+	{
+		quint64 hash = 14695981039346656037ULL; //FNV-1a
+		for (const CCLib::DgmOctree::IndexAndCode& element : elements)
+		{
+			hash = (hash ^ static_cast<quint64>(element.theCode)) * 1099511628211ULL;
+			if (withIndexes)
+				hash = (hash ^ element.theIndex) * 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	//! Former octree construction (serial projection followed by SortAlgo)
+	/** Only the sorted cell codes are computed (see DgmOctree::genericBuild before the parallel build).
+		\return the hash of the sorted cell codes (or 0 if there's not enough memory)
+	**/
+	static quint64 LegacyBuild(CCLib::GenericIndexedCloudPersist* cloud)
+	{
+		CCVector3 dimMin, dimMax;
+		cloud->getBoundingBox(dimMin, dimMax);
+		CCVector3 pointsMin = dimMin, pointsMax = dimMax;
+		CCLib::CCMiscTools::MakeMinAndMaxCubical(dimMin, dimMax);
+		const PointCoordinateType cs = (dimMax.x - dimMin.x) / (1ULL << CCLib::DgmOctree::MAX_OCTREE_LEVEL);
+
+		unsigned pointCount = cloud->size();
+		CCLib::DgmOctree::cellsContainer elements;
+		try
+		{
+			elements.resize(pointCount);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return 0;
+		}
+
+		unsigned projectedCount = 0;
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			const CCVector3* P = cloud->getPoint(i);
+			if (	P->x < pointsMin.x || P->x > pointsMax.x
+				||	P->y < pointsMin.y || P->y > pointsMax.y
+				||	P->z < pointsMin.z || P->z > pointsMax.z)
+			{
+				continue;
+			}
+
+			Tuple3i cellPos(static_cast<int>((P->x - dimMin.x) / cs),
+							static_cast<int>((P->y - dimMin.y) / cs),
+							static_cast<int>((P->z - dimMin.z) / cs));
+			for (unsigned char k = 0; k < 3; ++k)
+				cellPos.u[k] = std::max(0, std::min(cellPos.u[k], CCLib::DgmOctree::MAX_OCTREE_LENGTH - 1));
+
+			elements[projectedCount].theIndex = i;
+			elements[projectedCount].theCode = CCLib::DgmOctree::GenerateTruncatedCellCode(cellPos, CCLib::DgmOctree::MAX_OCTREE_LEVEL);
+			++projectedCount;
+		}
+		elements.resize(projectedCount);
+
+		SortAlgo(elements.begin(), elements.end(), CCLib::DgmOctree::IndexAndCode::codeComp);
+
+		return Hash(elements, false);
+	}
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		unsigned maxPointCount = 500000000; //up to 500M points by default
+
+		//optional (max) point count
+		if (!cmd.arguments().empty())
+		{
+			bool ok = false;
+			unsigned count = cmd.arguments().front().toUInt(&ok);
+			if (ok)
+			{
+				cmd.arguments().pop_front();
+				if (count == 0)
+					return cmd.error(QString("Invalid point count after '%1'").arg(COMMAND_OCTREE_BUILD_BENCHMARK));
+				maxPointCount = count;
+			}
+		}
+
+		std::vector<unsigned> pointCounts;
+		{
+			static const unsigned DefaultCounts[3] = { 10000000, 100000000, 500000000 };
+			for (unsigned count : DefaultCounts)
+				if (count <= maxPointCount)
+					pointCounts.push_back(count);
+			if (pointCounts.empty())
+				pointCounts.push_back(maxPointCount);
+		}
+
+		int defaultMaxThreadCount = CCLib::ParallelTools::DefaultMaxThreadCount();
+
+		for (unsigned pointCount : pointCounts)
+		{
+			cmd.print(QString("[Octree][Benchmark] Generating a cloud of %1 points").arg(pointCount));
+
+			//synthetic cloud: a gently undulating terrain
+			QScopedPointer<ccPointCloud> cloud(new ccPointCloud("Octree build benchmark"));
+			if (!cloud->reserve(pointCount))
+				return cmd.error("Not enough memory");
+			{
+				PointCoordinateType side = static_cast<PointCoordinateType>(sqrt(pointCount / 100.0)); //~100 points per m2
+				std::mt19937 gen(0);
+				std::uniform_real_distribution<PointCoordinateType> pos(0, side);
+				for (unsigned i = 0; i < pointCount; ++i)
+				{
+					PointCoordinateType x = pos(gen);
+					PointCoordinateType y = pos(gen);
+					cloud->addPoint(CCVector3(x, y, 2 * sin(x / 10) * cos(y / 10)));
+				}
+			}
+
+			QElapsedTimer timer;
+
+			//legacy build
+			timer.start();
+			quint64 legacyHash = LegacyBuild(cloud.data());
+			qint64 legacyTime_ms = timer.elapsed();
+			if (legacyHash == 0)
+				return cmd.error("Not enough memory");
+
+			CCLib::DgmOctree octree(cloud.data());
+
+			//parallel build, with a single thread
+			CCLib::ParallelTools::SetDefaultMaxThreadCount(1);
+			timer.start();
+			int projectedCount = octree.build();
+			qint64 singleThreadTime_ms = timer.elapsed();
+			CCLib::ParallelTools::SetDefaultMaxThreadCount(defaultMaxThreadCount);
+			if (projectedCount <= 0)
+				return cmd.error("Failed to compute the octree (not enough memory?)");
+			quint64 singleThreadHash = Hash(octree.pointsAndTheirCellCodes(), true);
+			bool identical = (Hash(octree.pointsAndTheirCellCodes(), false) == legacyHash);
+
+			//parallel build
+			timer.start();
+			projectedCount = octree.build();
+			qint64 parallelTime_ms = timer.elapsed();
+			if (projectedCount <= 0)
+				return cmd.error("Failed to compute the octree (not enough memory?)");
+			identical = identical && (Hash(octree.pointsAndTheirCellCodes(), true) == singleThreadHash);
+
+			cmd.print(QString("[Octree][Benchmark] %1 points: legacy %2 ms - parallel build %3 ms with 1 thread / %4 ms with %5 thread(s) (x%6)")
+				.arg(pointCount)
+				.arg(legacyTime_ms)
+				.arg(singleThreadTime_ms)
+				.arg(parallelTime_ms)
+				.arg(defaultMaxThreadCount)
+				.arg(static_cast<double>(legacyTime_ms) / std::max<qint64>(1, parallelTime_ms), 0, 'f', 1));
+
+			if (!identical)
+				return cmd.error("[Octree][Benchmark] The legacy and parallel builds don't give the same cells!");
+		}
+
+		return true;
+	}
+};
+
+struct CommandFastMarchingBenchmark : public ccCommandLineInterface::Command
+{
+	CommandFastMarchingBenchmark() : ccCommandLineInterface::Command("Fast Marching benchmark", COMMAND_FAST_MARCHING_BENCHMARK) {}
+
+	//! Fast Marching propagation that keeps track of the TRIAL cells count
+	class BenchmarkFastMarching : public CCLib::FastMarchingForPropagation
+	{
+	public:
+
+		BenchmarkFastMarching() : CCLib::FastMarchingForPropagation(), m_maxTrialCellCount(0) {}
+
+		//! Returns the max number of TRIAL cells during the last propagation
+		size_t maxTrialCellCount() const { return m_maxTrialCellCount; }
+
+		//! Returns the number of ACTIVE cells
+		size_t activeCellCount() const { return m_activeCells.size(); }
+
+		//! Checks that the cells have been activated by increasing front arrival time
+		bool activationOrderIsValid() const
+		{
+			for (size_t i = 1; i < m_activeCells.size(); ++i)
+				if (m_theGrid[m_activeCells[i]]->T < m_theGrid[m_activeCells[i - 1]]->T)
+					return false;
+			return true;
+		}
+
+	protected:
+
+		//inherited from FastMarching
+		virtual void addTrialCell(unsigned index) override
+		{
+			CCLib::FastMarchingForPropagation::addTrialCell(index);
+			m_maxTrialCellCount = std::max(m_maxTrialCellCount, m_trialCells.size());
+		}
+
+		//! Max number of TRIAL cells
+		size_t m_maxTrialCellCount;
+	};
+
+	virtual bool process(ccCommandLineInterface& cmd) override
+	{
+		unsigned char maxLevel = 8; //256^3 cells
+
+		//optional (max) grid level
+		if (!cmd.arguments().empty())
+		{
+			bool ok = false;
+			unsigned level = cmd.arguments().front().toUInt(&ok);
+			if (ok)
+			{
+				cmd.arguments().pop_front();
+				if (level < 4 || level > 9)
+					return cmd.error(QString("Invalid grid level after '%1' (4 to 9)").arg(COMMAND_FAST_MARCHING_BENCHMARK));
+				maxLevel = static_cast<unsigned char>(level);
+			}
+		}
+
+		static const unsigned PointsPerCell = 2;
+		static const unsigned CellsPerSeed = 16;
+
+		for (unsigned char level = std::min<unsigned char>(6, maxLevel); level <= maxLevel; ++level)
+		{
+			unsigned cellCount = (1u << (3 * level));
+			unsigned pointCount = PointsPerCell * cellCount;
+
+			//synthetic cloud: points randomly spread in a cube (so that nearly all the grid cells are filled)
+			QScopedPointer<ccPointCloud> cloud(new ccPointCloud("Fast Marching benchmark"));
+			if (!cloud->reserve(pointCount))
+				return cmd.error("Not enough memory");
+			std::mt19937 gen(0);
+			{
+				std::uniform_real_distribution<PointCoordinateType> pos(0, 1);
+				for (unsigned i = 0; i < pointCount; ++i)
+				{
+					PointCoordinateType x = pos(gen);
+					PointCoordinateType y = pos(gen);
+					PointCoordinateType z = pos(gen);
+					cloud->addPoint(CCVector3(x, y, z));
+				}
+			}
+
+			CCLib::DgmOctree octree(cloud.data());
+			if (octree.build() <= 0)
+				return cmd.error("Failed to compute the octree (not enough memory?)");
+
+			QElapsedTimer timer;
+			timer.start();
+			BenchmarkFastMarching fm;
+			if (fm.init(cloud.data(), &octree, level, true) < 0)
+				return cmd.error("[FM][Benchmark] Failed to initialize the grid (not enough memory?)");
+			qint64 initTime_ms = timer.elapsed();
+
+			//many seeds spread all over the grid: the TRIAL set quickly grows to millions of cells
+			unsigned seedCount = 0;
+			{
+				std::uniform_int_distribution<unsigned> pointIndex(0, pointCount - 1);
+				for (unsigned i = 0; i < cellCount / CellsPerSeed; ++i)
+				{
+					Tuple3i cellPos;
+					octree.getTheCellPosWhichIncludesThePoint(cloud->getPoint(pointIndex(gen)), cellPos, level);
+					if (fm.setSeedCell(cellPos))
+						++seedCount;
+				}
+			}
+
+			timer.start();
+			int result = fm.propagate();
+			qint64 propagationTime_ms = timer.elapsed();
+			if (result < 0)
+				return cmd.error("[FM][Benchmark] Propagation failed");
+
+			cmd.print(QString("[FM][Benchmark] Grid level %1 (%2 cells) - %3 seeds: init %4 ms - propagation %5 ms - %6 cells reached - max TRIAL cells: %7")
+				.arg(level)
+				.arg(cellCount)
+				.arg(seedCount)
+				.arg(initTime_ms)
+				.arg(propagationTime_ms)
+				.arg(fm.activeCellCount())
+				.arg(fm.maxTrialCellCount()));
+
+			if (!fm.activationOrderIsValid())
+				return cmd.error("[FM][Benchmark] The cells haven't been activated by increasing front arrival time!");
+		}
+
+		return true;
+	}
+};
+
 #endif //COMMAND_LINE_COMMANDS_HEADER
@@ -15,16 +15,400 @@
 //qCC
 #include "ccConsole.h"
 
+//CCLib
+#include <CCPlatform.h>
+#include <ParallelTools.h>
+
 //Qt
+#include <QCoreApplication>
+#include <QDateTime>
 #include <QMessageBox>
 #include <QElapsedTimer>
+#include <QFile>
+#include <QFuture>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
 
 //system
+#include <algorithm>
+#include <deque>
 #include <unordered_set>
+#if defined(CC_WINDOWS)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
 //commands
 static const char COMMAND_HELP[]							= "HELP";
 static const char COMMAND_SILENT_MODE[]						= "SILENT";
+static const char COMMAND_PROFILE[]							= "PROFILE";
+static const char COMMAND_PREFETCH[]						= "PREFETCH";
+static const char COMMAND_BATCH[]							= "BATCH";			//+ glob pattern or list file
+static const char COMMAND_BATCH_JOBS[]						= "JOBS";			//+ number of files processed concurrently
+static const char COMMAND_BATCH_REPORT[]					= "REPORT";			//+ report filename
+
+//! Built-in commands that can be processed outside of the main thread (batch mode)
+/** They don't use any dialog in silent mode (and file I/O is always
+	processed by the main thread). The other commands (including the
+	plugins commands) are processed by the main thread.
+**/
+static const char* const THREAD_SAFE_COMMANDS[] = {	COMMAND_SUBSAMPLE,
+													COMMAND_EXTRACT_CC,
+													COMMAND_CLEAR_NORMALS,
+													COMMAND_COMPUTE_OCTREE_NORMALS,
+													COMMAND_COMPUTE_GRIDDED_NORMALS,
+													COMMAND_APPLY_TRANSFORMATION,
+													COMMAND_DROP_GLOBAL_SHIFT,
+													COMMAND_FILTER_SF_BY_VALUE,
+													COMMAND_MESH_VOLUME,
+													COMMAND_MERGE_MESHES,
+													COMMAND_MERGE_CLOUDS,
+													COMMAND_SET_ACTIVE_SF,
+													COMMAND_REMOVE_ALL_SFS,
+													COMMAND_MATCH_BB_CENTERS,
+													COMMAND_BEST_FIT_PLANE,
+													COMMAND_ORIENT_NORMALS,
+													COMMAND_SOR_FILTER,
+													COMMAND_SAMPLE_MESH,
+													COMMAND_CROP,
+													COMMAND_COORD_TO_SF,
+													COMMAND_CROP_2D,
+													COMMAND_COLOR_BANDING,
+													COMMAND_STAT_TEST,
+													COMMAND_DELAUNAY,
+													COMMAND_C2C_DIST,
+													COMMAND_C2M_DIST,
+													COMMAND_SAVE_CLOUDS,
+													COMMAND_SAVE_MESHES,
+													COMMAND_AUTO_SAVE,
+													COMMAND_NO_TIMESTAMP,
+													COMMAND_CLEAR,
+													COMMAND_CLEAR_CLOUDS,
+													COMMAND_POP_CLOUDS,
+													COMMAND_CLEAR_MESHES,
+													COMMAND_POP_MESHES };
+
+static bool IsThreadSafeCommand(const QString& keyword)
+{
+	for (const char* command : THREAD_SAFE_COMMANDS)
+	{
+		if (keyword == command)
+			return true;
+	}
+	return false;
+}
+
+static bool IsMainThread()
+{
+	return (!QCoreApplication::instance() || QThread::currentThread() == QCoreApplication::instance()->thread());
+}
+
+//! Returns the input files of a batch
+/** \param input glob pattern on the file name (e.g. 'tiles/*.bin') or list file (one filename per line)
+**/
+static QStringList GetBatchInputFiles(const QString& input)
+{
+	QStringList files;
+
+	QFileInfo fi(input);
+	if (input.contains('*') || input.contains('?') || input.contains('['))
+	{
+		QDir dir(fi.path());
+		QStringList names = dir.entryList(QStringList(fi.fileName()), QDir::Files, QDir::Name);
+		for (const QString& name : names)
+		{
+			files << dir.absoluteFilePath(name);
+		}
+	}
+	else
+	{
+		QFile file(input);
+		if (file.open(QFile::ReadOnly | QFile::Text))
+		{
+			//relative paths are relative to the list file
+			QDir dir = fi.absoluteDir();
+			QTextStream stream(&file);
+			while (!stream.atEnd())
+			{
+				QString line = stream.readLine().trimmed();
+				if (line.isEmpty() || line.startsWith('#'))
+					continue;
+				files << dir.absoluteFilePath(line);
+			}
+		}
+	}
+
+	return files;
+}
+
+//! Process resources usage (see the 'PROFILE' option)
+struct ResourceUsage
+{
+	//! CPU time (user + system, all threads) in seconds
+	double cpuTime_s;
+	//! Peak resident set size (since the process start) in MB
+	double peakRSS_MB;
+};
+
+static ResourceUsage GetResourceUsage()
+{
+	ResourceUsage usage = { 0.0, 0.0 };
+
+#if defined(CC_WINDOWS)
+	HANDLE process = GetCurrentProcess();
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime))
+	{
+		ULARGE_INTEGER kernel, user;
+		kernel.LowPart = kernelTime.dwLowDateTime;
+		kernel.HighPart = kernelTime.dwHighDateTime;
+		user.LowPart = userTime.dwLowDateTime;
+		user.HighPart = userTime.dwHighDateTime;
+		usage.cpuTime_s = (kernel.QuadPart + user.QuadPart) * 1.0e-7; //100 ns units
+	}
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(process, &counters, sizeof(counters)))
+	{
+		usage.peakRSS_MB = counters.PeakWorkingSetSize / 1048576.0;
+	}
+#else
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+	{
+		usage.cpuTime_s =	ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+						+	(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1.0e-6;
+#if defined(CC_MAC_OS)
+		usage.peakRSS_MB = ru.ru_maxrss / 1048576.0; //bytes
+#else
+		usage.peakRSS_MB = ru.ru_maxrss / 1024.0; //kilobytes
+#endif
+	}
+#endif
+
+	return usage;
+}
+
+/*****************************************************/
+/************* Background file loading ***************/
+/*****************************************************/
+
+struct ccCommandLineParser::FilePrefetch
+{
+	FilePrefetch(const QString& _filename, const CLLoadParameters& _params)
+		: filename(_filename)
+		, params(_params)
+		, initialShiftEnabled(_params.m_coordinatesShiftEnabled)
+		, initialShift(_params.m_coordinatesShift)
+		, result(CC_FERR_NO_ERROR)
+	{
+		//the file state when the loading starts
+		QFileInfo fi(filename);
+		fileSize = fi.size();
+		lastModified = fi.lastModified();
+
+		//the copied pointers must point to the members of this copy
+		params.coordinatesShiftEnabled = &params.m_coordinatesShiftEnabled;
+		params.coordinatesShift = &params.m_coordinatesShift;
+		//no dialog outside of the main thread
+		params.parentWidget = 0;
+	}
+
+	//! Loads the file (called in a background thread)
+	ccHObject* load()
+	{
+		return FileIOFilter::LoadFromFile(filename, params, result, QString());
+	}
+
+	//! Returns whether the file has been loaded with the same parameters as the input ones
+	bool matches(const QString& _filename, const CLLoadParameters& _params) const
+	{
+		return	filename == _filename
+			&&	params.shiftHandlingMode == _params.shiftHandlingMode
+			&&	initialShiftEnabled == _params.m_coordinatesShiftEnabled
+			&&	initialShift == _params.m_coordinatesShift
+			&&	!_params.pointFilter.isActive();
+	}
+
+	//! Returns whether the file is (apparently) the same as when the loading started
+	/** The file may have been written by one of the commands processed in the meantime.
+	**/
+	bool fileUnchanged() const
+	{
+		QFileInfo fi(filename);
+		return	fi.exists()
+			&&	fi.size() == fileSize
+			&&	fi.lastModified() == lastModified;
+	}
+
+	QString filename;
+	CLLoadParameters params;
+	bool initialShiftEnabled;
+	CCVector3d initialShift;
+	qint64 fileSize;
+	QDateTime lastModified;
+	CC_FILE_ERROR result;
+	QFuture<ccHObject*> future;
+};
+
+/*****************************************************/
+/******************** Batch mode *********************/
+/*****************************************************/
+
+struct ccCommandLineParser::BatchContext
+{
+	BatchContext() : runningJobs(0) {}
+
+	//! Task to be run by the main thread
+	struct Task
+	{
+		explicit Task(const std::function<bool()>& _function)
+			: function(_function)
+			, result(false)
+			, done(false)
+		{}
+
+		const std::function<bool()>& function;
+		bool result;
+		bool done;
+	};
+
+	//! Queues a task for the main thread and waits for its completion (called by the workers)
+	bool run(const std::function<bool()>& function)
+	{
+		Task task(function);
+
+		QMutexLocker locker(&mutex);
+		tasks.push_back(&task);
+		wakeUp.wakeAll();
+		while (!task.done)
+		{
+			taskDone.wait(&mutex);
+		}
+
+		return task.result;
+	}
+
+	//! Runs the queued tasks or waits for new ones (called by the main thread)
+	void processTasks(unsigned long timeout_ms)
+	{
+		QMutexLocker locker(&mutex);
+		if (tasks.empty() && runningJobs != 0)
+		{
+			wakeUp.wait(&mutex, timeout_ms);
+		}
+
+		while (!tasks.empty())
+		{
+			Task* task = tasks.front();
+			tasks.pop_front();
+
+			locker.unlock();
+			bool result = task->function();
+			locker.relock();
+
+			task->result = result;
+			task->done = true;
+			taskDone.wakeAll();
+		}
+	}
+
+	//! Signals the end of a job (called by the workers)
+	void jobFinished()
+	{
+		QMutexLocker locker(&mutex);
+		--runningJobs;
+		wakeUp.wakeAll();
+	}
+
+	//! Returns whether all the jobs are finished
+	bool isFinished()
+	{
+		QMutexLocker locker(&mutex);
+		return (runningJobs == 0 && tasks.empty());
+	}
+
+	QMutex mutex;
+	QWaitCondition wakeUp;
+	QWaitCondition taskDone;
+	std::deque<Task*> tasks;
+	int runningJobs;
+};
+
+struct ccCommandLineParser::BatchJob : public QRunnable
+{
+	BatchJob(	const ccCommandLineParser& _mainParser,
+				BatchContext& _context,
+				const QString& _filename,
+				const QStringList& _commands)
+		: mainParser(_mainParser)
+		, context(_context)
+		, filename(_filename)
+		, commands(_commands)
+		, success(false)
+		, duration_s(0.0)
+	{
+		setAutoDelete(false);
+	}
+
+	virtual void run() override
+	{
+		QScopedPointer<ccCommandLineParser> parser(new ccCommandLineParser);
+
+		//same commands (including the plugins ones) and settings as the main parser
+		parser->m_commands = mainParser.m_commands;
+		parser->m_cloudExportFormat = mainParser.m_cloudExportFormat;
+		parser->m_cloudExportExt = mainParser.m_cloudExportExt;
+		parser->m_meshExportFormat = mainParser.m_meshExportFormat;
+		parser->m_meshExportExt = mainParser.m_meshExportExt;
+		parser->m_autoSaveMode = mainParser.m_autoSaveMode;
+		parser->m_addTimestamp = mainParser.m_addTimestamp;
+		parser->m_precision = mainParser.m_precision;
+		parser->m_loadingParameters = mainParser.m_loadingParameters;
+		parser->m_loadingParameters.coordinatesShiftEnabled = &parser->m_loadingParameters.m_coordinatesShiftEnabled;
+		parser->m_loadingParameters.coordinatesShift = &parser->m_loadingParameters.m_coordinatesShift;
+		parser->m_loadingParameters.parentWidget = 0;
+		//no dialog
+		parser->m_silentMode = true;
+		parser->m_batch = &context;
+		parser->m_logPrefix = QString("[%1] ").arg(QFileInfo(filename).fileName());
+
+		parser->m_arguments << QString("-%1").arg(COMMAND_OPEN) << filename;
+		parser->m_arguments.append(commands);
+
+		QElapsedTimer timer;
+		timer.start();
+		success = (parser->start() == EXIT_SUCCESS);
+		duration_s = timer.elapsed() / 1.0e3;
+		errorMessage = parser->m_lastError;
+
+		if (success)
+			mainParser.print(QString("[BATCH] '%1' processed in %2 s.").arg(filename).arg(duration_s, 0, 'f', 2));
+		else
+			mainParser.warning(QString("[BATCH] '%1' failed: %2").arg(filename, errorMessage));
+
+		//release the loaded entities before the next job starts
+		parser.reset();
+
+		context.jobFinished();
+	}
+
+	const ccCommandLineParser& mainParser;
+	BatchContext& context;
+	QString filename;
+	QStringList commands;
+	bool success;
+	double duration_s;
+	QString errorMessage;
+};
 
 /*****************************************************/
 /*************** ccCommandLineParser *****************/
@@ -32,28 +416,30 @@ static const char COMMAND_SILENT_MODE[]						= "SILENT";
 
 void ccCommandLineParser::print(const QString& message) const
 {
-	ccConsole::Print(message);
+	ccConsole::Print(m_logPrefix + message);
 	if (m_silentMode)
 	{
-		printf("%s\n", qPrintable(message));
+		printf("%s\n", qPrintable(m_logPrefix + message));
 	}
 }
 
 void ccCommandLineParser::warning(const QString& message) const
 {
-	ccConsole::Warning(message);
+	ccConsole::Warning(m_logPrefix + message);
 	if (m_silentMode)
 	{
-		printf("[WARNING] %s\n", qPrintable(message));
+		printf("[WARNING] %s\n", qPrintable(m_logPrefix + message));
 	}
 }
 
 bool ccCommandLineParser::error(const QString& message) const
 {
-	ccConsole::Error(message);
+	m_lastError = message;
+
+	ccConsole::Error(m_logPrefix + message);
 	if (m_silentMode)
 	{
-		printf("[ERROR] %s\n", qPrintable(message));
+		printf("[ERROR] %s\n", qPrintable(m_logPrefix + message));
 	}
 
 	return false;
@@ -139,6 +525,9 @@ ccCommandLineParser::ccCommandLineParser()
 	, m_orphans("orphans")
 	, m_progressDialog(0)
 	, m_parentWidget(0)
+	, m_profileEnabled(false)
+	, m_prefetchEnabled(false)
+	, m_batch(0)
 {
 	registerCommand(Command::Shared(new CommandLoad));
 	registerCommand(Command::Shared(new CommandSubsample));
@@ -188,11 +577,18 @@ ccCommandLineParser::ccCommandLineParser()
 	registerCommand(Command::Shared(new CommandClearMeshes));
 	registerCommand(Command::Shared(new CommandPopMeshes));
 	registerCommand(Command::Shared(new CommandSetNoTimestamp));
+	registerCommand(Command::Shared(new CommandScratchStorage));
+	registerCommand(Command::Shared(new CommandPreciseNormals));
 	registerCommand(Command::Shared(new CommandVolume25D));
 	registerCommand(Command::Shared(new CommandRasterize));
 	registerCommand(Command::Shared(new CommandOctreeNormal));
 	registerCommand(Command::Shared(new CommandClearNormals));
 	registerCommand(Command::Shared(new CommandComputeMeshVolume));
+	registerCommand(Command::Shared(new CommandBinBenchmark));
+	registerCommand(Command::Shared(new CommandPickingBenchmark));
+	registerCommand(Command::Shared(new CommandOctreeStress));
+	registerCommand(Command::Shared(new CommandOctreeBuildBenchmark));
+	registerCommand(Command::Shared(new CommandFastMarchingBenchmark));
 	//registerCommand(Command::Shared(new XXX));
 	//registerCommand(Command::Shared(new XXX));
 	//registerCommand(Command::Shared(new XXX));
@@ -200,6 +596,7 @@ ccCommandLineParser::ccCommandLineParser()
 
 ccCommandLineParser::~ccCommandLineParser()
 {
+	releasePrefetch();
 	removeClouds();
 	removeMeshes();
 
@@ -291,6 +688,14 @@ QString ccCommandLineParser::exportEntity(	CLEntityDesc& entityDesc,
 											bool forceIsCloud/*=false*/,
 											bool forceNoTimestamp/*=false*/)
 {
+	if (m_batch && !IsMainThread())
+	{
+		//the I/O filters may rely on dialogs
+		QString errorStr;
+		runInMainThread([&]() { errorStr = exportEntity(entityDesc, suffix, baseOutputFilename, forceIsCloud, forceNoTimestamp); return true; });
+		return errorStr;
+	}
+
 	print("[SAVING]");
 
 	//fetch the real entity
@@ -406,11 +811,21 @@ void ccCommandLineParser::removeMeshes(bool onlyLast/*=false*/)
 
 bool ccCommandLineParser::importFile(QString filename, FileIOFilter::Shared filter)
 {
+	if (m_batch && !IsMainThread())
+	{
+		//the I/O filters may rely on dialogs
+		return runInMainThread([&]() { return importFile(filename, filter); });
+	}
+
 	print(QString("Opening file: '%1'").arg(filename));
 
 	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
 	ccHObject* db = 0;
-	if (filter)
+	if (!filter && takePrefetchedFile(filename, db, result))
+	{
+		//already loaded in the background
+	}
+	else if (filter)
 	{
 		db = FileIOFilter::LoadFromFile(filename, m_loadingParameters, filter, result);
 	}
@@ -518,6 +933,12 @@ bool ccCommandLineParser::importFile(QString filename, FileIOFilter::Shared filt
 
 bool ccCommandLineParser::saveClouds(QString suffix/*=QString()*/, bool allAtOnce/*=false*/)
 {
+	if (m_batch && !IsMainThread())
+	{
+		//the I/O filters may rely on dialogs
+		return runInMainThread([&]() { return saveClouds(suffix, allAtOnce); });
+	}
+
 	//all-at-once: all clouds in a single file
 	if (allAtOnce)
 	{
@@ -570,6 +991,12 @@ bool ccCommandLineParser::saveClouds(QString suffix/*=QString()*/, bool allAtOnc
 
 bool ccCommandLineParser::saveMeshes(QString suffix/*=QString()*/, bool allAtOnce/*=false*/)
 {
+	if (m_batch && !IsMainThread())
+	{
+		//the I/O filters may rely on dialogs
+		return runInMainThread([&]() { return saveMeshes(suffix, allAtOnce); });
+	}
+
 	//all-at-once: all meshes in a single file
 	if (allAtOnce)
 	{
@@ -617,6 +1044,263 @@ bool ccCommandLineParser::saveMeshes(QString suffix/*=QString()*/, bool allAtOnc
 	return true;
 }
 
+size_t ccCommandLineParser::loadedPointCount() const
+{
+	size_t count = 0;
+	for (const CLCloudDesc& desc : m_clouds)
+	{
+		if (desc.pc)
+			count += desc.pc->size();
+	}
+	for (const CLMeshDesc& desc : m_meshes)
+	{
+		if (desc.mesh && desc.mesh->getAssociatedCloud())
+			count += desc.mesh->getAssociatedCloud()->size();
+	}
+	return count;
+}
+
+void ccCommandLineParser::startPrefetch()
+{
+	if (m_prefetch)
+	{
+		//one file at a time
+		return;
+	}
+
+	//look for the next 'open' command
+	for (int i = 0; i < m_arguments.size(); ++i)
+	{
+		//we don't prefetch past the commands that explicitly save files (they could overwrite the file)
+		if (	IsCommand(m_arguments[i], COMMAND_SAVE_CLOUDS)
+			||	IsCommand(m_arguments[i], COMMAND_SAVE_MESHES))
+			return;
+
+		if (!IsCommand(m_arguments[i], COMMAND_OPEN))
+			continue;
+
+		//local options (filters, global shift, etc.) are only known when the command is processed
+		if (i + 1 == m_arguments.size() || m_arguments[i + 1].startsWith("-"))
+			return;
+
+		QString filename = m_arguments[i + 1];
+		QFileInfo fi(filename);
+		if (!fi.exists())
+		{
+			//the error will be issued by the command itself
+			return;
+		}
+
+		//the other filters may display dialogs (which can't be created outside of the main thread)
+		FileIOFilter::Shared filter = FileIOFilter::FindBestFilterForExtension(fi.suffix());
+		if (!filter || !filter.dynamicCast<BinFilter>())
+			return;
+		if (	m_loadingParameters.shiftHandlingMode != ccGlobalShiftManager::NO_DIALOG
+			&&	m_loadingParameters.shiftHandlingMode != ccGlobalShiftManager::NO_DIALOG_AUTO_SHIFT)
+			return;
+		if (m_loadingParameters.pointFilter.isActive())
+			return;
+
+		print(QString("Prefetching file: '%1'").arg(filename));
+		m_prefetch.reset(new FilePrefetch(filename, m_loadingParameters));
+		m_prefetch->future = QtConcurrent::run(m_prefetch.data(), &FilePrefetch::load);
+		return;
+	}
+}
+
+bool ccCommandLineParser::takePrefetchedFile(const QString& filename, ccHObject*& db, CC_FILE_ERROR& result)
+{
+	if (!m_prefetch || m_prefetch->filename != filename)
+	{
+		return false;
+	}
+
+	if (!m_prefetch->matches(filename, m_loadingParameters))
+	{
+		//the loading parameters have changed in the meantime
+		releasePrefetch();
+		return false;
+	}
+
+	db = m_prefetch->future.result(); //waits for the loading to complete
+	if (!m_prefetch->fileUnchanged())
+	{
+		//the file has been modified in the meantime (e.g. by an automatic save)
+		print(QString("File '%1' has changed since it was prefetched: it will be loaded again").arg(filename));
+		releasePrefetch();
+		db = 0;
+		return false;
+	}
+	result = m_prefetch->result;
+
+	//forward the global shift (if any) as a standard loading would do
+	m_loadingParameters.m_coordinatesShiftEnabled = m_prefetch->params.m_coordinatesShiftEnabled;
+	m_loadingParameters.m_coordinatesShift = m_prefetch->params.m_coordinatesShift;
+
+	m_prefetch.reset();
+
+	return true;
+}
+
+void ccCommandLineParser::releasePrefetch()
+{
+	if (!m_prefetch)
+		return;
+
+	ccHObject* db = m_prefetch->future.result(); //waits for the loading to complete
+	if (db)
+	{
+		delete db;
+		db = 0;
+	}
+
+	m_prefetch.reset();
+}
+
+bool ccCommandLineParser::runInMainThread(const std::function<bool()>& task)
+{
+	if (!m_batch || IsMainThread())
+	{
+		return task();
+	}
+
+	return m_batch->run(task);
+}
+
+bool ccCommandLineParser::processBatch()
+{
+	print("[BATCH]");
+	if (m_batch)
+		return error(QString("Command '-%1' can't be used inside a batch").arg(COMMAND_BATCH));
+	if (m_arguments.empty())
+		return error(QString("Missing parameter: glob pattern or list file after '%1'").arg(COMMAND_BATCH));
+
+	QString input = m_arguments.takeFirst();
+	QStringList inputFiles = GetBatchInputFiles(input);
+	if (inputFiles.empty())
+		return error(QString("No input file found for '%1' (glob pattern or list file expected)").arg(input));
+
+	//optional parameters
+	int jobCount = 0;
+	int maxThreadCount = 0;
+	QString reportFilename;
+	while (!m_arguments.empty())
+	{
+		QString argument = m_arguments.front();
+		if (IsCommand(argument, COMMAND_BATCH_JOBS))
+		{
+			//local option confirmed, we can move on
+			m_arguments.pop_front();
+
+			bool ok = false;
+			if (!m_arguments.empty())
+				jobCount = m_arguments.takeFirst().toInt(&ok);
+			if (!ok || jobCount <= 0)
+				return error(QString("Invalid parameter: number of files processed concurrently after '%1'").arg(COMMAND_BATCH_JOBS));
+		}
+		else if (IsCommand(argument, COMMAND_MAX_THREAD_COUNT))
+		{
+			//local option confirmed, we can move on
+			m_arguments.pop_front();
+
+			bool ok = false;
+			if (!m_arguments.empty())
+				maxThreadCount = m_arguments.takeFirst().toInt(&ok);
+			if (!ok || maxThreadCount < 0)
+				return error(QString("Invalid thread count! (after %1)").arg(COMMAND_MAX_THREAD_COUNT));
+		}
+		else if (IsCommand(argument, COMMAND_BATCH_REPORT))
+		{
+			//local option confirmed, we can move on
+			m_arguments.pop_front();
+
+			if (m_arguments.empty())
+				return error(QString("Missing parameter: report filename after '%1'").arg(COMMAND_BATCH_REPORT));
+			reportFilename = m_arguments.takeFirst();
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	//all the remaining commands are applied to each file
+	if (m_arguments.empty())
+		return error(QString("Missing commands after '%1'").arg(COMMAND_BATCH));
+	QStringList commands = m_arguments;
+	m_arguments.clear();
+
+	//split the threads between the files (inter-file) and the commands (intra-file)
+	if (maxThreadCount == 0)
+		maxThreadCount = CCLib::ParallelTools::IdealThreadCount();
+	if (jobCount == 0)
+		jobCount = std::max(1, maxThreadCount / 4); //a few threads per file by default
+	jobCount = std::min(jobCount, inputFiles.size());
+	int threadsPerJob = std::max(1, maxThreadCount / jobCount);
+
+	print(QString("%1 file(s) to process: %2 at a time, with %3 thread(s) each").arg(inputFiles.size()).arg(jobCount).arg(threadsPerJob));
+
+	//the parallel jobs of the commands use private thread pools (the global pool is left untouched)
+	CCLib::ParallelTools::SetDefaultMaxThreadCount(threadsPerJob);
+
+	BatchContext context;
+	context.runningJobs = inputFiles.size();
+	QList< QSharedPointer<BatchJob> > jobs;
+	QThreadPool pool;
+	pool.setMaxThreadCount(jobCount);
+	for (const QString& filename : inputFiles)
+	{
+		jobs.push_back(QSharedPointer<BatchJob>(new BatchJob(*this, context, filename, commands)));
+		pool.start(jobs.back().data());
+	}
+
+	//meanwhile, the main thread processes the file I/O and the other main thread tasks
+	while (!context.isFinished())
+	{
+		context.processTasks(100);
+		QCoreApplication::processEvents();
+	}
+	pool.waitForDone();
+
+	CCLib::ParallelTools::SetDefaultMaxThreadCount(0);
+
+	//per-file results
+	int successCount = 0;
+	for (const QSharedPointer<BatchJob>& job : jobs)
+	{
+		if (job->success)
+			++successCount;
+		else
+			warning(QString("[BATCH] Failed: '%1' (%2)").arg(job->filename, job->errorMessage));
+	}
+
+	if (!reportFilename.isEmpty())
+	{
+		QFile file(reportFilename);
+		if (file.open(QFile::WriteOnly | QFile::Text))
+		{
+			QTextStream stream(&file);
+			stream << "file;status;duration_s;error" << endl;
+			for (const QSharedPointer<BatchJob>& job : jobs)
+			{
+				stream << job->filename << ';' << (job->success ? "OK" : "FAILED") << ';' << QString::number(job->duration_s, 'f', 2) << ';' << job->errorMessage << endl;
+			}
+			print(QString("Batch report saved to '%1'").arg(reportFilename));
+		}
+		else
+		{
+			warning(QString("Failed to save the batch report to '%1'").arg(reportFilename));
+		}
+	}
+
+	print(QString("[BATCH] %1/%2 file(s) processed successfully").arg(successCount).arg(inputFiles.size()));
+
+	if (successCount != inputFiles.size())
+		return error(QString("%1 file(s) failed").arg(inputFiles.size() - successCount));
+
+	return true;
+}
+
 int ccCommandLineParser::start(QDialog* parent/*=0*/)
 {
 	if (m_arguments.empty())
@@ -653,13 +1337,80 @@ int ccCommandLineParser::start(QDialog* parent/*=0*/)
 		if (m_commands.contains(keyword))
 		{
 			assert(m_commands[keyword]);
-			success = m_commands[keyword]->process(*this);
+
+			if (m_prefetchEnabled && keyword != COMMAND_OPEN)
+			{
+				//load the next file while this command is computing
+				startPrefetch();
+			}
+
+			//batch jobs: commands that may rely on dialogs are processed by the main thread
+			Command::Shared command = m_commands[keyword];
+			bool mainThreadOnly = (m_batch && !IsThreadSafeCommand(keyword));
+
+			ResourceUsage usageBefore = { 0.0, 0.0 };
+			size_t pointCountBefore = 0;
+			QElapsedTimer commandTimer;
+			if (m_profileEnabled)
+			{
+				usageBefore = GetResourceUsage();
+				pointCountBefore = loadedPointCount();
+				commandTimer.start();
+			}
+
+			if (mainThreadOnly)
+				success = runInMainThread([&]() { return command->process(*this); });
+			else
+				success = command->process(*this);
+
+			if (m_profileEnabled)
+			{
+				double wallTime_s = commandTimer.nsecsElapsed() / 1.0e9;
+				ResourceUsage usageAfter = GetResourceUsage();
+				//processed points = loaded points before or after the command (e.g. for loading or sub-sampling)
+				size_t pointCount = std::max(pointCountBefore, loadedPointCount());
+
+				QJsonObject commandProfile;
+				commandProfile["command"] = keyword;
+				commandProfile["name"] = command->m_name;
+				commandProfile["success"] = success;
+				commandProfile["wall_time_s"] = wallTime_s;
+				commandProfile["cpu_time_s"] = usageAfter.cpuTime_s - usageBefore.cpuTime_s; //whole process (i.e. including the prefetching thread)
+				commandProfile["peak_rss_mb"] = usageAfter.peakRSS_MB;
+				commandProfile["peak_rss_increase_mb"] = usageAfter.peakRSS_MB - usageBefore.peakRSS_MB;
+				commandProfile["points"] = static_cast<double>(pointCount);
+				commandProfile["points_per_s"] = (wallTime_s > 0 ? pointCount / wallTime_s : 0.0);
+				m_profile.append(commandProfile);
+			}
 		}
 		//silent mode (i.e. no console)
 		else if (keyword == COMMAND_SILENT_MODE)
 		{
 			warning(QString("Misplaced command: '%1' (must be first)").arg(COMMAND_SILENT_MODE));
 		}
+		//commands profile (JSON)
+		else if (keyword == COMMAND_PROFILE)
+		{
+			m_profileEnabled = true;
+
+			//optional output file
+			if (!m_arguments.empty() && !m_arguments.front().startsWith("-"))
+			{
+				m_profileFilename = m_arguments.takeFirst();
+			}
+			print(QString("The following commands will be profiled (output: %1)").arg(m_profileFilename.isEmpty() ? QString("console") : m_profileFilename));
+		}
+		//same commands applied to several files
+		else if (keyword == COMMAND_BATCH)
+		{
+			success = processBatch();
+		}
+		//background loading of the next file
+		else if (keyword == COMMAND_PREFETCH)
+		{
+			m_prefetchEnabled = true;
+			print("The next file to open will be loaded in the background while the current command is computing");
+		}
 		else if (keyword == COMMAND_HELP)
 		{
 			print("Available commands:");
@@ -676,6 +1427,36 @@ int ccCommandLineParser::start(QDialog* parent/*=0*/)
 		}
 	}
 
+	//discard the prefetched file if it has not been opened
+	releasePrefetch();
+
+	if (m_profileEnabled)
+	{
+		QJsonObject profile;
+		profile["success"] = success;
+		profile["wall_time_s"] = eTimer.nsecsElapsed() / 1.0e9;
+		profile["commands"] = m_profile;
+		QByteArray json = QJsonDocument(profile).toJson();
+
+		if (m_profileFilename.isEmpty())
+		{
+			print(QString::fromUtf8(json));
+		}
+		else
+		{
+			QFile file(m_profileFilename);
+			if (file.open(QFile::WriteOnly | QFile::Text))
+			{
+				file.write(json);
+				print(QString("Profile saved to '%1'").arg(m_profileFilename));
+			}
+			else
+			{
+				warning(QString("Failed to save the profile to '%1'").arg(m_profileFilename));
+			}
+		}
+	}
+
 	print(QString("Processed finished in %1 s.").arg(eTimer.elapsed() / 1.0e3, 0, 'f', 2));
 
 	return success ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -7,6 +7,13 @@
 //Local
 #include "ccPluginInfo.h"
 
+//Qt
+#include <QJsonArray>
+#include <QScopedPointer>
+
+//system
+#include <functional>
+
 class ccProgressDialog;
 class QDialog;
 
@@ -61,6 +68,40 @@ protected: //other methods
 	//! Parses the command line
 	int start(QDialog* parent = 0);
 
+	//! Starts loading the file of the next 'open' command in the background (see the 'PREFETCH' option)
+	/** Only files that can be loaded without any dialog (i.e. outside of the main thread)
+		and without any local option are prefetched (and not past a command that saves files).
+	**/
+	void startPrefetch();
+
+	//! Retrieves the prefetched file content (if it corresponds to the input filename)
+	/** Waits for the background loading to complete if necessary.
+		\param filename file to load
+		\param db loaded entities (output)
+		\param result loading result (output)
+		\return whether the file had been prefetched with the current loading parameters (and hasn't changed since) or not
+	**/
+	bool takePrefetchedFile(const QString& filename, ccHObject*& db, CC_FILE_ERROR& result);
+
+	//! Waits for the background loading (if any) to complete and discards its result
+	void releasePrefetch();
+
+	//! Returns the total number of points of the loaded clouds and meshes (vertices)
+	size_t loadedPointCount() const;
+
+	//! Processes the remaining commands on each input file (see the 'BATCH' option)
+	/** Parses the batch parameters first (input files, etc.).
+		\return whether all the files have been processed successfully or not
+	**/
+	bool processBatch();
+
+	//! Runs a task in the main thread
+	/** Batch jobs are processed by worker threads. The I/O filters and some
+		commands require the main thread (as they rely on dialogs).
+		\return the task output
+	**/
+	bool runInMainThread(const std::function<bool()>& task);
+
 private: //members
 
 	//! Current cloud(s) export format (can be modified with the 'COMMAND_CLOUD_EXPORT_FORMAT' option)
@@ -89,6 +130,31 @@ private: //members
 
 	//! Widget parent
 	QDialog* m_parentWidget;
+
+	//! Whether each command should be profiled or not (see the 'PROFILE' option)
+	bool m_profileEnabled;
+	//! Profile output file (the profile is printed to the console if empty)
+	QString m_profileFilename;
+	//! Commands profile (one JSON object per command)
+	QJsonArray m_profile;
+
+	//! Whether the next file to open should be loaded in the background (see the 'PREFETCH' option)
+	bool m_prefetchEnabled;
+	//! Background file loading
+	struct FilePrefetch;
+	//! Pending background file loading (if any)
+	QScopedPointer<FilePrefetch> m_prefetch;
+
+	//! Shared state of a batch
+	struct BatchContext;
+	//! Batch job (i.e. command chain applied to one input file)
+	struct BatchJob;
+	//! Batch this parser belongs to (if it processes a batch job)
+	BatchContext* m_batch;
+	//! Log prefix (e.g. name of the batch job input file)
+	QString m_logPrefix;
+	//! Last error message
+	mutable QString m_lastError;
 };
 
 #endif
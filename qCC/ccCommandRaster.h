@@ -270,7 +270,19 @@ struct CommandRasterize : public ccCommandLineInterface::Command
 			{
 				//memory allocation
 				CCVector3d minCorner = CCVector3d::fromArray(gridBBox.minCorner().u);
-				if (!grid.init(gridWidth, gridHeight, gridStep, minCorner))
+
+				//we only allocate the layers that will actually be exported
+				int layers = ccRasterGrid::NO_OPTIONAL_LAYER;
+				if (resample)
+				{
+					layers |= ccRasterGrid::LAYER_POINT_INDEX;
+				}
+				if (outputCloud || outputMesh || outputRasterRGB)
+				{
+					layers |= ccRasterGrid::LAYER_COLOR;
+				}
+
+				if (!grid.init(gridWidth, gridHeight, gridStep, minCorner, layers))
 				{
 					//not enough memory
 					return cmd.error("Not enough memory");
@@ -51,6 +51,9 @@
 
 const unsigned char DEFAULT_OCTREE_LEVEL = 7;
 
+//! Local models names (same order as CC_LOCAL_MODEL_TYPES)
+static const char* s_localModelNames[] = { "NONE", "Least Square Plane", "2D1/2 Triangulation", "Quadric" };
+
 ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 									ccHObject* refEntity,
 									CC_COMPARISON_TYPE cpType,
@@ -88,10 +91,8 @@ ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 			octreeLevelComboBox->addItem(QString::number(i));
 
 		//local model
-		localModelComboBox->addItem("NONE");
-		localModelComboBox->addItem("Least Square Plane");
-		localModelComboBox->addItem("2D1/2 Triangulation");
-		localModelComboBox->addItem("Quadric");
+		for (const char* modelName : s_localModelNames)
+			localModelComboBox->addItem(modelName);
 		localModelComboBox->setCurrentIndex(0);
 	}
 
@@ -120,10 +121,13 @@ ccComparisonDlg::ccComparisonDlg(	ccHObject* compEntity,
 		signedDistCheckBox->setChecked(true);
 		filterVisibilityCheckBox->setEnabled(false);
 		filterVisibilityCheckBox->setVisible(false);
+		useTriangleBVHCheckBox->setEnabled(true);
 	}
 	else
 	{
 		signedDistCheckBox->setEnabled(false);
+		useTriangleBVHCheckBox->setEnabled(false);
+		useTriangleBVHCheckBox->setVisible(false);
 		split3DCheckBox->setEnabled(true);
 		lmRadiusDoubleSpinBox->setValue(compEntBBox.getDiagNorm() / 200.0);
 		filterVisibilityCheckBox->setEnabled(m_refCloud && m_refCloud->isA(CC_TYPES::POINT_CLOUD) && static_cast<ccPointCloud*>(m_refCloud)->hasSensor());
@@ -480,8 +484,27 @@ int ccComparisonDlg::determineBestOctreeLevel(double maxSearchDist)
 		return -1;
 	}
 
+	ccProgressDialog progressCb(false, this);
+	progressCb.setMethodTitle(tr("Determining optimal octree level"));
+
+	return DetermineBestOctreeLevel(m_compOctree.data(), approxDistances, m_refOctree.data(), m_refMesh, maxSearchDist, &progressCb);
+}
+
+int ccComparisonDlg::DetermineBestOctreeLevel(	const CCLib::DgmOctree* compOctree,
+												const CCLib::ScalarField* approxDistances,
+												const CCLib::DgmOctree* refOctree,
+												CCLib::GenericIndexedMesh* refMesh,
+												double maxSearchDist,
+												CCLib::GenericProgressCallback* progressCb/*=0*/)
+{
+	if (!compOctree || !approxDistances || (!refOctree && !refMesh))
+	{
+		assert(false);
+		return -1;
+	}
+
 	//evalutate the theoretical time for each octree level
-	const int MAX_OCTREE_LEVEL = m_refMesh ? 9 : CCLib::DgmOctree::MAX_OCTREE_LEVEL; //DGM: can't go higher than level 9 with a mesh as the grid is 'plain' and would take too much memory!
+	const int MAX_OCTREE_LEVEL = refMesh ? 9 : CCLib::DgmOctree::MAX_OCTREE_LEVEL; //DGM: can't go higher than level 9 with a mesh as the grid is 'plain' and would take too much memory!
 	std::vector<double> timings;
 	try
 	{
@@ -496,15 +519,10 @@ int ccComparisonDlg::determineBestOctreeLevel(double maxSearchDist)
 	//if the reference is a mesh
 	double meanTriangleSurface = 1.0;
 	CCLib::GenericIndexedMesh* mesh = 0;
-	if (!m_refOctree)
+	if (!refOctree)
 	{
-		if (!m_refMesh)
-		{
-			ccLog::Error("Internal error: reference entity should be a mesh!");
-			return -1;
-		}
-		mesh = static_cast<CCLib::GenericIndexedMesh*>(m_refMesh);
-		if (!mesh || mesh->size() == 0)
+		mesh = refMesh;
+		if (mesh->size() == 0)
 		{
 			ccLog::Warning("Can't determine best octree level: mesh is empty!");
 			return -1;
@@ -523,15 +541,15 @@ int ccComparisonDlg::determineBestOctreeLevel(double maxSearchDist)
 	int theBestOctreeLevel = s_minOctreeLevel;
 
 	//we don't test the very first and very last level
-	ccProgressDialog progressCb(false, this);
-	progressCb.setMethodTitle(tr("Determining optimal octree level"));
-	progressCb.setInfo(tr("Testing %1 levels...").arg(MAX_OCTREE_LEVEL)); //we lie here ;)
-	CCLib::NormalizedProgress nProgress(&progressCb, MAX_OCTREE_LEVEL - 2);
-	progressCb.start();
-	QApplication::processEvents();
+	CCLib::NormalizedProgress nProgress(progressCb, MAX_OCTREE_LEVEL - 2);
+	if (progressCb)
+	{
+		progressCb->setInfo(qPrintable(tr("Testing %1 levels...").arg(MAX_OCTREE_LEVEL))); //we lie here ;)
+		progressCb->start();
+	}
 
-	bool maxDistanceDefined = maxDistCheckBox->isChecked();
-	PointCoordinateType maxDistance = static_cast<PointCoordinateType>(maxDistanceDefined ? maxSearchDistSpinBox->value() : 0);
+	bool maxDistanceDefined = (maxSearchDist > 0);
+	PointCoordinateType maxDistance = static_cast<PointCoordinateType>(maxDistanceDefined ? maxSearchDist : 0);
 
 	//for each level
 	for (int level = s_minOctreeLevel; level < MAX_OCTREE_LEVEL; ++level)
@@ -544,19 +562,19 @@ int ccComparisonDlg::determineBestOctreeLevel(double maxSearchDist)
 
 		//we compute a 'correction factor' that converts an approximate distance into an
 		//approximate size of the neighborhood (in terms of cells)
-		PointCoordinateType cellSize = m_compOctree->getCellSize(static_cast<unsigned char>(level));
+		PointCoordinateType cellSize = compOctree->getCellSize(static_cast<unsigned char>(level));
 
 		//we also use the reference cloud density (points/cell) if we have the info
 		double refListDensity = 1.0;
-		if (m_refOctree)
+		if (refOctree)
 		{
-			refListDensity = m_refOctree->computeMeanOctreeDensity(static_cast<unsigned char>(level));
+			refListDensity = refOctree->computeMeanOctreeDensity(static_cast<unsigned char>(level));
 		}
 
 		CCLib::DgmOctree::CellCode tempCode = 0xFFFFFFFF;
 
 		//scan the octree structure
-		const CCLib::DgmOctree::cellsContainer& compCodes = m_compOctree->pointsAndTheirCellCodes();
+		const CCLib::DgmOctree::cellsContainer& compCodes = compOctree->pointsAndTheirCellCodes();
 		for (CCLib::DgmOctree::cellsContainer::const_iterator c=compCodes.begin(); c!=compCodes.end(); ++c)
 		{
 			CCLib::DgmOctree::CellCode truncatedCode = (c->theCode >> bitDec);
@@ -831,7 +849,7 @@ bool ccComparisonDlg::computeDistances()
 
 	case CLOUDMESH_DIST: //cloud-mesh
 
-		if (multiThread && maxDistCheckBox->isChecked())
+		if (multiThread && maxDistCheckBox->isChecked() && !useTriangleBVHCheckBox->isChecked())
 		{
 			ccLog::Warning("[Cloud/Mesh comparison] Max search distance is not supported in multi-thread mode! Switching to single thread mode...");
 		}
@@ -844,6 +862,7 @@ bool ccComparisonDlg::computeDistances()
 			c2mParams.signedDistances = signedDistances;
 			c2mParams.flipNormals = flipNormals;
 			c2mParams.multiThread = multiThread;
+			c2mParams.useTriangleBVH = useTriangleBVHCheckBox->isChecked();
 		}
 		
 		result = CCLib::DistanceComputationTools::computeCloud2MeshDistance(	m_compCloud,
@@ -873,37 +892,7 @@ bool ccComparisonDlg::computeDistances()
 		//restore UI items
 		okButton->setEnabled(true);
 
-		m_sfName.clear();
-		switch(m_compType)
-		{
-		case CLOUDCLOUD_DIST: //hausdorff
-			m_sfName = QString(CC_CLOUD2CLOUD_DISTANCES_DEFAULT_SF_NAME);
-			break;
-		case CLOUDMESH_DIST: //cloud-mesh
-			m_sfName = QString(signedDistances ? CC_CLOUD2MESH_SIGNED_DISTANCES_DEFAULT_SF_NAME : CC_CLOUD2MESH_DISTANCES_DEFAULT_SF_NAME);
-			break;
-		}
-
-		if (c2cParams.localModel != NO_MODEL)
-		{
-			m_sfName += QString("[%1]").arg(localModelComboBox->currentText());
-			if (c2cParams.useSphericalSearchForLocalModel)
-				m_sfName += QString("[r=%1]").arg(c2cParams.radiusForLocalModel);
-			else
-				m_sfName += QString("[k=%1]").arg(c2cParams.kNNForLocalModel);
-			if (c2cParams.reuseExistingLocalModels)
-				m_sfName += QString("[fast]");
-		}
-
-		if (flipNormals)
-		{
-			m_sfName += QString("[-]");
-		}
-
-		if (maxSearchDist > 0)
-		{
-			m_sfName += QString("[<%1]").arg(maxSearchDist);
-		}
+		m_sfName = GetDistancesSFName(m_compType, c2cParams, signedDistances, flipNormals, maxSearchDist);
 
 		if (split3D)
 		{
@@ -950,6 +939,47 @@ bool ccComparisonDlg::computeDistances()
 	return result >= 0;
 }
 
+QString ccComparisonDlg::GetDistancesSFName(	CC_COMPARISON_TYPE cpType,
+											const CCLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams& c2cParams,
+											bool signedDistances,
+											bool flipNormals,
+											double maxSearchDist)
+{
+	QString sfName;
+	switch (cpType)
+	{
+	case CLOUDCLOUD_DIST: //hausdorff
+		sfName = QString(CC_CLOUD2CLOUD_DISTANCES_DEFAULT_SF_NAME);
+		break;
+	case CLOUDMESH_DIST: //cloud-mesh
+		sfName = QString(signedDistances ? CC_CLOUD2MESH_SIGNED_DISTANCES_DEFAULT_SF_NAME : CC_CLOUD2MESH_DISTANCES_DEFAULT_SF_NAME);
+		break;
+	}
+
+	if (c2cParams.localModel != NO_MODEL)
+	{
+		sfName += QString("[%1]").arg(s_localModelNames[c2cParams.localModel]);
+		if (c2cParams.useSphericalSearchForLocalModel)
+			sfName += QString("[r=%1]").arg(c2cParams.radiusForLocalModel);
+		else
+			sfName += QString("[k=%1]").arg(c2cParams.kNNForLocalModel);
+		if (c2cParams.reuseExistingLocalModels)
+			sfName += QString("[fast]");
+	}
+
+	if (flipNormals)
+	{
+		sfName += QString("[-]");
+	}
+
+	if (maxSearchDist > 0)
+	{
+		sfName += QString("[<%1]").arg(maxSearchDist);
+	}
+
+	return sfName;
+}
+
 void ccComparisonDlg::showHisto()
 {
 	if (!m_compCloud)
@@ -18,6 +18,9 @@
 #ifndef CC_COMPARISON_DIALOG_HEADER
 #define CC_COMPARISON_DIALOG_HEADER
 
+//CCLib
+#include <DistanceComputationTools.h>
+
 //qCC_db
 #include <ccOctree.h>
 
@@ -61,6 +64,30 @@ public:
 	//! Returns compared entity
 	ccHObject* getReferenceEntity() { return m_refEnt; }
 
+	//! Determines the best octree level for computing the distances
+	/** Relies on the approximate distances and on a (rough) timing model.
+		\param compOctree compared cloud's octree
+		\param approxDistances approximate distances (one per point of the compared cloud)
+		\param refOctree reference cloud's octree (cloud/cloud case only)
+		\param refMesh reference mesh (cloud/mesh case only)
+		\param maxSearchDist max search distance (or 0 if none)
+		\param progressCb progress callback (optional)
+		\return the best octree level (or -1 if an error occurred)
+	**/
+	static int DetermineBestOctreeLevel(	const CCLib::DgmOctree* compOctree,
+											const CCLib::ScalarField* approxDistances,
+											const CCLib::DgmOctree* refOctree,
+											CCLib::GenericIndexedMesh* refMesh,
+											double maxSearchDist,
+											CCLib::GenericProgressCallback* progressCb = 0);
+
+	//! Returns the (final) name of the distances scalar field
+	static QString GetDistancesSFName(	CC_COMPARISON_TYPE cpType,
+										const CCLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams& c2cParams,
+										bool signedDistances,
+										bool flipNormals,
+										double maxSearchDist);
+
 public slots:
 	bool computeDistances();
 	void applyAndExit();
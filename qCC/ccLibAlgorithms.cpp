@@ -611,6 +611,8 @@ namespace ccLibAlgorithms
 								 false,
 								 transformationFilters,
 								 0,
+								 false,
+								 false,
 								 parent))
 						{
 							scales[i] = finalScale;
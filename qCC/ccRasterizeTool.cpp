@@ -728,12 +728,12 @@ bool ccRasterizeTool::updateGrid(bool interpolateSF/*=false*/)
 		unsigned filledCellCount = 0;
 		for (unsigned j = 0; j < m_grid.height; ++j)
 		{
-			const ccRasterGrid::Row& row = m_grid.rows[j];
 			for (unsigned i = 0; i < m_grid.width; ++i)
 			{
-				if (std::isfinite(row[i].h))
+				double h = m_grid.cellHeight(i, j);
+				if (std::isfinite(h))
 				{
-					hSum += row[i].h;
+					hSum += h;
 					++filledCellCount;
 				}
 			}
@@ -878,6 +878,7 @@ void ccRasterizeTool::generateMesh() const
 
 //system
 #include <assert.h>
+#include <functional>
 
 class RasterExportOptionsDlg
 	: public QDialog
@@ -904,11 +905,11 @@ void ccRasterizeTool::generateRaster() const
 		return;
 	}
 
-	bool hasScalarFields = !m_grid.scalarFields.empty();
+	bool hasScalarFields = (m_grid.scalarFieldCount != 0);
 	int visibleSfIndex = -1;
 	if (activeLayerComboBox->currentData().toInt() == LAYER_SF && m_cloud->isA(CC_TYPES::POINT_CLOUD))
 	{
-		//the indexes in the 'm_grid.scalarFields' are the same as in the cloud
+		//the indexes of the grid scalar fields are the same as in the cloud
 		visibleSfIndex = static_cast<ccPointCloud*>(m_cloud)->getScalarFieldIndexByName(qPrintable(activeLayerComboBox->currentText()));
 	}
 
@@ -1083,13 +1084,10 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 	
 	if (exportBands.allSFs)
 	{
-		for (size_t i = 0; i < grid.scalarFields.size(); ++i)
+		if (grid.scalarFieldCount != 0)
 		{
-			if (!grid.scalarFields[i].empty())
-			{
-				++totalBands;
-				onlyRGBA = false;
-			}
+			totalBands += static_cast<int>(grid.scalarFieldCount);
+			onlyRGBA = false;
 		}
 	}
 	else if (exportBands.visibleSF && visibleSfIndex >= 0)
@@ -1122,13 +1120,19 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 		return false;
 	}
 
+	//the raster is tiled (with blocks as big as the grid tiles), so that it can be written block by block
 	char **papszOptions = NULL;
+	papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+	papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", qPrintable(QString::number(ccRasterGrid::TILE_SIZE)));
+	papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", qPrintable(QString::number(ccRasterGrid::TILE_SIZE)));
 	GDALDataset* poDstDS = poDriver->Create(qPrintable(outputFilename),
 											static_cast<int>(grid.width),
 											static_cast<int>(grid.height),
 											totalBands,
 											onlyRGBA ? GDT_Byte : GDT_Float64,
 											papszOptions);
+	CSLDestroy(papszOptions);
+	papszOptions = NULL;
 
 	if (!poDstDS)
 	{
@@ -1156,6 +1160,55 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 	//poDstDS->SetProjection( pszSRS_WKT );
 	//CPLFree( pszSRS_WKT );
 
+	//buffer for one block
+	double* tileBuffer = (double*)CPLMalloc(sizeof(double) * ccRasterGrid::TILE_SIZE * ccRasterGrid::TILE_SIZE);
+	if (!tileBuffer)
+	{
+		ccLog::Error("[GDAL] Not enough memory");
+		GDALClose(poDstDS);
+		return false;
+	}
+
+	//writes a band block by block (only one block is kept in memory at a time)
+	//DGM: the GDAL blocks start at the top of the raster (Ymax) while the grid tiles start at its bottom (Ymin),
+	//so we follow the GDAL blocks (otherwise each write would straddle two rows of blocks if height % TILE_SIZE != 0)
+	auto writeBand = [&](GDALRasterBand* band, const std::function<double(unsigned, unsigned)>& cellValue) -> bool
+	{
+		for (unsigned r0 = 0; r0 < grid.height; r0 += ccRasterGrid::TILE_SIZE)
+		{
+			unsigned blockHeight = std::min(static_cast<unsigned>(ccRasterGrid::TILE_SIZE), grid.height - r0);
+
+			for (unsigned i0 = 0; i0 < grid.width; i0 += ccRasterGrid::TILE_SIZE)
+			{
+				unsigned blockWidth = std::min(static_cast<unsigned>(ccRasterGrid::TILE_SIZE), grid.width - i0);
+
+				double* _tileBuffer = tileBuffer;
+				for (unsigned k = 0; k < blockHeight; ++k)
+				{
+					unsigned j = grid.height - 1 - (r0 + k); //the first row is the northest one (i.e. Ymax)
+					for (unsigned i = i0; i < i0 + blockWidth; ++i)
+					{
+						*_tileBuffer++ = cellValue(i, j);
+					}
+				}
+
+				if (band->RasterIO(	GF_Write,
+									static_cast<int>(i0),
+									static_cast<int>(r0),
+									static_cast<int>(blockWidth),
+									static_cast<int>(blockHeight),
+									tileBuffer,
+									static_cast<int>(blockWidth),
+									static_cast<int>(blockHeight),
+									GDT_Float64, 0, 0) != CE_None)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+
 	int currentBand = 0;
 
 	//exort RGB band?
@@ -1168,14 +1221,6 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 		rgbBands[1]->SetColorInterpretation(GCI_GreenBand);
 		rgbBands[2]->SetColorInterpretation(GCI_BlueBand);
 
-		unsigned char* cLine = (unsigned char*)CPLMalloc(sizeof(unsigned char)*grid.width);
-		if (!cLine)
-		{
-			ccLog::Error("[GDAL] Not enough memory");
-			GDALClose(poDstDS);
-			return false;
-		}
-
 		bool error = false;
 		
 		//export the R, G and B components
@@ -1183,20 +1228,14 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 		{
 			rgbBands[k]->SetStatistics(0, 255, 128, 0); //warning: arbitrary average and std. dev. values
 
-			for (unsigned j = 0; j<grid.height; ++j)
-			{
-				const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j]; //the first row is the northest one (i.e. Ymax)
-				for (unsigned i = 0; i<grid.width; ++i)
-				{
-					cLine[i] = (std::isfinite(row[i].h) ? static_cast<unsigned char>(std::max(0.0, std::min(255.0, row[i].color.u[k]))) : 0);
-				}
-
-				if (rgbBands[k]->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, cLine, static_cast<int>(grid.width), 1, GDT_Byte, 0, 0) != CE_None)
+			if (!writeBand(rgbBands[k], [&](unsigned i, unsigned j) -> double
 				{
-					error = true;
-					k = 3; //early stop
-					break;
-				}
+					ccRasterCell cell = grid.cell(i, j);
+					return (std::isfinite(cell.h) ? static_cast<unsigned char>(std::max(0.0, std::min(255.0, cell.color.u[k]))) : 0);
+				}))
+			{
+				error = true;
+				break;
 			}
 		}
 
@@ -1207,40 +1246,18 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 			aBand->SetColorInterpretation(GCI_AlphaBand);
 			aBand->SetStatistics(0, 255, 255, 0); //warning: arbitrary average and std. dev. values
 
-			for (unsigned j = 0; j<grid.height; ++j)
-			{
-				const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-				for (unsigned i = 0; i<grid.width; ++i)
-				{
-					cLine[i] = (std::isfinite(row[i].h) ? 255 : 0);
-				}
-
-				if (aBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, cLine, static_cast<int>(grid.width), 1, GDT_Byte, 0, 0) != CE_None)
-				{
-					error = true;
-					break;
-				}
-			}
+			error = !writeBand(aBand, [&](unsigned i, unsigned j) { return (std::isfinite(grid.cellHeight(i, j)) ? 255.0 : 0.0); });
 		}
 
-		CPLFree(cLine);
-
 		if (error)
 		{
 			ccLog::Error("[GDAL] An error occurred while writing the color bands!");
+			CPLFree(tileBuffer);
 			GDALClose(poDstDS);
 			return false;
 		}
 	}
 
-	double* scanline = (double*)CPLMalloc(sizeof(double)*grid.width);
-	if (!scanline)
-	{
-		ccLog::Error("[GDAL] Not enough memory");
-		GDALClose(poDstDS);
-		return false;
-	}
-
 	//exort height band?
 	if (exportBands.height)
 	{
@@ -1272,22 +1289,16 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 			assert(false);
 		}
 
-		for (unsigned j = 0; j < grid.height; ++j)
-		{
-			const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-			for (unsigned i = 0; i<grid.width; ++i)
-			{
-				scanline[i] = std::isfinite(row[i].h) ? row[i].h : emptyCellHeight;
-			}
-
-			if (poBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, scanline, static_cast<int>(grid.width), 1, GDT_Float64, 0, 0) != CE_None)
+		if (!writeBand(poBand, [&](unsigned i, unsigned j) -> double
 			{
-				ccLog::Error("[GDAL] An error occurred while writing the height band!");
-				if (scanline)
-					CPLFree(scanline);
-				GDALClose(poDstDS);
-				return false;
-			}
+				double h = grid.cellHeight(i, j);
+				return std::isfinite(h) ? h : emptyCellHeight;
+			}))
+		{
+			ccLog::Error("[GDAL] An error occurred while writing the height band!");
+			CPLFree(tileBuffer);
+			GDALClose(poDstDS);
+			return false;
 		}
 	}
 
@@ -1297,73 +1308,42 @@ bool ccRasterizeTool::ExportGeoTiff(QString outputFilename,
 		GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
 		assert(poBand);
 		poBand->SetColorInterpretation(GCI_Undefined);
-		for (unsigned j = 0; j < grid.height; ++j)
-		{
-			const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-			for (unsigned i = 0; i < grid.width; ++i)
-			{
-				scanline[i] = row[i].nbPoints;
-			}
 
-			if (poBand->RasterIO(GF_Write, 0, static_cast<int>(j), static_cast<int>(grid.width), 1, scanline, static_cast<int>(grid.width), 1, GDT_Float64, 0, 0) != CE_None)
-			{
-				ccLog::Error("[GDAL] An error occurred while writing the height band!");
-				if (scanline)
-					CPLFree(scanline);
-				GDALClose(poDstDS);
-				return false;
-			}
+		if (!writeBand(poBand, [&](unsigned i, unsigned j) { return static_cast<double>(grid.cellPointCount(i, j)); }))
+		{
+			ccLog::Error("[GDAL] An error occurred while writing the height band!");
+			CPLFree(tileBuffer);
+			GDALClose(poDstDS);
+			return false;
 		}
 	}
 
 	//export SF bands
 	if (exportBands.allSFs || (exportBands.visibleSF && visibleSfIndex >= 0))
 	{
-		for (size_t k = 0; k < grid.scalarFields.size(); ++k)
+		for (unsigned k = 0; k < grid.scalarFieldCount; ++k)
 		{
-			assert(!grid.scalarFields[k].empty());
 			if (exportBands.allSFs || (exportBands.visibleSF && visibleSfIndex == static_cast<int>(k)))
 			{
-				const double* sfGrid = &(grid.scalarFields[k].front());
 				GDALRasterBand* poBand = poDstDS->GetRasterBand(++currentBand);
 
-				double sfNanValue = std::numeric_limits<ccRasterGrid::SF::value_type>::quiet_NaN();
+				double sfNanValue = std::numeric_limits<double>::quiet_NaN();
 				poBand->SetNoDataValue(sfNanValue); //should be transparent!
 				assert(poBand);
 				poBand->SetColorInterpretation(GCI_Undefined);
 
-				for (unsigned j = 0; j < grid.height; ++j)
+				if (!writeBand(poBand, [&](unsigned i, unsigned j) { return grid.cellPointCount(i, j) ? grid.cellSFValue(k, i, j) : sfNanValue; }))
 				{
-					const ccRasterGrid::Row& row = grid.rows[grid.height - 1 - j];
-					const double* sfRow = sfGrid + (grid.height - 1 - j) * grid.width;
-					for (unsigned i = 0; i < grid.width; ++i)
-					{
-						scanline[i] = row[i].nbPoints ? sfRow[i] : sfNanValue;
-					}
-
-					if (poBand->RasterIO(	GF_Write,
-											0,
-											static_cast<int>(j),
-											static_cast<int>(grid.width),
-											1,
-											scanline,
-											static_cast<int>(grid.width),
-											1,
-											GDT_Float64, 0, 0 ) != CE_None)
-					{
-						//the corresponding SF should exist on the input cloud
-						ccLog::Error(QString("[GDAL] An error occurred while writing a scalar field band!"));
-						k = grid.scalarFields.size(); //quick stop
-						break;
-					}
+					//the corresponding SF should exist on the input cloud
+					ccLog::Error(QString("[GDAL] An error occurred while writing a scalar field band!"));
+					break;
 				}
 			}
 		}
 	}
 
-	if (scanline)
-		CPLFree(scanline);
-	scanline = 0;
+	CPLFree(tileBuffer);
+	tileBuffer = 0;
 
 	/* Once we're done, close properly the dataset */
 	GDALClose(poDstDS);
@@ -1433,12 +1413,10 @@ void ccRasterizeTool::generateHillshade()
 	unsigned validCellIndex = 0;
 	for (unsigned j = (sparseSF ? 0 : 1); j < m_grid.height - 1; ++j)
 	{
-		const ccRasterGrid::Row& row = m_grid.rows[j];
-		
 		for (unsigned i=sparseSF ? 0 : 1; i<m_grid.width; ++i)
 		{
 			//valid height value
-			if (std::isfinite(row[i].h))
+			if (std::isfinite(m_grid.cellHeight(i, j)))
 			{
 				if (i != 0 && i + 1 != m_grid.width && j != 0)
 				{
@@ -1451,20 +1429,20 @@ void ccRasterizeTool::generateHillshade()
 					{
 						for (int dj=-1; dj<=1; ++dj)
 						{
-							const ccRasterCell& n = m_grid.rows[j - dj][i + di]; //-dj (instead of + dj) because we scan the grid in the reverse orientation! (from bottom to top)
-							if (n.h == n.h)
+							double nh = m_grid.cellHeight(i + di, j - dj); //-dj (instead of + dj) because we scan the grid in the reverse orientation! (from bottom to top)
+							if (nh == nh)
 							{
 								if (di != 0)
 								{
 									int dx_weight = (dj == 0 ? 2 : 1);
-									dz_dx += (di < 0 ? -1.0 : 1.0) * dx_weight * n.h;
+									dz_dx += (di < 0 ? -1.0 : 1.0) * dx_weight * nh;
 									dz_dx_count += dx_weight;
 								}
 
 								if (dj != 0)
 								{
 									int dy_weight = (di == 0 ? 2 : 1);
-									dz_dy += (dj < 0 ? -1.0 : 1.0) * dy_weight * n.h;
+									dz_dy += (dj < 0 ? -1.0 : 1.0) * dy_weight * nh;
 									dz_dy_count += dy_weight;
 								}
 							}
@@ -1564,7 +1542,7 @@ static CPLErr ContourWriter(	double dfLevel,
 		{
 			int xi = std::min(std::max(static_cast<int>(padfX[i]), 0), static_cast<int>(params->grid->width) - 1);
 			int yi = std::min(std::max(static_cast<int>(padfY[i]), 0), static_cast<int>(params->grid->height) - 1);
-			double h = params->grid->rows[yi][xi].h;
+			double h = params->grid->cellHeight(xi, yi);
 			if (std::isfinite(h))
 			{
 				P.z = static_cast<PointCoordinateType>(h);
@@ -1742,10 +1720,9 @@ void ccRasterizeTool::generateContours()
 
 		for (unsigned j = 0; j < m_grid.height; ++j)
 		{
-			const ccRasterGrid::Row& cellRow = m_grid.rows[j];
 			for (unsigned i = 0; i < m_grid.width; ++i)
 			{
-				if (cellRow[i].nbPoints || !sparseLayer)
+				if (m_grid.cellPointCount(i, j) || !sparseLayer)
 				{
 					ScalarType value = activeLayer->getValue(layerIndex++);
 					scanline[i] = ccScalarField::ValidValue(value) ? value : emptyCellsValue;
@@ -1853,11 +1830,10 @@ void ccRasterizeTool::generateContours()
 		unsigned layerIndex = 0;
 		for (unsigned j = 0; j < m_grid.height; ++j)
 		{
-			const ccRasterGrid::Row& cellRow = m_grid.rows[j];
 			double* row = &(grid[(j + margin)*xDim + margin]);
 			for (unsigned i = 0; i < m_grid.width; ++i)
 			{
-				if (cellRow[i].nbPoints || !sparseLayer)
+				if (m_grid.cellPointCount(i, j) || !sparseLayer)
 				{
 					ScalarType value = activeLayer->getValue(layerIndex++);
 					row[i] = ccScalarField::ValidValue(value) ? value : emptyCellsValue;
@@ -1941,7 +1917,7 @@ void ccRasterizeTool::generateContours()
 								{
 									int xi = std::min(std::max(static_cast<int>(x), 0), static_cast<int>(m_grid.width) - 1);
 									int yi = std::min(std::max(static_cast<int>(y), 0), static_cast<int>(m_grid.height) - 1);
-									double h = m_grid.rows[yi][xi].h;
+									double h = m_grid.cellHeight(xi, yi);
 									if (std::isfinite(h))
 									{
 										/*P.u[Z] = */P.z = static_cast<PointCoordinateType>(h);
@@ -2214,12 +2190,12 @@ void ccRasterizeTool::generateImage() const
 		// Filling the image with grid values
 		for (unsigned j = 0; j < m_grid.height; ++j)
 		{
-			const ccRasterGrid::Row& row = m_grid.rows[j];
 			for (unsigned i = 0; i < m_grid.width; ++i)
 			{
-				if (std::isfinite(row[i].h))
+				double h = m_grid.cellHeight(i, j);
+				if (std::isfinite(h))
 				{
-					double normalizedHeight = (row[i].h - minHeight) / range;
+					double normalizedHeight = (h - minHeight) / range;
 					assert(normalizedHeight >= 0.0 && normalizedHeight <= 1.0);
 					unsigned char val = static_cast<unsigned char>(floor(normalizedHeight*maxColorComp));
 					bitmap8.setPixel(i, m_grid.height - 1 - j, val);
@@ -2294,10 +2270,10 @@ void ccRasterizeTool::generateASCIIMatrix() const
 	getFillEmptyCellsStrategyExt(emptyCellsHeight, minHeight, maxHeight);
 	for (unsigned j = 0; j < m_grid.height; ++j)
 	{
-		const ccRasterGrid::Row& row = m_grid.rows[m_grid.height - 1 - j];
 		for (unsigned i = 0; i < m_grid.width; ++i)
 		{
-			fprintf(pFile, "%.8f ", std::isfinite(row[i].h) ? row[i].h : emptyCellsHeight);
+			double h = m_grid.cellHeight(i, m_grid.height - 1 - j);
+			fprintf(pFile, "%.8f ", std::isfinite(h) ? h : emptyCellsHeight);
 		}
 
 		fprintf(pFile, "\n");
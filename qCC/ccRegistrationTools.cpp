@@ -60,6 +60,8 @@ bool ccRegistrationTools::ICP(	ccHObject* data,
 								bool useModelSFAsWeights/*=false*/,
 								int filters/*=CCLib::ICPRegistrationTools::SKIP_NONE*/,
 								int maxThreadCount/*=0*/,
+								bool useStaticModelIndex/*=false*/,
+								bool pointToPlane/*=false*/,
 								QWidget* parent/*=0*/)
 {
 	//progress bar
@@ -256,6 +258,32 @@ bool ccRegistrationTools::ICP(	ccHObject* data,
 		}
 	}
 
+	//model normals (point-to-plane variant)
+	std::vector<CCVector3> modelNormals;
+	if (pointToPlane)
+	{
+		ccPointCloud* pc = (!modelMesh && model->isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(model) : 0);
+		if (!pc || !pc->hasNormals())
+		{
+			ccLog::Error("[ICP] The point-to-plane variant requires a model point cloud with normals!");
+			return false;
+		}
+		unsigned count = pc->size();
+		try
+		{
+			modelNormals.resize(count);
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Error("Not enough memory!");
+			return false;
+		}
+		for (unsigned i=0; i<count; ++i)
+		{
+			modelNormals[i] = pc->getPointNormal(i);
+		}
+	}
+
 	CCLib::ICPRegistrationTools::RESULT_TYPE result;
 	CCLib::PointProjectionTools::Transformation transform;
 	CCLib::ICPRegistrationTools::Parameters params;
@@ -271,6 +299,9 @@ bool ccRegistrationTools::ICP(	ccHObject* data,
 		params.dataWeights = dataWeights;
 		params.transformationFilters = filters;
 		params.maxThreadCount = maxThreadCount;
+		params.useStaticModelIndex = useStaticModelIndex;
+		params.pointToPlane = pointToPlane;
+		params.modelNormals = (pointToPlane ? &modelNormals : 0);
 	}
 
 	result = CCLib::ICPRegistrationTools::Register(	modelCloud,
@@ -36,6 +36,7 @@ public:
 
 	//! Applies ICP registration on two entities
 	/** \warning Automatically samples points on meshes if necessary (see code for magic numbers ;)
+		\warning The point-to-plane variant requires a model point cloud with normals
 	**/
 	static bool ICP(ccHObject* data,
 					ccHObject* model,
@@ -54,6 +55,8 @@ public:
 					bool useModelSFAsWeights = false,
 					int transformationFilters = CCLib::ICPRegistrationTools::SKIP_NONE,
 					int maxThreadCount = 0,
+					bool useStaticModelIndex = false,
+					bool pointToPlane = false,
 					QWidget* parent = 0);
 
 };
@@ -38,6 +38,7 @@
 //CCLib
 #include <Delaunay2dMesh.h>
 #include <PointProjectionTools.h>
+#include <ParallelTools.h>
 
 //Qt
 #include <QSettings>
@@ -50,6 +51,7 @@
 
 //System
 #include <assert.h>
+#include <atomic>
 
 ccVolumeCalcTool::ccVolumeCalcTool(ccGenericPointCloud* cloud1, ccGenericPointCloud* cloud2, QWidget* parent/*=0*/)
 	: QDialog(parent, Qt::WindowMaximizeButtonHint | Qt::WindowCloseButtonHint)
@@ -555,7 +557,8 @@ bool ccVolumeCalcTool::ComputeVolume(	ccRasterGrid& grid,
 
 	//memory allocation
 	CCVector3d minCorner = CCVector3d::fromArray(gridBox.minCorner().u);
-	if (!grid.init(gridWidth, gridHeight, gridStep, minCorner))
+	//we only need the height (and population) layers
+	if (!grid.init(gridWidth, gridHeight, gridStep, minCorner, ccRasterGrid::NO_OPTIONAL_LAYER))
 	{
 		//not enough memory
 		return SendError("Not enough memory", parentWidget);
@@ -571,7 +574,7 @@ bool ccVolumeCalcTool::ComputeVolume(	ccRasterGrid& grid,
 	ccRasterGrid groundRaster;
 	if (ground)
 	{
-		if (!groundRaster.init(gridWidth, gridHeight, gridStep, minCorner))
+		if (!groundRaster.init(gridWidth, gridHeight, gridStep, minCorner, ccRasterGrid::NO_OPTIONAL_LAYER))
 		{
 			//not enough memory
 			return SendError("Not enough memory", parentWidget);
@@ -597,7 +600,7 @@ bool ccVolumeCalcTool::ComputeVolume(	ccRasterGrid& grid,
 	ccRasterGrid ceilRaster;
 	if (ceil)
 	{
-		if (!ceilRaster.init(gridWidth, gridHeight, gridStep, minCorner))
+		if (!ceilRaster.init(gridWidth, gridHeight, gridStep, minCorner, ccRasterGrid::NO_OPTIONAL_LAYER))
 		{
 			//not enough memory
 			return SendError("Not enough memory", parentWidget);
@@ -631,77 +634,144 @@ bool ccVolumeCalcTool::ComputeVolume(	ccRasterGrid& grid,
 		}
 		CCLib::NormalizedProgress nProgress(pDlg.data(), grid.width * grid.height);
 		
+		//partial sums (per tile)
+		struct TileSums
+		{
+			TileSums() : volume(0), addedVolume(0), removedVolume(0), surface(0), matchingCount(0), ceilNonMatchingCount(0), groundNonMatchingCount(0), cellCount(0) {}
+
+			double volume;
+			double addedVolume;
+			double removedVolume;
+			double surface;
+			unsigned matchingCount;
+			unsigned ceilNonMatchingCount;
+			unsigned groundNonMatchingCount;
+			unsigned cellCount;
+		};
+		std::vector<TileSums> tileSums;
+		try
+		{
+			tileSums.resize(grid.tiles.size());
+		}
+		catch (const std::bad_alloc&)
+		{
+			return SendError("Not enough memory", parentWidget);
+		}
+
+		//at least one of the grid is based on a cloud (the tiles are processed in parallel)
+		CCLib::ParallelCancelToken cancelToken;
+		std::atomic<bool> notEnoughMemory(false);
+		const unsigned tileCountX = grid.tileCountX();
+		CCLib::ParallelTools::ForEach(	static_cast<unsigned>(grid.tiles.size()),
+										[&](unsigned t)
+										{
+											const unsigned tx = t % tileCountX;
+											const unsigned ty = t / tileCountX;
+											ccRasterGrid::Tile* tile = grid.getOrCreateTile(tx, ty);
+											if (!tile)
+											{
+												notEnoughMemory = true;
+												cancelToken.cancel();
+												return;
+											}
+
+											const unsigned i0 = tx << ccRasterGrid::TILE_SIZE_SHIFT;
+											const unsigned j0 = ty << ccRasterGrid::TILE_SIZE_SHIFT;
+											TileSums& sums = tileSums[t];
+
+											for (unsigned lj = 0; lj < tile->height; ++lj)
+											{
+												for (unsigned li = 0; li < tile->width; ++li)
+												{
+													const unsigned index = tile->cellIndex(li, lj);
+
+													bool validGround = true;
+													double minHeight = groundHeight;
+													if (ground)
+													{
+														minHeight = groundRaster.cellHeight(i0 + li, j0 + lj);
+														validGround = std::isfinite(minHeight);
+													}
+
+													bool validCeil = true;
+													double maxHeight = ceilHeight;
+													if (ceil)
+													{
+														maxHeight = ceilRaster.cellHeight(i0 + li, j0 + lj);
+														validCeil = std::isfinite(maxHeight);
+													}
+
+													if (validGround && validCeil)
+													{
+														double h = maxHeight - minHeight;
+														tile->h[index] = h;
+														tile->nbPoints[index] = 1;
+
+														sums.volume += h;
+														if (h < 0)
+														{
+															sums.removedVolume -= h;
+														}
+														else if (h > 0)
+														{
+															sums.addedVolume += h;
+														}
+														sums.surface += 1.0;
+														++sums.matchingCount;
+														++sums.cellCount;
+													}
+													else
+													{
+														if (validGround)
+														{
+															++sums.cellCount;
+															++sums.groundNonMatchingCount;
+														}
+														else if (validCeil)
+														{
+															++sums.cellCount;
+															++sums.ceilNonMatchingCount;
+														}
+														tile->h[index] = std::numeric_limits<double>::quiet_NaN();
+														tile->nbPoints[index] = 0;
+													}
+												}
+											}
+
+											if (pDlg && !nProgress.steps(tile->width * tile->height))
+											{
+												cancelToken.cancel();
+											}
+										},
+										0,
+										&cancelToken,
+										1 );
+
+		if (notEnoughMemory)
+		{
+			return SendError("Not enough memory", parentWidget);
+		}
+		else if (cancelToken.isCanceled())
+		{
+			ccLog::Warning("[Volume] Process cancelled by the user");
+			return false;
+		}
+
+		//merge the partial sums (always in the same order)
 		size_t ceilNonMatchingCount = 0;
 		size_t groundNonMatchingCount = 0;
 		size_t cellCount = 0;
-
-		//at least one of the grid is based on a cloud
 		grid.nonEmptyCellCount = 0;
-		for (unsigned i = 0; i < grid.height; ++i)
+		for (const TileSums& sums : tileSums)
 		{
-			for (unsigned j = 0; j < grid.width; ++j)
-			{
-				ccRasterCell& cell = grid.rows[i][j];
-
-				bool validGround = true;
-				cell.minHeight = groundHeight;
-				if (ground)
-				{
-					cell.minHeight = groundRaster.rows[i][j].h;
-					validGround = std::isfinite(cell.minHeight);
-				}
-
-				bool validCeil = true;
-				cell.maxHeight = ceilHeight;
-				if (ceil)
-				{
-					cell.maxHeight = ceilRaster.rows[i][j].h;
-					validCeil = std::isfinite(cell.maxHeight);
-				}
-
-				if (validGround && validCeil)
-				{
-					cell.h = cell.maxHeight - cell.minHeight;
-					cell.nbPoints = 1;
-
-					reportInfo.volume += cell.h;
-					if (cell.h < 0)
-					{
-						reportInfo.removedVolume -= cell.h;
-					}
-					else if (cell.h > 0)
-					{
-						reportInfo.addedVolume += cell.h;
-					}
-					reportInfo.surface += 1.0;
-					++grid.nonEmptyCellCount; //= matching count
-					++cellCount;
-				}
-				else
-				{
-					if (validGround)
-					{
-						++cellCount;
-						++groundNonMatchingCount;
-					}
-					else if (validCeil)
-					{
-						++cellCount;
-						++ceilNonMatchingCount;
-					}
-					cell.h = std::numeric_limits<double>::quiet_NaN();
-					cell.nbPoints = 0;
-				}
-
-				cell.avgHeight = (groundHeight + ceilHeight) / 2;
-				cell.stdDevHeight = 0;
-
-				if (pDlg && !nProgress.oneStep())
-				{
-					ccLog::Warning("[Volume] Process cancelled by the user");
-					return false;
-				}
-			}
+			reportInfo.volume += sums.volume;
+			reportInfo.addedVolume += sums.addedVolume;
+			reportInfo.removedVolume += sums.removedVolume;
+			reportInfo.surface += sums.surface;
+			grid.nonEmptyCellCount += sums.matchingCount; //= matching count
+			ceilNonMatchingCount += sums.ceilNonMatchingCount;
+			groundNonMatchingCount += sums.groundNonMatchingCount;
+			cellCount += sums.cellCount;
 		}
 		grid.validCellCount = grid.nonEmptyCellCount;
 
@@ -713,8 +783,7 @@ bool ccVolumeCalcTool::ComputeVolume(	ccRasterGrid& grid,
 			{
 				for (unsigned j = 1; j < grid.width - 1; ++j)
 				{
-					ccRasterCell& cell = grid.rows[i][j];
-					if (cell.h == cell.h)
+					if (std::isfinite(grid.cellHeight(j, i)))
 					{
 						for (unsigned k = i - 1; k <= i + 1; ++k)
 						{
@@ -722,8 +791,7 @@ bool ccVolumeCalcTool::ComputeVolume(	ccRasterGrid& grid,
 							{
 								if (k != i || l != j)
 								{
-									ccRasterCell& otherCell = grid.rows[k][l];
-									if (std::isfinite(otherCell.h))
+									if (std::isfinite(grid.cellHeight(l, k)))
 									{
 										++validNeighborsCount;
 									}
@@ -22,6 +22,7 @@
 #include <Delaunay2dMesh.h>
 #include <Jacobi.h>
 #include <MeshSamplingTools.h>
+#include <NeighbourStatsCache.h>
 #include <NormalDistribution.h>
 #include <ScalarFieldTools.h>
 #include <SimpleCloud.h>
@@ -3544,6 +3545,8 @@ void MainWindow::doActionRegister()
 									useModelSFAsWeights,
 									transformationFilters,
 									maxThreadCount,
+									false,
+									false,
 									this))
 	{
 		QString rmsString = QString("Final RMS: %1 (computed on %2 points)").arg(finalError).arg(finalPointCount);
@@ -5248,6 +5251,70 @@ void MainWindow::doActionMatchScales()
 	updateUI();
 }
 
+//! Neighbourhood statistics of the last cloud processed by the SOR or the noise filter
+/** The statistics are released as soon as the cloud is deleted or its geometry modified
+	(this object is notified through the dependency mechanism).
+**/
+class ccFilterStatsCache : public ccHObject
+{
+public:
+
+	//! Default constructor
+	ccFilterStatsCache() : ccHObject("Filter statistics cache"), m_cloud(nullptr) {}
+
+	//! Destructor
+	~ccFilterStatsCache() override { release(); }
+
+	//! Returns the statistics cache (bound to a given cloud)
+	CCLib::NeighbourStatsCache& bind(ccPointCloud* cloud)
+	{
+		if (cloud != m_cloud)
+		{
+			release();
+			m_cloud = cloud;
+			m_cloud->addDependency(this, DP_NOTIFY_OTHER_ON_DELETE | DP_NOTIFY_OTHER_ON_UPDATE);
+		}
+		return m_stats;
+	}
+
+	//! Releases the statistics (and the associated cloud)
+	void release()
+	{
+		if (m_cloud)
+		{
+			m_cloud->removeDependencyWith(this);
+			removeDependencyWith(m_cloud);
+			m_cloud = nullptr;
+		}
+		m_stats.clear();
+	}
+
+protected:
+
+	//inherited from ccHObject
+	void onDeletionOf(const ccHObject* obj) override
+	{
+		if (obj == m_cloud)
+		{
+			m_cloud = nullptr;
+			m_stats.clear();
+		}
+		ccHObject::onDeletionOf(obj);
+	}
+	void onUpdateOf(ccHObject* obj) override
+	{
+		if (obj == m_cloud)
+		{
+			m_stats.clear();
+		}
+	}
+
+	//! Associated cloud
+	ccPointCloud* m_cloud;
+	//! Cached statistics
+	CCLib::NeighbourStatsCache m_stats;
+};
+
 void MainWindow::doActionSORFilter()
 {
 	ccSORFilterDlg sorDlg(this);
@@ -5255,6 +5322,9 @@ void MainWindow::doActionSORFilter()
 	//set semi-persistent/dynamic parameters
 	static int s_sorFilterKnn = 6;
 	static double s_sorFilterNSigma = 1.0;
+	//the statistics of the last filtered cloud are kept (so as to apply the filter
+	//again with another threshold without extracting the neighbors again)
+	static ccFilterStatsCache s_sorCache;
 	sorDlg.knnSpinBox->setValue(s_sorFilterKnn);
 	sorDlg.nSigmaDoubleSpinBox->setValue(s_sorFilterNSigma);
 	if (!sorDlg.exec())
@@ -5283,11 +5353,17 @@ void MainWindow::doActionSORFilter()
 		}
 
 		//computation
-		CCLib::ReferenceCloud* selection = CCLib::CloudSamplingTools::sorFilter(cloud,
-																				s_sorFilterKnn,
-																				s_sorFilterNSigma,
-																				0,
-																				&pDlg);
+		CCLib::ReferenceCloud* selection = nullptr;
+		if (cloud)
+		{
+			//we only keep the mean distances for the requested number of neighbors (one value per point)
+			CCLib::NeighbourStatsCache& stats = s_sorCache.bind(cloud);
+			if (	stats.hasKnnMeanDistances(cloud, s_sorFilterKnn)
+				||	stats.computeKnnMeanDistances(cloud, s_sorFilterKnn, s_sorFilterKnn, cloud->getOctree().data(), &pDlg))
+			{
+				selection = stats.sorFilter(s_sorFilterKnn, s_sorFilterNSigma);
+			}
+		}
 
 		if (selection && cloud)
 		{
@@ -5354,6 +5430,9 @@ void MainWindow::doActionFilterNoise()
 	static double s_noiseFilterAbsError = 1.0;
 	static double s_noiseFilterNSigma = 1.0;
 	static bool s_noiseFilterRemoveIsolatedPoints = false;
+	//the distances of the last filtered cloud are kept (so as to apply the filter
+	//again with other thresholds without extracting the neighbors again)
+	static ccFilterStatsCache s_noiseCache;
 	noiseDlg.radiusDoubleSpinBox->setValue(kernelRadius);
 	noiseDlg.knnSpinBox->setValue(s_noiseFilterKnn);
 	noiseDlg.nSigmaDoubleSpinBox->setValue(s_noiseFilterNSigma);
@@ -5399,16 +5478,19 @@ void MainWindow::doActionFilterNoise()
 		}
 
 		//computation
-		CCLib::ReferenceCloud* selection = CCLib::CloudSamplingTools::noiseFilter(	cloud,
-																					kernelRadius,
-																					s_noiseFilterNSigma,
-																					s_noiseFilterRemoveIsolatedPoints,
-																					s_noiseFilterUseKnn,
-																					s_noiseFilterKnn,
-																					s_noiseFilterUseAbsError,
-																					s_noiseFilterAbsError,
-																					0,
-																					&pDlg);
+		CCLib::ReferenceCloud* selection = nullptr;
+		if (cloud)
+		{
+			CCLib::NeighbourStatsCache& stats = s_noiseCache.bind(cloud);
+			if (	stats.hasPlaneDistances(cloud, kernelRadius, s_noiseFilterUseKnn, s_noiseFilterKnn)
+				||	stats.computePlaneDistances(cloud, kernelRadius, s_noiseFilterUseKnn, s_noiseFilterKnn, cloud->getOctree().data(), &pDlg))
+			{
+				selection = stats.noiseFilter(	s_noiseFilterNSigma,
+												s_noiseFilterRemoveIsolatedPoints,
+												s_noiseFilterUseAbsError,
+												s_noiseFilterAbsError);
+			}
+		}
 
 		if (selection && cloud)
 		{